@@ -124,16 +124,16 @@ void argconfig_print_help(const char *program_desc,
 {
 	const struct argconfig_commandline_options *s;
 
-	printf("\033[1mUsage: %s\033[0m\n\n",
-	       append_usage_str);
+	fprintf(stderr, "\033[1mUsage: %s\033[0m\n\n",
+		append_usage_str);
 
 	print_word_wrapped(program_desc, 0, 0);
-	printf("\n");
+	fprintf(stderr, "\n");
 
 	if (!options || !options->option)
 		return;
 
-	printf("\n\033[1mOptions:\033[0m\n");
+	fprintf(stderr, "\n\033[1mOptions:\033[0m\n");
 	for (s = options; (s->option != NULL) && (s != NULL); s++)
 		show_option(s);
 }
@@ -6,11 +6,11 @@ _cmds="list id-ctrl id-ns list-ns create-ns delete-ns \
 	attach-ns detach-ns list-ctrl get-ns-id get-log \
 	fw-log smart-log smart-log-add error-log \
 	get-feature set-feature format fw-activate \
-	fw-download admin-passthru io-passthru security-send \
+	fw-download fw-update admin-passthru io-passthru security-send \
 	security-recv resv-acquire resv-register resv-release \
-	resv-report dsm flush compare read write write-zeroes \
+	resv-report dsm flush compare read write latency write-zeroes \
 	write-uncor reset subsystem-reset show-regs discover \
-	connect-all connect disconnect version help \
+	connect-all connect disconnect version daemon batch help \
 	intel lnvm memblaze list-subsys"
 
 nvme_list_opts () {
@@ -32,7 +32,7 @@ nvme_list_opts () {
 
 	case "$1" in
 		"list")
-		opts=""
+		opts+=" --output-format= -o --timeout= -t --sysfs -s"
 		;;
 		"id-ctrl")
 		opts+=" --raw-binary -b --human-readable -H \
@@ -99,7 +99,11 @@ nvme_list_opts () {
 		opts+=" --action= -a --slot= -s"
 			;;
 		"fw-download")
-		opts+=" --fw= -f --xfer= -x --offset= -o"
+		opts+=" --fw= -f --xfer= -x --offset= -o --controllers= -C"
+			;;
+		"fw-update")
+		opts+=" --fw= -f --devices= -d --nqn= -n --revision= -r \
+			--slot= -s --action= -a --xfer= -x --jobs= -j --reset -R"
 			;;
 		"admin-passthru")
 		opts+=" --opcode= -o --flags= -f --prefil= -p --rsvd= -R \
@@ -154,7 +158,8 @@ nvme_list_opts () {
 			--metadata= -M --prinfo= -p --app-tag-mask= -m \
 			--app-tag= -a --limited-retry -l \
 			--force-unit-access -f --show-command -v \
-			--dry-run -w --latency -t"
+			--dry-run -w --latency -t --queue-depth= -q \
+			--iterations= -i --io-pattern= -P"
 			;;
 		"read")
 		opts+=" --start-block= -s --block-count= -c --data-size= -z \
@@ -162,7 +167,15 @@ nvme_list_opts () {
 			--metadata= -M --prinfo= -p --app-tag-mask= -m \
 			--app-tag= -a --limited-retry -l \
 			--force-unit-access -f --show-command -v \
-			--dry-run -w --latency -t"
+			--dry-run -w --latency -t --queue-depth= -q \
+			--iterations= -i --io-pattern= -P"
+			;;
+		"latency")
+		opts+=" --start-block= -s --block-count= -c --data-size= -z \
+			--metadata-size= -y --ref-tag= -r --prinfo= -p \
+			--app-tag-mask= -m --app-tag= -a --limited-retry -l \
+			--force-unit-access -f --write -w --iterations= -i \
+			--queue-depth= -q --io-pattern= -P --output-format= -o"
 			;;
 		"write")
 		opts+=" --start-block= -s --block-count= -c --data-size= -z \
@@ -170,7 +183,8 @@ nvme_list_opts () {
 			--metadata= -M --prinfo= -p --app-tag-mask= -m \
 			--app-tag= -a --limited-retry -l \
 			--force-unit-access -f --show-command -v \
-			--dry-run -w --latency -t"
+			--dry-run -w --latency -t --queue-depth= -q \
+			--iterations= -i --io-pattern= -P"
 			;;
 		"write-zeros")
 		opts+=" --namespace-id= -n --start-block= -s \
@@ -193,11 +207,12 @@ nvme_list_opts () {
 			;;
 		"discover")
 		opts+=" --transport= -t -traddr= -a -trsvcid= -s \
-			--hostnqn= -q --raw= -r"
+			--hostnqn= -q --raw= -r --monitor -M"
 			;;
 		"connect-all")
 		opts+=" --transport= -t --traddr= -a --trsvcid= -s
-			--hostnqn= -q --raw= -r"
+			--hostnqn= -q --raw= -r --jobs= -j --connect-timeout= -T
+			--monitor -M"
 			;;
 		"connect")
 		opts+=" --transport= -t --nqn= -n --traddr= -a --trsvcid -s \
@@ -210,6 +225,12 @@ nvme_list_opts () {
 		"version")
 		opts+=""
 			;;
+		"daemon")
+		opts+=" --socket= -S"
+			;;
+		"batch")
+		opts+=" --stop-on-error -e"
+			;;
 		"help")
 		opts=$_cmds
 			;;
@@ -227,7 +248,7 @@ _nvme_subcmds () {
 	_init_completion || return
 
 	if [[ ${#words[*]} -lt 3 ]]; then
-		COMPREPLY+=( $(compgen -W "$_cmds" -- $cur ) )
+		COMPREPLY+=( $(compgen -W "$_cmds --output-file=" -- $cur ) )
 	else
 		nvme_list_opts ${words[1]} $prev
 	fi
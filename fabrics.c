@@ -32,11 +32,18 @@
 #include <libgen.h>
 #include <sys/stat.h>
 #include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 
 #include "parser.h"
 #include "nvme-ioctl.h"
 #include "nvme-status.h"
 #include "fabrics.h"
+#include "nvme-output.h"
 
 #include "nvme.h"
 #include "argconfig.h"
@@ -68,15 +75,29 @@ static struct config {
 	int  data_digest;
 	bool persistent;
 	bool quiet;
+	int  nr_jobs;
+	int  connect_tmo;
+	int  monitor;
 } cfg = { NULL };
 
+/*
+ * Every command starts from the defaults. The daemon and batch run many
+ * commands in one process, and the strings of the last one are gone.
+ */
+static void cfg_reset(void)
+{
+	memset(&cfg, 0, sizeof(cfg));
+}
+
 #define BUF_SIZE		4096
 #define PATH_NVME_FABRICS	"/dev/nvme-fabrics"
 #define PATH_NVMF_DISC		"/etc/nvme/discovery.conf"
 #define PATH_NVMF_HOSTNQN	"/etc/nvme/hostnqn"
 #define PATH_NVMF_HOSTID	"/etc/nvme/hostid"
+#define PATH_NVMF_DISC_CACHE	"/run/nvme"
 #define MAX_DISC_ARGS		10
 #define MAX_DISC_RETRIES	10
+#define NVMF_DEF_CONNECT_JOBS	16
 
 enum {
 	OPT_INSTANCE,
@@ -314,7 +335,83 @@ enum {
 	DISC_NOT_EQUAL,
 };
 
-static int nvmf_get_log_page_discovery(const char *dev_path,
+/*
+ * The last log read from each discovery controller is kept under
+ * PATH_NVMF_DISC_CACHE, in the format --raw writes. The file is named
+ * after the address of the controller and the host NQN, which is what
+ * the content of the log depends on. A cached log is only used if the
+ * generation counter and number of records in the header just read
+ * from the controller match it.
+ */
+static void disc_cache_path(char *argstr, char *path, size_t len)
+{
+	static const char * const fields[] = {
+		"transport", "traddr", "trsvcid", "host_traddr", "hostnqn",
+	};
+	unsigned long long hash = 14695981039346656037ULL;
+	char *val, *p;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fields); i++) {
+		val = __parse_connect_arg(argstr, ',', fields[i]);
+		for (p = val; p && *p; p++)
+			hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+		/* separator, so that "a","bc" differs from "ab","c" */
+		hash = (hash ^ 0xff) * 1099511628211ULL;
+		free(val);
+	}
+	snprintf(path, len, "%s/discovery-%016llx", PATH_NVMF_DISC_CACHE,
+		 hash);
+}
+
+static struct nvmf_disc_rsp_page_hdr *
+disc_cache_load(const char *path, __u64 genctr, __u64 numrec)
+{
+	struct nvmf_disc_rsp_page_hdr *log;
+	struct stat st;
+	size_t size;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	size = sizeof(*log) + numrec *
+		sizeof(struct nvmf_disc_rsp_page_entry);
+	log = malloc(size);
+	if (!log || fstat(fd, &st) < 0 || st.st_size != size ||
+	    read(fd, log, size) != size ||
+	    le64_to_cpu(log->genctr) != genctr ||
+	    le64_to_cpu(log->numrec) != numrec) {
+		free(log);
+		log = NULL;
+	}
+	close(fd);
+	return log;
+}
+
+static void disc_cache_store(const char *path,
+			     const struct nvmf_disc_rsp_page_hdr *log, int numrec)
+{
+	size_t size = sizeof(*log) +
+		numrec * sizeof(struct nvmf_disc_rsp_page_entry);
+	char tmp[PATH_MAX];
+	int fd;
+
+	mkdir(PATH_NVMF_DISC_CACHE, 0755);
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= sizeof(tmp))
+		return;
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		return;
+	/* replaced in one go, concurrent readers never see half a log */
+	if (write(fd, log, size) != size || fchmod(fd, 0644) < 0 ||
+	    rename(tmp, path) < 0)
+		unlink(tmp);
+	close(fd);
+}
+
+static int nvmf_get_log_page_discovery(const char *dev_path, const char *cache,
 		struct nvmf_disc_rsp_page_hdr **logp, int *numrec, int *status)
 {
 	struct nvmf_disc_rsp_page_hdr *log;
@@ -340,7 +437,7 @@ static int nvmf_get_log_page_discovery(const char *dev_path,
 	 * Issue first get log page w/numdl small enough to retrieve numrec.
 	 * We just want to know how many records to retrieve.
 	 */
-	log = calloc(1, hdr_size);
+	log = calloc(1, sizeof(*log));
 	if (!log) {
 		error = -ENOMEM;
 		goto out_close;
@@ -352,6 +449,20 @@ static int nvmf_get_log_page_discovery(const char *dev_path,
 		goto out_free_log;
 	}
 
+	*numrec = le64_to_cpu(log->numrec);
+	genctr = le64_to_cpu(log->genctr);
+	if (cache && *numrec) {
+		struct nvmf_disc_rsp_page_hdr *cached;
+
+		cached = disc_cache_load(cache, genctr, *numrec);
+		if (cached) {
+			free(log);
+			*logp = cached;
+			error = DISC_OK;
+			goto out_close;
+		}
+	}
+
 	do {
 		unsigned int log_size;
 
@@ -420,6 +531,9 @@ static int nvmf_get_log_page_discovery(const char *dev_path,
 		goto out_free_log;
 	}
 
+	if (cache)
+		disc_cache_store(cache, log, *numrec);
+
 	/* needs to be freed by the caller */
 	*logp = log;
 	error = DISC_OK;
@@ -445,44 +559,99 @@ static int space_strip_len(int max, const char *str)
 	return i + 1;
 }
 
+/*
+ * Snapshot of the controllers in SYS_NVME shared by all lookups of one
+ * command, so that matching many discovery log entries against the
+ * existing controllers reads sysfs once. It is taken on first use and
+ * dropped whenever this process has created or deleted controllers
+ * since. Only used from the main thread.
+ */
+static struct ctrl_index *sys_ctrls;
+
+static struct ctrl_index *sys_ctrls_get(void)
+{
+	if (!sys_ctrls)
+		sys_ctrls = ctrl_index_scan();
+	return sys_ctrls;
+}
+
+static void sys_ctrls_drop(void)
+{
+	ctrl_index_free(sys_ctrls);
+	sys_ctrls = NULL;
+}
+
+static struct ctrl_index_item *sys_ctrls_find(struct connect_args *args)
+{
+	struct ctrl_index *idx = sys_ctrls_get();
+
+	return idx ? ctrl_index_find(idx, args) : NULL;
+}
+
+/* Connect arguments of a discovery log entry, as found in sysfs */
+struct entry_args {
+	struct connect_args args;
+	char traddr[NVMF_TRADDR_SIZE + 1];
+	char trsvcid[NVMF_TRSVCID_SIZE + 1];
+	char subnqn[NVMF_NQN_FIELD_LEN + 1];
+};
+
+static void entry_args_init(struct entry_args *a,
+			    const struct nvmf_disc_rsp_page_entry *e,
+			    char *host_traddr)
+{
+	snprintf(a->traddr, sizeof(a->traddr), "%.*s",
+		 space_strip_len(NVMF_TRADDR_SIZE, e->traddr), e->traddr);
+	snprintf(a->trsvcid, sizeof(a->trsvcid), "%.*s",
+		 space_strip_len(NVMF_TRSVCID_SIZE, e->trsvcid), e->trsvcid);
+	snprintf(a->subnqn, sizeof(a->subnqn), "%.*s",
+		 (int)sizeof(e->subnqn), e->subnqn);
+
+	a->args.subsysnqn = a->subnqn;
+	a->args.transport = (char *)trtype_str(e->trtype);
+	a->args.traddr = a->traddr;
+	a->args.trsvcid = a->trsvcid;
+	a->args.host_traddr = host_traddr;
+}
+
 static void print_discovery_log(struct nvmf_disc_rsp_page_hdr *log, int numrec)
 {
 	int i;
 
-	printf("\nDiscovery Log Number of Records %d, "
+	fprintf(nvme_out(), "\nDiscovery Log Number of Records %d, "
 	       "Generation counter %"PRIu64"\n",
 		numrec, le64_to_cpu(log->genctr));
 
 	for (i = 0; i < numrec; i++) {
 		struct nvmf_disc_rsp_page_entry *e = &log->entries[i];
 
-		printf("=====Discovery Log Entry %d======\n", i);
-		printf("trtype:  %s\n", trtype_str(e->trtype));
-		printf("adrfam:  %s\n", adrfam_str(e->adrfam));
-		printf("subtype: %s\n", subtype_str(e->subtype));
-		printf("treq:    %s\n", treq_str(e->treq));
-		printf("portid:  %d\n", e->portid);
-		printf("trsvcid: %.*s\n",
+		fprintf(nvme_out(), "=====Discovery Log Entry %d======\n", i);
+		fprintf(nvme_out(), "trtype:  %s\n", trtype_str(e->trtype));
+		fprintf(nvme_out(), "adrfam:  %s\n", adrfam_str(e->adrfam));
+		fprintf(nvme_out(), "subtype: %s\n", subtype_str(e->subtype));
+		fprintf(nvme_out(), "treq:    %s\n", treq_str(e->treq));
+		fprintf(nvme_out(), "portid:  %d\n", e->portid);
+		fprintf(nvme_out(), "trsvcid: %.*s\n",
 		       space_strip_len(NVMF_TRSVCID_SIZE, e->trsvcid),
 		       e->trsvcid);
-		printf("subnqn:  %s\n", e->subnqn);
-		printf("traddr:  %.*s\n",
+		fprintf(nvme_out(), "subnqn:  %s\n", e->subnqn);
+		fprintf(nvme_out(), "traddr:  %.*s\n",
 		       space_strip_len(NVMF_TRADDR_SIZE, e->traddr),
 		       e->traddr);
 
 		switch (e->trtype) {
 		case NVMF_TRTYPE_RDMA:
-			printf("rdma_prtype: %s\n",
+			fprintf(nvme_out(), "rdma_prtype: %s\n",
 				prtype_str(e->tsas.rdma.prtype));
-			printf("rdma_qptype: %s\n",
+			fprintf(nvme_out(), "rdma_qptype: %s\n",
 				qptype_str(e->tsas.rdma.qptype));
-			printf("rdma_cms:    %s\n",
+			fprintf(nvme_out(), "rdma_cms:    %s\n",
 				cms_str(e->tsas.rdma.cms));
-			printf("rdma_pkey: 0x%04x\n",
+			fprintf(nvme_out(), "rdma_pkey: 0x%04x\n",
 				e->tsas.rdma.pkey);
 			break;
 		case NVMF_TRTYPE_TCP:
-			printf("sectype: %s\n",
+			fprintf(nvme_out(), "sectype: %s\n",
 				sectype_str(e->tsas.tcp.sectype));
 			break;
 		}
@@ -508,7 +677,7 @@ static void save_discovery_log(struct nvmf_disc_rsp_page_hdr *log, int numrec)
 		fprintf(stderr, "failed to write to %s: %s\n",
 			cfg.raw, strerror(errno));
 	else
-		printf("Discovery log is saved to %s\n", cfg.raw);
+		fprintf(nvme_out(), "Discovery log is saved to %s\n", cfg.raw);
 
 	close(fd);
 }
@@ -666,7 +835,8 @@ static int build_options(char *argstr, int max_len, bool discover)
 	return 0;
 }
 
-static int connect_ctrl(struct nvmf_disc_rsp_page_entry *e)
+static int connect_ctrl(struct nvmf_disc_rsp_page_entry *e,
+			const struct config *c)
 {
 	char argstr[BUF_SIZE], *p;
 	const char *transport;
@@ -693,64 +863,64 @@ retry:
 		return -EINVAL;
 	p += len;
 
-	if (cfg.hostnqn && strcmp(cfg.hostnqn, "none")) {
-		len = sprintf(p, ",hostnqn=%s", cfg.hostnqn);
+	if (c->hostnqn && strcmp(c->hostnqn, "none")) {
+		len = sprintf(p, ",hostnqn=%s", c->hostnqn);
 		if (len < 0)
 			return -EINVAL;
 		p += len;
 	}
 
-	if (cfg.hostid && strcmp(cfg.hostid, "none")) {
-		len = sprintf(p, ",hostid=%s", cfg.hostid);
+	if (c->hostid && strcmp(c->hostid, "none")) {
+		len = sprintf(p, ",hostid=%s", c->hostid);
 		if (len < 0)
 			return -EINVAL;
 		p += len;
 	}
 
-	if (cfg.queue_size && !discover) {
-		len = sprintf(p, ",queue_size=%d", cfg.queue_size);
+	if (c->queue_size && !discover) {
+		len = sprintf(p, ",queue_size=%d", c->queue_size);
 		if (len < 0)
 			return -EINVAL;
 		p += len;
 	}
 
-	if (cfg.nr_io_queues && !discover) {
-		len = sprintf(p, ",nr_io_queues=%d", cfg.nr_io_queues);
+	if (c->nr_io_queues && !discover) {
+		len = sprintf(p, ",nr_io_queues=%d", c->nr_io_queues);
 		if (len < 0)
 			return -EINVAL;
 		p += len;
 	}
 
-	if (cfg.nr_write_queues) {
-		len = sprintf(p, ",nr_write_queues=%d", cfg.nr_write_queues);
+	if (c->nr_write_queues) {
+		len = sprintf(p, ",nr_write_queues=%d", c->nr_write_queues);
 		if (len < 0)
 			return -EINVAL;
 		p += len;
 	}
 
-	if (cfg.nr_poll_queues) {
-		len = sprintf(p, ",nr_poll_queues=%d", cfg.nr_poll_queues);
+	if (c->nr_poll_queues) {
+		len = sprintf(p, ",nr_poll_queues=%d", c->nr_poll_queues);
 		if (len < 0)
 			return -EINVAL;
 		p += len;
 	}
 
-	if (cfg.host_traddr && strcmp(cfg.host_traddr, "none")) {
-		len = sprintf(p, ",host_traddr=%s", cfg.host_traddr);
+	if (c->host_traddr && strcmp(c->host_traddr, "none")) {
+		len = sprintf(p, ",host_traddr=%s", c->host_traddr);
 		if (len < 0)
 			return -EINVAL;
 		p+= len;
 	}
 
-	if (cfg.ctrl_loss_tmo) {
-		len = sprintf(p, ",ctrl_loss_tmo=%d", cfg.ctrl_loss_tmo);
+	if (c->ctrl_loss_tmo) {
+		len = sprintf(p, ",ctrl_loss_tmo=%d", c->ctrl_loss_tmo);
 		if (len < 0)
 			return -EINVAL;
 		p += len;
 	}
 
-	if (cfg.keep_alive_tmo && !discover) {
-		len = sprintf(p, ",keep_alive_tmo=%d", cfg.keep_alive_tmo);
+	if (c->keep_alive_tmo && !discover) {
+		len = sprintf(p, ",keep_alive_tmo=%d", c->keep_alive_tmo);
 		if (len < 0)
 			return -EINVAL;
 		p += len;
@@ -768,14 +938,14 @@ retry:
 		return -EINVAL;
 	p += len;
 
-	if (cfg.hdr_digest) {
+	if (c->hdr_digest) {
 		len = sprintf(p, ",hdr_digest");
 		if (len < 0)
 			return -EINVAL;
 		p += len;
 	}
 
-	if (cfg.data_digest) {
+	if (c->data_digest) {
 		len = sprintf(p, ",data_digest");
 		if (len < 0)
 			return -EINVAL;
@@ -844,24 +1014,414 @@ retry:
 	return ret;
 }
 
-static int connect_ctrls(struct nvmf_disc_rsp_page_hdr *log, int numrec)
+/*
+ * Creating a controller blocks in the write to /dev/nvme-fabrics until
+ * the target answers or the transport gives up, so the entries of a
+ * discovery log are connected by a pool of workers. A worker stuck on
+ * an entry for longer than the connect timeout is abandoned: the entry
+ * is reported as timed out and a new worker takes its place. The pool
+ * is freed by whoever drops the last reference, which may be such an
+ * abandoned worker once its write finally returns.
+ */
+enum {
+	CONNECT_PENDING,
+	CONNECT_RUNNING,
+	CONNECT_DONE,
+	CONNECT_TIMEDOUT,
+};
+
+/*
+ * @e/@cfg: entry to connect and the configuration to connect it with.
+ * The pool works on copies in @entry/@conf, which stay valid for an
+ * abandoned worker after the caller has freed the originals. Of the
+ * strings in @conf only those connect_ctrl() uses are copied.
+ */
+struct connect_job {
+	struct nvmf_disc_rsp_page_entry *e;
+	const struct config *cfg;
+	struct nvmf_disc_rsp_page_entry entry;
+	struct config conf;
+	struct timespec start;
+	int state;
+	int ret;
+};
+
+struct connect_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct connect_job *jobs;
+	int nr_jobs;
+	int next;
+	int settled;
+	int refs;
+};
+
+static void connect_pool_put(struct connect_pool *pool)
 {
+	bool last;
 	int i;
-	int instance;
+
+	pthread_mutex_lock(&pool->lock);
+	last = !--pool->refs;
+	pthread_mutex_unlock(&pool->lock);
+	if (!last)
+		return;
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->cond);
+	for (i = 0; i < pool->nr_jobs; i++) {
+		free(pool->jobs[i].conf.hostnqn);
+		free(pool->jobs[i].conf.hostid);
+		free(pool->jobs[i].conf.host_traddr);
+	}
+	free(pool->jobs);
+	free(pool);
+}
+
+static char *connect_strdup(const char *str)
+{
+	return str ? strdup(str) : NULL;
+}
+
+/*
+ * Whether the kernel would refuse to connect @job with EALREADY: a live
+ * controller to the same port of the subsystem exists for the same host.
+ * Only answered for transports the kernel checks duplicates for, and
+ * only if the host NQN is known, as the kernel matches on it too.
+ */
+static bool connect_job_connected(const struct connect_job *job)
+{
+	const struct config *c = job->cfg;
+	struct ctrl_index_item *item;
+	struct entry_args a;
+
+	if (c->duplicate_connect || !c->hostnqn || !strcmp(c->hostnqn, "none"))
+		return false;
+	switch (job->e->trtype) {
+	case NVMF_TRTYPE_RDMA:
+	case NVMF_TRTYPE_FC:
+	case NVMF_TRTYPE_TCP:
+		break;
+	default:
+		return false;
+	}
+
+	entry_args_init(&a, job->e, c->host_traddr &&
+			strcmp(c->host_traddr, "none") ? c->host_traddr : "");
+	item = sys_ctrls_find(&a.args);
+	if (!item || !item->state || !item->hostnqn)
+		return false;
+	if (!strncmp(item->state, "deleting", 8) ||
+	    !strcmp(item->state, "dead"))
+		return false;
+	if (strcmp(item->hostnqn, c->hostnqn))
+		return false;
+	if (c->hostid && strcmp(c->hostid, "none") &&
+	    (!item->hostid || strcmp(item->hostid, c->hostid)))
+		return false;
+	return true;
+}
+
+/*
+ * Sets up a pool for the subsystem entries of @jobs. Referrals to other
+ * discovery controllers go through do_discover(), which is not safe to
+ * run concurrently, and are left to the caller. Entries that are
+ * already connected are settled right away, without a worker.
+ */
+static struct connect_pool *connect_pool_alloc(struct connect_job *jobs,
+					       int nr)
+{
+	pthread_condattr_t attr;
+	struct connect_pool *pool;
+	struct connect_job *job;
+	int i;
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return NULL;
+	pool->jobs = calloc(nr, sizeof(*pool->jobs));
+	if (!pool->jobs) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&pool->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pool->refs = 1;
+
+	for (i = 0; i < nr; i++) {
+		if (jobs[i].e->subtype == NVME_NQN_DISC)
+			continue;
+		job = &pool->jobs[pool->nr_jobs++];
+		job->entry = *jobs[i].e;
+		job->e = &job->entry;
+		job->conf = *jobs[i].cfg;
+		job->conf.hostnqn = connect_strdup(jobs[i].cfg->hostnqn);
+		job->conf.hostid = connect_strdup(jobs[i].cfg->hostid);
+		job->conf.host_traddr = connect_strdup(jobs[i].cfg->host_traddr);
+		job->cfg = &job->conf;
+		if (connect_job_connected(job)) {
+			job->state = CONNECT_DONE;
+			job->ret = -EALREADY;
+			pool->settled++;
+		}
+	}
+	return pool;
+}
+
+static void *connect_worker(void *arg)
+{
+	struct connect_pool *pool = arg;
+	struct connect_job *job;
+	int ret;
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->next < pool->nr_jobs) {
+		job = &pool->jobs[pool->next++];
+		if (job->state != CONNECT_PENDING)
+			continue;
+		job->state = CONNECT_RUNNING;
+		clock_gettime(CLOCK_MONOTONIC, &job->start);
+		pthread_mutex_unlock(&pool->lock);
+
+		ret = connect_ctrl(job->e, job->cfg);
+
+		pthread_mutex_lock(&pool->lock);
+		if (job->state == CONNECT_TIMEDOUT)
+			/* replaced by another worker already */
+			break;
+		job->ret = ret;
+		job->state = CONNECT_DONE;
+		pool->settled++;
+		pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	connect_pool_put(pool);
+	return NULL;
+}
+
+static int connect_worker_start(struct connect_pool *pool)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	int err;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pool->refs++;
+	err = pthread_create(&thread, &attr, connect_worker, pool);
+	if (err)
+		pool->refs--;
+	pthread_attr_destroy(&attr);
+	return -err;
+}
+
+/* Whether a worker that wasn't abandoned is still around */
+static bool connect_pool_busy(struct connect_pool *pool)
+{
+	int i;
+
+	for (i = 0; i < pool->next; i++)
+		if (pool->jobs[i].state == CONNECT_RUNNING)
+			return true;
+	return false;
+}
+
+/*
+ * Settles the jobs no worker has taken yet with @err, for when no
+ * worker is left to take them.
+ */
+static void connect_pool_fail(struct connect_pool *pool, int err)
+{
+	struct connect_job *job;
+
+	fprintf(stderr, "failed to start connect workers: %s\n",
+		strerror(-err));
+
+	while (pool->next < pool->nr_jobs) {
+		job = &pool->jobs[pool->next++];
+		if (job->state != CONNECT_PENDING)
+			continue;
+		job->state = CONNECT_DONE;
+		job->ret = err;
+		pool->settled++;
+	}
+}
+
+/* Marks overdue jobs as timed out, returns the next deadline to wait for */
+static bool connect_pool_expire(struct connect_pool *pool,
+				struct timespec *deadline)
+{
+	struct connect_job *job;
+	struct timespec now, end;
+	bool wait = false;
+	int i, err;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for (i = 0; i < pool->next; i++) {
+		job = &pool->jobs[i];
+		if (job->state != CONNECT_RUNNING)
+			continue;
+		end = job->start;
+		end.tv_sec += cfg.connect_tmo;
+		if (now.tv_sec > end.tv_sec ||
+		    (now.tv_sec == end.tv_sec && now.tv_nsec >= end.tv_nsec)) {
+			job->state = CONNECT_TIMEDOUT;
+			job->ret = -ETIMEDOUT;
+			pool->settled++;
+			if (pool->next < pool->nr_jobs) {
+				err = connect_worker_start(pool);
+				/* the other workers take over, if any are left */
+				if (err && !connect_pool_busy(pool))
+					connect_pool_fail(pool, err);
+			}
+			continue;
+		}
+		if (!wait || end.tv_sec < deadline->tv_sec ||
+		    (end.tv_sec == deadline->tv_sec &&
+		     end.tv_nsec < deadline->tv_nsec))
+			*deadline = end;
+		wait = true;
+	}
+	return wait;
+}
+
+static int connect_pool_run(struct connect_pool *pool)
+{
+	struct timespec deadline;
+	int i, nr, err = 0;
+
+	nr = cfg.nr_jobs > 0 ? cfg.nr_jobs : NVMF_DEF_CONNECT_JOBS;
+	if (nr > pool->nr_jobs - pool->settled)
+		nr = pool->nr_jobs - pool->settled;
+
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < nr; i++) {
+		err = connect_worker_start(pool);
+		if (err)
+			break;
+	}
+	if (!i) {
+		pthread_mutex_unlock(&pool->lock);
+		return err;
+	}
+
+	while (pool->settled < pool->nr_jobs) {
+		if (cfg.connect_tmo > 0 &&
+		    connect_pool_expire(pool, &deadline)) {
+			pthread_cond_timedwait(&pool->cond, &pool->lock,
+					       &deadline);
+			continue;
+		}
+		if (pool->settled < pool->nr_jobs)
+			pthread_cond_wait(&pool->cond, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+
+/* Referrals run do_discover(), which only knows the global configuration */
+static int connect_referral(struct connect_job *job)
+{
+	struct config saved;
+	int ret;
+
+	if (job->cfg == &cfg)
+		return connect_ctrl(job->e, &cfg);
+	saved = cfg;
+	cfg = *job->cfg;
+	ret = connect_ctrl(job->e, &cfg);
+	cfg = saved;
+	return ret;
+}
+
+/*
+ * Instances of the controllers connected while discover --monitor runs.
+ * Only these are disconnected again when their records go away, never
+ * controllers connected by hand or by another host NQN.
+ */
+static int *monitor_owned;
+static int nr_monitor_owned, max_monitor_owned;
+static bool monitor_owning;
+
+static void monitor_own(int instance)
+{
+	int *tmp, max;
+
+	if (!monitor_owning)
+		return;
+	if (nr_monitor_owned == max_monitor_owned) {
+		max = max_monitor_owned ? max_monitor_owned * 2 : 16;
+		tmp = realloc(monitor_owned, max * sizeof(*tmp));
+		/* not owned is safe, it is just never disconnected */
+		if (!tmp)
+			return;
+		monitor_owned = tmp;
+		max_monitor_owned = max;
+	}
+	monitor_owned[nr_monitor_owned++] = instance;
+}
+
+static bool monitor_disown(int instance)
+{
+	int i;
+
+	for (i = 0; i < nr_monitor_owned; i++) {
+		if (monitor_owned[i] == instance) {
+			monitor_owned[i] = monitor_owned[--nr_monitor_owned];
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Connects every entry of @jobs, each with the configuration it carries */
+static int connect_jobs(struct connect_job *jobs, int nr)
+{
+	struct connect_pool *pool;
+	struct connect_job *job;
+	const char *traddr;
+	int i, instance, err;
 	int ret = 0;
 
-	for (i = 0; i < numrec; i++) {
-		instance = connect_ctrl(&log->entries[i]);
+	if (!nr)
+		return 0;
+	pool = connect_pool_alloc(jobs, nr);
+	if (!pool)
+		return -ENOMEM;
+
+	if (pool->settled < pool->nr_jobs) {
+		err = connect_pool_run(pool);
+		if (err) {
+			fprintf(stderr, "failed to start connect workers: %s\n",
+				strerror(-err));
+			connect_pool_put(pool);
+			return err;
+		}
+	}
+
+	/* referrals are followed once the subsystems are connected */
+	for (i = 0; i < nr; i++)
+		if (jobs[i].e->subtype == NVME_NQN_DISC)
+			connect_referral(&jobs[i]);
+
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < pool->nr_jobs; i++) {
+		job = &pool->jobs[i];
+		instance = job->ret;
+		traddr = job->e->traddr;
 
 		/* clean success */
-		if (instance >= 0)
+		if (instance >= 0) {
+			monitor_own(instance);
 			continue;
+		}
 
 		/* already connected print message	*/
 		if (instance == -EALREADY) {
-			const char *traddr = log->entries[i].traddr;
-
-			if (!cfg.quiet)
+			if (!job->cfg->quiet)
 				fprintf(stderr,
 					"traddr=%.*s is already connected\n",
 					space_strip_len(NVMF_TRADDR_SIZE,
@@ -870,6 +1430,12 @@ static int connect_ctrls(struct nvmf_disc_rsp_page_hdr *log, int numrec)
 			continue;
 		}
 
+		if (job->state == CONNECT_TIMEDOUT)
+			fprintf(stderr,
+				"traddr=%.*s nqn=%s: connect timed out\n",
+				space_strip_len(NVMF_TRADDR_SIZE, traddr),
+				traddr, job->e->subnqn);
+
 		/*
 		 * don't error out. The Discovery Log may contain
 		 * devices that aren't necessarily connectable via
@@ -877,96 +1443,152 @@ static int connect_ctrls(struct nvmf_disc_rsp_page_hdr *log, int numrec)
 		 * fail and continue on to the next log element.
 		 */
 	}
+	pthread_mutex_unlock(&pool->lock);
+	connect_pool_put(pool);
+	sys_ctrls_drop();
 
 	return ret;
 }
 
+static int connect_ctrls(struct nvmf_disc_rsp_page_hdr *log, int numrec)
+{
+	struct connect_job *jobs;
+	int i, ret;
+
+	jobs = calloc(numrec, sizeof(*jobs));
+	if (!jobs)
+		return -ENOMEM;
+	for (i = 0; i < numrec; i++) {
+		jobs[i].e = &log->entries[i];
+		jobs[i].cfg = &cfg;
+	}
+	ret = connect_jobs(jobs, numrec);
+	free(jobs);
+	return ret;
+}
+
 static const char delim_comma  = ',';
 
-static int do_discover(char *argstr, bool connect)
+/* Points cfg.device at a controller matching the connect arguments */
+static void discover_resolve_device(char *argstr)
 {
-	struct nvmf_disc_rsp_page_hdr *log = NULL;
-	char *dev_name;
-	int instance, numrec = 0, ret, err;
-	int status = 0;
+	struct ctrl_index_item *item;
+	struct connect_args cargs;
+
+	memset(&cargs, 0, sizeof(cargs));
+	cargs.subsysnqn = __parse_connect_arg(argstr, delim_comma,
+					conarg_nqn);
+	cargs.transport = __parse_connect_arg(argstr, delim_comma,
+					conarg_transport);
+	cargs.traddr = __parse_connect_arg(argstr, delim_comma,
+					conarg_traddr);
+	cargs.trsvcid = __parse_connect_arg(argstr, delim_comma,
+					conarg_trsvcid);
+	cargs.host_traddr = __parse_connect_arg(argstr, delim_comma,
+					conarg_host_traddr);
 
-	if (cfg.device) {
-		struct connect_args cargs;
-
-		memset(&cargs, 0, sizeof(cargs));
-		cargs.subsysnqn = __parse_connect_arg(argstr, delim_comma,
-						conarg_nqn);
-		cargs.transport = __parse_connect_arg(argstr, delim_comma,
-						conarg_transport);
-		cargs.traddr = __parse_connect_arg(argstr, delim_comma,
-						conarg_traddr);
-		cargs.trsvcid = __parse_connect_arg(argstr, delim_comma,
-						conarg_trsvcid);
-		cargs.host_traddr = __parse_connect_arg(argstr, delim_comma,
-						conarg_host_traddr);
+	/*
+	 * if the cfg.device passed in matches the connect args
+	 *    cfg.device is left as-is
+	 * else if there exists a controller that matches the
+	 *         connect args
+	 *    cfg.device is the matching ctrl name
+	 * else if no ctrl matches the connect args
+	 *    cfg.device is set to null. This will attempt to
+	 *    create a new ctrl.
+	 * endif
+	 */
+	if (!ctrl_matches_connectargs(cfg.device, &cargs)) {
+		item = sys_ctrls_find(&cargs);
+		cfg.device = item ? strdup(item->name) : NULL;
+	}
 
-		/*
-		 * if the cfg.device passed in matches the connect args
-		 *    cfg.device is left as-is
-		 * else if there exists a controller that matches the
-		 *         connect args
-		 *    cfg.device is the matching ctrl name
-		 * else if no ctrl matches the connect args
-		 *    cfg.device is set to null. This will attempt to
-		 *    create a new ctrl.
-		 * endif
-		 */
-		if (!ctrl_matches_connectargs(cfg.device, &cargs))
-			cfg.device = find_ctrl_with_connectargs(&cargs);
+	free(cargs.subsysnqn);
+	free(cargs.transport);
+	free(cargs.traddr);
+	free(cargs.trsvcid);
+	free(cargs.host_traddr);
+}
 
-		free(cargs.subsysnqn);
-		free(cargs.transport);
-		free(cargs.traddr);
-		free(cargs.trsvcid);
-		free(cargs.host_traddr);
-	}
+/*
+ * Discovery log read from one discovery controller. @ret is one of the
+ * DISC_* values or a negative errno from nvmf_get_log_page_discovery().
+ */
+struct disc_log {
+	struct nvmf_disc_rsp_page_hdr *log;
+	int numrec;
+	int status;
+	int ret;
+	int instance;
+};
 
-	if (!cfg.device)
+/*
+ * Reads the log of the discovery controller @device, or of one created
+ * from @argstr and removed again unless @persistent. Only uses its
+ * arguments, so several discovery controllers can be queried at once.
+ * Returns a negative errno if the controller could not be created or
+ * removed, else the outcome is in @d.
+ */
+static int discover_get_log(char *argstr, char *device, bool persistent,
+			    struct disc_log *d)
+{
+	char *dev_name, cache[PATH_MAX];
+	int instance, err;
+
+	memset(d, 0, sizeof(*d));
+	if (!device)
 		instance = add_ctrl(argstr);
 	else
-		instance = ctrl_instance(cfg.device);
+		instance = ctrl_instance(device);
 	if (instance < 0)
 		return instance;
+	d->instance = instance;
 
 	if (asprintf(&dev_name, "/dev/nvme%d", instance) < 0)
 		return -errno;
-	ret = nvmf_get_log_page_discovery(dev_name, &log, &numrec, &status);
+	disc_cache_path(argstr, cache, sizeof(cache));
+	d->ret = nvmf_get_log_page_discovery(dev_name, cache, &d->log,
+					     &d->numrec, &d->status);
 	free(dev_name);
-	if (!cfg.device && !cfg.persistent) {
+	if (!device && !persistent) {
 		err = remove_ctrl(instance);
-		if (err)
+		if (err) {
+			free(d->log);
+			d->log = NULL;
 			return err;
+		}
 	}
+	return 0;
+}
+
+static int discover_report(struct disc_log *d, bool connect)
+{
+	int ret = d->ret;
 
 	switch (ret) {
 	case DISC_OK:
 		if (connect)
-			ret = connect_ctrls(log, numrec);
+			ret = connect_ctrls(d->log, d->numrec);
 		else if (cfg.raw)
-			save_discovery_log(log, numrec);
+			save_discovery_log(d->log, d->numrec);
 		else
-			print_discovery_log(log, numrec);
+			print_discovery_log(d->log, d->numrec);
 		break;
 	case DISC_GET_NUMRECS:
 		fprintf(stderr,
 			"Get number of discovery log entries failed.\n");
-		ret = status;
+		ret = d->status;
 		break;
 	case DISC_GET_LOG:
 		fprintf(stderr, "Get discovery log entries failed.\n");
-		ret = status;
+		ret = d->status;
 		break;
 	case DISC_NO_LOG:
-		fprintf(stdout, "No discovery log entries to fetch.\n");
+		fprintf(nvme_out(), "No discovery log entries to fetch.\n");
 		ret = DISC_OK;
 		break;
 	case DISC_RETRY_EXHAUSTED:
-		fprintf(stdout, "Discovery retries exhausted.\n");
+		fprintf(nvme_out(), "Discovery retries exhausted.\n");
 		ret = -EAGAIN;
 		break;
 	case DISC_NOT_EQUAL:
@@ -982,13 +1604,192 @@ static int do_discover(char *argstr, bool connect)
 	return ret;
 }
 
-static int discover_from_conf_file(const char *desc, char *argstr,
-		const struct argconfig_commandline_options *opts, bool connect)
+static int do_discover(char *argstr, bool connect)
+{
+	struct disc_log d;
+	int ret;
+
+	if (cfg.device)
+		discover_resolve_device(argstr);
+
+	ret = discover_get_log(argstr, cfg.device, cfg.persistent, &d);
+	if (ret)
+		return ret;
+	ret = discover_report(&d, connect);
+	free(d.log);
+	return ret;
+}
+
+static bool disc_entry_equal(const struct nvmf_disc_rsp_page_entry *a,
+			     const struct nvmf_disc_rsp_page_entry *b)
+{
+	int la = space_strip_len(NVMF_TRADDR_SIZE, a->traddr);
+	int lb = space_strip_len(NVMF_TRADDR_SIZE, b->traddr);
+
+	if (a->trtype != b->trtype || la != lb ||
+	    memcmp(a->traddr, b->traddr, la))
+		return false;
+	la = space_strip_len(NVMF_TRSVCID_SIZE, a->trsvcid);
+	lb = space_strip_len(NVMF_TRSVCID_SIZE, b->trsvcid);
+	if (la != lb || memcmp(a->trsvcid, b->trsvcid, la))
+		return false;
+	return !strncmp(a->subnqn, b->subnqn, sizeof(a->subnqn));
+}
+
+static unsigned int disc_entry_hash(const struct nvmf_disc_rsp_page_entry *e)
+{
+	unsigned int h = 2166136261u ^ e->trtype;
+	int i, len;
+
+	len = space_strip_len(NVMF_TRADDR_SIZE, e->traddr);
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char)e->traddr[i]) * 16777619u;
+	len = space_strip_len(NVMF_TRSVCID_SIZE, e->trsvcid);
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char)e->trsvcid[i]) * 16777619u;
+	for (i = 0; i < sizeof(e->subnqn) && e->subnqn[i]; i++)
+		h = (h ^ (unsigned char)e->subnqn[i]) * 16777619u;
+	return h;
+}
+
+/* Set of discovery log entries, keyed like disc_entry_equal() */
+struct disc_index {
+	const struct nvmf_disc_rsp_page_entry **table;
+	unsigned int size;
+};
+
+static int disc_index_init(struct disc_index *idx, int nr)
+{
+	idx->size = 1;
+	while (idx->size < 2 * nr)
+		idx->size <<= 1;
+	idx->table = calloc(idx->size, sizeof(*idx->table));
+	return idx->table ? 0 : -ENOMEM;
+}
+
+static void disc_index_free(struct disc_index *idx)
 {
+	free(idx->table);
+	idx->table = NULL;
+}
+
+/* Returns the equal entry already in @idx, else adds @e if @add */
+static const struct nvmf_disc_rsp_page_entry *
+disc_index_lookup(struct disc_index *idx,
+		  const struct nvmf_disc_rsp_page_entry *e, bool add)
+{
+	unsigned int h, mask = idx->size - 1;
+
+	for (h = disc_entry_hash(e) & mask; idx->table[h]; h = (h + 1) & mask)
+		if (disc_entry_equal(idx->table[h], e))
+			return idx->table[h];
+	if (add)
+		idx->table[h] = e;
+	return NULL;
+}
+
+/*
+ * One line of the discovery.conf file, with the configuration it was
+ * parsed into. The strings in @cfg point into @args.
+ */
+struct disc_conf_job {
+	struct config cfg;
+	char argstr[BUF_SIZE];
+	char *args;
+	char **argv;
+	pthread_t thread;
+	bool started;
+	bool created;
+	struct disc_log d;
+	int err;
+	int retry;		/* seconds until the next retry, 0 if none */
+	struct timespec retry_at;
+};
+
+static void *discover_conf_thread(void *arg)
+{
+	struct disc_conf_job *job = arg;
+
+	job->err = discover_get_log(job->argstr, job->cfg.device,
+				    job->cfg.persistent, &job->d);
+	return NULL;
+}
+
+/*
+ * Merges the logs of all discovery controllers into one list of
+ * entries to connect. An entry reported by several of them is kept
+ * once, with the configuration of the first conf file line that
+ * reported it.
+ */
+static int discover_conf_connect(struct disc_conf_job **jobs, int nr_jobs)
+{
+	struct nvmf_disc_rsp_page_entry *e;
+	struct connect_job *merged;
+	struct disc_index idx;
+	int i, j, total = 0, nr = 0, ret;
+
+	for (i = 0; i < nr_jobs; i++)
+		if (!jobs[i]->err && jobs[i]->d.ret == DISC_OK)
+			total += jobs[i]->d.numrec;
+	if (!total)
+		return 0;
+
+	merged = calloc(total, sizeof(*merged));
+	if (!merged || disc_index_init(&idx, total)) {
+		free(merged);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nr_jobs; i++) {
+		if (jobs[i]->err || jobs[i]->d.ret != DISC_OK)
+			continue;
+		for (j = 0; j < jobs[i]->d.numrec; j++) {
+			e = &jobs[i]->d.log->entries[j];
+			if (disc_index_lookup(&idx, e, true))
+				continue;
+			merged[nr].e = e;
+			merged[nr++].cfg = &jobs[i]->cfg;
+		}
+	}
+
+	ret = connect_jobs(merged, nr);
+	disc_index_free(&idx);
+	free(merged);
+	return ret;
+}
+
+static void discover_conf_free(struct disc_conf_job *job)
+{
+	free(job->d.log);
+	free(job->argv);
+	free(job->args);
+	free(job);
+}
+
+static void discover_jobs_free(struct disc_conf_job **jobs, int nr_jobs)
+{
+	int i;
+
+	for (i = 0; i < nr_jobs; i++)
+		discover_conf_free(jobs[i]);
+	free(jobs);
+}
+
+/*
+ * Parses every line of the conf file into a job of its own. Lines
+ * start from the configuration the previous one left behind.
+ */
+static int discover_conf_parse(const char *desc,
+		const struct argconfig_commandline_options *opts,
+		struct disc_conf_job ***jobsp, int *nr_jobsp)
+{
+	struct disc_conf_job **jobs = NULL, **tmp, *job;
 	FILE *f;
-	char line[256], *ptr, *args, **argv;
-	int argc, err, ret = 0;
+	char line[256], *ptr, *args;
+	int argc, err, nr_jobs = 0, ret = 0;
 
+	*jobsp = NULL;
+	*nr_jobsp = 0;
 	f = fopen(PATH_NVMF_DISC, "r");
 	if (f == NULL) {
 		fprintf(stderr, "No discover params given and no %s conf\n",
@@ -1000,58 +1801,519 @@ static int discover_from_conf_file(const char *desc, char *argstr,
 		if (line[0] == '#' || line[0] == '\n')
 			continue;
 
-		args = strdup(line);
+		job = calloc(1, sizeof(*job));
+		tmp = realloc(jobs, (nr_jobs + 1) * sizeof(*jobs));
+		if (tmp)
+			jobs = tmp;
+		if (!job || !tmp) {
+			fprintf(stderr, "failed to allocate discovery job\n");
+			free(job);
+			ret = -ENOMEM;
+			break;
+		}
+
+		args = job->args = strdup(line);
 		if (!args) {
 			fprintf(stderr, "failed to strdup args\n");
+			free(job);
 			ret = -ENOMEM;
-			goto out;
+			break;
 		}
 
-		argv = calloc(MAX_DISC_ARGS, BUF_SIZE);
-		if (!argv) {
+		job->argv = calloc(MAX_DISC_ARGS, BUF_SIZE);
+		if (!job->argv) {
 			fprintf(stderr, "failed to allocate argv vector\n");
-			free(args);
+			discover_conf_free(job);
 			ret = -ENOMEM;
-			goto out;
+			break;
 		}
 
 		argc = 0;
-		argv[argc++] = "discover";
+		job->argv[argc++] = "discover";
 		while ((ptr = strsep(&args, " =\n")) != NULL)
-			argv[argc++] = ptr;
+			job->argv[argc++] = ptr;
 
-		err = argconfig_parse(argc, argv, desc, opts, &cfg, sizeof(cfg));
-		if (err)
+		err = argconfig_parse(argc, job->argv, desc, opts, &cfg,
+				      sizeof(cfg));
+		if (err) {
+			discover_conf_free(job);
 			continue;
+		}
 
 		if (cfg.persistent && !cfg.keep_alive_tmo)
 			cfg.keep_alive_tmo = NVMF_DEF_DISC_TMO;
 
-		err = build_options(argstr, BUF_SIZE, true);
+		err = build_options(job->argstr, BUF_SIZE, true);
 		if (err) {
+			discover_conf_free(job);
 			ret = err;
 			continue;
 		}
+		if (cfg.device)
+			discover_resolve_device(job->argstr);
 
-		err = do_discover(argstr, connect);
-		if (err) {
-			ret = err;
+		job->cfg = cfg;
+		jobs[nr_jobs++] = job;
+	}
+	fclose(f);
+
+	if (ret == -ENOMEM) {
+		discover_jobs_free(jobs, nr_jobs);
+		return ret;
+	}
+	if (!nr_jobs) {
+		free(jobs);
+		jobs = NULL;
+	}
+	*jobsp = jobs;
+	*nr_jobsp = nr_jobs;
+	return ret;
+}
+
+/* Queries all discovery controllers of @jobs at once */
+static void discover_conf_fetch(struct disc_conf_job **jobs, int nr_jobs)
+{
+	int i, err;
+
+	for (i = 0; i < nr_jobs; i++) {
+		err = pthread_create(&jobs[i]->thread, NULL,
+				     discover_conf_thread, jobs[i]);
+		if (err)
+			discover_conf_thread(jobs[i]);
+		else
+			jobs[i]->started = true;
+	}
+	for (i = 0; i < nr_jobs; i++)
+		if (jobs[i]->started)
+			pthread_join(jobs[i]->thread, NULL);
+}
+
+/*
+ * Every line of the conf file describes a discovery controller. They
+ * are all queried at once; with @connect their logs are then merged
+ * and the union is connected, else each log is shown in turn.
+ */
+static int discover_from_conf_file(const char *desc,
+		const struct argconfig_commandline_options *opts, bool connect)
+{
+	struct disc_conf_job **jobs, *job;
+	int err, i, nr_jobs, ret;
+
+	ret = discover_conf_parse(desc, opts, &jobs, &nr_jobs);
+	if (ret == -ENOMEM || !nr_jobs)
+		return ret;
+
+	discover_conf_fetch(jobs, nr_jobs);
+
+	for (i = 0; i < nr_jobs; i++) {
+		job = jobs[i];
+		if (job->err) {
+			ret = job->err;
 			continue;
 		}
+		if (connect && job->d.ret == DISC_OK)
+			continue;
+		cfg = job->cfg;
+		err = discover_report(&job->d, false);
+		if (err)
+			ret = err;
+	}
 
-		free(args);
-		free(argv);
+	if (connect) {
+		err = discover_conf_connect(jobs, nr_jobs);
+		if (err)
+			ret = err;
 	}
 
-out:
-	fclose(f);
+	discover_jobs_free(jobs, nr_jobs);
 	return ret;
 }
 
+/*
+ * discover --monitor keeps its discovery controllers and listens for
+ * the uevents the kernel sends when one of them reports a Discovery Log
+ * Page Change. The new log is compared with the previous one and only
+ * the entries that appeared or went away are connected or disconnected.
+ */
+#define NVMF_AEN_DISC_CHANGED	0x70f002
+
+#define MONITOR_RETRY_MIN	1
+#define MONITOR_RETRY_MAX	60
+
+static volatile sig_atomic_t monitor_stop;
+
+static void monitor_signal(int sig)
+{
+	monitor_stop = 1;
+}
+
+static int monitor_uevent_socket(void)
+{
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1,		/* kernel uevents */
+	};
+	int fd, err;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+		    NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -errno;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+	return fd;
+}
+
+/*
+ * Returns the instance of the nvme controller a uevent reports a
+ * discovery log change or the removal of, else -1.
+ */
+static int monitor_parse_uevent(char *buf, int len, bool *removed)
+{
+	char *action = NULL, *subsys = NULL, *name = NULL;
+	char *aen = NULL, *event = NULL, *p;
+
+	for (p = buf; p < buf + len; p += strlen(p) + 1) {
+		if (!strncmp(p, "ACTION=", 7))
+			action = p + 7;
+		else if (!strncmp(p, "SUBSYSTEM=", 10))
+			subsys = p + 10;
+		else if (!strncmp(p, "DEVNAME=", 8))
+			name = p + 8;
+		else if (!strncmp(p, "NVME_AEN=", 9))
+			aen = p + 9;
+		else if (!strncmp(p, "NVME_EVENT=", 11))
+			event = p + 11;
+	}
+	if (!action || !subsys || !name || strcmp(subsys, "nvme"))
+		return -1;
+
+	*removed = !strcmp(action, "remove");
+	if (!*removed &&
+	    (strcmp(action, "change") ||
+	     !((aen && strtoul(aen, NULL, 0) == NVMF_AEN_DISC_CHANGED) ||
+	       (event && !strcmp(event, "discovery")))))
+		return -1;
+	return ctrl_instance(name);
+}
+
+/* True if a monitored controller other than @skip still reports @e */
+static bool monitor_reported(struct disc_conf_job **jobs, int nr_jobs,
+			     struct disc_conf_job *skip,
+			     const struct nvmf_disc_rsp_page_entry *e)
+{
+	int i, j;
+
+	for (i = 0; i < nr_jobs; i++) {
+		if (jobs[i] == skip || !jobs[i]->d.log)
+			continue;
+		for (j = 0; j < jobs[i]->d.numrec; j++)
+			if (disc_entry_equal(&jobs[i]->d.log->entries[j], e))
+				return true;
+	}
+	return false;
+}
+
+static void monitor_disconnect(const struct nvmf_disc_rsp_page_entry *e,
+			       const struct config *c)
+{
+	struct ctrl_index_item *item;
+	struct entry_args a;
+	int instance;
+
+	entry_args_init(&a, e, c->host_traddr &&
+			strcmp(c->host_traddr, "none") ? c->host_traddr : "");
+	if (!*a.trsvcid)
+		a.args.trsvcid = "none";
+
+	item = sys_ctrls_find(&a.args);
+	if (!item)
+		return;
+	/* the same subsystem may be connected for another host */
+	if (c->hostnqn && strcmp(c->hostnqn, "none") &&
+	    (!item->hostnqn || strcmp(item->hostnqn, c->hostnqn)))
+		return;
+	if (c->hostid && strcmp(c->hostid, "none") &&
+	    (!item->hostid || strcmp(item->hostid, c->hostid)))
+		return;
+	instance = ctrl_instance(item->name);
+	if (instance < 0 || !monitor_disown(instance))
+		return;
+	if (!remove_ctrl(instance))
+		fprintf(nvme_out(), "%s: disconnected traddr=%s nqn=%s\n",
+			item->name, a.traddr, a.subnqn);
+}
+
+/* Replaces the log of @job by @d, acting on the differences */
+static void monitor_apply(struct disc_conf_job **jobs, int nr_jobs,
+			  struct disc_conf_job *job, struct disc_log *d)
+{
+	struct nvmf_disc_rsp_page_entry *e;
+	struct connect_job *added = NULL;
+	struct disc_log old = job->d;
+	struct disc_index idx;
+	int i, nr_added = 0, nr_removed = 0;
+
+	sys_ctrls_drop();
+	if (disc_index_init(&idx, d->numrec > old.numrec ?
+			    d->numrec : old.numrec)) {
+		free(d->log);
+		return;
+	}
+
+	for (i = 0; i < d->numrec; i++)
+		disc_index_lookup(&idx, &d->log->entries[i], true);
+	for (i = 0; i < old.numrec; i++) {
+		e = &old.log->entries[i];
+		if (disc_index_lookup(&idx, e, false))
+			continue;
+		nr_removed++;
+		if (e->subtype != NVME_NQN_DISC &&
+		    !monitor_reported(jobs, nr_jobs, job, e))
+			monitor_disconnect(e, &job->cfg);
+	}
+
+	memset(idx.table, 0, idx.size * sizeof(*idx.table));
+	for (i = 0; i < old.numrec; i++)
+		disc_index_lookup(&idx, &old.log->entries[i], true);
+	if (d->numrec)
+		added = calloc(d->numrec, sizeof(*added));
+	for (i = 0; added && i < d->numrec; i++) {
+		e = &d->log->entries[i];
+		if (disc_index_lookup(&idx, e, false))
+			continue;
+		nr_added++;
+		if (monitor_reported(jobs, nr_jobs, job, e))
+			continue;
+		added[i].e = e;
+		added[i].cfg = &job->cfg;
+	}
+	disc_index_free(&idx);
+
+	job->d = *d;
+	job->d.ret = DISC_OK;
+	free(old.log);
+
+	if (nr_added || nr_removed)
+		fprintf(nvme_out(),
+			"nvme%d: discovery log changed, %d added, %d removed\n",
+			job->d.instance, nr_added, nr_removed);
+	fflush(nvme_out());
+
+	/* compact the entries to connect */
+	for (i = 0, nr_added = 0; added && i < d->numrec; i++)
+		if (added[i].e)
+			added[nr_added++] = added[i];
+	connect_jobs(added, nr_added);
+	free(added);
+}
+
+/* Acts on the log @d just read from the discovery controller of @job */
+static void monitor_update(struct disc_conf_job **jobs, int nr_jobs,
+			   struct disc_conf_job *job, struct disc_log *d)
+{
+	if (d->ret == DISC_NO_LOG) {
+		d->numrec = 0;
+	} else if (d->ret != DISC_OK) {
+		job->d.instance = d->instance;
+		cfg = job->cfg;
+		discover_report(d, false);
+		fflush(nvme_out());
+		return;
+	}
+	monitor_apply(jobs, nr_jobs, job, d);
+}
+
+/* Tries again after 1, 2, 4... seconds, up to once a minute */
+static void monitor_retry_schedule(struct disc_conf_job *job)
+{
+	if (!job->retry)
+		job->retry = MONITOR_RETRY_MIN;
+	else if (job->retry < MONITOR_RETRY_MAX / 2)
+		job->retry *= 2;
+	else
+		job->retry = MONITOR_RETRY_MAX;
+	clock_gettime(CLOCK_MONOTONIC, &job->retry_at);
+	job->retry_at.tv_sec += job->retry;
+}
+
+/*
+ * Creates the discovery controller of @job again and catches up with
+ * its log, or schedules another attempt if the target is still away.
+ */
+static void monitor_recreate(struct disc_conf_job **jobs, int nr_jobs,
+			     struct disc_conf_job *job)
+{
+	struct disc_log d;
+	int err;
+
+	err = discover_get_log(job->argstr, NULL, true, &d);
+	if (err) {
+		monitor_retry_schedule(job);
+		fprintf(stderr, "failed to recreate discovery controller: "
+			"%s, retrying in %ds\n", strerror(-err), job->retry);
+		return;
+	}
+	job->retry = 0;
+	fprintf(nvme_out(), "nvme%d: monitoring\n", d.instance);
+	monitor_update(jobs, nr_jobs, job, &d);
+}
+
+/*
+ * Retries the discovery controllers that are due. Returns the poll
+ * timeout in milliseconds until the next retry, -1 if none is pending.
+ */
+static int monitor_retry(struct disc_conf_job **jobs, int nr_jobs)
+{
+	struct disc_conf_job *job;
+	struct timespec now;
+	long long ms, timeout = -1;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for (i = 0; i < nr_jobs; i++) {
+		job = jobs[i];
+		if (!job->retry)
+			continue;
+		ms = (job->retry_at.tv_sec - now.tv_sec) * 1000LL +
+		     (job->retry_at.tv_nsec - now.tv_nsec) / 1000000;
+		if (ms <= 0) {
+			monitor_recreate(jobs, nr_jobs, job);
+			if (!job->retry)
+				continue;
+			ms = job->retry * 1000LL;
+		}
+		if (timeout < 0 || ms < timeout)
+			timeout = ms;
+	}
+	return timeout;
+}
+
+static void monitor_event(struct disc_conf_job **jobs, int nr_jobs,
+			  struct disc_conf_job *job, bool removed)
+{
+	struct disc_log d;
+	char *dev_name, cache[PATH_MAX];
+
+	if (removed) {
+		fprintf(nvme_out(), "nvme%d: discovery controller removed\n",
+			job->d.instance);
+		job->d.instance = -1;
+		/* it was ours, create it again and catch up */
+		if (job->created)
+			monitor_recreate(jobs, nr_jobs, job);
+		return;
+	}
+
+	memset(&d, 0, sizeof(d));
+	d.instance = job->d.instance;
+	if (asprintf(&dev_name, "/dev/nvme%d", d.instance) < 0)
+		return;
+	disc_cache_path(job->argstr, cache, sizeof(cache));
+	d.ret = nvmf_get_log_page_discovery(dev_name, cache, &d.log,
+					    &d.numrec, &d.status);
+	free(dev_name);
+	monitor_update(jobs, nr_jobs, job, &d);
+}
+
+/*
+ * Connects everything the discovery controllers of @jobs report, then
+ * follows the changes of their logs until SIGINT or SIGTERM. The
+ * controllers created here are removed on exit unless @keep.
+ */
+static int discover_monitor(struct disc_conf_job **jobs, int nr_jobs,
+			    bool keep)
+{
+	struct sigaction sa = { .sa_handler = monitor_signal };
+	struct disc_conf_job *job;
+	struct pollfd pfd;
+	char buf[8192];
+	bool removed;
+	int fd, i, len, instance, timeout, active = 0;
+
+	/* listen first, so no change goes unnoticed */
+	fd = monitor_uevent_socket();
+	if (fd < 0) {
+		fprintf(stderr, "failed to listen for uevents: %s\n",
+			strerror(-fd));
+		return fd;
+	}
+
+	discover_conf_fetch(jobs, nr_jobs);
+	for (i = 0; i < nr_jobs; i++) {
+		job = jobs[i];
+		job->created = !job->cfg.device;
+		if (job->err) {
+			fprintf(stderr, "failed to create discovery "
+				"controller: %s\n", strerror(-job->err));
+			job->d.instance = -1;
+			if (job->created)
+				monitor_retry_schedule(job);
+			continue;
+		}
+		fprintf(nvme_out(), "nvme%d: monitoring\n", job->d.instance);
+		active++;
+		if (job->d.ret == DISC_NO_LOG) {
+			job->d.ret = DISC_OK;
+		} else if (job->d.ret != DISC_OK) {
+			cfg = job->cfg;
+			discover_report(&job->d, false);
+			job->d.numrec = 0;
+		}
+	}
+	fflush(nvme_out());
+	if (!active) {
+		close(fd);
+		return jobs[0]->err;
+	}
+	monitor_owning = true;
+	discover_conf_connect(jobs, nr_jobs);
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (!monitor_stop) {
+		timeout = monitor_retry(jobs, nr_jobs);
+		if (poll(&pfd, 1, timeout) <= 0)
+			continue;
+		len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		if (len <= 0)
+			continue;
+		buf[len] = '\0';
+
+		instance = monitor_parse_uevent(buf, len, &removed);
+		if (instance < 0)
+			continue;
+		/* the instance may be handed out again to someone else */
+		if (removed)
+			monitor_disown(instance);
+		for (i = 0; i < nr_jobs; i++)
+			if (jobs[i]->d.instance == instance)
+				monitor_event(jobs, nr_jobs, jobs[i], removed);
+	}
+	close(fd);
+	monitor_owning = false;
+	free(monitor_owned);
+	monitor_owned = NULL;
+	nr_monitor_owned = max_monitor_owned = 0;
+
+	for (i = 0; i < nr_jobs; i++)
+		if (!keep && jobs[i]->created && jobs[i]->d.instance >= 0)
+			remove_ctrl(jobs[i]->d.instance);
+	return 0;
+}
+
 int discover(const char *desc, int argc, char **argv, bool connect)
 {
+	struct disc_conf_job **jobs, *job;
 	char argstr[BUF_SIZE];
-	int ret;
+	int ret, nr_jobs;
+	bool keep;
 	const struct argconfig_commandline_options command_line_options[] = {
 		{"transport",   't', "LIST", CFG_STRING, &cfg.transport,   required_argument, "transport type" },
 		{"traddr",      'a', "LIST", CFG_STRING, &cfg.traddr,      required_argument, "transport address" },
@@ -1072,9 +2334,13 @@ int discover(const char *desc, int argc, char **argv, bool connect)
 		{"queue-size",      'Q', "LIST", CFG_INT, &cfg.queue_size,      required_argument, "number of io queue elements to use (default 128)" },
 		{"persistent",  'p', "LIST", CFG_NONE, &cfg.persistent,  no_argument, "persistent discovery connection" },
 		{"quiet",       'Q', "LIST", CFG_NONE, &cfg.quiet,  no_argument, "suppress already connected errors" },
+		{"jobs",        'j', "LIST", CFG_INT, &cfg.nr_jobs,  required_argument, "number of controllers connected at once (default 16)" },
+		{"connect-timeout", 'T', "LIST", CFG_INT, &cfg.connect_tmo, required_argument, "seconds to wait for each controller to connect (default no limit)" },
+		{"monitor",     'M', "LIST", CFG_NONE, &cfg.monitor, no_argument, "keep connecting and disconnecting as the discovery logs change" },
 		{NULL},
 	};
 
+	cfg_reset();
 	ret = argconfig_parse(argc, argv, desc, command_line_options, &cfg,
 			sizeof(cfg));
 	if (ret)
@@ -1085,9 +2351,21 @@ int discover(const char *desc, int argc, char **argv, bool connect)
 
 	cfg.nqn = NVME_DISC_SUBSYS_NAME;
 
-	if (!cfg.transport && !cfg.traddr) {
-		ret = discover_from_conf_file(desc, argstr,
-				command_line_options, connect);
+	/* the controllers must outlive the first log read */
+	keep = cfg.persistent;
+	if (cfg.monitor)
+		cfg.persistent = true;
+
+	if (!cfg.transport && !cfg.traddr && cfg.monitor) {
+		ret = discover_conf_parse(desc, command_line_options,
+				&jobs, &nr_jobs);
+		if (ret == -ENOMEM || !nr_jobs)
+			goto out;
+		ret = discover_monitor(jobs, nr_jobs, keep);
+		discover_jobs_free(jobs, nr_jobs);
+	} else if (!cfg.transport && !cfg.traddr) {
+		ret = discover_from_conf_file(desc, command_line_options,
+				connect);
 	} else {
 		if (cfg.persistent && !cfg.keep_alive_tmo)
 			cfg.keep_alive_tmo = NVMF_DEF_DISC_TMO;
@@ -1095,14 +2373,30 @@ int discover(const char *desc, int argc, char **argv, bool connect)
 		if (ret)
 			goto out;
 
-		ret = do_discover(argstr, connect);
+		if (!cfg.monitor) {
+			ret = do_discover(argstr, connect);
+			goto out;
+		}
+
+		job = calloc(1, sizeof(*job));
+		if (!job) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		if (cfg.device)
+			discover_resolve_device(argstr);
+		strcpy(job->argstr, argstr);
+		job->cfg = cfg;
+		ret = discover_monitor(&job, 1, keep);
+		discover_conf_free(job);
 	}
 
 out:
+	sys_ctrls_drop();
 	return nvme_status_to_errno(ret, true);
 }
 
-int connect(const char *desc, int argc, char **argv)
+int fabrics_connect(const char *desc, int argc, char **argv)
 {
 	char argstr[BUF_SIZE];
 	int instance, ret;
@@ -1128,6 +2422,7 @@ int connect(const char *desc, int argc, char **argv)
 		{NULL},
 	};
 
+	cfg_reset();
 	ret = argconfig_parse(argc, argv, desc, command_line_options, &cfg,
 			sizeof(cfg));
 	if (ret)
@@ -1151,74 +2446,29 @@ out:
 	return nvme_status_to_errno(ret, true);
 }
 
-static int scan_sys_nvme_filter(const struct dirent *d)
-{
-	if (!strcmp(d->d_name, "."))
-		return 0;
-	if (!strcmp(d->d_name, ".."))
-		return 0;
-	return 1;
-}
-
-/*
- * Returns 1 if disconnect occurred, 0 otherwise.
- */
-static int disconnect_subsys(char *nqn, char *ctrl)
-{
-	char *sysfs_nqn_path = NULL, *sysfs_del_path = NULL;
-	char subsysnqn[NVMF_NQN_SIZE] = {};
-	int fd, ret = 0;
-
-	if (asprintf(&sysfs_nqn_path, "%s/%s/subsysnqn", SYS_NVME, ctrl) < 0)
-		goto free;
-	if (asprintf(&sysfs_del_path, "%s/%s/delete_controller", SYS_NVME, ctrl) < 0)
-		goto free;
-
-	fd = open(sysfs_nqn_path, O_RDONLY);
-	if (fd < 0) {
-		fprintf(stderr, "Failed to open %s: %s\n",
-				sysfs_nqn_path, strerror(errno));
-		goto free;
-	}
-
-	if (read(fd, subsysnqn, NVMF_NQN_SIZE) < 0)
-		goto close;
-
-	subsysnqn[strcspn(subsysnqn, "\n")] = '\0';
-	if (strcmp(subsysnqn, nqn))
-		goto close;
-
-	if (!remove_ctrl_by_path(sysfs_del_path))
-		ret = 1;
- close:
-	close(fd);
- free:
-	free(sysfs_del_path);
-	free(sysfs_nqn_path);
-	return ret;
-}
-
 /*
  * Returns the number of controllers successfully disconnected.
  */
 static int disconnect_by_nqn(char *nqn)
 {
-	struct dirent **devices = NULL;
-	int i, n, ret = 0;
+	struct ctrl_index_item *item = NULL;
+	struct ctrl_index *idx;
+	int instance, ret = 0;
 
 	if (strlen(nqn) > NVMF_NQN_SIZE)
 		return -EINVAL;
 
-	n = scandir(SYS_NVME, &devices, scan_sys_nvme_filter, alphasort);
-	if (n < 0)
-		return n;
+	idx = sys_ctrls_get();
+	if (!idx)
+		return -ENOMEM;
 
-	for (i = 0; i < n; i++)
-		ret += disconnect_subsys(nqn, devices[i]->d_name);
-
-	for (i = 0; i < n; i++)
-		free(devices[i]);
-	free(devices);
+	while ((item = ctrl_index_find_nqn(idx, nqn, item))) {
+		instance = ctrl_instance(item->name);
+		if (instance >= 0 && !remove_ctrl(instance))
+			ret++;
+	}
+	if (ret)
+		sys_ctrls_drop();
 
 	return ret;
 }
@@ -1245,6 +2495,7 @@ int disconnect(const char *desc, int argc, char **argv)
 		{NULL},
 	};
 
+	cfg_reset();
 	ret = argconfig_parse(argc, argv, desc, command_line_options, &cfg,
 			sizeof(cfg));
 	if (ret)
@@ -1262,7 +2513,7 @@ int disconnect(const char *desc, int argc, char **argv)
 			fprintf(stderr, "Failed to disconnect by NQN: %s\n",
 				cfg.nqn);
 		else {
-			printf("NQN:%s disconnected %d controller(s)\n", cfg.nqn, ret);
+			fprintf(nvme_out(), "NQN:%s disconnected %d controller(s)\n", cfg.nqn, ret);
 			ret = 0;
 		}
 	}
@@ -1276,6 +2527,7 @@ int disconnect(const char *desc, int argc, char **argv)
 	}
 
 out:
+	sys_ctrls_drop();
 	return nvme_status_to_errno(ret, true);
 }
 
@@ -1287,6 +2539,7 @@ int disconnect_all(const char *desc, int argc, char **argv)
 		{NULL},
 	};
 
+	cfg_reset();
 	ret = argconfig_parse(argc, argv, desc, command_line_options, &cfg,
 			sizeof(cfg));
 	if (ret)
@@ -5,83 +5,186 @@
 #include <stdarg.h>
 #include "json.h"
 
+#define min(x, y) ((x) < (y) ? (x) : (y))
+
 static inline void fail_and_notify(void)
 {
 	fprintf(stderr, "Allocation of memory for json object failed, aborting.\n");
 	abort();
 }
 
-struct json_object *json_create_object(void)
+/*
+ * Bump allocator backing a JSON tree. Chunks grow geometrically, nothing
+ * is freed until the whole arena is released. Every object or array is
+ * created with an arena of its own; adding it to another tree hands
+ * that arena over to the arena of the tree, which releases both.
+ */
+#define JSON_ARENA_MIN		512
+#define JSON_ARENA_MAX		(1 << 20)
+#define JSON_ARENA_ALIGN	16
+
+struct json_chunk {
+	struct json_chunk *next;
+	size_t size;
+	size_t used;
+	char data[] __attribute__((aligned(JSON_ARENA_ALIGN)));
+};
+
+struct json_arena {
+	struct json_chunk *chunks;
+	size_t next_size;
+	struct json_arena *owner;	/* arena that took this one over */
+	struct json_arena *adopted;	/* arenas taken over, freed with us */
+	struct json_arena *next;
+};
+
+/* The arena actually holding the tree, shortening the path on the way */
+static struct json_arena *json_arena_owner(struct json_arena *arena)
 {
-	void *test = calloc(1, sizeof(struct json_object));
-	if (!test)
-		fail_and_notify();
-	return test;
+	while (arena->owner) {
+		if (arena->owner->owner)
+			arena->owner = arena->owner->owner;
+		arena = arena->owner;
+	}
+	return arena;
 }
 
-struct json_array *json_create_array(void)
+static void *json_arena_alloc(struct json_arena *arena, size_t len)
 {
-	void *test = calloc(1, sizeof(struct json_array));
-	if (!test)
-		fail_and_notify();
-	return test;
+	struct json_chunk *chunk;
+	size_t size;
+	void *p;
+
+	arena = json_arena_owner(arena);
+	chunk = arena->chunks;
+	len = (len + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+	if (!chunk || chunk->size - chunk->used < len) {
+		size = arena->next_size;
+		if (size < JSON_ARENA_MAX)
+			arena->next_size <<= 1;
+		if (size < len)
+			size = len;
+		chunk = malloc(sizeof(*chunk) + size);
+		if (!chunk)
+			fail_and_notify();
+		chunk->size = size;
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+	p = chunk->data + chunk->used;
+	chunk->used += len;
+	return p;
 }
 
-static struct json_pair *json_create_pair(const char *name, struct json_value *value)
+static void *json_arena_zalloc(struct json_arena *arena, size_t len)
 {
-	struct json_pair *pair = malloc(sizeof(struct json_pair));
-	if (pair) {
-		pair->name = strdup(name);
-		pair->value = value;
+	return memset(json_arena_alloc(arena, len), 0, len);
+}
 
-		value->parent_type = JSON_PARENT_TYPE_PAIR;
-		value->parent_pair = pair;
-	} else
-		fail_and_notify();
+static char *json_arena_strdup(struct json_arena *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
 
-	return pair;
+	return memcpy(json_arena_alloc(arena, len), str, len);
 }
 
-static struct json_value *json_create_value_int(long long number)
+/* Grows a pointer array by doubling, the old copy stays in the arena */
+static void *json_arena_grow(struct json_arena *arena, void *array, int cnt,
+			     int *max)
 {
-	struct json_value *value = malloc(sizeof(struct json_value));
+	void *p;
 
-	if (value) {
-		value->type = JSON_TYPE_INTEGER;
-		value->integer_number = number;
-	} else
+	*max = *max ? *max * 2 : 8;
+	p = json_arena_alloc(arena, *max * sizeof(void *));
+	if (cnt)
+		memcpy(p, array, cnt * sizeof(void *));
+	return p;
+}
+
+static struct json_arena *json_arena_new(void)
+{
+	struct json_arena *arena;
+
+	arena = calloc(1, sizeof(*arena));
+	if (!arena)
 		fail_and_notify();
+	arena->next_size = JSON_ARENA_MIN;
+	return arena;
+}
 
-	return value;
+/* @child, and whatever it took over, is released along with @arena */
+static void json_arena_adopt(struct json_arena *arena,
+			     struct json_arena *child)
+{
+	arena = json_arena_owner(arena);
+	child = json_arena_owner(child);
+	if (arena == child)
+		return;
+	child->owner = arena;
+	child->next = arena->adopted;
+	arena->adopted = child;
 }
 
-static struct json_value *json_create_value_uint(unsigned long long number)
+static void json_arena_free(struct json_arena *arena)
 {
-	struct json_value *value = malloc(sizeof(struct json_value));
+	struct json_arena *child;
+	struct json_chunk *chunk;
 
-	if (value) {
-		value->type = JSON_TYPE_UINT;
-		value->uint_number = number;
-	} else
-		fail_and_notify();
+	while ((child = arena->adopted)) {
+		arena->adopted = child->next;
+		json_arena_free(child);
+	}
+	while ((chunk = arena->chunks)) {
+		arena->chunks = chunk->next;
+		free(chunk);
+	}
+	free(arena);
+}
 
-	return value;
+struct json_object *json_create_object(void)
+{
+	struct json_arena *arena = json_arena_new();
+	struct json_object *obj;
+
+	obj = json_arena_zalloc(arena, sizeof(*obj));
+	obj->arena = arena;
+	return obj;
 }
 
-static struct json_value *json_create_value_float(long double number)
+struct json_array *json_create_array(void)
 {
-	struct json_value *value = malloc(sizeof(struct json_value));
+	struct json_arena *arena = json_arena_new();
+	struct json_array *array;
 
-	if (value) {
-		value->type = JSON_TYPE_FLOAT;
-		value->float_number = number;
-	}  else
-		fail_and_notify();
+	array = json_arena_zalloc(arena, sizeof(*array));
+	array->arena = arena;
+	return array;
+}
+
+static struct json_pair *json_create_pair(struct json_arena *arena,
+		const char *name, struct json_value *value)
+{
+	struct json_pair *pair = json_arena_alloc(arena, sizeof(struct json_pair));
 
+	pair->name = json_arena_strdup(arena, name);
+	pair->value = value;
+
+	value->parent_type = JSON_PARENT_TYPE_PAIR;
+	value->parent_pair = pair;
+
+	return pair;
+}
+
+static struct json_value *json_create_value(struct json_arena *arena, int type)
+{
+	struct json_value *value = json_arena_alloc(arena, sizeof(struct json_value));
+
+	value->type = type;
 	return value;
 }
 
-static char *strdup_escape(const char *str)
+static char *strdup_escape(struct json_arena *arena, const char *str)
 {
 	const char *input = str;
 	char *p, *ret;
@@ -96,9 +199,7 @@ static char *strdup_escape(const char *str)
 		input++;
 	}
 
-	p = ret = malloc(strlen(str) + escapes + 1);
-	if (!ret)
-		fail_and_notify();
+	p = ret = json_arena_alloc(arena, strlen(str) + escapes + 1);
 
 	while (*str) {
 		if (*str == '\\' || *str == '\"')
@@ -113,295 +214,795 @@ static char *strdup_escape(const char *str)
 /*
  * Valid JSON strings must escape '"' and '/' with a preceding '/'
  */
-static struct json_value *json_create_value_string(const char *str)
+static struct json_value *json_create_value_string(struct json_arena *arena,
+						   const char *str)
 {
-	struct json_value *value = malloc(sizeof(struct json_value));
-
-	if (value) {
-		value->type = JSON_TYPE_STRING;
-		value->string = strdup_escape(str);
-		if (!value->string) {
-			free(value);
-			value = NULL;
-			return value;
-		}
-	}
-	if (!value)
-		fail_and_notify();
+	char *string = strdup_escape(arena, str);
+	struct json_value *value;
 
+	if (!string)
+		return NULL;
+	value = json_create_value(arena, JSON_TYPE_STRING);
+	value->string = string;
 	return value;
 }
 
-static struct json_value *json_create_value_object(struct json_object *obj)
+static struct json_value *json_create_value_object(struct json_arena *arena,
+						   struct json_object *obj)
 {
-	struct json_value *value = malloc(sizeof(struct json_value));
-
-	if (value) {
-		value->type = JSON_TYPE_OBJECT;
-		value->object = obj;
-		obj->parent = value;
-	} else
-		fail_and_notify();
+	struct json_value *value = json_create_value(arena, JSON_TYPE_OBJECT);
 
+	value->object = obj;
+	obj->parent = value;
+	json_arena_adopt(arena, obj->arena);
 	return value;
 }
 
-static struct json_value *json_create_value_array(struct json_array *array)
+static struct json_value *json_create_value_array(struct json_arena *arena,
+						  struct json_array *array)
 {
-	struct json_value *value = malloc(sizeof(struct json_value));
-
-	if (value) {
-		value->type = JSON_TYPE_ARRAY;
-		value->array = array;
-		array->parent = value;
-	} else
-		fail_and_notify();
+	struct json_value *value = json_create_value(arena, JSON_TYPE_ARRAY);
 
+	value->array = array;
+	array->parent = value;
+	json_arena_adopt(arena, array->arena);
 	return value;
 }
 
-static void json_free_pair(struct json_pair *pair);
-static void json_free_value(struct json_value *value);
-
-void json_free_object(struct json_object *obj)
+static struct json_value *json_create_value_va(struct json_arena *arena,
+					       int type, va_list args)
 {
-	int i;
-
-	for (i = 0; i < obj->pair_cnt; i++)
-		json_free_pair(obj->pairs[i]);
-	free(obj->pairs);
-	free(obj);
-}
-
-static void json_free_array(struct json_array *array)
-{
-	int i;
-
-	for (i = 0; i < array->value_cnt; i++)
-		json_free_value(array->values[i]);
-	free(array->values);
-	free(array);
-}
-
-static void json_free_pair(struct json_pair *pair)
-{
-	json_free_value(pair->value);
-	free(pair->name);
-	free(pair);
-}
+	struct json_value *value;
 
-static void json_free_value(struct json_value *value)
-{
-	switch (value->type) {
+	switch (type) {
 	case JSON_TYPE_STRING:
-		free(value->string);
-		break;
+		return json_create_value_string(arena, va_arg(args, char *));
+	case JSON_TYPE_INTEGER:
+		value = json_create_value(arena, type);
+		value->integer_number = va_arg(args, long long);
+		return value;
+	case JSON_TYPE_UINT:
+		value = json_create_value(arena, type);
+		value->uint_number = va_arg(args, unsigned long long);
+		return value;
+	case JSON_TYPE_FLOAT:
+		value = json_create_value(arena, type);
+		value->float_number = va_arg(args, long double);
+		return value;
+	case JSON_TYPE_UINT128:
+		value = json_create_value(arena, type);
+		value->uint128_number = va_arg(args, struct uint128);
+		return value;
 	case JSON_TYPE_OBJECT:
-		json_free_object(value->object);
-		break;
-	case JSON_TYPE_ARRAY:
-		json_free_array(value->array);
-		break;
+		return json_create_value_object(arena,
+				va_arg(args, struct json_object *));
+	default:
+		return json_create_value_array(arena,
+				va_arg(args, struct json_array *));
 	}
-	free(value);
 }
 
-static int json_array_add_value(struct json_array *array, struct json_value *value)
+/*
+ * Only a root owns memory, everything below it goes away with its arena.
+ */
+void json_free_object(struct json_object *obj)
 {
-	struct json_value **values = realloc(array->values,
-		sizeof(struct json_value *) * (array->value_cnt + 1));
+	if (!obj->parent)
+		json_arena_free(json_arena_owner(obj->arena));
+}
 
-	if (!values)
-		return ENOMEM;
-	values[array->value_cnt] = value;
-	array->value_cnt++;
-	array->values = values;
+static void json_array_add_value(struct json_array *array, struct json_value *value)
+{
+	if (array->value_cnt == array->value_max)
+		array->values = json_arena_grow(array->arena, array->values,
+				array->value_cnt, &array->value_max);
+	array->values[array->value_cnt++] = value;
 
 	value->parent_type = JSON_PARENT_TYPE_ARRAY;
 	value->parent_array = array;
-	return 0;
 }
 
-static int json_object_add_pair(struct json_object *obj, struct json_pair *pair)
+static void json_object_add_pair(struct json_object *obj, struct json_pair *pair)
 {
-	struct json_pair **pairs = realloc(obj->pairs,
-		sizeof(struct json_pair *) * (obj->pair_cnt + 1));
-	if (!pairs)
-		return ENOMEM;
-	pairs[obj->pair_cnt] = pair;
-	obj->pair_cnt++;
-	obj->pairs = pairs;
+	if (obj->pair_cnt == obj->pair_max)
+		obj->pairs = json_arena_grow(obj->arena, obj->pairs,
+				obj->pair_cnt, &obj->pair_max);
+	obj->pairs[obj->pair_cnt++] = pair;
 
 	pair->parent = obj;
-	return 0;
 }
 
 int json_object_add_value_type(struct json_object *obj, const char *name, int type, ...)
 {
 	struct json_value *value;
-	struct json_pair *pair;
 	va_list args;
-	int ret;
 
 	va_start(args, type);
-	if (type == JSON_TYPE_STRING)
-		value = json_create_value_string(va_arg(args, char *));
-	else if (type == JSON_TYPE_INTEGER)
-		value = json_create_value_int(va_arg(args, long long));
-	else if (type == JSON_TYPE_UINT)
-		value = json_create_value_uint(va_arg(args, unsigned long long));
-	else if (type == JSON_TYPE_FLOAT)
-		value = json_create_value_float(va_arg(args, long double));
-	else if (type == JSON_TYPE_OBJECT)
-		value = json_create_value_object(va_arg(args, struct json_object *));
-	else
-		value = json_create_value_array(va_arg(args, struct json_array *));
+	value = json_create_value_va(obj->arena, type, args);
 	va_end(args);
 
+	/* empty strings are left out */
 	if (!value)
 		return ENOMEM;
 
-	pair = json_create_pair(name, value);
-	if (!pair) {
-		json_free_value(value);
-		return ENOMEM;
-	}
-	ret = json_object_add_pair(obj, pair);
-	if (ret) {
-		json_free_pair(pair);
-		return ENOMEM;
-	}
+	json_object_add_pair(obj, json_create_pair(obj->arena, name, value));
 	return 0;
 }
 
-static void json_print_array(struct json_array *array, void *);
 int json_array_add_value_type(struct json_array *array, int type, ...)
 {
 	struct json_value *value;
 	va_list args;
-	int ret;
 
 	va_start(args, type);
-	if (type == JSON_TYPE_STRING)
-		value = json_create_value_string(va_arg(args, char *));
-	else if (type == JSON_TYPE_INTEGER)
-		value = json_create_value_int(va_arg(args, long long));
-	else if (type == JSON_TYPE_UINT)
-		value = json_create_value_uint(va_arg(args, unsigned long long));
-	else if (type == JSON_TYPE_FLOAT)
-		value = json_create_value_float(va_arg(args, double));
-	else if (type == JSON_TYPE_OBJECT)
-		value = json_create_value_object(va_arg(args, struct json_object *));
-	else
-		value = json_create_value_array(va_arg(args, struct json_array *));
+	if (type == JSON_TYPE_FLOAT) {
+		value = json_create_value(array->arena, type);
+		value->float_number = va_arg(args, double);
+	} else
+		value = json_create_value_va(array->arena, type, args);
 	va_end(args);
 
 	if (!value)
 		return ENOMEM;
 
-	ret = json_array_add_value(array, value);
-	if (ret) {
-		json_free_value(value);
-		return ENOMEM;
-	}
+	json_array_add_value(array, value);
 	return 0;
 }
 
-static int json_value_level(struct json_value *value);
-static int json_pair_level(struct json_pair *pair);
-static int json_array_level(struct json_array *array);
-static int json_object_level(struct json_object *object)
+/*
+ * Output is collected in one large buffer and handed to stdio in a few
+ * big writes instead of one call per token.
+ */
+#define JSON_OUT_BUF	(64 * 1024)
+
+struct json_out {
+	FILE *file;
+	char *buf;
+	size_t len;
+	bool pretty;
+};
+
+static enum json_format json_format;
+
+void json_set_format(enum json_format fmt)
 {
-	if (object->parent == NULL)
-		return 0;
-	return json_value_level(object->parent);
+	json_format = fmt;
 }
 
-static int json_pair_level(struct json_pair *pair)
+static FILE *json_output;
+
+void json_set_output(FILE *out)
 {
-	return json_object_level(pair->parent) + 1;
+	json_output = out;
 }
 
-static int json_array_level(struct json_array *array)
+static void json_out_flush(struct json_out *o)
 {
-	return json_value_level(array->parent);
+	if (o->len)
+		fwrite(o->buf, 1, o->len, o->file);
+	o->len = 0;
 }
 
-static int json_value_level(struct json_value *value)
+static void json_out_write(struct json_out *o, const char *str, size_t len)
 {
-	if (value->parent_type == JSON_PARENT_TYPE_PAIR)
-		return json_pair_level(value->parent_pair);
-	else
-		return json_array_level(value->parent_array) + 1;
+	if (o->len + len > JSON_OUT_BUF) {
+		json_out_flush(o);
+		if (len > JSON_OUT_BUF) {
+			fwrite(str, 1, len, o->file);
+			return;
+		}
+	}
+	memcpy(o->buf + o->len, str, len);
+	o->len += len;
 }
 
-static void json_print_level(int level, void *out)
+static void json_out_puts(struct json_out *o, const char *str)
 {
-	while (level-- > 0)
-		printf("  ");
+	json_out_write(o, str, strlen(str));
+}
+
+static void json_out_printf(struct json_out *o, const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintf(o->buf + o->len, JSON_OUT_BUF - o->len, fmt, args);
+	va_end(args);
+	if (len >= JSON_OUT_BUF - o->len) {
+		json_out_flush(o);
+		va_start(args, fmt);
+		len = vsnprintf(o->buf, JSON_OUT_BUF, fmt, args);
+		va_end(args);
+		if (len >= JSON_OUT_BUF)
+			len = JSON_OUT_BUF - 1;
+	}
+	if (len > 0)
+		o->len += len;
+}
+
+static void json_print_level(int level, struct json_out *o)
+{
+	static const char spaces[] = "                                ";
+	int n = level * 2;
+
+	while (n > 0) {
+		json_out_write(o, spaces, min(n, (int)sizeof(spaces) - 1));
+		n -= sizeof(spaces) - 1;
+	}
 }
 
-static void json_print_pair(struct json_pair *pair, void *);
-static void json_print_array(struct json_array *array, void *);
-static void json_print_value(struct json_value *value, void *);
-void json_print_object(struct json_object *obj, void *out)
+static void json_print_array(struct json_array *array, int level, struct json_out *o);
+static void json_print_value(struct json_value *value, int level, struct json_out *o);
+
+static void json_print_open(const char *open, struct json_out *o)
+{
+	json_out_puts(o, open);
+	if (o->pretty)
+		json_out_puts(o, "\n");
+}
+
+static void json_print_close(const char *close, int level, struct json_out *o)
+{
+	if (o->pretty) {
+		json_out_puts(o, "\n");
+		json_print_level(level, o);
+	}
+	json_out_puts(o, close);
+}
+
+static void json_print_sep(int i, int level, struct json_out *o)
+{
+	if (i > 0)
+		json_out_puts(o, o->pretty ? ",\n" : ",");
+	if (o->pretty)
+		json_print_level(level, o);
+}
+
+static void json_print_pair(struct json_pair *pair, int level, struct json_out *o)
+{
+	json_out_printf(o, o->pretty ? "\"%s\" : " : "\"%s\":", pair->name);
+	json_print_value(pair->value, level, o);
+}
+
+/* @level is the depth of the value holding @obj, 0 for the root */
+static void json_print_obj(struct json_object *obj, int level, struct json_out *o)
 {
 	int i;
 
-	printf("{\n");
+	json_print_open("{", o);
+	for (i = 0; i < obj->pair_cnt; i++) {
+		json_print_sep(i, level + 1, o);
+		json_print_pair(obj->pairs[i], level + 1, o);
+	}
+	json_print_close("}", level, o);
+}
+
+static void json_print_array(struct json_array *array, int level, struct json_out *o)
+{
+	int i;
+
+	json_print_open("[", o);
+	for (i = 0; i < array->value_cnt; i++) {
+		json_print_sep(i, level + 1, o);
+		json_print_value(array->values[i], level + 1, o);
+	}
+	json_print_close("]", level, o);
+}
+
+static void json_print_lines(struct json_object *obj, struct json_out *o)
+{
+	struct json_value *value;
+	int i, j, lines = 0;
+
 	for (i = 0; i < obj->pair_cnt; i++) {
-		if (i > 0)
-			printf(",\n");
-		json_print_pair(obj->pairs[i], out);
+		value = obj->pairs[i]->value;
+		if (value->type != JSON_TYPE_ARRAY) {
+			if (lines++)
+				json_out_puts(o, "\n");
+			json_out_puts(o, "{");
+			json_print_pair(obj->pairs[i], 1, o);
+			json_out_puts(o, "}");
+			continue;
+		}
+		for (j = 0; j < value->array->value_cnt; j++) {
+			if (lines++)
+				json_out_puts(o, "\n");
+			json_print_value(value->array->values[j], 0, o);
+		}
+	}
+}
+
+static void json_print_value(struct json_value *value, int level, struct json_out *o)
+{
+	char str[UINT128_STRLEN];
+
+	switch (value->type) {
+	case JSON_TYPE_STRING:
+		json_out_puts(o, "\"");
+		json_out_puts(o, value->string);
+		json_out_puts(o, "\"");
+		break;
+	case JSON_TYPE_INTEGER:
+		json_out_printf(o, "%lld", value->integer_number);
+		break;
+	case JSON_TYPE_UINT:
+		json_out_printf(o, "%llu", value->uint_number);
+		break;
+	case JSON_TYPE_FLOAT:
+		json_out_printf(o, "%.0Lf", value->float_number);
+		break;
+	case JSON_TYPE_UINT128:
+		json_out_puts(o, uint128_to_str(value->uint128_number, str, false));
+		break;
+	case JSON_TYPE_OBJECT:
+		json_print_obj(value->object, level, o);
+		break;
+	case JSON_TYPE_ARRAY:
+		json_print_array(value->array, level, o);
+		break;
 	}
-	printf("\n");
-	json_print_level(json_object_level(obj), out);
-	printf("}");
 }
 
-static void json_print_pair(struct json_pair *pair, void *out)
+/*
+ * CBOR: a head is the major type in the top three bits followed by the
+ * argument, inline below 24 or in the next 1, 2, 4 or 8 bytes.
+ */
+#define CBOR_UINT		0
+#define CBOR_NEGINT		1
+#define CBOR_BYTES		2
+#define CBOR_TEXT		3
+#define CBOR_ARRAY		4
+#define CBOR_MAP		5
+#define CBOR_TAG		6
+#define CBOR_TAG_BIGNUM		2
+#define CBOR_FLOAT64		0xfb
+#define CBOR_INDEFINITE		31
+#define CBOR_BREAK		0xff
+
+static int cbor_head(unsigned char *buf, int major, unsigned long long val)
 {
-	json_print_level(json_pair_level(pair), out);
-	printf("\"%s\" : ", pair->name);
-	json_print_value(pair->value, out);
+	int len, i;
+
+	if (val < 24) {
+		buf[0] = major << 5 | val;
+		return 1;
+	}
+	if (val <= 0xff)
+		len = 1;
+	else if (val <= 0xffff)
+		len = 2;
+	else if (val <= 0xffffffff)
+		len = 4;
+	else
+		len = 8;
+	buf[0] = major << 5 | (24 + (len == 1 ? 0 : len == 2 ? 1 : len == 4 ? 2 : 3));
+	for (i = len; i > 0; i--, val >>= 8)
+		buf[i] = val & 0xff;
+	return len + 1;
 }
 
-static void json_print_array(struct json_array *array, void *out)
+static int cbor_int(unsigned char *buf, long long val)
 {
+	if (val < 0)
+		return cbor_head(buf, CBOR_NEGINT, -1 - val);
+	return cbor_head(buf, CBOR_UINT, val);
+}
+
+/* Whole numbers, the only ones printed, are kept exact where they fit */
+static int cbor_float(unsigned char *buf, long double val)
+{
+	union {
+		double d;
+		unsigned long long u;
+	} f;
 	int i;
 
-	printf("[\n");
-	for (i = 0; i < array->value_cnt; i++) {
-		if (i > 0)
-			printf(",\n");
-		json_print_level(json_value_level(array->values[i]), out);
-		json_print_value(array->values[i], out);
+	if (val >= 0 && val < 18446744073709551616.0L &&
+	    val == (unsigned long long)val)
+		return cbor_head(buf, CBOR_UINT, (unsigned long long)val);
+	f.d = val;
+	buf[0] = CBOR_FLOAT64;
+	for (i = 8; i > 0; i--, f.u >>= 8)
+		buf[i] = f.u & 0xff;
+	return 9;
+}
+
+/* Counters beyond 64 bits become a bignum, a tagged big endian byte string */
+#define CBOR_UINT128_MAX	18
+
+static int cbor_uint128(unsigned char *buf, struct uint128 val)
+{
+	int len = 8, i;
+
+	if (!val.hi)
+		return cbor_head(buf, CBOR_UINT, val.lo);
+	while (!(val.hi >> (len - 1) * 8))
+		len--;
+	buf[0] = CBOR_TAG << 5 | CBOR_TAG_BIGNUM;
+	buf[1] = CBOR_BYTES << 5 | (len + 8);
+	for (i = len + 1; i > 1; i--, val.hi >>= 8)
+		buf[i] = val.hi & 0xff;
+	for (i = len + 9; i > len + 1; i--, val.lo >>= 8)
+		buf[i] = val.lo & 0xff;
+	return len + 10;
+}
+
+static void json_cbor_text(const char *str, size_t len, struct json_out *o)
+{
+	unsigned char head[9];
+
+	json_out_write(o, (char *)head, cbor_head(head, CBOR_TEXT, len));
+	json_out_write(o, str, len);
+}
+
+/* Tree strings are stored escaped for JSON, CBOR wants them raw */
+static void json_cbor_string(const char *str, struct json_out *o)
+{
+	unsigned char head[9];
+	const char *p;
+	size_t len = 0;
+
+	for (p = str; *p; p++, len++)
+		if (*p == '\\' && p[1])
+			p++;
+	json_out_write(o, (char *)head, cbor_head(head, CBOR_TEXT, len));
+	for (p = str; *p; p++) {
+		if (*p == '\\' && p[1])
+			p++;
+		json_out_write(o, p, 1);
 	}
-	printf("\n");
-	json_print_level(json_array_level(array), out);
-	printf("]");
 }
 
-static void json_print_value(struct json_value *value, void *out)
+static void json_cbor_value(struct json_value *value, struct json_out *o);
+
+static void json_cbor_obj(struct json_object *obj, struct json_out *o)
 {
+	unsigned char head[9];
+	int i;
+
+	json_out_write(o, (char *)head, cbor_head(head, CBOR_MAP, obj->pair_cnt));
+	for (i = 0; i < obj->pair_cnt; i++) {
+		json_cbor_text(obj->pairs[i]->name,
+			       strlen(obj->pairs[i]->name), o);
+		json_cbor_value(obj->pairs[i]->value, o);
+	}
+}
+
+static void json_cbor_value(struct json_value *value, struct json_out *o)
+{
+	unsigned char buf[CBOR_UINT128_MAX];
+	int i;
+
 	switch (value->type) {
 	case JSON_TYPE_STRING:
-		printf( "\"%s\"", value->string);
+		json_cbor_string(value->string, o);
 		break;
 	case JSON_TYPE_INTEGER:
-		printf( "%lld", value->integer_number);
+		json_out_write(o, (char *)buf, cbor_int(buf, value->integer_number));
 		break;
 	case JSON_TYPE_UINT:
-		printf( "%llu", value->uint_number);
+		json_out_write(o, (char *)buf,
+			       cbor_head(buf, CBOR_UINT, value->uint_number));
 		break;
 	case JSON_TYPE_FLOAT:
-		printf( "%.0Lf", value->float_number);
+		json_out_write(o, (char *)buf, cbor_float(buf, value->float_number));
+		break;
+	case JSON_TYPE_UINT128:
+		json_out_write(o, (char *)buf,
+			       cbor_uint128(buf, value->uint128_number));
 		break;
 	case JSON_TYPE_OBJECT:
-		json_print_object(value->object, out);
+		json_cbor_obj(value->object, o);
 		break;
 	case JSON_TYPE_ARRAY:
-		json_print_array(value->array, out);
+		json_out_write(o, (char *)buf, cbor_head(buf, CBOR_ARRAY,
+						value->array->value_cnt));
+		for (i = 0; i < value->array->value_cnt; i++)
+			json_cbor_value(value->array->values[i], o);
 		break;
 	}
 }
+
+void json_print_object(struct json_object *obj, FILE *out)
+{
+	struct json_out o = {
+		.file = out ? out : json_output ? json_output : stdout,
+		.pretty = json_format == JSON_FMT_PRETTY,
+	};
+
+	o.buf = malloc(JSON_OUT_BUF);
+	if (!o.buf)
+		fail_and_notify();
+	if (json_format == JSON_FMT_CBOR) {
+		json_cbor_obj(obj, &o);
+	} else {
+		if (json_format == JSON_FMT_NDJSON && obj->pair_cnt &&
+		    obj->pairs[0]->value->type == JSON_TYPE_ARRAY)
+			json_print_lines(obj, &o);
+		else
+			json_print_obj(obj, 0, &o);
+		json_out_puts(&o, "\n");
+	}
+	json_out_flush(&o);
+	free(o.buf);
+}
+
+void json_writer_init(struct json_writer *w, FILE *out)
+{
+	memset(w, 0, sizeof(*w));
+	w->out = out;
+	w->fmt = json_format;
+	w->first = 1;
+}
+
+static void json_writer_indent(struct json_writer *w)
+{
+	int level = w->depth;
+
+	while (level-- > 0)
+		fputs("  ", w->out);
+}
+
+static void json_writer_newline(struct json_writer *w)
+{
+	if (w->lines)
+		fputc('\n', w->out);
+	w->lines = true;
+}
+
+/*
+ * ndjson handling of a member of the root or of the list being unrolled.
+ * Returns true if the member is an unrolled array that prints nothing.
+ */
+static bool json_writer_line(struct json_writer *w, bool array)
+{
+	if (w->depth == 1 && w->pending) {
+		w->pending = false;
+		if (array) {
+			w->unroll = true;
+			return true;
+		}
+		fputc('{', w->out);
+	} else if (w->depth == 1 && w->unroll) {
+		if (array)
+			return true;
+		json_writer_newline(w);
+		fputc('{', w->out);
+		w->first |= 1ULL << w->depth;
+		w->wrapped = true;
+	} else if (w->depth == 2 && w->in_unrolled) {
+		json_writer_newline(w);
+		w->first |= 1ULL << w->depth;
+	}
+	return false;
+}
+
+/* Separator, indentation and key of the next member */
+static void json_writer_member(struct json_writer *w, const char *name)
+{
+	bool pretty = w->fmt == JSON_FMT_PRETTY;
+
+	if (w->depth) {
+		if (!(w->first & (1ULL << w->depth)))
+			fputs(pretty ? ",\n" : ",", w->out);
+		w->first &= ~(1ULL << w->depth);
+		if (pretty)
+			json_writer_indent(w);
+	}
+	if (name && !(w->in_unrolled && w->depth == 2))
+		fprintf(w->out, pretty ? "\"%s\" : " : "\"%s\":", name);
+}
+
+/* Closes the line of a wrapped root member once its value is done */
+static void json_writer_done(struct json_writer *w)
+{
+	if (w->wrapped && w->depth == 1) {
+		fputc('}', w->out);
+		w->wrapped = false;
+	}
+}
+
+static void json_writer_cbor_key(struct json_writer *w, const char *name)
+{
+	unsigned char head[9];
+	size_t len;
+
+	if (!name)
+		return;
+	len = strlen(name);
+	fwrite(head, 1, cbor_head(head, CBOR_TEXT, len), w->out);
+	fwrite(name, 1, len, w->out);
+}
+
+static void json_writer_begin(struct json_writer *w, const char *name,
+			      const char *open)
+{
+	bool ndjson = w->fmt == JSON_FMT_NDJSON;
+
+	if (w->fmt == JSON_FMT_CBOR) {
+		json_writer_cbor_key(w, name);
+		fputc((open[0] == '[' ? CBOR_ARRAY : CBOR_MAP) << 5 |
+		      CBOR_INDEFINITE, w->out);
+	} else if (ndjson && !w->depth) {
+		w->pending = true;
+	} else if (ndjson && json_writer_line(w, open[0] == '[')) {
+		w->in_unrolled = true;
+	} else {
+		json_writer_member(w, name);
+		fputs(open, w->out);
+		if (w->fmt == JSON_FMT_PRETTY)
+			fputc('\n', w->out);
+	}
+	if (w->depth < JSON_WRITER_MAX_DEPTH - 1)
+		w->depth++;
+	w->first |= 1ULL << w->depth;
+}
+
+static void json_writer_end(struct json_writer *w, const char *close)
+{
+	bool ndjson = w->fmt == JSON_FMT_NDJSON;
+
+	if (w->fmt == JSON_FMT_CBOR) {
+		fputc(CBOR_BREAK, w->out);
+		if (w->depth)
+			w->depth--;
+		return;
+	}
+	if (ndjson && w->depth == 2 && w->in_unrolled) {
+		w->in_unrolled = false;
+		w->depth--;
+		return;
+	}
+	if (ndjson && w->depth == 1) {
+		if (w->pending)
+			fputs("{}", w->out);
+		else if (!w->unroll)
+			fputs(close, w->out);
+		fputc('\n', w->out);
+		w->depth--;
+		return;
+	}
+	if (w->fmt == JSON_FMT_PRETTY)
+		fputs("\n", w->out);
+	if (w->depth)
+		w->depth--;
+	if (w->fmt == JSON_FMT_PRETTY)
+		json_writer_indent(w);
+	fputs(close, w->out);
+	if (!w->depth)
+		fputc('\n', w->out);
+	json_writer_done(w);
+}
+
+void json_writer_begin_object(struct json_writer *w, const char *name)
+{
+	json_writer_begin(w, name, "{");
+}
+
+void json_writer_end_object(struct json_writer *w)
+{
+	json_writer_end(w, "}");
+}
+
+void json_writer_begin_array(struct json_writer *w, const char *name)
+{
+	json_writer_begin(w, name, "[");
+}
+
+void json_writer_end_array(struct json_writer *w)
+{
+	json_writer_end(w, "]");
+}
+
+void json_write_string(struct json_writer *w, const char *name, const char *val)
+{
+	unsigned char head[9];
+	size_t len;
+
+	/* empty strings are left out, like in a tree */
+	if (!*val)
+		return;
+	if (w->fmt == JSON_FMT_CBOR) {
+		json_writer_cbor_key(w, name);
+		len = strlen(val);
+		fwrite(head, 1, cbor_head(head, CBOR_TEXT, len), w->out);
+		fwrite(val, 1, len, w->out);
+		return;
+	}
+	if (w->fmt == JSON_FMT_NDJSON)
+		json_writer_line(w, false);
+	json_writer_member(w, name);
+	fputc('"', w->out);
+	for (; *val; val++) {
+		switch (*val) {
+		case '\\':
+		case '"':
+			fputc('\\', w->out);
+			fputc(*val, w->out);
+			break;
+		case '\n':
+			fputs("\\n", w->out);
+			break;
+		case '\r':
+			fputs("\\r", w->out);
+			break;
+		case '\t':
+			fputs("\\t", w->out);
+			break;
+		default:
+			/* other control characters are not valid in a string */
+			if ((unsigned char)*val < 0x20)
+				fprintf(w->out, "\\u%04x", *val);
+			else
+				fputc(*val, w->out);
+		}
+	}
+	fputc('"', w->out);
+	json_writer_done(w);
+}
+
+void json_write_int(struct json_writer *w, const char *name, long long val)
+{
+	unsigned char buf[9];
+
+	if (w->fmt == JSON_FMT_CBOR) {
+		json_writer_cbor_key(w, name);
+		fwrite(buf, 1, cbor_int(buf, val), w->out);
+		return;
+	}
+	if (w->fmt == JSON_FMT_NDJSON)
+		json_writer_line(w, false);
+	json_writer_member(w, name);
+	fprintf(w->out, "%lld", val);
+	json_writer_done(w);
+}
+
+void json_write_uint(struct json_writer *w, const char *name, unsigned long long val)
+{
+	unsigned char buf[9];
+
+	if (w->fmt == JSON_FMT_CBOR) {
+		json_writer_cbor_key(w, name);
+		fwrite(buf, 1, cbor_head(buf, CBOR_UINT, val), w->out);
+		return;
+	}
+	if (w->fmt == JSON_FMT_NDJSON)
+		json_writer_line(w, false);
+	json_writer_member(w, name);
+	fprintf(w->out, "%llu", val);
+	json_writer_done(w);
+}
+
+void json_write_float(struct json_writer *w, const char *name, long double val)
+{
+	unsigned char buf[9];
+
+	if (w->fmt == JSON_FMT_CBOR) {
+		json_writer_cbor_key(w, name);
+		fwrite(buf, 1, cbor_float(buf, val), w->out);
+		return;
+	}
+	if (w->fmt == JSON_FMT_NDJSON)
+		json_writer_line(w, false);
+	json_writer_member(w, name);
+	fprintf(w->out, "%.0Lf", val);
+	json_writer_done(w);
+}
+
+void json_write_uint128(struct json_writer *w, const char *name, struct uint128 val)
+{
+	unsigned char buf[CBOR_UINT128_MAX];
+	char str[UINT128_STRLEN];
+
+	if (w->fmt == JSON_FMT_CBOR) {
+		json_writer_cbor_key(w, name);
+		fwrite(buf, 1, cbor_uint128(buf, val), w->out);
+		return;
+	}
+	if (w->fmt == JSON_FMT_NDJSON)
+		json_writer_line(w, false);
+	json_writer_member(w, name);
+	fputs(uint128_to_str(val, str, false), w->out);
+	json_writer_done(w);
+}
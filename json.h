@@ -1,9 +1,15 @@
 #ifndef __JSON__H
 #define __JSON__H
 
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "uint128.h"
+
 struct json_object;
 struct json_array;
 struct json_pair;
+struct json_arena;
 
 #define JSON_TYPE_STRING 0
 #define JSON_TYPE_INTEGER 1
@@ -11,6 +17,7 @@ struct json_pair;
 #define JSON_TYPE_OBJECT 3
 #define JSON_TYPE_ARRAY 4
 #define JSON_TYPE_UINT 5
+#define JSON_TYPE_UINT128 6
 #define JSON_PARENT_TYPE_PAIR 0
 #define JSON_PARENT_TYPE_ARRAY 1
 struct json_value {
@@ -19,6 +26,7 @@ struct json_value {
 		long long integer_number;
 		unsigned long long uint_number;
 		long double float_number;
+		struct uint128 uint128_number;
 		char *string;
 		struct json_object *object;
 		struct json_array *array;
@@ -33,13 +41,17 @@ struct json_value {
 struct json_array {
 	struct json_value **values;
 	int value_cnt;
+	int value_max;
 	struct json_value *parent;
+	struct json_arena *arena;
 };
 
 struct json_object {
 	struct json_pair **pairs;
 	int pair_cnt;
+	int pair_max;
 	struct json_value *parent;
+	struct json_arena *arena;
 };
 
 struct json_pair {
@@ -48,6 +60,11 @@ struct json_pair {
 	struct json_object *parent;
 };
 
+/*
+ * Every object or array owns the memory of everything added to it until
+ * it is added to another tree itself. json_free_object() on a root
+ * releases the whole tree; a tree must be built on a single thread.
+ */
 struct json_object *json_create_object(void);
 struct json_array *json_create_array(void);
 
@@ -60,6 +77,8 @@ int json_object_add_value_type(struct json_object *obj, const char *name, int ty
 	json_object_add_value_type((obj), name, JSON_TYPE_UINT, (unsigned long long) (val))
 #define json_object_add_value_float(obj, name, val) \
 	json_object_add_value_type((obj), name, JSON_TYPE_FLOAT, (val))
+#define json_object_add_value_uint128(obj, name, val) \
+	json_object_add_value_type((obj), name, JSON_TYPE_UINT128, (struct uint128)(val))
 #define json_object_add_value_string(obj, name, val) \
 	json_object_add_value_type((obj), name, JSON_TYPE_STRING, (val))
 #define json_object_add_value_object(obj, name, val) \
@@ -73,6 +92,8 @@ int json_array_add_value_type(struct json_array *array, int type, ...);
 	json_array_add_value_type((obj), JSON_TYPE_UINT, (val))
 #define json_array_add_value_float(obj, val) \
 	json_array_add_value_type((obj), JSON_TYPE_FLOAT, (val))
+#define json_array_add_value_uint128(obj, val) \
+	json_array_add_value_type((obj), JSON_TYPE_UINT128, (struct uint128)(val))
 #define json_array_add_value_string(obj, val) \
 	json_array_add_value_type((obj), JSON_TYPE_STRING, (val))
 #define json_array_add_value_object(obj, val) \
@@ -83,5 +104,57 @@ int json_array_add_value_type(struct json_array *array, int type, ...);
 #define json_array_last_value_object(obj) \
 	(obj->values[obj->value_cnt - 1]->object)
 
-void json_print_object(struct json_object *obj, void *);
+/*
+ * JSON_FMT_NDJSON prints a list, a root whose first member is an array,
+ * with one line per array element. Other root members of a list get a
+ * line of their own and any other root is printed on a single line.
+ *
+ * JSON_FMT_CBOR encodes the same data model as one binary CBOR (RFC 8949)
+ * item per document.
+ */
+enum json_format {
+	JSON_FMT_PRETTY,
+	JSON_FMT_COMPACT,
+	JSON_FMT_NDJSON,
+	JSON_FMT_CBOR,
+};
+
+void json_set_format(enum json_format fmt);
+
+/* Stream json_print_object() writes to when not given one, NULL for stdout */
+void json_set_output(FILE *out);
+
+/* Prints a whole document, text formats end it with a newline */
+void json_print_object(struct json_object *obj, FILE *out);
+
+/*
+ * Streaming writer producing the same output as json_print_object()
+ * without building a tree. CBOR containers are written with indefinite
+ * length. @name is NULL for members of an array.
+ */
+#define JSON_WRITER_MAX_DEPTH	64
+
+struct json_writer {
+	FILE *out;
+	enum json_format fmt;
+	int depth;
+	unsigned long long first;
+	/* ndjson state */
+	bool pending;
+	bool unroll;
+	bool in_unrolled;
+	bool wrapped;
+	bool lines;
+};
+
+void json_writer_init(struct json_writer *w, FILE *out);
+void json_writer_begin_object(struct json_writer *w, const char *name);
+void json_writer_end_object(struct json_writer *w);
+void json_writer_begin_array(struct json_writer *w, const char *name);
+void json_writer_end_array(struct json_writer *w);
+void json_write_string(struct json_writer *w, const char *name, const char *val);
+void json_write_int(struct json_writer *w, const char *name, long long val);
+void json_write_uint(struct json_writer *w, const char *name, unsigned long long val);
+void json_write_float(struct json_writer *w, const char *name, long double val);
+void json_write_uint128(struct json_writer *w, const char *name, struct uint128 val);
 #endif
@@ -0,0 +1,212 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nvme-capture.h"
+#include "nvme-ioctl.h"
+#include "suffix.h"
+
+/*
+ * Two buffers are handed back and forth between the thread reading from
+ * the device and a writer thread, so the device never waits for the
+ * file system and vice versa.
+ */
+struct capture_buf {
+	void *data;
+	__u32 len;
+	bool full;
+};
+
+struct capture_writer {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct capture_buf buf[2];
+	int out;
+	int err;
+	bool done;
+};
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, buf, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!ret)
+			return -EIO;
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static void *capture_write_thread(void *arg)
+{
+	struct capture_writer *w = arg;
+	struct capture_buf *b;
+	int idx = 0, err;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		b = &w->buf[idx];
+		while (!b->full && !w->done)
+			pthread_cond_wait(&w->cond, &w->lock);
+		if (!b->full)
+			break;
+		pthread_mutex_unlock(&w->lock);
+
+		err = write_all(w->out, b->data, b->len);
+
+		pthread_mutex_lock(&w->lock);
+		if (err && !w->err)
+			w->err = err;
+		b->full = false;
+		pthread_cond_broadcast(&w->cond);
+		idx ^= 1;
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+static int capture_get_log(int fd, void *priv, __u64 offset, __u32 len,
+			   void *buf, bool last)
+{
+	struct nvme_capture *c = priv;
+	int err;
+
+	err = nvme_get_log13(fd, c->nsid, c->log_id, c->lsp, offset, 0,
+			     c->rae, len, buf);
+	return err < 0 ? -errno : err;
+}
+
+static double capture_elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) +
+		(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void capture_progress(const struct nvme_capture *c, __u64 done,
+			     const struct timespec *start, bool final)
+{
+	static double last;
+	double secs = capture_elapsed(start);
+	double rate = secs > 0 ? done / secs : 0;
+	const char *suffix = suffix_si_get(&rate);
+	bool tty = isatty(STDERR_FILENO);
+
+	if (final) {
+		fprintf(stderr, "%s%llu bytes in %.2f s (%.2f %sB/s)\n",
+			tty ? "\r" : "", (unsigned long long)done, secs,
+			rate, suffix);
+		return;
+	}
+	if (!tty || secs - last < 0.1)
+		return;
+	last = secs;
+	fprintf(stderr, "\r%3u%% %llu/%llu bytes, %.2f %sB/s",
+		(unsigned int)(done * 100 / c->len), (unsigned long long)done,
+		(unsigned long long)c->len, rate, suffix);
+}
+
+int nvme_capture_log(struct nvme_capture *c)
+{
+	struct capture_writer w = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.cond = PTHREAD_COND_INITIALIZER,
+		.out = c->out,
+	};
+	nvme_capture_read_fn read_chunk = c->read ? c->read : capture_get_log;
+	void *priv = c->read ? c->priv : c;
+	struct timespec start;
+	struct capture_buf *b;
+	pthread_t writer;
+	__u64 done = 0;
+	__u32 xfer, len;
+	int err = 0, idx = 0, i;
+
+	if (!c->len)
+		return 0;
+
+	xfer = c->xfer ? c->xfer : nvme_get_max_xfer(c->fd);
+	if (xfer > c->len)
+		xfer = c->len;
+	for (i = 0; i < 2; i++) {
+		if (posix_memalign(&w.buf[i].data, getpagesize(), xfer)) {
+			err = -ENOMEM;
+			goto free;
+		}
+	}
+
+	err = -pthread_create(&writer, NULL, capture_write_thread, &w);
+	if (err)
+		goto free;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (done < c->len) {
+		b = &w.buf[idx];
+		pthread_mutex_lock(&w.lock);
+		while (b->full && !w.err)
+			pthread_cond_wait(&w.cond, &w.lock);
+		err = w.err;
+		pthread_mutex_unlock(&w.lock);
+		if (err)
+			break;
+
+		len = xfer;
+		if (len > c->len - done)
+			len = c->len - done;
+		err = read_chunk(c->fd, priv, c->offset + done, len, b->data,
+				 done + len == c->len);
+		if (nvme_xfer_rejected(err) && !c->xfer &&
+		    xfer > NVME_XFER_MIN) {
+			/* same as nvme_get_log_split(): back off and retry */
+			xfer >>= 1;
+			nvme_limit_max_xfer(c->fd, xfer);
+			continue;
+		}
+		if (err)
+			break;
+
+		pthread_mutex_lock(&w.lock);
+		b->len = len;
+		b->full = true;
+		pthread_cond_broadcast(&w.cond);
+		pthread_mutex_unlock(&w.lock);
+
+		done += len;
+		idx ^= 1;
+		if (c->progress)
+			capture_progress(c, done, &start, false);
+	}
+
+	pthread_mutex_lock(&w.lock);
+	w.done = true;
+	pthread_cond_broadcast(&w.cond);
+	pthread_mutex_unlock(&w.lock);
+	pthread_join(writer, NULL);
+	if (!err)
+		err = w.err;
+
+	if (c->progress) {
+		if (err && isatty(STDERR_FILENO))
+			fprintf(stderr, "\n");
+		else if (!err)
+			capture_progress(c, done, &start, true);
+	}
+free:
+	free(w.buf[0].data);
+	free(w.buf[1].data);
+	return err;
+}
@@ -0,0 +1,46 @@
+#ifndef _NVME_CAPTURE_H
+#define _NVME_CAPTURE_H
+
+#include <linux/types.h>
+#include <stdbool.h>
+
+/*
+ * Reads @len bytes at @offset of a log into @buf. @last is set for the
+ * final chunk of the capture. Returns 0, a positive NVMe status or
+ * -errno.
+ */
+typedef int (*nvme_capture_read_fn)(int fd, void *priv, __u64 offset,
+				    __u32 len, void *buf, bool last);
+
+/*
+ * nvme_capture - copies a large log from a device into a file
+ * @fd: device to read from
+ * @out: file descriptor the data is written to
+ * @offset/@len: byte range of the log to copy
+ * @xfer: transfer size, 0 to use the largest the controller allows
+ * @read: reads one chunk, NULL to use Get Log Page with the fields below
+ * @priv: passed to @read
+ * @nsid/@log_id/@lsp/@rae: Get Log Page fields for the default reader
+ * @progress: report progress and throughput on stderr
+ *
+ * Reading the next chunk from the device overlaps with writing the
+ * previous one to @out.
+ */
+struct nvme_capture {
+	int fd;
+	int out;
+	__u64 offset;
+	__u64 len;
+	__u32 xfer;
+	nvme_capture_read_fn read;
+	void *priv;
+	__u32 nsid;
+	__u8 log_id;
+	__u8 lsp;
+	bool rae;
+	bool progress;
+};
+
+int nvme_capture_log(struct nvme_capture *c);
+
+#endif /* _NVME_CAPTURE_H */
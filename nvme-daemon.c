@@ -0,0 +1,231 @@
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "nvme-daemon.h"
+#include "nvme-output.h"
+
+#define DAEMON_MAX_CLIENTS	64
+#define DAEMON_MAX_LINE		4096
+
+struct daemon_client {
+	int fd;
+	size_t len;
+	char buf[DAEMON_MAX_LINE];
+};
+
+static volatile sig_atomic_t daemon_stop;
+
+static void daemon_signal(int sig)
+{
+	daemon_stop = 1;
+}
+
+/* Only ever removes a socket, never a file given by mistake */
+static void unlink_socket(const char *path)
+{
+	struct stat st;
+
+	if (!lstat(path, &st) && S_ISSOCK(st.st_mode))
+		unlink(path);
+}
+
+static int daemon_listen(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd, err;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+	/* a socket left behind by a previous instance */
+	unlink_socket(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(fd, DAEMON_MAX_CLIENTS) < 0) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+	return fd;
+}
+
+int nvme_daemon_split(char *line, char **argv, int max)
+{
+	char *src = line, *dst = line, quote;
+	int argc = 0;
+
+	for (;;) {
+		while (*src == ' ' || *src == '\t')
+			src++;
+		if (!*src)
+			break;
+		if (argc == max - 1)
+			return -E2BIG;
+
+		argv[argc++] = dst;
+		quote = 0;
+		for (; *src; src++) {
+			if (quote && *src == quote)
+				quote = 0;
+			else if (!quote && (*src == '\'' || *src == '"'))
+				quote = *src;
+			else if (!quote && (*src == ' ' || *src == '\t'))
+				break;
+			else
+				*dst++ = *src;
+		}
+		if (quote)
+			return -EINVAL;
+		if (*src)
+			src++;
+		*dst++ = '\0';
+	}
+	argv[argc] = NULL;
+	return argc;
+}
+
+static int daemon_send(int fd, const char *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = send(fd, buf, len, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int daemon_request(int fd, char *line, nvme_daemon_run_fn run)
+{
+	char *argv[NVME_DAEMON_MAX_ARGS], head[32];
+	struct nvme_sink sink;
+	int argc, ret, err;
+
+	argc = nvme_daemon_split(line, argv, NVME_DAEMON_MAX_ARGS);
+	if (argc <= 0) {
+		ret = argc ? argc : -EINVAL;
+		sink.buf = NULL;
+		sink.len = 0;
+	} else {
+		err = nvme_sink_memory(&sink);
+		if (err)
+			return err;
+		nvme_sink_push(&sink);
+		ret = run(argc, argv);
+		nvme_sink_pop(&sink);
+		nvme_sink_close(&sink);
+	}
+
+	snprintf(head, sizeof(head), "%d %zu\n", ret, sink.len);
+	err = daemon_send(fd, head, strlen(head));
+	if (!err && sink.len)
+		err = daemon_send(fd, sink.buf, sink.len);
+	free(sink.buf);
+	return err;
+}
+
+/* Runs every complete line received so far, returns < 0 to drop @c */
+static int daemon_client_input(struct daemon_client *c, nvme_daemon_run_fn run)
+{
+	char *nl, *line;
+	ssize_t ret;
+	int err;
+
+	ret = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+	if (ret <= 0)
+		return ret < 0 && errno == EINTR ? 0 : -1;
+	c->len += ret;
+
+	line = c->buf;
+	while ((nl = memchr(line, '\n', c->len - (line - c->buf)))) {
+		*nl = '\0';
+		err = daemon_request(c->fd, line, run);
+		if (err)
+			return err;
+		line = nl + 1;
+	}
+	c->len -= line - c->buf;
+	memmove(c->buf, line, c->len);
+
+	/* a line that does not fit the buffer can never be completed */
+	return c->len == sizeof(c->buf) ? -E2BIG : 0;
+}
+
+int nvme_daemon_serve(const char *path, nvme_daemon_run_fn run)
+{
+	struct daemon_client *clients[DAEMON_MAX_CLIENTS] = { NULL };
+	struct pollfd pfd[DAEMON_MAX_CLIENTS + 1];
+	struct sigaction sa = { .sa_handler = daemon_signal };
+	int lfd, fd, nr = 0, i, n, err = 0;
+
+	lfd = daemon_listen(path);
+	if (lfd < 0)
+		return lfd;
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	while (!daemon_stop) {
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < nr; i++) {
+			pfd[i + 1].fd = clients[i]->fd;
+			pfd[i + 1].events = POLLIN;
+		}
+
+		n = poll(pfd, nr + 1, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		for (i = nr - 1; i >= 0; i--) {
+			if (!pfd[i + 1].revents)
+				continue;
+			if (daemon_client_input(clients[i], run) < 0) {
+				close(clients[i]->fd);
+				free(clients[i]);
+				clients[i] = clients[--nr];
+			}
+		}
+
+		if (!(pfd[0].revents & POLLIN))
+			continue;
+		fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0)
+			continue;
+		if (nr == DAEMON_MAX_CLIENTS ||
+		    !(clients[nr] = calloc(1, sizeof(*clients[nr])))) {
+			close(fd);
+			continue;
+		}
+		clients[nr++]->fd = fd;
+	}
+
+	for (i = 0; i < nr; i++) {
+		close(clients[i]->fd);
+		free(clients[i]);
+	}
+	close(lfd);
+	unlink_socket(path);
+	return err;
+}
@@ -0,0 +1,30 @@
+#ifndef _NVME_DAEMON_H
+#define _NVME_DAEMON_H
+
+/*
+ * Runs one command line, without the program name. Whatever it prints
+ * to nvme_out() is sent back to the client.
+ */
+typedef int (*nvme_daemon_run_fn)(int argc, char **argv);
+
+#define NVME_DAEMON_MAX_ARGS	128
+
+/*
+ * Splits a request @line in place into at most @max - 1 arguments,
+ * separated by blanks and optionally quoted with ' or ". @argv is NULL
+ * terminated. Returns the number of arguments, -EINVAL for an unbalanced
+ * quote or -E2BIG.
+ */
+int nvme_daemon_split(char *line, char **argv, int max);
+
+/*
+ * Accepts connections on the Unix stream socket @path until SIGINT or
+ * SIGTERM. Every client may send any number of requests, one command
+ * line per newline terminated line, split by nvme_daemon_split(). Each
+ * request is answered with a "<status> <length>\n" header followed by
+ * <length> bytes of output. Requests are run one at a time in the order
+ * they arrive.
+ */
+int nvme_daemon_serve(const char *path, nvme_daemon_run_fn run);
+
+#endif /* _NVME_DAEMON_H */
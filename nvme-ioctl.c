@@ -15,8 +15,13 @@
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/sysmacros.h>
 
 #include "nvme-ioctl.h"
+#include "nvme-uring.h"
 
 static int nvme_verify_chr(int fd)
 {
@@ -85,17 +90,22 @@ int nvme_get_nsid(int fd)
 int nvme_submit_passthru(int fd, unsigned long ioctl_cmd,
 			 struct nvme_passthru_cmd *cmd)
 {
+	int err;
+
+	if ((ioctl_cmd == NVME_IOCTL_ADMIN_CMD || ioctl_cmd == NVME_IOCTL_IO_CMD) &&
+	    nvme_uring_passthru(fd, ioctl_cmd == NVME_IOCTL_ADMIN_CMD, cmd, &err))
+		return err;
 	return ioctl(fd, ioctl_cmd, cmd);
 }
 
 static int nvme_submit_admin_passthru(int fd, struct nvme_passthru_cmd *cmd)
 {
-	return ioctl(fd, NVME_IOCTL_ADMIN_CMD, cmd);
+	return nvme_submit_passthru(fd, NVME_IOCTL_ADMIN_CMD, cmd);
 }
 
 static int nvme_submit_io_passthru(int fd, struct nvme_passthru_cmd *cmd)
 {
-	return ioctl(fd, NVME_IOCTL_IO_CMD, cmd);
+	return nvme_submit_passthru(fd, NVME_IOCTL_IO_CMD, cmd);
 }
 
 int nvme_passthru(int fd, unsigned long ioctl_cmd, __u8 opcode,
@@ -151,6 +161,36 @@ int nvme_io(int fd, __u8 opcode, __u64 slba, __u16 nblocks, __u16 control,
 		.appmask	= appmask,
 		.apptag		= apptag,
 	};
+	struct nvme_uring_target t;
+	bool done = false;
+	int err;
+
+	/*
+	 * The io_uring backend only takes passthrough commands, so the
+	 * transfer length the kernel derives for SUBMIT_IO is computed
+	 * here. Commands with metadata keep using the ioctl.
+	 */
+	if (!metadata && nvme_get_backend() == NVME_BACKEND_IO_URING &&
+	    !nvme_uring_get_target(fd, false, &t)) {
+		struct nvme_passthru_cmd cmd = {
+			.opcode		= opcode,
+			.nsid		= t.nsid,
+			.addr		= (__u64)(uintptr_t) data,
+			.data_len	= (nblocks + 1) * t.lba_size,
+			.cdw10		= slba & 0xffffffff,
+			.cdw11		= slba >> 32,
+			.cdw12		= nblocks | (control << 16),
+			.cdw13		= dsmgmt,
+			.cdw14		= reftag,
+			.cdw15		= apptag | (appmask << 16),
+		};
+
+		if (t.lba_size)
+			done = nvme_uring_passthru_target(&t, false, &cmd, &err);
+		nvme_uring_put_target(&t);
+		if (done)
+			return err;
+	}
 	return ioctl(fd, NVME_IOCTL_SUBMIT_IO, &io);
 }
 
@@ -366,6 +406,128 @@ int nvme_identify_ctrl(int fd, void *data)
 	return nvme_identify(fd, 0, 1, data);
 }
 
+/*
+ * Identify Controller cache. Entries are keyed by the sysfs device of
+ * the controller, so all namespaces of a controller (or of a subsystem
+ * with native multipath, where the kernel may route the command down
+ * any path) share one entry. Failures are not cached. Data older than
+ * ID_CTRL_CACHE_TTL seconds is read again, as another process may have
+ * formatted or updated the controller in the meantime.
+ */
+#define ID_CTRL_CACHE_TTL	5
+
+struct id_ctrl_cache_entry {
+	struct id_ctrl_cache_entry *next;
+	char key[PATH_MAX];
+	pthread_mutex_t lock;
+	bool valid;
+	struct timespec stamp;
+	struct nvme_id_ctrl ctrl;
+	__u32 max_xfer;
+};
+
+static struct id_ctrl_cache_entry *id_ctrl_cache;
+static pthread_mutex_t id_ctrl_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int nvme_ctrl_key(int fd, char *key)
+{
+	char path[64];
+	struct stat st;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	if (S_ISBLK(st.st_mode))
+		snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/device",
+			 major(st.st_rdev), minor(st.st_rdev));
+	else if (S_ISCHR(st.st_mode))
+		snprintf(path, sizeof(path), "/sys/dev/char/%u:%u",
+			 major(st.st_rdev), minor(st.st_rdev));
+	else
+		return -ENOTTY;
+	if (!realpath(path, key))
+		return -errno;
+	return 0;
+}
+
+/*
+ * Return the cache entry of the controller behind @fd with its lock
+ * held and the identify data valid. Returns NULL if the controller can
+ * not be cached (*err == 0) or identify failed (*err != 0).
+ */
+static struct id_ctrl_cache_entry *id_ctrl_cache_get(int fd, int *err)
+{
+	struct id_ctrl_cache_entry *e;
+	struct nvme_id_ctrl ctrl;
+	struct timespec now;
+	char key[PATH_MAX];
+
+	*err = 0;
+	if (nvme_ctrl_key(fd, key))
+		return NULL;
+
+	pthread_mutex_lock(&id_ctrl_cache_lock);
+	for (e = id_ctrl_cache; e; e = e->next)
+		if (!strcmp(e->key, key))
+			break;
+	if (!e) {
+		e = calloc(1, sizeof(*e));
+		if (!e) {
+			pthread_mutex_unlock(&id_ctrl_cache_lock);
+			return NULL;
+		}
+		strcpy(e->key, key);
+		pthread_mutex_init(&e->lock, NULL);
+		e->next = id_ctrl_cache;
+		id_ctrl_cache = e;
+	}
+	pthread_mutex_unlock(&id_ctrl_cache_lock);
+
+	/* concurrent lookups of one controller wait for the first one */
+	pthread_mutex_lock(&e->lock);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!e->valid || now.tv_sec - e->stamp.tv_sec >= ID_CTRL_CACHE_TTL) {
+		*err = nvme_identify_ctrl(fd, &ctrl);
+		if (*err) {
+			e->valid = false;
+			pthread_mutex_unlock(&e->lock);
+			return NULL;
+		}
+		/* new firmware may take a different transfer size */
+		if (!e->valid || ctrl.mdts != e->ctrl.mdts)
+			e->max_xfer = 0;
+		e->ctrl = ctrl;
+		e->stamp = now;
+		e->valid = true;
+	}
+	return e;
+}
+
+int nvme_identify_ctrl_cached(int fd, void *data)
+{
+	struct id_ctrl_cache_entry *e;
+	int err;
+
+	e = id_ctrl_cache_get(fd, &err);
+	if (!e)
+		return err ? err : nvme_identify_ctrl(fd, data);
+	memcpy(data, &e->ctrl, sizeof(e->ctrl));
+	pthread_mutex_unlock(&e->lock);
+	return 0;
+}
+
+void nvme_identify_ctrl_cache_flush(void)
+{
+	struct id_ctrl_cache_entry *e;
+
+	pthread_mutex_lock(&id_ctrl_cache_lock);
+	while ((e = id_ctrl_cache)) {
+		id_ctrl_cache = e->next;
+		pthread_mutex_destroy(&e->lock);
+		free(e);
+	}
+	pthread_mutex_unlock(&id_ctrl_cache_lock);
+}
+
 int nvme_identify_ns(int fd, __u32 nsid, bool present, void *data)
 {
 	int cns = present ? NVME_ID_CNS_NS_PRESENT : NVME_ID_CNS_NS;
@@ -438,25 +600,92 @@ int nvme_get_log14(int fd, __u32 nsid, __u8 log_id, __u8 lsp, __u64 lpo,
 
 }
 
-int nvme_get_log(int fd, __u32 nsid, __u8 log_id, bool rae,
-		 __u32 data_len, void *data)
+/*
+ * MDTS is in units of the minimum memory page size, which would need a
+ * register read to find out. Assume 4k, the smallest it can be, and
+ * don't go past what the kernel accepts for a passthrough command by
+ * default even if the controller has no limit.
+ */
+#define NVME_XFER_MAX	(1024 * 1024)
+
+__u32 nvme_get_max_xfer(int fd)
+{
+	struct id_ctrl_cache_entry *e;
+	__u32 xfer;
+	int err;
+
+	e = id_ctrl_cache_get(fd, &err);
+	if (!e)
+		return NVME_XFER_MIN;
+	if (!e->max_xfer) {
+		if (e->ctrl.mdts && e->ctrl.mdts < 9)
+			e->max_xfer = NVME_XFER_MIN << e->ctrl.mdts;
+		else
+			e->max_xfer = NVME_XFER_MAX;
+	}
+	xfer = e->max_xfer;
+	pthread_mutex_unlock(&e->lock);
+	return xfer;
+}
+
+void nvme_limit_max_xfer(int fd, __u32 xfer)
+{
+	struct id_ctrl_cache_entry *e;
+	int err;
+
+	e = id_ctrl_cache_get(fd, &err);
+	if (!e)
+		return;
+	if (!e->max_xfer || xfer < e->max_xfer)
+		e->max_xfer = xfer;
+	pthread_mutex_unlock(&e->lock);
+}
+
+/*
+ * Whether a failed command was turned down by the kernel for its
+ * transfer size. @err is what a passthrough call returned: -1 with
+ * errno set, or a negative errno. Positive NVMe status values are the
+ * controller's answer to the command itself and never count.
+ */
+bool nvme_xfer_rejected(int err)
+{
+	if (err == -1)
+		err = -errno;
+	return err == -EINVAL || err == -ENOMEM;
+}
+
+int nvme_get_log_split(int fd, __u32 nsid, __u8 log_id, __u8 lsp, __u64 lpo,
+		       __u16 lsi, bool rae, __u8 uuid_ix, __u32 data_len,
+		       void *data)
 {
 	void *ptr = data;
-	__u32 offset = 0, xfer_len = data_len;
+	__u32 offset = 0, xfer_len = data_len, max_xfer = NVME_XFER_MIN;
 	int ret;
 
 	/*
-	 * 4k is the smallest possible transfer unit, so by
-	 * restricting ourselves for 4k transfers we avoid having
-	 * to check the MDTS value of the controller.
+	 * Logs that fit into the smallest possible transfer unit don't
+	 * need to know the MDTS value of the controller.
 	 */
+	if (data_len > NVME_XFER_MIN)
+		max_xfer = nvme_get_max_xfer(fd);
+
 	do {
 		xfer_len = data_len - offset;
-		if (xfer_len > 4096)
-			xfer_len = 4096;
-
-		ret = nvme_get_log13(fd, nsid, log_id, NVME_NO_LOG_LSP,
-				     offset, 0, rae, xfer_len, ptr);
+		if (xfer_len > max_xfer)
+			xfer_len = max_xfer;
+
+		ret = nvme_get_log14(fd, nsid, log_id, lsp, lpo + offset,
+				     lsi, rae, uuid_ix, xfer_len, ptr);
+		if (nvme_xfer_rejected(ret) && max_xfer > NVME_XFER_MIN) {
+			/*
+			 * The kernel or the controller may not take as much
+			 * as MDTS suggests; retry the same offset with smaller
+			 * transfers and remember the limit for next time.
+			 */
+			max_xfer >>= 1;
+			nvme_limit_max_xfer(fd, max_xfer);
+			continue;
+		}
 		if (ret)
 			return ret;
 
@@ -467,6 +696,13 @@ int nvme_get_log(int fd, __u32 nsid, __u8 log_id, bool rae,
 	return 0;
 }
 
+int nvme_get_log(int fd, __u32 nsid, __u8 log_id, bool rae,
+		 __u32 data_len, void *data)
+{
+	return nvme_get_log_split(fd, nsid, log_id, NVME_NO_LOG_LSP, 0, 0,
+				  rae, 0, data_len, data);
+}
+
 int nvme_get_telemetry_log(int fd, void *lp, int generate_report,
 			   int ctrl_init, size_t log_page_size, __u64 offset)
 {
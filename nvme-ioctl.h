@@ -7,6 +7,7 @@
 #include "nvme.h"
 
 #define NVME_IOCTL_TIMEOUT 120000 /* in milliseconds */
+#define NVME_XFER_MIN 4096 /* smallest possible MDTS, in bytes */
 
 int nvme_get_nsid(int fd);
 
@@ -73,6 +74,8 @@ int nvme_resv_report(int fd, __u32 nsid, __u32 numd, __u32 cdw11, void *data);
 int nvme_identify13(int fd, __u32 nsid, __u32 cdw10, __u32 cdw11, void *data);
 int nvme_identify(int fd, __u32 nsid, __u32 cdw10, void *data);
 int nvme_identify_ctrl(int fd, void *data);
+int nvme_identify_ctrl_cached(int fd, void *data);
+void nvme_identify_ctrl_cache_flush(void);
 int nvme_identify_ns(int fd, __u32 nsid, bool present, void *data);
 int nvme_identify_ns_list(int fd, __u32 nsid, bool all, void *data);
 int nvme_identify_ctrl_list(int fd, __u32 nsid, __u16 cntid, void *data);
@@ -83,6 +86,12 @@ int nvme_identify_secondary_ctrl_list(int fd, __u32 nsid, __u16 cntid, void *dat
 int nvme_identify_ns_granularity(int fd, void *data);
 int nvme_get_log(int fd, __u32 nsid, __u8 log_id, bool rae,
 		 __u32 data_len, void *data);
+__u32 nvme_get_max_xfer(int fd);
+void nvme_limit_max_xfer(int fd, __u32 xfer);
+bool nvme_xfer_rejected(int err);
+int nvme_get_log_split(int fd, __u32 nsid, __u8 log_id, __u8 lsp, __u64 lpo,
+		       __u16 lsi, bool rae, __u8 uuid_ix, __u32 data_len,
+		       void *data);
 int nvme_get_log14(int fd, __u32 nsid, __u8 log_id, __u8 lsp, __u64 lpo,
 		   __u16 group_id, bool rae, __u8 uuid_ix,
 		   __u32 data_len, void *data);
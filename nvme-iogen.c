@@ -0,0 +1,419 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nvme-ioctl.h"
+#include "nvme-iogen.h"
+#include "nvme-uring.h"
+#include "common.h"
+
+void nvme_hist_init(struct nvme_hist *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = ~0ULL;
+}
+
+static unsigned int nvme_hist_index(__u64 val)
+{
+	unsigned int msb, shift;
+
+	if (val < NVME_HIST_SUB)
+		return val;
+
+	msb = 63 - __builtin_clzll(val);
+	shift = msb - NVME_HIST_SUB_BITS;
+	return ((shift + 1) << NVME_HIST_SUB_BITS) +
+		((val >> shift) - NVME_HIST_SUB);
+}
+
+void nvme_hist_bucket_range(unsigned int idx, __u64 *low, __u64 *high)
+{
+	unsigned int shift;
+
+	if (idx < NVME_HIST_SUB) {
+		*low = *high = idx;
+		return;
+	}
+
+	shift = (idx >> NVME_HIST_SUB_BITS) - 1;
+	*low = ((__u64)(idx & (NVME_HIST_SUB - 1)) + NVME_HIST_SUB) << shift;
+	*high = *low + (1ULL << shift) - 1;
+}
+
+/* Midpoint of the value range covered by bucket @idx */
+static __u64 nvme_hist_value(unsigned int idx)
+{
+	__u64 low, high;
+
+	nvme_hist_bucket_range(idx, &low, &high);
+	return low + (high - low + 1) / 2;
+}
+
+void nvme_hist_add(struct nvme_hist *h, __u64 val)
+{
+	h->buckets[nvme_hist_index(val)]++;
+	h->count++;
+	h->sum += val;
+	if (val < h->min)
+		h->min = val;
+	if (val > h->max)
+		h->max = val;
+}
+
+void nvme_hist_merge(struct nvme_hist *dst, const struct nvme_hist *src)
+{
+	int i;
+
+	if (!src->count)
+		return;
+	for (i = 0; i < NVME_HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	dst->sum += src->sum;
+	dst->min = min(dst->min, src->min);
+	dst->max = max(dst->max, src->max);
+}
+
+__u64 nvme_hist_percentile(const struct nvme_hist *h, double pct)
+{
+	__u64 target, seen = 0;
+	int i;
+
+	if (!h->count)
+		return 0;
+
+	target = (__u64)(h->count * pct / 100.0 + 0.5);
+	if (!target)
+		target = 1;
+	for (i = 0; i < NVME_HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= target)
+			return min(max(nvme_hist_value(i), h->min), h->max);
+	}
+	return h->max;
+}
+
+int nvme_iogen_parse_pattern(const char *str)
+{
+	if (!strcmp(str, "fixed"))
+		return NVME_IOGEN_FIXED;
+	if (!strcmp(str, "seq"))
+		return NVME_IOGEN_SEQ;
+	if (!strcmp(str, "rand"))
+		return NVME_IOGEN_RAND;
+	return -EINVAL;
+}
+
+struct iogen_ctx {
+	struct nvme_iogen_job *job;
+	__u64 slots;
+	__u64 next;
+	int stop;
+	int err;
+};
+
+struct iogen_worker {
+	struct iogen_ctx *ctx;
+	pthread_t thread;
+	void *buf;
+	void *mbuf;
+	__u64 seed;
+	__u64 ios;
+	__u64 start;
+	struct nvme_passthru_cmd cmd;
+	struct nvme_hist lat;
+};
+
+static inline __u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline __u64 xorshift64(__u64 *state)
+{
+	__u64 x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *state = x;
+}
+
+static void iogen_set_err(struct iogen_ctx *ctx, int err)
+{
+	__atomic_compare_exchange_n(&ctx->err, &(int){0}, err, false,
+				    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	__atomic_store_n(&ctx->stop, 1, __ATOMIC_RELAXED);
+}
+
+/* Claims the next command of the job, returns false once all are issued */
+static bool iogen_next_lba(struct iogen_worker *w, __u64 *lba)
+{
+	struct iogen_ctx *ctx = w->ctx;
+	struct nvme_iogen_job *job = ctx->job;
+	__u64 n, slot;
+
+	if (__atomic_load_n(&ctx->stop, __ATOMIC_RELAXED))
+		return false;
+	n = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED);
+	if (n >= job->iterations)
+		return false;
+
+	if (job->pattern == NVME_IOGEN_RAND)
+		slot = xorshift64(&w->seed) % ctx->slots;
+	else if (job->pattern == NVME_IOGEN_SEQ)
+		slot = n % ctx->slots;
+	else
+		slot = 0;
+	*lba = job->slba + slot * (job->nblocks + 1);
+	return true;
+}
+
+static void *iogen_worker_fn(void *arg)
+{
+	struct iogen_worker *w = arg;
+	struct iogen_ctx *ctx = w->ctx;
+	struct nvme_iogen_job *job = ctx->job;
+	__u64 lba, start;
+	int err;
+
+	while (iogen_next_lba(w, &lba)) {
+		start = now_ns();
+		if (job->opcode == nvme_cmd_verify)
+			err = nvme_verify(job->fd, job->nsid, lba, job->nblocks,
+					  job->control, job->reftag,
+					  job->apptag, job->appmask);
+		else
+			err = nvme_io(job->fd, job->opcode, lba, job->nblocks,
+				      job->control, job->dsmgmt, job->reftag,
+				      job->apptag, job->appmask, w->buf, w->mbuf);
+		if (err) {
+			iogen_set_err(ctx, err < 0 ? -errno : err);
+			break;
+		}
+		nvme_hist_add(&w->lat, now_ns() - start);
+		w->ios++;
+	}
+	return NULL;
+}
+
+static int iogen_uring_issue(struct nvme_uring *ring, struct iogen_worker *w,
+			     struct nvme_uring_target *t)
+{
+	struct nvme_iogen_job *job = w->ctx->job;
+	struct nvme_passthru_cmd *cmd = &w->cmd;
+	__u64 lba;
+	int err;
+
+	if (!iogen_next_lba(w, &lba))
+		return 0;
+
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->opcode = job->opcode;
+	cmd->nsid = job->nsid ? job->nsid : t->nsid;
+	cmd->cdw10 = lba & 0xffffffff;
+	cmd->cdw11 = lba >> 32;
+	cmd->cdw12 = job->nblocks | (job->control << 16);
+	cmd->cdw14 = job->reftag;
+	cmd->cdw15 = job->apptag | (job->appmask << 16);
+	if (job->opcode != nvme_cmd_verify) {
+		cmd->cdw13 = job->dsmgmt;
+		cmd->addr = (__u64)(uintptr_t)w->buf;
+		cmd->data_len = job->data_size;
+		if (t->lba_size)
+			cmd->data_len = min(cmd->data_len,
+				(__u32)(job->nblocks + 1) * t->lba_size);
+		cmd->metadata = (__u64)(uintptr_t)w->mbuf;
+		cmd->metadata_len = w->mbuf ? job->metadata_size : 0;
+	}
+
+	w->start = now_ns();
+	err = nvme_uring_queue(ring, t->fd, false, cmd, w);
+	return err ? err : 1;
+}
+
+/*
+ * With the io_uring backend all queue slots are kept in flight from the
+ * calling thread. Returns -ENOTSUP if no ring could be set up.
+ */
+static int iogen_run_uring(struct iogen_ctx *ctx, struct iogen_worker *workers,
+			   struct nvme_uring_target *t)
+{
+	struct nvme_iogen_job *job = ctx->job;
+	struct nvme_uring_cqe *cqes;
+	struct nvme_uring *ring;
+	unsigned int i, inflight = 0;
+	int n, nr, err = 0;
+
+	ring = nvme_uring_create(job->qd);
+	if (!ring)
+		return -ENOTSUP;
+	cqes = calloc(job->qd, sizeof(*cqes));
+	if (!cqes) {
+		nvme_uring_destroy(ring);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < job->qd; i++) {
+		n = iogen_uring_issue(ring, &workers[i], t);
+		if (n < 0)
+			err = n;
+		if (n <= 0)
+			break;
+		inflight++;
+	}
+
+	while (inflight) {
+		n = nvme_uring_submit(ring, 1);
+		if (n < 0) {
+			/* nvme_uring_destroy() waits for the submitted ones */
+			err = n;
+			break;
+		}
+		/* several completions may be reaped at once */
+		nr = nvme_uring_reap(ring, cqes, job->qd);
+		for (i = 0; i < nr; i++) {
+			struct iogen_worker *w = cqes[i].priv;
+
+			inflight--;
+			if (cqes[i].status) {
+				iogen_set_err(ctx, cqes[i].status);
+				continue;
+			}
+			nvme_hist_add(&w->lat, now_ns() - w->start);
+			w->ios++;
+			if (err)
+				continue;
+			n = iogen_uring_issue(ring, w, t);
+			if (n < 0)
+				err = n;
+			else if (n > 0)
+				inflight++;
+		}
+	}
+
+	free(cqes);
+	nvme_uring_destroy(ring);
+	return err;
+}
+
+/*
+ * The NVMe passthrough ioctls are synchronous, so unless the io_uring
+ * backend is in use each queue slot is served by its own thread; slot 0
+ * runs on the calling thread.
+ */
+int nvme_iogen_run(struct nvme_iogen_job *job, struct nvme_iogen_result *res)
+{
+	struct iogen_ctx ctx = { .job = job };
+	struct nvme_uring_target t;
+	struct iogen_worker *workers;
+	size_t slot_size = 0;
+	void *pool = NULL, *mpool = NULL;
+	__u64 start;
+	unsigned int i, started = 1;
+	int err = 0;
+
+	memset(res, 0, sizeof(*res));
+	nvme_hist_init(&res->lat);
+
+	if (!job->qd || !job->iterations)
+		return -EINVAL;
+	ctx.slots = job->nr_lbas / (job->nblocks + 1);
+	if (!ctx.slots) {
+		fprintf(stderr, "I/O region is smaller than one command\n");
+		return -EINVAL;
+	}
+
+	workers = calloc(job->qd, sizeof(*workers));
+	if (!workers)
+		return -ENOMEM;
+
+	if (job->data_size && job->opcode != nvme_cmd_verify) {
+		slot_size = round_up(job->data_size, (size_t)getpagesize());
+		if (posix_memalign(&pool, getpagesize(), slot_size * job->qd)) {
+			err = -ENOMEM;
+			goto free_workers;
+		}
+	}
+	if (job->metadata_size && job->opcode != nvme_cmd_verify) {
+		mpool = calloc(job->qd, job->metadata_size);
+		if (!mpool) {
+			err = -ENOMEM;
+			goto free_pool;
+		}
+	}
+
+	for (i = 0; i < job->qd; i++) {
+		struct iogen_worker *w = &workers[i];
+
+		w->ctx = &ctx;
+		w->seed = (now_ns() ^ ((__u64)getpid() << 32)) + i * 0x9e3779b97f4a7c15ULL;
+		if (!w->seed)
+			w->seed = 1;
+		nvme_hist_init(&w->lat);
+		if (pool) {
+			w->buf = pool + i * slot_size;
+			if (job->data)
+				memcpy(w->buf, job->data, job->data_size);
+			else
+				memset(w->buf, 0, job->data_size);
+		}
+		if (mpool) {
+			w->mbuf = mpool + i * job->metadata_size;
+			if (job->metadata)
+				memcpy(w->mbuf, job->metadata, job->metadata_size);
+		}
+	}
+
+	start = now_ns();
+	if (nvme_get_backend() == NVME_BACKEND_IO_URING &&
+	    !nvme_uring_get_target(job->fd, false, &t)) {
+		err = iogen_run_uring(&ctx, workers, &t);
+		nvme_uring_put_target(&t);
+		if (err != -ENOTSUP) {
+			started = job->qd;
+			goto done;
+		}
+		err = 0;
+	}
+
+	for (; started < job->qd; started++) {
+		err = pthread_create(&workers[started].thread, NULL,
+				     iogen_worker_fn, &workers[started]);
+		if (err) {
+			fprintf(stderr, "failed to start I/O thread: %s\n",
+				strerror(err));
+			__atomic_store_n(&ctx.stop, 1, __ATOMIC_RELAXED);
+			err = -err;
+			break;
+		}
+	}
+	iogen_worker_fn(&workers[0]);
+	for (i = 1; i < started; i++)
+		pthread_join(workers[i].thread, NULL);
+done:
+	res->elapsed_ns = now_ns() - start;
+
+	for (i = 0; i < started; i++) {
+		res->ios += workers[i].ios;
+		nvme_hist_merge(&res->lat, &workers[i].lat);
+	}
+	res->bytes = res->ios * job->data_size;
+	res->err = ctx.err;
+	if (!err)
+		err = ctx.err;
+
+	free(mpool);
+free_pool:
+	free(pool);
+free_workers:
+	free(workers);
+	return err;
+}
@@ -0,0 +1,77 @@
+#ifndef _NVME_IOGEN_H
+#define _NVME_IOGEN_H
+
+#include <linux/types.h>
+#include <stddef.h>
+
+/*
+ * Log-linear latency histogram: values below 2^NVME_HIST_SUB_BITS get
+ * their own bucket, every following power of two is split into
+ * 2^NVME_HIST_SUB_BITS linear sub-buckets (~3% relative error).
+ */
+#define NVME_HIST_SUB_BITS	5
+#define NVME_HIST_SUB		(1 << NVME_HIST_SUB_BITS)
+#define NVME_HIST_BUCKETS	((64 - NVME_HIST_SUB_BITS + 1) * NVME_HIST_SUB)
+
+struct nvme_hist {
+	__u64 count;
+	__u64 sum;
+	__u64 min;
+	__u64 max;
+	__u64 buckets[NVME_HIST_BUCKETS];
+};
+
+void nvme_hist_init(struct nvme_hist *h);
+void nvme_hist_add(struct nvme_hist *h, __u64 val);
+void nvme_hist_merge(struct nvme_hist *dst, const struct nvme_hist *src);
+__u64 nvme_hist_percentile(const struct nvme_hist *h, double pct);
+void nvme_hist_bucket_range(unsigned int idx, __u64 *low, __u64 *high);
+
+enum nvme_iogen_pattern {
+	NVME_IOGEN_FIXED,
+	NVME_IOGEN_SEQ,
+	NVME_IOGEN_RAND,
+};
+
+int nvme_iogen_parse_pattern(const char *str);
+
+/*
+ * nvme_iogen_job - describes a repeated I/O workload
+ * @slba/@nr_lbas: LBA region the workload is confined to
+ * @nblocks: zeroes based block count of every command
+ * @data/@metadata: payload template copied into every queue slot
+ * @qd: number of commands kept in flight
+ * @iterations: total number of commands to issue
+ */
+struct nvme_iogen_job {
+	int fd;
+	__u8 opcode;
+	__u32 nsid;
+	__u64 slba;
+	__u64 nr_lbas;
+	__u16 nblocks;
+	__u16 control;
+	__u32 dsmgmt;
+	__u32 reftag;
+	__u16 apptag;
+	__u16 appmask;
+	void *data;
+	size_t data_size;
+	void *metadata;
+	size_t metadata_size;
+	unsigned int qd;
+	__u64 iterations;
+	enum nvme_iogen_pattern pattern;
+};
+
+struct nvme_iogen_result {
+	__u64 ios;
+	__u64 bytes;
+	__u64 elapsed_ns;
+	int err;
+	struct nvme_hist lat;
+};
+
+int nvme_iogen_run(struct nvme_iogen_job *job, struct nvme_iogen_result *res);
+
+#endif /* _NVME_IOGEN_H */
@@ -277,6 +277,46 @@ static FILE *open_pci_ids(void)
 	return NULL;
 }
 
+/*
+ * Looking a device up means reading all of pci.ids. Names are kept per
+ * PCI ID for the life of the process, so a list of many namespaces or
+ * a long running daemon reads the file once per kind of device.
+ */
+struct product_cache {
+	struct product_cache *next;
+	char key[4 * 7 + 13];
+	char *name;
+};
+
+static struct product_cache *product_cache;
+
+static struct product_cache *product_cache_find(const char *key)
+{
+	struct product_cache *p;
+
+	for (p = product_cache; p; p = p->next)
+		if (!strcmp(p->key, key))
+			return p;
+	return NULL;
+}
+
+static void product_cache_add(const char *key, const char *name)
+{
+	struct product_cache *p;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return;
+	p->name = strdup(name);
+	if (!p->name) {
+		free(p);
+		return;
+	}
+	strcpy(p->key, key);
+	p->next = product_cache;
+	product_cache = p;
+}
+
 char *nvme_product_name(int id)
 {
 	char *line = NULL;
@@ -286,12 +326,11 @@ char *nvme_product_name(int id)
 	char sub_device[7] = { 0 };
 	char sub_vendor[7] = { 0 };
 	char class[13] = { 0 };
+	char key[sizeof(product_cache->key)];
+	struct product_cache *cached;
 	size_t size = 1024;
 	char ret;
-	FILE *file = open_pci_ids();
-
-	if (!file)
-		goto error1;
+	FILE *file;
 
 	snprintf(fmt1, 78, _fmt1, id);
 	snprintf(fmt2, 78, _fmt2, id);
@@ -305,7 +344,17 @@ char *nvme_product_name(int id)
 	ret |= read_sys_node(fmt4, device, 7);
 	ret |= read_sys_node(fmt5, class, 13);
 	if (ret)
-		goto error0;
+		goto error1;
+
+	snprintf(key, sizeof(key), "%s%s%s%s%s", vendor, device, sub_vendor,
+		 sub_device, class);
+	cached = product_cache_find(key);
+	if (cached)
+		return strdup(cached->name);
+
+	file = open_pci_ids();
+	if (!file)
+		goto error1;
 
 	line = malloc(1024);
 	if (!line) {
@@ -330,6 +379,7 @@ char *nvme_product_name(int id)
 	fclose(file);
 	format_all(line, vendor, device);
 	free_all();
+	product_cache_add(key, line);
 	return line;
 error0:
 	fclose(file);
@@ -0,0 +1,127 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "nvme-output.h"
+#include "json.h"
+
+/* Large enough that a typical command is written out in one go */
+#define NVME_SINK_BUF	(64 * 1024)
+
+static FILE *nvme_out_fp;
+
+FILE *nvme_out(void)
+{
+	return nvme_out_fp ? nvme_out_fp : stdout;
+}
+
+int nvme_sink_file(struct nvme_sink *sink, FILE *fp)
+{
+	memset(sink, 0, sizeof(*sink));
+	sink->type = NVME_SINK_FILE;
+	sink->fp = fp;
+	return 0;
+}
+
+int nvme_sink_memory(struct nvme_sink *sink)
+{
+	memset(sink, 0, sizeof(*sink));
+	sink->type = NVME_SINK_MEMORY;
+	sink->fp = open_memstream(&sink->buf, &sink->len);
+	if (!sink->fp)
+		return -errno;
+	sink->owned = true;
+	return 0;
+}
+
+int nvme_sink_socket(struct nvme_sink *sink, int fd)
+{
+	int dfd;
+
+	memset(sink, 0, sizeof(*sink));
+	sink->type = NVME_SINK_SOCKET;
+	dfd = dup(fd);
+	if (dfd < 0)
+		return -errno;
+	sink->fp = fdopen(dfd, "w");
+	if (!sink->fp) {
+		close(dfd);
+		return -errno;
+	}
+	setvbuf(sink->fp, NULL, _IOFBF, NVME_SINK_BUF);
+	sink->owned = true;
+	return 0;
+}
+
+void nvme_sink_push(struct nvme_sink *sink)
+{
+	sink->prev = nvme_out_fp;
+	nvme_out_fp = sink->fp;
+	json_set_output(sink->fp);
+}
+
+int nvme_sink_pop(struct nvme_sink *sink)
+{
+	int err = fflush(sink->fp) ? -errno : 0;
+
+	nvme_out_fp = sink->prev;
+	json_set_output(sink->prev);
+	return err;
+}
+
+int nvme_sink_close(struct nvme_sink *sink)
+{
+	int err = 0;
+
+	if (sink->owned && fclose(sink->fp))
+		err = -errno;
+	else if (!sink->owned && fflush(sink->fp))
+		err = -errno;
+	sink->fp = NULL;
+	return err;
+}
+
+int nvme_socket_connect(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		int err = -errno;
+
+		close(fd);
+		return err;
+	}
+	return fd;
+}
+
+int nvme_output_redirect(const char *path)
+{
+	struct stat st;
+	int fd, err = 0;
+
+	if (!stat(path, &st) && S_ISSOCK(st.st_mode))
+		fd = nvme_socket_connect(path);
+	else if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+		fd = -errno;
+	if (fd < 0)
+		return fd;
+
+	if (dup2(fd, STDOUT_FILENO) < 0)
+		err = -errno;
+	close(fd);
+	if (!err)
+		setvbuf(stdout, NULL, _IOFBF, NVME_SINK_BUF);
+	return err;
+}
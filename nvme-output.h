@@ -0,0 +1,58 @@
+#ifndef _NVME_OUTPUT_H
+#define _NVME_OUTPUT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Output sinks. The printers in nvme-print.c, the JSON printer and the
+ * builtin commands write to nvme_out(), which is stdout unless a sink
+ * has been pushed. This lets a caller collect a command's output in a
+ * memory buffer or send it down a socket it keeps open, without going
+ * through a pipe and a process exit.
+ */
+enum nvme_sink_type {
+	NVME_SINK_FILE,
+	NVME_SINK_MEMORY,
+	NVME_SINK_SOCKET,
+};
+
+/*
+ * @fp: stream the output is written to
+ * @buf/@len: output of a memory sink, valid after nvme_sink_close() and
+ *	      owned by the caller from then on
+ * @prev: stream that was active before nvme_sink_push()
+ */
+struct nvme_sink {
+	enum nvme_sink_type type;
+	FILE *fp;
+	char *buf;
+	size_t len;
+	FILE *prev;
+	bool owned;
+};
+
+FILE *nvme_out(void);
+
+/* Writes to an already open stream, which is not closed with the sink */
+int nvme_sink_file(struct nvme_sink *sink, FILE *fp);
+/* Collects the output in a growing memory buffer */
+int nvme_sink_memory(struct nvme_sink *sink);
+/* Writes to a connected stream socket, @fd stays open after the sink */
+int nvme_sink_socket(struct nvme_sink *sink, int fd);
+
+void nvme_sink_push(struct nvme_sink *sink);
+int nvme_sink_pop(struct nvme_sink *sink);
+int nvme_sink_close(struct nvme_sink *sink);
+
+int nvme_socket_connect(const char *path);
+
+/*
+ * Sends the whole process' standard output to @path, connecting to it
+ * if it is a Unix socket. Unlike a pushed sink this also covers the
+ * plugins and anything else printing to stdout directly. Must be
+ * called before anything has been printed.
+ */
+int nvme_output_redirect(const char *path);
+
+#endif /* _NVME_OUTPUT_H */
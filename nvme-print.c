@@ -1,10 +1,12 @@
 #include <assert.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 
 #include "nvme-print.h"
+#include "nvme-iogen.h"
 #include "json.h"
 #include "nvme-models.h"
 #include "suffix.h"
@@ -35,39 +37,27 @@ static const char *nvme_ana_state_to_string(enum nvme_ana_state state)
 	return "invalid state";
 }
 
-static long double int128_to_double(__u8 *data)
-{
-	int i;
-	long double result = 0;
-
-	for (i = 0; i < 16; i++) {
-		result *= 256;
-		result += data[15 - i];
-	}
-	return result;
-}
-
 void d(unsigned char *buf, int len, int width, int group)
 {
 	int i, offset = 0, line_done = 0;
 	char ascii[32 + 1];
 
 	assert(width < sizeof(ascii));
-	printf("     ");
+	fprintf(nvme_out(), "     ");
 	for (i = 0; i <= 15; i++)
-		printf("%3x", i);
+		fprintf(nvme_out(), "%3x", i);
 	for (i = 0; i < len; i++) {
 		line_done = 0;
 		if (i % width == 0)
-			printf( "\n%04x:", offset);
+			fprintf(nvme_out(), "\n%04x:", offset);
 		if (i % group == 0)
-			printf( " %02x", buf[i]);
+			fprintf(nvme_out(), " %02x", buf[i]);
 		else
-			printf( "%02x", buf[i]);
+			fprintf(nvme_out(), "%02x", buf[i]);
 		ascii[i % width] = (buf[i] >= '!' && buf[i] <= '~') ? buf[i] : '.';
 		if (((i + 1) % width) == 0) {
 			ascii[i % width + 1] = '\0';
-			printf( " \"%.*s\"", width, ascii);
+			fprintf(nvme_out(), " \"%.*s\"", width, ascii);
 			offset += width;
 			line_done = 1;
 		}
@@ -75,18 +65,16 @@ void d(unsigned char *buf, int len, int width, int group)
 	if (!line_done) {
 		unsigned b = width - (i % width);
 		ascii[i % width + 1] = '\0';
-		printf( " %*s \"%.*s\"",
+		fprintf(nvme_out(), " %*s \"%.*s\"",
 				2 * b + b / group + (b % group ? 1 : 0), "",
 				width, ascii);
 	}
-	printf( "\n");
+	fprintf(nvme_out(), "\n");
 }
 
 void d_raw(unsigned char *buf, unsigned len)
 {
-	unsigned i;
-	for (i = 0; i < len; i++)
-		putchar(*(buf+i));
+	fwrite(buf, 1, len, nvme_out());
 }
 
 void show_nvme_status(__u16 status)
@@ -131,7 +119,7 @@ static const char *nvme_uuid_to_string(uuid_t uuid)
 	return uuid_str;
 }
 
-static void show_nvme_id_ctrl_cmic(__u8 cmic)
+static void show_nvme_id_ctrl_cmic(__u32 cmic)
 {
 	__u8 rsvd = (cmic & 0xF0) >> 4;
 	__u8 ana = (cmic & 0x8) >> 3;
@@ -139,18 +127,17 @@ static void show_nvme_id_ctrl_cmic(__u8 cmic)
 	__u8 mctl = (cmic & 0x2) >> 1;
 	__u8 mp = cmic & 0x1;
 	if (rsvd)
-		printf("  [7:4] : %#x\tReserved\n", rsvd);
-	printf("  [3:3] : %#x\tANA %ssupported\n", ana, ana ? "" : "not ");
-	printf("  [2:2] : %#x\t%s\n", sriov, sriov ? "SR-IOV" : "PCI");
-	printf("  [1:1] : %#x\t%s Controller\n",
+		fprintf(nvme_out(), "  [7:4] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [3:3] : %#x\tANA %ssupported\n", ana, ana ? "" : "not ");
+	fprintf(nvme_out(), "  [2:2] : %#x\t%s\n", sriov, sriov ? "SR-IOV" : "PCI");
+	fprintf(nvme_out(), "  [1:1] : %#x\t%s Controller\n",
 		mctl, mctl ? "Multi" : "Single");
-	printf("  [0:0] : %#x\t%s Port\n", mp, mp ? "Multi" : "Single");
-	printf("\n");
+	fprintf(nvme_out(), "  [0:0] : %#x\t%s Port\n", mp, mp ? "Multi" : "Single");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_oaes(__le32 ctrl_oaes)
+static void show_nvme_id_ctrl_oaes(__u32 oaes)
 {
-	__u32 oaes = le32_to_cpu(ctrl_oaes);
 	__u32 rsvd0 = (oaes & 0xFFFF8000) >> 15;
 	__u32 nace = (oaes & 0x100) >> 8;
 	__u32 fan = (oaes & 0x200) >> 9;
@@ -161,29 +148,28 @@ static void show_nvme_id_ctrl_oaes(__le32 ctrl_oaes)
 	__u32 rsvd1 = oaes & 0xFF;
 
 	if (rsvd0)
-		printf(" [31:10] : %#x\tReserved\n", rsvd0);
-	printf("[14:14] : %#x\tEndurance Group Event Aggregate Log Page"\
+		fprintf(nvme_out(), " [31:10] : %#x\tReserved\n", rsvd0);
+	fprintf(nvme_out(), "[14:14] : %#x\tEndurance Group Event Aggregate Log Page"\
 			" Change Notice %sSupported\n",
 			egealpcn, egealpcn ? "" : "Not ");
-	printf("[13:13] : %#x\tLBA Status Information Notices %sSupported\n",
+	fprintf(nvme_out(), "[13:13] : %#x\tLBA Status Information Notices %sSupported\n",
 			lbasin, lbasin ? "" : "Not ");
-	printf("[12:12] : %#x\tPredictable Latency Event Aggregate Log Change"\
+	fprintf(nvme_out(), "[12:12] : %#x\tPredictable Latency Event Aggregate Log Change"\
 			" Notices %sSupported\n",
 			plealcn, plealcn ? "" : "Not ");
-	printf("[11:11] : %#x\tAsymmetric Namespace Access Change Notices"\
+	fprintf(nvme_out(), "[11:11] : %#x\tAsymmetric Namespace Access Change Notices"\
 			" %sSupported\n", anacn, anacn ? "" : "Not ");
-	printf("  [9:9] : %#x\tFirmware Activation Notices %sSupported\n",
+	fprintf(nvme_out(), "  [9:9] : %#x\tFirmware Activation Notices %sSupported\n",
 		fan, fan ? "" : "Not ");
-	printf("  [8:8] : %#x\tNamespace Attribute Changed Event %sSupported\n",
+	fprintf(nvme_out(), "  [8:8] : %#x\tNamespace Attribute Changed Event %sSupported\n",
 		nace, nace ? "" : "Not ");
 	if (rsvd1)
-		printf("  [7:0] : %#x\tReserved\n", rsvd1);
-	printf("\n");
+		fprintf(nvme_out(), "  [7:0] : %#x\tReserved\n", rsvd1);
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_ctratt(__le32 ctrl_ctratt)
+static void show_nvme_id_ctrl_ctratt(__u32 ctratt)
 {
-	__u32 ctratt = le32_to_cpu(ctrl_ctratt);
 	__u32 rsvd = ctratt >> 10;
 	__u32 hostid128 = (ctratt & NVME_CTRL_CTRATT_128_ID) >> 0;
 	__u32 psp = (ctratt & NVME_CTRL_CTRATT_NON_OP_PSP) >> 1;
@@ -197,34 +183,33 @@ static void show_nvme_id_ctrl_ctratt(__le32 ctrl_ctratt)
 	__u32 rsvd8 = (ctratt & 0x00000100) >> 8;
 
 	if (rsvd)
-		printf(" [31:10] : %#x\tReserved\n", rsvd);
+		fprintf(nvme_out(), " [31:10] : %#x\tReserved\n", rsvd);
 
-	printf("  [9:9] : %#x\tUUID List %sSupported\n",
+	fprintf(nvme_out(), "  [9:9] : %#x\tUUID List %sSupported\n",
 		uuidlist, uuidlist ? "" : "Not ");
 	if (rsvd8)
-		printf(" [8:8] : %#x\tReserved\n", rsvd8);
-	printf("  [7:7] : %#x\tNamespace Granularity %sSupported\n",
+		fprintf(nvme_out(), " [8:8] : %#x\tReserved\n", rsvd8);
+	fprintf(nvme_out(), "  [7:7] : %#x\tNamespace Granularity %sSupported\n",
 		ng, ng ? "" : "Not ");
 	if (rsvd6)
-		printf(" [6:6] : %#x\tReserved\n", rsvd6);
-	printf("  [5:5] : %#x\tPredictable Latency Mode %sSupported\n",
+		fprintf(nvme_out(), " [6:6] : %#x\tReserved\n", rsvd6);
+	fprintf(nvme_out(), "  [5:5] : %#x\tPredictable Latency Mode %sSupported\n",
 		iod, iod ? "" : "Not ");
-	printf("  [4:4] : %#x\tEndurance Groups %sSupported\n",
+	fprintf(nvme_out(), "  [4:4] : %#x\tEndurance Groups %sSupported\n",
 		eg, eg ? "" : "Not ");
-	printf("  [3:3] : %#x\tRead Recovery Levels %sSupported\n",
+	fprintf(nvme_out(), "  [3:3] : %#x\tRead Recovery Levels %sSupported\n",
 		rrl, rrl ? "" : "Not ");
-	printf("  [2:2] : %#x\tNVM Sets %sSupported\n",
+	fprintf(nvme_out(), "  [2:2] : %#x\tNVM Sets %sSupported\n",
 		sets, sets ? "" : "Not ");
-	printf("  [1:1] : %#x\tNon-Operational Power State Permissive %sSupported\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tNon-Operational Power State Permissive %sSupported\n",
 		psp, psp ? "" : "Not ");
-	printf("  [0:0] : %#x\t128-bit Host Identifier %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\t128-bit Host Identifier %sSupported\n",
 		hostid128, hostid128 ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_oacs(__le16 ctrl_oacs)
+static void show_nvme_id_ctrl_oacs(__u32 oacs)
 {
-	__u16 oacs = le16_to_cpu(ctrl_oacs);
 	__u16 rsvd = (oacs & 0xFC00) >> 10;
 	__u16 glbas = (oacs & 0x200) >> 9;
 	__u16 dbc = (oacs & 0x100) >> 8;
@@ -238,47 +223,47 @@ static void show_nvme_id_ctrl_oacs(__le16 ctrl_oacs)
 	__u16 sec = oacs & 0x1;
 
 	if (rsvd)
-		printf(" [15:9] : %#x\tReserved\n", rsvd);
-	printf("  [9:9] : %#x\tGet LBA Status Capability %sSupported\n",
+		fprintf(nvme_out(), " [15:9] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [9:9] : %#x\tGet LBA Status Capability %sSupported\n",
 		glbas, glbas ? "" : "Not ");
-	printf("  [8:8] : %#x\tDoorbell Buffer Config %sSupported\n",
+	fprintf(nvme_out(), "  [8:8] : %#x\tDoorbell Buffer Config %sSupported\n",
 		dbc, dbc ? "" : "Not ");
-	printf("  [7:7] : %#x\tVirtualization Management %sSupported\n",
+	fprintf(nvme_out(), "  [7:7] : %#x\tVirtualization Management %sSupported\n",
 		vir, vir ? "" : "Not ");
-	printf("  [6:6] : %#x\tNVMe-MI Send and Receive %sSupported\n",
+	fprintf(nvme_out(), "  [6:6] : %#x\tNVMe-MI Send and Receive %sSupported\n",
 		nmi, nmi ? "" : "Not ");
-	printf("  [5:5] : %#x\tDirectives %sSupported\n",
+	fprintf(nvme_out(), "  [5:5] : %#x\tDirectives %sSupported\n",
 		dir, dir ? "" : "Not ");
-	printf("  [4:4] : %#x\tDevice Self-test %sSupported\n",
+	fprintf(nvme_out(), "  [4:4] : %#x\tDevice Self-test %sSupported\n",
 		sft, sft ? "" : "Not ");
-	printf("  [3:3] : %#x\tNS Management and Attachment %sSupported\n",
+	fprintf(nvme_out(), "  [3:3] : %#x\tNS Management and Attachment %sSupported\n",
 		nsm, nsm ? "" : "Not ");
-	printf("  [2:2] : %#x\tFW Commit and Download %sSupported\n",
+	fprintf(nvme_out(), "  [2:2] : %#x\tFW Commit and Download %sSupported\n",
 		fwc, fwc ? "" : "Not ");
-	printf("  [1:1] : %#x\tFormat NVM %sSupported\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tFormat NVM %sSupported\n",
 		fmt, fmt ? "" : "Not ");
-	printf("  [0:0] : %#x\tSecurity Send and Receive %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tSecurity Send and Receive %sSupported\n",
 		sec, sec ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_frmw(__u8 frmw)
+static void show_nvme_id_ctrl_frmw(__u32 frmw)
 {
 	__u8 rsvd = (frmw & 0xE0) >> 5;
 	__u8 fawr = (frmw & 0x10) >> 4;
 	__u8 nfws = (frmw & 0xE) >> 1;
 	__u8 s1ro = frmw & 0x1;
 	if (rsvd)
-		printf("  [7:5] : %#x\tReserved\n", rsvd);
-	printf("  [4:4] : %#x\tFirmware Activate Without Reset %sSupported\n",
+		fprintf(nvme_out(), "  [7:5] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [4:4] : %#x\tFirmware Activate Without Reset %sSupported\n",
 		fawr, fawr ? "" : "Not ");
-	printf("  [3:1] : %#x\tNumber of Firmware Slots\n", nfws);
-	printf("  [0:0] : %#x\tFirmware Slot 1 Read%s\n",
+	fprintf(nvme_out(), "  [3:1] : %#x\tNumber of Firmware Slots\n", nfws);
+	fprintf(nvme_out(), "  [0:0] : %#x\tFirmware Slot 1 Read%s\n",
 		s1ro, s1ro ? "-Only" : "/Write");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_lpa(__u8 lpa)
+static void show_nvme_id_ctrl_lpa(__u32 lpa)
 {
 	__u8 rsvd = (lpa & 0xF0) >> 4;
 	__u8 telem = (lpa & 0x8) >> 3;
@@ -286,74 +271,71 @@ static void show_nvme_id_ctrl_lpa(__u8 lpa)
 	__u8 celp = (lpa & 0x2) >> 1;
 	__u8 smlp = lpa & 0x1;
 	if (rsvd)
-		printf("  [7:4] : %#x\tReserved\n", rsvd);
-	printf("  [3:3] : %#x\tTelemetry host/controller initiated log page %sSupported\n",
+		fprintf(nvme_out(), "  [7:4] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [3:3] : %#x\tTelemetry host/controller initiated log page %sSupported\n",
 	       telem, telem ? "" : "Not ");
-	printf("  [2:2] : %#x\tExtended data for Get Log Page %sSupported\n",
+	fprintf(nvme_out(), "  [2:2] : %#x\tExtended data for Get Log Page %sSupported\n",
 		ed, ed ? "" : "Not ");
-	printf("  [1:1] : %#x\tCommand Effects Log Page %sSupported\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tCommand Effects Log Page %sSupported\n",
 		celp, celp ? "" : "Not ");
-	printf("  [0:0] : %#x\tSMART/Health Log Page per NS %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tSMART/Health Log Page per NS %sSupported\n",
 		smlp, smlp ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_avscc(__u8 avscc)
+static void show_nvme_id_ctrl_avscc(__u32 avscc)
 {
 	__u8 rsvd = (avscc & 0xFE) >> 1;
 	__u8 fmt = avscc & 0x1;
 	if (rsvd)
-		printf("  [7:1] : %#x\tReserved\n", rsvd);
-	printf("  [0:0] : %#x\tAdmin Vendor Specific Commands uses %s Format\n",
+		fprintf(nvme_out(), "  [7:1] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [0:0] : %#x\tAdmin Vendor Specific Commands uses %s Format\n",
 		fmt, fmt ? "NVMe" : "Vendor Specific");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_apsta(__u8 apsta)
+static void show_nvme_id_ctrl_apsta(__u32 apsta)
 {
 	__u8 rsvd = (apsta & 0xFE) >> 1;
 	__u8 apst = apsta & 0x1;
 	if (rsvd)
-		printf("  [7:1] : %#x\tReserved\n", rsvd);
-	printf("  [0:0] : %#x\tAutonomous Power State Transitions %sSupported\n",
+		fprintf(nvme_out(), "  [7:1] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [0:0] : %#x\tAutonomous Power State Transitions %sSupported\n",
 		apst, apst ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_rpmbs(__le32 ctrl_rpmbs)
+static void show_nvme_id_ctrl_rpmbs(__u32 rpmbs)
 {
-	__u32 rpmbs = le32_to_cpu(ctrl_rpmbs);
 	__u32 asz = (rpmbs & 0xFF000000) >> 24;
 	__u32 tsz = (rpmbs & 0xFF0000) >> 16;
 	__u32 rsvd = (rpmbs & 0xFFC0) >> 6;
 	__u32 auth = (rpmbs & 0x38) >> 3;
 	__u32 rpmb = rpmbs & 0x7;
 
-	printf(" [31:24]: %#x\tAccess Size\n", asz);
-	printf(" [23:16]: %#x\tTotal Size\n", tsz);
+	fprintf(nvme_out(), " [31:24]: %#x\tAccess Size\n", asz);
+	fprintf(nvme_out(), " [23:16]: %#x\tTotal Size\n", tsz);
 	if (rsvd)
-		printf(" [15:6] : %#x\tReserved\n", rsvd);
-	printf("  [5:3] : %#x\tAuthentication Method\n", auth);
-	printf("  [2:0] : %#x\tNumber of RPMB Units\n", rpmb);
-	printf("\n");
+		fprintf(nvme_out(), " [15:6] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [5:3] : %#x\tAuthentication Method\n", auth);
+	fprintf(nvme_out(), "  [2:0] : %#x\tNumber of RPMB Units\n", rpmb);
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_hctma(__le16 ctrl_hctma)
+static void show_nvme_id_ctrl_hctma(__u32 hctma)
 {
-	__u16 hctma = le16_to_cpu(ctrl_hctma);
 	__u16 rsvd = (hctma & 0xFFFE) >> 1;
 	__u16 hctm = hctma & 0x1;
 
 	if (rsvd)
-		printf(" [15:1] : %#x\tReserved\n", rsvd);
-	printf("  [0:0] : %#x\tHost Controlled Thermal Management %sSupported\n",
+		fprintf(nvme_out(), " [15:1] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [0:0] : %#x\tHost Controlled Thermal Management %sSupported\n",
 		hctm, hctm ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_sanicap(__le32 ctrl_sanicap)
+static void show_nvme_id_ctrl_sanicap(__u32 sanicap)
 {
-	__u32 sanicap = le32_to_cpu(ctrl_sanicap);
 	__u32 rsvd = (sanicap & 0x1FFFFFF8) >> 3;
 	__u32 owr = (sanicap & 0x4) >> 2;
 	__u32 ber = (sanicap & 0x2) >> 1;
@@ -368,21 +350,21 @@ static void show_nvme_id_ctrl_sanicap(__le32 ctrl_sanicap)
 		"Reserved"
 	};
 
-	printf("  [31:30] : %#x\t%s\n", nodmmas, modifies_media[nodmmas]);
-	printf("  [29:29] : %#x\tNo-Deallocate After Sanitize bit in Sanitize command %sSupported\n",
+	fprintf(nvme_out(), "  [31:30] : %#x\t%s\n", nodmmas, modifies_media[nodmmas]);
+	fprintf(nvme_out(), "  [29:29] : %#x\tNo-Deallocate After Sanitize bit in Sanitize command %sSupported\n",
 		ndi, ndi ? "Not " : "");
 	if (rsvd)
-		printf("  [28:3] : %#x\tReserved\n", rsvd);
-	printf("    [2:2] : %#x\tOverwrite Sanitize Operation %sSupported\n",
+		fprintf(nvme_out(), "  [28:3] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "    [2:2] : %#x\tOverwrite Sanitize Operation %sSupported\n",
 		owr, owr ? "" : "Not ");
-	printf("    [1:1] : %#x\tBlock Erase Sanitize Operation %sSupported\n",
+	fprintf(nvme_out(), "    [1:1] : %#x\tBlock Erase Sanitize Operation %sSupported\n",
 		ber, ber ? "" : "Not ");
-	printf("    [0:0] : %#x\tCrypto Erase Sanitize Operation %sSupported\n",
+	fprintf(nvme_out(), "    [0:0] : %#x\tCrypto Erase Sanitize Operation %sSupported\n",
 		cer, cer ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_anacap(__u8 anacap)
+static void show_nvme_id_ctrl_anacap(__u32 anacap)
 {
 	__u8 nz = (anacap & 0x80) >> 7;
 	__u8 grpid_change = (anacap & 0x40) >> 6;
@@ -393,46 +375,45 @@ static void show_nvme_id_ctrl_anacap(__u8 anacap)
 	__u8 ana_nonopt = (anacap & 0x02) >> 1;
 	__u8 ana_opt = (anacap & 0x01);
 
-	printf("  [7:7] : %#x\tNon-zero group ID %sSupported\n",
+	fprintf(nvme_out(), "  [7:7] : %#x\tNon-zero group ID %sSupported\n",
 			nz, nz ? "" : "Not ");
-	printf("  [6:6] : %#x\tGroup ID does %schange\n",
+	fprintf(nvme_out(), "  [6:6] : %#x\tGroup ID does %schange\n",
 			grpid_change, grpid_change ? "" : "not ");
 	if (rsvd)
-		printf(" [5:5] : %#x\tReserved\n", rsvd);
-	printf("  [4:4] : %#x\tANA Change state %sSupported\n",
+		fprintf(nvme_out(), " [5:5] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [4:4] : %#x\tANA Change state %sSupported\n",
 			ana_change, ana_change ? "" : "Not ");
-	printf("  [3:3] : %#x\tANA Persistent Loss state %sSupported\n",
+	fprintf(nvme_out(), "  [3:3] : %#x\tANA Persistent Loss state %sSupported\n",
 			ana_persist_loss, ana_persist_loss ? "" : "Not ");
-	printf("  [2:2] : %#x\tANA Inaccessible state %sSupported\n",
+	fprintf(nvme_out(), "  [2:2] : %#x\tANA Inaccessible state %sSupported\n",
 			ana_inaccessible, ana_inaccessible ? "" : "Not ");
-	printf("  [1:1] : %#x\tANA Non-optimized state %sSupported\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tANA Non-optimized state %sSupported\n",
 			ana_nonopt, ana_nonopt ? "" : "Not ");
-	printf("  [0:0] : %#x\tANA Optimized state %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tANA Optimized state %sSupported\n",
 			ana_opt, ana_opt ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_sqes(__u8 sqes)
+static void show_nvme_id_ctrl_sqes(__u32 sqes)
 {
 	__u8 msqes = (sqes & 0xF0) >> 4;
 	__u8 rsqes = sqes & 0xF;
-	printf("  [7:4] : %#x\tMax SQ Entry Size (%d)\n", msqes, 1 << msqes);
-	printf("  [3:0] : %#x\tMin SQ Entry Size (%d)\n", rsqes, 1 << rsqes);
-	printf("\n");
+	fprintf(nvme_out(), "  [7:4] : %#x\tMax SQ Entry Size (%d)\n", msqes, 1 << msqes);
+	fprintf(nvme_out(), "  [3:0] : %#x\tMin SQ Entry Size (%d)\n", rsqes, 1 << rsqes);
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_cqes(__u8 cqes)
+static void show_nvme_id_ctrl_cqes(__u32 cqes)
 {
 	__u8 mcqes = (cqes & 0xF0) >> 4;
 	__u8 rcqes = cqes & 0xF;
-	printf("  [7:4] : %#x\tMax CQ Entry Size (%d)\n", mcqes, 1 << mcqes);
-	printf("  [3:0] : %#x\tMin CQ Entry Size (%d)\n", rcqes, 1 << rcqes);
-	printf("\n");
+	fprintf(nvme_out(), "  [7:4] : %#x\tMax CQ Entry Size (%d)\n", mcqes, 1 << mcqes);
+	fprintf(nvme_out(), "  [3:0] : %#x\tMin CQ Entry Size (%d)\n", rcqes, 1 << rcqes);
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_oncs(__le16 ctrl_oncs)
+static void show_nvme_id_ctrl_oncs(__u32 oncs)
 {
-	__u16 oncs = le16_to_cpu(ctrl_oncs);
 	__u16 rsvd = (oncs & 0xFF00) >> 8;
 	__u16 vrfy = (oncs & 0x80) >> 7;
 	__u16 tmst = (oncs & 0x40) >> 6;
@@ -444,79 +425,78 @@ static void show_nvme_id_ctrl_oncs(__le16 ctrl_oncs)
 	__u16 cmp = oncs & 0x1;
 
 	if (rsvd)
-		printf(" [15:8] : %#x\tReserved\n", rsvd);
-	printf("  [7:7] : %#x\tVerify %sSupported\n",
+		fprintf(nvme_out(), " [15:8] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [7:7] : %#x\tVerify %sSupported\n",
 		vrfy, vrfy ? "" : "Not ");
-	printf("  [6:6] : %#x\tTimestamp %sSupported\n",
+	fprintf(nvme_out(), "  [6:6] : %#x\tTimestamp %sSupported\n",
 		tmst, tmst ? "" : "Not ");
-	printf("  [5:5] : %#x\tReservations %sSupported\n",
+	fprintf(nvme_out(), "  [5:5] : %#x\tReservations %sSupported\n",
 		resv, resv ? "" : "Not ");
-	printf("  [4:4] : %#x\tSave and Select %sSupported\n",
+	fprintf(nvme_out(), "  [4:4] : %#x\tSave and Select %sSupported\n",
 		save, save ? "" : "Not ");
-	printf("  [3:3] : %#x\tWrite Zeroes %sSupported\n",
+	fprintf(nvme_out(), "  [3:3] : %#x\tWrite Zeroes %sSupported\n",
 		wzro, wzro ? "" : "Not ");
-	printf("  [2:2] : %#x\tData Set Management %sSupported\n",
+	fprintf(nvme_out(), "  [2:2] : %#x\tData Set Management %sSupported\n",
 		dsms, dsms ? "" : "Not ");
-	printf("  [1:1] : %#x\tWrite Uncorrectable %sSupported\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tWrite Uncorrectable %sSupported\n",
 		wunc, wunc ? "" : "Not ");
-	printf("  [0:0] : %#x\tCompare %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tCompare %sSupported\n",
 		cmp, cmp ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_fuses(__le16 ctrl_fuses)
+static void show_nvme_id_ctrl_fuses(__u32 fuses)
 {
-	__u16 fuses = le16_to_cpu(ctrl_fuses);
 	__u16 rsvd = (fuses & 0xFE) >> 1;
 	__u16 cmpw = fuses & 0x1;
 
 	if (rsvd)
-		printf(" [15:1] : %#x\tReserved\n", rsvd);
-	printf("  [0:0] : %#x\tFused Compare and Write %sSupported\n",
+		fprintf(nvme_out(), " [15:1] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [0:0] : %#x\tFused Compare and Write %sSupported\n",
 		cmpw, cmpw ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_fna(__u8 fna)
+static void show_nvme_id_ctrl_fna(__u32 fna)
 {
 	__u8 rsvd = (fna & 0xF8) >> 3;
 	__u8 cese = (fna & 0x4) >> 2;
 	__u8 cens = (fna & 0x2) >> 1;
 	__u8 fmns = fna & 0x1;
 	if (rsvd)
-		printf("  [7:3] : %#x\tReserved\n", rsvd);
-	printf("  [2:2] : %#x\tCrypto Erase %sSupported as part of Secure Erase\n",
+		fprintf(nvme_out(), "  [7:3] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [2:2] : %#x\tCrypto Erase %sSupported as part of Secure Erase\n",
 		cese, cese ? "" : "Not ");
-	printf("  [1:1] : %#x\tCrypto Erase Applies to %s Namespace(s)\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tCrypto Erase Applies to %s Namespace(s)\n",
 		cens, cens ? "All" : "Single");
-	printf("  [0:0] : %#x\tFormat Applies to %s Namespace(s)\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tFormat Applies to %s Namespace(s)\n",
 		fmns, fmns ? "All" : "Single");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_vwc(__u8 vwc)
+static void show_nvme_id_ctrl_vwc(__u32 vwc)
 {
 	__u8 rsvd = (vwc & 0xFE) >> 1;
 	__u8 vwcp = vwc & 0x1;
 	if (rsvd)
-		printf("  [7:3] : %#x\tReserved\n", rsvd);
-	printf("  [0:0] : %#x\tVolatile Write Cache %sPresent\n",
+		fprintf(nvme_out(), "  [7:3] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [0:0] : %#x\tVolatile Write Cache %sPresent\n",
 		vwcp, vwcp ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_nvscc(__u8 nvscc)
+static void show_nvme_id_ctrl_nvscc(__u32 nvscc)
 {
 	__u8 rsvd = (nvscc & 0xFE) >> 1;
 	__u8 fmt = nvscc & 0x1;
 	if (rsvd)
-		printf("  [7:1] : %#x\tReserved\n", rsvd);
-	printf("  [0:0] : %#x\tNVM Vendor Specific Commands uses %s Format\n",
+		fprintf(nvme_out(), "  [7:1] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [0:0] : %#x\tNVM Vendor Specific Commands uses %s Format\n",
 		fmt, fmt ? "NVMe" : "Vendor Specific");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_nwpc(__u8 nwpc)
+static void show_nvme_id_ctrl_nwpc(__u32 nwpc)
 {
 	__u8 no_wp_wp = (nwpc & 0x01);
 	__u8 wp_power_cycle = (nwpc & 0x02) >> 1;
@@ -524,20 +504,19 @@ static void show_nvme_id_ctrl_nwpc(__u8 nwpc)
 	__u8 rsvd = (nwpc & 0xF8) >> 3;
 
 	if (rsvd)
-		printf("  [7:3] : %#x\tReserved\n", rsvd);
+		fprintf(nvme_out(), "  [7:3] : %#x\tReserved\n", rsvd);
 
-	printf("  [2:2] : %#x\tPermanent Write Protect %sSupported\n",
+	fprintf(nvme_out(), "  [2:2] : %#x\tPermanent Write Protect %sSupported\n",
 		wp_permanent, wp_permanent ? "" : "Not ");
-	printf("  [1:1] : %#x\tWrite Protect Until Power Supply %sSupported\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tWrite Protect Until Power Supply %sSupported\n",
 		wp_power_cycle, wp_power_cycle ? "" : "Not ");
-	printf("  [0:0] : %#x\tNo Write Protect and Write Protect Namespace %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tNo Write Protect and Write Protect Namespace %sSupported\n",
 		no_wp_wp, no_wp_wp ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_sgls(__le32 ctrl_sgls)
+static void show_nvme_id_ctrl_sgls(__u32 sgls)
 {
-	__u32 sgls = le32_to_cpu(ctrl_sgls);
 	__u32 rsvd0 = (sgls & 0xFFC00000) >> 22;
 	__u32 trsdbd = (sgls & 0x200000) >> 21;
 	__u32 aofdsl = (sgls & 0x100000) >> 20;
@@ -550,56 +529,56 @@ static void show_nvme_id_ctrl_sgls(__le32 ctrl_sgls)
 	__u32 sglsp = sgls & 0x3;
 
 	if (rsvd0)
-		printf(" [31:22]: %#x\tReserved\n", rsvd0);
+		fprintf(nvme_out(), " [31:22]: %#x\tReserved\n", rsvd0);
 	if (sglsp || (!sglsp && trsdbd))
-		printf(" [21:21]: %#x\tTransport SGL Data Block Descriptor %sSupported\n",
+		fprintf(nvme_out(), " [21:21]: %#x\tTransport SGL Data Block Descriptor %sSupported\n",
 			trsdbd, trsdbd ? "" : "Not ");
 	if (sglsp || (!sglsp && aofdsl))
-		printf(" [20:20]: %#x\tAddress Offsets %sSupported\n",
+		fprintf(nvme_out(), " [20:20]: %#x\tAddress Offsets %sSupported\n",
 			aofdsl, aofdsl ? "" : "Not ");
 	if (sglsp || (!sglsp && mpcsd))
-		printf(" [19:19]: %#x\tMetadata Pointer Containing "
+		fprintf(nvme_out(), " [19:19]: %#x\tMetadata Pointer Containing "
 			"SGL Descriptor is %sSupported\n",
 			mpcsd, mpcsd ? "" : "Not ");
 	if (sglsp || (!sglsp && sglltb))
-		printf(" [18:18]: %#x\tSGL Length Larger than Buffer %sSupported\n",
+		fprintf(nvme_out(), " [18:18]: %#x\tSGL Length Larger than Buffer %sSupported\n",
 			sglltb, sglltb ? "" : "Not ");
 	if (sglsp || (!sglsp && bacmdb))
-		printf(" [17:17]: %#x\tByte-Aligned Contig. MD Buffer %sSupported\n",
+		fprintf(nvme_out(), " [17:17]: %#x\tByte-Aligned Contig. MD Buffer %sSupported\n",
 			bacmdb, bacmdb ? "" : "Not ");
 	if (sglsp || (!sglsp && bbs))
-		printf(" [16:16]: %#x\tSGL Bit-Bucket %sSupported\n",
+		fprintf(nvme_out(), " [16:16]: %#x\tSGL Bit-Bucket %sSupported\n",
 			bbs, bbs ? "" : "Not ");
 	if (rsvd1)
-		printf(" [15:3] : %#x\tReserved\n", rsvd1);
+		fprintf(nvme_out(), " [15:3] : %#x\tReserved\n", rsvd1);
 	if (sglsp || (!sglsp && key))
-		printf("  [2:2] : %#x\tKeyed SGL Data Block descriptor %sSupported\n",
+		fprintf(nvme_out(), "  [2:2] : %#x\tKeyed SGL Data Block descriptor %sSupported\n",
 			key, key ? "" : "Not ");
 	if (sglsp == 0x3)
-		printf("  [1:0] : %#x\tReserved\n", sglsp);
+		fprintf(nvme_out(), "  [1:0] : %#x\tReserved\n", sglsp);
 	else if (sglsp == 0x2)
-		printf("  [1:0] : %#x\tScatter-Gather Lists Supported."
+		fprintf(nvme_out(), "  [1:0] : %#x\tScatter-Gather Lists Supported."
 			" Dword alignment required.\n", sglsp);
 	else if (sglsp == 0x1)
-		printf("  [1:0] : %#x\tScatter-Gather Lists Supported."
+		fprintf(nvme_out(), "  [1:0] : %#x\tScatter-Gather Lists Supported."
 			" No Dword alignment required.\n", sglsp);
 	else
-		printf(" [1:0]  : %#x\tScatter-Gather Lists Not Supported\n", sglsp);
-	printf("\n");
+		fprintf(nvme_out(), " [1:0]  : %#x\tScatter-Gather Lists Not Supported\n", sglsp);
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ctrl_ctrattr(__u8 ctrattr)
+static void show_nvme_id_ctrl_ctrattr(__u32 ctrattr)
 {
 	__u8 rsvd = (ctrattr & 0xFE) >> 1;
 	__u8 scm = ctrattr & 0x1;
 	if (rsvd)
-		printf("  [7:1] : %#x\tReserved\n", rsvd);
-	printf("  [0:0] : %#x\t%s Controller Model\n",
+		fprintf(nvme_out(), "  [7:1] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [0:0] : %#x\t%s Controller Model\n",
 		scm, scm ? "Static" : "Dynamic");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ns_nsfeat(__u8 nsfeat)
+static void show_nvme_id_ns_nsfeat(__u32 nsfeat)
 {
 	__u8 rsvd = (nsfeat & 0xE0) >> 5;
 	__u8 ioopt = (nsfeat & 0x10) >> 4;
@@ -607,46 +586,46 @@ static void show_nvme_id_ns_nsfeat(__u8 nsfeat)
 	__u8 na = (nsfeat & 0x2) >> 1;
 	__u8 thin = nsfeat & 0x1;
 	if (rsvd)
-		printf("  [7:5] : %#x\tReserved\n", rsvd);
-	printf("  [4:4] : %#x\tNPWG, NPWA, NPDG, NPDA, and NOWS are %sSupported\n",
+		fprintf(nvme_out(), "  [7:5] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [4:4] : %#x\tNPWG, NPWA, NPDG, NPDA, and NOWS are %sSupported\n",
 		ioopt, ioopt ? "" : "Not ");
-	printf("  [2:2] : %#x\tDeallocated or Unwritten Logical Block error %sSupported\n",
+	fprintf(nvme_out(), "  [2:2] : %#x\tDeallocated or Unwritten Logical Block error %sSupported\n",
 		dulbe, dulbe ? "" : "Not ");
-	printf("  [1:1] : %#x\tNamespace uses %s\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tNamespace uses %s\n",
 		na, na ? "NAWUN, NAWUPF, and NACWU" : "AWUN, AWUPF, and ACWU");
-	printf("  [0:0] : %#x\tThin Provisioning %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tThin Provisioning %sSupported\n",
 		thin, thin ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ns_flbas(__u8 flbas)
+static void show_nvme_id_ns_flbas(__u32 flbas)
 {
 	__u8 rsvd = (flbas & 0xE0) >> 5;
 	__u8 mdedata = (flbas & 0x10) >> 4;
 	__u8 lbaf = flbas & 0xF;
 	if (rsvd)
-		printf("  [7:5] : %#x\tReserved\n", rsvd);
-	printf("  [4:4] : %#x\tMetadata Transferred %s\n",
+		fprintf(nvme_out(), "  [7:5] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [4:4] : %#x\tMetadata Transferred %s\n",
 		mdedata, mdedata ? "at End of Data LBA" : "in Separate Contiguous Buffer");
-	printf("  [3:0] : %#x\tCurrent LBA Format Selected\n", lbaf);
-	printf("\n");
+	fprintf(nvme_out(), "  [3:0] : %#x\tCurrent LBA Format Selected\n", lbaf);
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ns_mc(__u8 mc)
+static void show_nvme_id_ns_mc(__u32 mc)
 {
 	__u8 rsvd = (mc & 0xFC) >> 2;
 	__u8 mdp = (mc & 0x2) >> 1;
 	__u8 extdlba = mc & 0x1;
 	if (rsvd)
-		printf("  [7:2] : %#x\tReserved\n", rsvd);
-	printf("  [1:1] : %#x\tMetadata Pointer %sSupported\n",
+		fprintf(nvme_out(), "  [7:2] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [1:1] : %#x\tMetadata Pointer %sSupported\n",
 		mdp, mdp ? "" : "Not ");
-	printf("  [0:0] : %#x\tMetadata as Part of Extended Data LBA %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tMetadata as Part of Extended Data LBA %sSupported\n",
 		extdlba, extdlba ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ns_dpc(__u8 dpc)
+static void show_nvme_id_ns_dpc(__u32 dpc)
 {
 	__u8 rsvd = (dpc & 0xE0) >> 5;
 	__u8 pil8 = (dpc & 0x10) >> 4;
@@ -655,49 +634,49 @@ static void show_nvme_id_ns_dpc(__u8 dpc)
 	__u8 pit2 = (dpc & 0x2) >> 1;
 	__u8 pit1 = dpc & 0x1;
 	if (rsvd)
-		printf("  [7:5] : %#x\tReserved\n", rsvd);
-	printf("  [4:4] : %#x\tProtection Information Transferred as Last 8 Bytes of Metadata %sSupported\n",
+		fprintf(nvme_out(), "  [7:5] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [4:4] : %#x\tProtection Information Transferred as Last 8 Bytes of Metadata %sSupported\n",
 		pil8, pil8 ? "" : "Not ");
-	printf("  [3:3] : %#x\tProtection Information Transferred as First 8 Bytes of Metadata %sSupported\n",
+	fprintf(nvme_out(), "  [3:3] : %#x\tProtection Information Transferred as First 8 Bytes of Metadata %sSupported\n",
 		pif8, pif8 ? "" : "Not ");
-	printf("  [2:2] : %#x\tProtection Information Type 3 %sSupported\n",
+	fprintf(nvme_out(), "  [2:2] : %#x\tProtection Information Type 3 %sSupported\n",
 		pit3, pit3 ? "" : "Not ");
-	printf("  [1:1] : %#x\tProtection Information Type 2 %sSupported\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tProtection Information Type 2 %sSupported\n",
 		pit2, pit2 ? "" : "Not ");
-	printf("  [0:0] : %#x\tProtection Information Type 1 %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tProtection Information Type 1 %sSupported\n",
 		pit1, pit1 ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ns_dps(__u8 dps)
+static void show_nvme_id_ns_dps(__u32 dps)
 {
 	__u8 rsvd = (dps & 0xF0) >> 4;
 	__u8 pif8 = (dps & 0x8) >> 3;
 	__u8 pit = dps & 0x7;
 	if (rsvd)
-		printf("  [7:4] : %#x\tReserved\n", rsvd);
-	printf("  [3:3] : %#x\tProtection Information is Transferred as %s 8 Bytes of Metadata\n",
+		fprintf(nvme_out(), "  [7:4] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [3:3] : %#x\tProtection Information is Transferred as %s 8 Bytes of Metadata\n",
 		pif8, pif8 ? "First" : "Last");
-	printf("  [2:0] : %#x\tProtection Information %s\n", pit,
+	fprintf(nvme_out(), "  [2:0] : %#x\tProtection Information %s\n", pit,
 		pit == 3 ? "Type 3 Enabled" :
 		pit == 2 ? "Type 2 Enabled" :
 		pit == 1 ? "Type 1 Enabled" :
 		pit == 0 ? "Disabled" : "Reserved Enabled");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ns_nmic(__u8 nmic)
+static void show_nvme_id_ns_nmic(__u32 nmic)
 {
 	__u8 rsvd = (nmic & 0xFE) >> 1;
 	__u8 mp = nmic & 0x1;
 	if (rsvd)
-		printf("  [7:1] : %#x\tReserved\n", rsvd);
-	printf("  [0:0] : %#x\tNamespace Multipath %sCapable\n",
+		fprintf(nvme_out(), "  [7:1] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [0:0] : %#x\tNamespace Multipath %sCapable\n",
 		mp, mp ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ns_rescap(__u8 rescap)
+static void show_nvme_id_ns_rescap(__u32 rescap)
 {
 	__u8 rsvd = (rescap & 0x80) >> 7;
 	__u8 eaar = (rescap & 0x40) >> 6;
@@ -708,125 +687,373 @@ static void show_nvme_id_ns_rescap(__u8 rescap)
 	__u8 we = (rescap & 0x2) >> 1;
 	__u8 ptpl = rescap & 0x1;
 	if (rsvd)
-		printf("  [7:7] : %#x\tReserved\n", rsvd);
-	printf("  [6:6] : %#x\tExclusive Access - All Registrants %sSupported\n",
+		fprintf(nvme_out(), "  [7:7] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [6:6] : %#x\tExclusive Access - All Registrants %sSupported\n",
 		eaar, eaar ? "" : "Not ");
-	printf("  [5:5] : %#x\tWrite Exclusive - All Registrants %sSupported\n",
+	fprintf(nvme_out(), "  [5:5] : %#x\tWrite Exclusive - All Registrants %sSupported\n",
 		wear, wear ? "" : "Not ");
-	printf("  [4:4] : %#x\tExclusive Access - Registrants Only %sSupported\n",
+	fprintf(nvme_out(), "  [4:4] : %#x\tExclusive Access - Registrants Only %sSupported\n",
 		earo, earo ? "" : "Not ");
-	printf("  [3:3] : %#x\tWrite Exclusive - Registrants Only %sSupported\n",
+	fprintf(nvme_out(), "  [3:3] : %#x\tWrite Exclusive - Registrants Only %sSupported\n",
 		wero, wero ? "" : "Not ");
-	printf("  [2:2] : %#x\tExclusive Access %sSupported\n",
+	fprintf(nvme_out(), "  [2:2] : %#x\tExclusive Access %sSupported\n",
 		ea, ea ? "" : "Not ");
-	printf("  [1:1] : %#x\tWrite Exclusive %sSupported\n",
+	fprintf(nvme_out(), "  [1:1] : %#x\tWrite Exclusive %sSupported\n",
 		we, we ? "" : "Not ");
-	printf("  [0:0] : %#x\tPersist Through Power Loss %sSupported\n",
+	fprintf(nvme_out(), "  [0:0] : %#x\tPersist Through Power Loss %sSupported\n",
 		ptpl, ptpl ? "" : "Not ");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ns_fpi(__u8 fpi)
+static void show_nvme_id_ns_fpi(__u32 fpi)
 {
 	__u8 fpis = (fpi & 0x80) >> 7;
 	__u8 fpii = fpi & 0x7F;
-	printf("  [7:7] : %#x\tFormat Progress Indicator %sSupported\n",
+	fprintf(nvme_out(), "  [7:7] : %#x\tFormat Progress Indicator %sSupported\n",
 		fpis, fpis ? "" : "Not ");
 	if (fpis || (!fpis && fpii))
-		printf("  [6:0] : %#x\tFormat Progress Indicator (Remaining %d%%)\n",
+		fprintf(nvme_out(), "  [6:0] : %#x\tFormat Progress Indicator (Remaining %d%%)\n",
 		fpii, fpii);
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
-static void show_nvme_id_ns_dlfeat(__u8 dlfeat)
+static void show_nvme_id_ns_dlfeat(__u32 dlfeat)
 {
 	__u8 rsvd = (dlfeat & 0xE0) >> 5;
 	__u8 guard = (dlfeat & 0x10) >> 4;
 	__u8 dwz = (dlfeat & 0x8) >> 3;
 	__u8 val = dlfeat & 0x7;
 	if (rsvd)
-		printf("  [7:5] : %#x\tReserved\n", rsvd);
-	printf("  [4:4] : %#x\tGuard Field of Deallocated Logical Blocks is set to %s\n",
+		fprintf(nvme_out(), "  [7:5] : %#x\tReserved\n", rsvd);
+	fprintf(nvme_out(), "  [4:4] : %#x\tGuard Field of Deallocated Logical Blocks is set to %s\n",
 		guard, guard ? "CRC of The Value Read" : "0xFFFF");
-	printf("  [3:3] : %#x\tDeallocate Bit in the Write Zeroes Command is %sSupported\n",
+	fprintf(nvme_out(), "  [3:3] : %#x\tDeallocate Bit in the Write Zeroes Command is %sSupported\n",
 		dwz, dwz ? "" : "Not ");
-	printf("  [2:0] : %#x\tBytes Read From a Deallocated Logical Block and its Metadata are %s\n", val,
+	fprintf(nvme_out(), "  [2:0] : %#x\tBytes Read From a Deallocated Logical Block and its Metadata are %s\n", val,
 		val == 2 ? "0xFF" :
 		val == 1 ? "0x00" :
 		val == 0 ? "Not Reported" : "Reserved Value");
-	printf("\n");
+	fprintf(nvme_out(), "\n");
+}
+
+/*
+ * Field descriptors for the Identify and log page structures. Every field
+ * is little endian; one table drives both the normal and the JSON output
+ * so the two cannot drift apart. The binary output is the raw structure.
+ */
+enum nvme_field_fmt {
+	NVME_FIELD_DEC,		/* unsigned decimal */
+	NVME_FIELD_HEX,		/* hex with 0x prefix */
+	NVME_FIELD_PCT,		/* percentage */
+	NVME_FIELD_TEMP,	/* Kelvin, shown in Celsius */
+	NVME_FIELD_U128,	/* 128-bit counter */
+	NVME_FIELD_OUI,		/* 24-bit IEEE OUI */
+	NVME_FIELD_STR,		/* space padded ASCII */
+	NVME_FIELD_ID,		/* identifier shown as hex bytes */
+};
+
+#define NVME_FIELD_GROUP	0x1	/* digit grouping in normal output */
+#define NVME_FIELD_NONZERO	0x2	/* left out when zero */
+
+struct nvme_field {
+	const char *name;	/* JSON key */
+	const char *label;	/* normal output, NULL to use @name */
+	unsigned short offset;
+	unsigned short size;
+	unsigned char fmt;
+	unsigned char flags;
+	void (*human)(__u32 val);
+};
+
+#define NVME_FIELD(type, member, fmt, human) \
+	{ #member, NULL, offsetof(type, member), \
+	  sizeof(((type *)0)->member), fmt, 0, human }
+#define NVME_FIELD_NAMED(type, member, name, label, fmt, flags) \
+	{ name, label, offsetof(type, member), \
+	  sizeof(((type *)0)->member), fmt, flags, NULL }
+
+static __u64 nvme_field_uint(const void *base, const struct nvme_field *f)
+{
+	const __u8 *p = (const __u8 *)base + f->offset;
+	__u64 val = 0;
+	int i;
+
+	for (i = f->size - 1; i >= 0; i--)
+		val = val << 8 | p[i];
+	return val;
+}
+
+static void nvme_field_id(const void *base, const struct nvme_field *f,
+			  char *buf)
+{
+	const __u8 *p = (const __u8 *)base + f->offset;
+	int i;
+
+	for (i = 0; i < f->size; i++)
+		buf += sprintf(buf, "%02x", p[i]);
+}
+
+static void show_fields(const void *base, const struct nvme_field *fields,
+			int n, int width, bool human)
+{
+	char id[33], str[UINT128_STRLEN];
+	const struct nvme_field *f;
+	const __u8 *p;
+	__u64 val;
+
+	for (f = fields; f < fields + n; f++) {
+		p = (const __u8 *)base + f->offset;
+		val = f->size <= 8 ? nvme_field_uint(base, f) : 0;
+		if ((f->flags & NVME_FIELD_NONZERO) && !val)
+			continue;
+
+		fprintf(nvme_out(), "%-*s: ", width, f->label ? f->label : f->name);
+		switch (f->fmt) {
+		case NVME_FIELD_DEC:
+			fprintf(nvme_out(), "%"PRIu64"\n", (uint64_t)val);
+			break;
+		case NVME_FIELD_HEX:
+			fprintf(nvme_out(), "%#"PRIx64"\n", (uint64_t)val);
+			break;
+		case NVME_FIELD_PCT:
+			fprintf(nvme_out(), "%"PRIu64"%%\n", (uint64_t)val);
+			break;
+		case NVME_FIELD_TEMP:
+			fprintf(nvme_out(), "%d C\n", (int)val - 273);
+			break;
+		case NVME_FIELD_U128:
+			fprintf(nvme_out(), "%s\n", le128_to_str(p, str,
+						    f->flags & NVME_FIELD_GROUP));
+			break;
+		case NVME_FIELD_OUI:
+			fprintf(nvme_out(), "%06"PRIx64"\n", (uint64_t)val);
+			break;
+		case NVME_FIELD_STR:
+			fprintf(nvme_out(), "%-.*s\n", f->size, (const char *)p);
+			break;
+		case NVME_FIELD_ID:
+			nvme_field_id(base, f, id);
+			fprintf(nvme_out(), "%s\n", id);
+			break;
+		}
+		if (human && f->human)
+			f->human(val);
+	}
+}
+
+static void json_add_fields(struct json_object *root, const void *base,
+			    const struct nvme_field *fields, int n)
+{
+	const struct nvme_field *f;
+	char str[257];
+	const __u8 *p;
+	__u64 val;
+
+	for (f = fields; f < fields + n; f++) {
+		p = (const __u8 *)base + f->offset;
+		switch (f->fmt) {
+		case NVME_FIELD_U128:
+			json_object_add_value_uint128(root, f->name,
+					uint128_from_le(p));
+			break;
+		case NVME_FIELD_STR:
+			snprintf(str, sizeof(str), "%-.*s", f->size,
+				 (const char *)p);
+			json_object_add_value_string(root, f->name, str);
+			break;
+		case NVME_FIELD_ID:
+			nvme_field_id(base, f, str);
+			json_object_add_value_string(root, f->name, str);
+			break;
+		default:
+			val = nvme_field_uint(base, f);
+			if ((f->flags & NVME_FIELD_NONZERO) && !val)
+				break;
+			json_object_add_value_uint(root, f->name, val);
+			break;
+		}
+	}
 }
 
+#define ID_NS_FIELD(member, fmt, human) \
+	NVME_FIELD(struct nvme_id_ns, member, fmt, human)
+
+static const struct nvme_field id_ns_fields[] = {
+	ID_NS_FIELD(nsze,	NVME_FIELD_HEX, NULL),
+	ID_NS_FIELD(ncap,	NVME_FIELD_HEX, NULL),
+	ID_NS_FIELD(nuse,	NVME_FIELD_HEX, NULL),
+	ID_NS_FIELD(nsfeat,	NVME_FIELD_HEX, show_nvme_id_ns_nsfeat),
+	ID_NS_FIELD(nlbaf,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(flbas,	NVME_FIELD_HEX, show_nvme_id_ns_flbas),
+	ID_NS_FIELD(mc,		NVME_FIELD_HEX, show_nvme_id_ns_mc),
+	ID_NS_FIELD(dpc,	NVME_FIELD_HEX, show_nvme_id_ns_dpc),
+	ID_NS_FIELD(dps,	NVME_FIELD_HEX, show_nvme_id_ns_dps),
+	ID_NS_FIELD(nmic,	NVME_FIELD_HEX, show_nvme_id_ns_nmic),
+	ID_NS_FIELD(rescap,	NVME_FIELD_HEX, show_nvme_id_ns_rescap),
+	ID_NS_FIELD(fpi,	NVME_FIELD_HEX, show_nvme_id_ns_fpi),
+	ID_NS_FIELD(dlfeat,	NVME_FIELD_DEC, show_nvme_id_ns_dlfeat),
+	ID_NS_FIELD(nawun,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(nawupf,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(nacwu,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(nabsn,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(nabo,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(nabspf,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(noiob,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(nvmcap,	NVME_FIELD_U128, NULL),
+};
+
+/* only valid when NSFEAT bit 4 is set */
+static const struct nvme_field id_ns_optperf_fields[] = {
+	ID_NS_FIELD(npwg,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(npwa,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(npdg,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(npda,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(nows,	NVME_FIELD_DEC, NULL),
+};
+
+static const struct nvme_field id_ns_tail_fields[] = {
+	ID_NS_FIELD(nsattr,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(nvmsetid,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(anagrpid,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(endgid,	NVME_FIELD_DEC, NULL),
+	ID_NS_FIELD(nguid,	NVME_FIELD_ID, NULL),
+	ID_NS_FIELD(eui64,	NVME_FIELD_ID, NULL),
+};
+
+#define ID_CTRL_FIELD(member, fmt, human) \
+	NVME_FIELD(struct nvme_id_ctrl, member, fmt, human)
+
+static const struct nvme_field id_ctrl_fields[] = {
+	ID_CTRL_FIELD(vid,	 NVME_FIELD_HEX, NULL),
+	ID_CTRL_FIELD(ssvid,	 NVME_FIELD_HEX, NULL),
+	ID_CTRL_FIELD(sn,	 NVME_FIELD_STR, NULL),
+	ID_CTRL_FIELD(mn,	 NVME_FIELD_STR, NULL),
+	ID_CTRL_FIELD(fr,	 NVME_FIELD_STR, NULL),
+	ID_CTRL_FIELD(rab,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(ieee,	 NVME_FIELD_OUI, NULL),
+	ID_CTRL_FIELD(cmic,	 NVME_FIELD_HEX, show_nvme_id_ctrl_cmic),
+	ID_CTRL_FIELD(mdts,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(cntlid,	 NVME_FIELD_HEX, NULL),
+	ID_CTRL_FIELD(ver,	 NVME_FIELD_HEX, NULL),
+	ID_CTRL_FIELD(rtd3r,	 NVME_FIELD_HEX, NULL),
+	ID_CTRL_FIELD(rtd3e,	 NVME_FIELD_HEX, NULL),
+	ID_CTRL_FIELD(oaes,	 NVME_FIELD_HEX, show_nvme_id_ctrl_oaes),
+	ID_CTRL_FIELD(ctratt,	 NVME_FIELD_HEX, show_nvme_id_ctrl_ctratt),
+	ID_CTRL_FIELD(rrls,	 NVME_FIELD_HEX, NULL),
+	ID_CTRL_FIELD(crdt1,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(crdt2,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(crdt3,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(oacs,	 NVME_FIELD_HEX, show_nvme_id_ctrl_oacs),
+	ID_CTRL_FIELD(acl,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(aerl,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(frmw,	 NVME_FIELD_HEX, show_nvme_id_ctrl_frmw),
+	ID_CTRL_FIELD(lpa,	 NVME_FIELD_HEX, show_nvme_id_ctrl_lpa),
+	ID_CTRL_FIELD(elpe,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(npss,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(avscc,	 NVME_FIELD_HEX, show_nvme_id_ctrl_avscc),
+	ID_CTRL_FIELD(apsta,	 NVME_FIELD_HEX, show_nvme_id_ctrl_apsta),
+	ID_CTRL_FIELD(wctemp,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(cctemp,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(mtfa,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(hmpre,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(hmmin,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(tnvmcap,	 NVME_FIELD_U128, NULL),
+	ID_CTRL_FIELD(unvmcap,	 NVME_FIELD_U128, NULL),
+	ID_CTRL_FIELD(rpmbs,	 NVME_FIELD_HEX, show_nvme_id_ctrl_rpmbs),
+	ID_CTRL_FIELD(edstt,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(dsto,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(fwug,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(kas,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(hctma,	 NVME_FIELD_HEX, show_nvme_id_ctrl_hctma),
+	ID_CTRL_FIELD(mntmt,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(mxtmt,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(sanicap,	 NVME_FIELD_HEX, show_nvme_id_ctrl_sanicap),
+	ID_CTRL_FIELD(hmminds,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(hmmaxd,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(nsetidmax, NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(anatt,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(anacap,	 NVME_FIELD_DEC, show_nvme_id_ctrl_anacap),
+	ID_CTRL_FIELD(anagrpmax, NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(nanagrpid, NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(sqes,	 NVME_FIELD_HEX, show_nvme_id_ctrl_sqes),
+	ID_CTRL_FIELD(cqes,	 NVME_FIELD_HEX, show_nvme_id_ctrl_cqes),
+	ID_CTRL_FIELD(maxcmd,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(nn,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(oncs,	 NVME_FIELD_HEX, show_nvme_id_ctrl_oncs),
+	ID_CTRL_FIELD(fuses,	 NVME_FIELD_HEX, show_nvme_id_ctrl_fuses),
+	ID_CTRL_FIELD(fna,	 NVME_FIELD_HEX, show_nvme_id_ctrl_fna),
+	ID_CTRL_FIELD(vwc,	 NVME_FIELD_HEX, show_nvme_id_ctrl_vwc),
+	ID_CTRL_FIELD(awun,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(awupf,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(nvscc,	 NVME_FIELD_DEC, show_nvme_id_ctrl_nvscc),
+	ID_CTRL_FIELD(nwpc,	 NVME_FIELD_DEC, show_nvme_id_ctrl_nwpc),
+	ID_CTRL_FIELD(acwu,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(sgls,	 NVME_FIELD_HEX, show_nvme_id_ctrl_sgls),
+	ID_CTRL_FIELD(mnan,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(subnqn,	 NVME_FIELD_STR, NULL),
+	ID_CTRL_FIELD(ioccsz,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(iorcsz,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(icdoff,	 NVME_FIELD_DEC, NULL),
+	ID_CTRL_FIELD(ctrattr,	 NVME_FIELD_HEX, show_nvme_id_ctrl_ctrattr),
+	ID_CTRL_FIELD(msdbd,	 NVME_FIELD_DEC, NULL),
+};
+
+#define SMART_FIELD(member, name, label, fmt, flags) \
+	NVME_FIELD_NAMED(struct nvme_smart_log, member, name, label, fmt, flags)
+#define SMART_COUNTER(member, name) \
+	SMART_FIELD(member, name, NULL, NVME_FIELD_U128, NVME_FIELD_GROUP)
+#define SMART_SENSOR(n) \
+	SMART_FIELD(temp_sensor[n - 1], "temperature_sensor_" #n, \
+		    "Temperature Sensor " #n, NVME_FIELD_TEMP, NVME_FIELD_NONZERO)
+
+static const struct nvme_field smart_log_fields[] = {
+	SMART_FIELD(critical_warning, "critical_warning", NULL, NVME_FIELD_HEX, 0),
+	SMART_FIELD(temperature, "temperature", NULL, NVME_FIELD_TEMP, 0),
+	SMART_FIELD(avail_spare, "avail_spare", "available_spare", NVME_FIELD_PCT, 0),
+	SMART_FIELD(spare_thresh, "spare_thresh", "available_spare_threshold", NVME_FIELD_PCT, 0),
+	SMART_FIELD(percent_used, "percent_used", "percentage_used", NVME_FIELD_PCT, 0),
+	SMART_COUNTER(data_units_read, "data_units_read"),
+	SMART_COUNTER(data_units_written, "data_units_written"),
+	SMART_COUNTER(host_reads, "host_read_commands"),
+	SMART_COUNTER(host_writes, "host_write_commands"),
+	SMART_COUNTER(ctrl_busy_time, "controller_busy_time"),
+	SMART_COUNTER(power_cycles, "power_cycles"),
+	SMART_COUNTER(power_on_hours, "power_on_hours"),
+	SMART_COUNTER(unsafe_shutdowns, "unsafe_shutdowns"),
+	SMART_COUNTER(media_errors, "media_errors"),
+	SMART_COUNTER(num_err_log_entries, "num_err_log_entries"),
+	SMART_FIELD(warning_temp_time, "warning_temp_time", "Warning Temperature Time", NVME_FIELD_DEC, 0),
+	SMART_FIELD(critical_comp_time, "critical_comp_time", "Critical Composite Temperature Time", NVME_FIELD_DEC, 0),
+	SMART_SENSOR(1),
+	SMART_SENSOR(2),
+	SMART_SENSOR(3),
+	SMART_SENSOR(4),
+	SMART_SENSOR(5),
+	SMART_SENSOR(6),
+	SMART_SENSOR(7),
+	SMART_SENSOR(8),
+	SMART_FIELD(thm_temp1_trans_count, "thm_temp1_trans_count", "Thermal Management T1 Trans Count", NVME_FIELD_DEC, 0),
+	SMART_FIELD(thm_temp2_trans_count, "thm_temp2_trans_count", "Thermal Management T2 Trans Count", NVME_FIELD_DEC, 0),
+	SMART_FIELD(thm_temp1_total_time, "thm_temp1_total_time", "Thermal Management T1 Total Time", NVME_FIELD_DEC, 0),
+	SMART_FIELD(thm_temp2_total_time, "thm_temp2_total_time", "Thermal Management T2 Total Time", NVME_FIELD_DEC, 0),
+};
+
 void show_nvme_id_ns(struct nvme_id_ns *ns, unsigned int mode)
 {
 	int i;
 	int human = mode & HUMAN,
 		vs = mode & VS;
 
-	printf("nsze    : %#"PRIx64"\n", le64_to_cpu(ns->nsze));
-	printf("ncap    : %#"PRIx64"\n", le64_to_cpu(ns->ncap));
-	printf("nuse    : %#"PRIx64"\n", le64_to_cpu(ns->nuse));
-	printf("nsfeat  : %#x\n", ns->nsfeat);
-	if (human)
-		show_nvme_id_ns_nsfeat(ns->nsfeat);
-	printf("nlbaf   : %d\n", ns->nlbaf);
-	printf("flbas   : %#x\n", ns->flbas);
-	if (human)
-		show_nvme_id_ns_flbas(ns->flbas);
-	printf("mc      : %#x\n", ns->mc);
-	if (human)
-		show_nvme_id_ns_mc(ns->mc);
-	printf("dpc     : %#x\n", ns->dpc);
-	if (human)
-		show_nvme_id_ns_dpc(ns->dpc);
-	printf("dps     : %#x\n", ns->dps);
-	if (human)
-		show_nvme_id_ns_dps(ns->dps);
-	printf("nmic    : %#x\n", ns->nmic);
-	if (human)
-		show_nvme_id_ns_nmic(ns->nmic);
-	printf("rescap  : %#x\n", ns->rescap);
-	if (human)
-		show_nvme_id_ns_rescap(ns->rescap);
-	printf("fpi     : %#x\n", ns->fpi);
-	if (human)
-		show_nvme_id_ns_fpi(ns->fpi);
-	printf("dlfeat  : %d\n", ns->dlfeat);
-	if (human)
-		show_nvme_id_ns_dlfeat(ns->dlfeat);
-	printf("nawun   : %d\n", le16_to_cpu(ns->nawun));
-	printf("nawupf  : %d\n", le16_to_cpu(ns->nawupf));
-	printf("nacwu   : %d\n", le16_to_cpu(ns->nacwu));
-	printf("nabsn   : %d\n", le16_to_cpu(ns->nabsn));
-	printf("nabo    : %d\n", le16_to_cpu(ns->nabo));
-	printf("nabspf  : %d\n", le16_to_cpu(ns->nabspf));
-	printf("noiob   : %d\n", le16_to_cpu(ns->noiob));
-	printf("nvmcap  : %.0Lf\n", int128_to_double(ns->nvmcap));
-	if (ns->nsfeat & 0x10) {
-		printf("npwg    : %u\n", le16_to_cpu(ns->npwg));
-		printf("npwa    : %u\n", le16_to_cpu(ns->npwa));
-		printf("npdg    : %u\n", le16_to_cpu(ns->npdg));
-		printf("npda    : %u\n", le16_to_cpu(ns->npda));
-		printf("nows    : %u\n", le16_to_cpu(ns->nows));
-	}
-	printf("nsattr	: %u\n", ns->nsattr);
-	printf("nvmsetid: %d\n", le16_to_cpu(ns->nvmsetid));
-	printf("anagrpid: %u\n", le32_to_cpu(ns->anagrpid));
-	printf("endgid  : %d\n", le16_to_cpu(ns->endgid));
-
-	printf("nguid   : ");
-	for (i = 0; i < 16; i++)
-		printf("%02x", ns->nguid[i]);
-	printf("\n");
-
-	printf("eui64   : ");
-	for (i = 0; i < 8; i++)
-		printf("%02x", ns->eui64[i]);
-	printf("\n");
+	show_fields(ns, id_ns_fields, ARRAY_SIZE(id_ns_fields), 8, human);
+	if (ns->nsfeat & 0x10)
+		show_fields(ns, id_ns_optperf_fields,
+			    ARRAY_SIZE(id_ns_optperf_fields), 8, human);
+	show_fields(ns, id_ns_tail_fields, ARRAY_SIZE(id_ns_tail_fields), 8,
+		    human);
 
 	for (i = 0; i <= ns->nlbaf; i++) {
 		if (human)
-			printf("LBA Format %2d : Metadata Size: %-3d bytes - "
+			fprintf(nvme_out(), "LBA Format %2d : Metadata Size: %-3d bytes - "
 				"Data Size: %-2d bytes - Relative Performance: %#x %s %s\n", i,
 				le16_to_cpu(ns->lbaf[i].ms), 1 << ns->lbaf[i].ds, ns->lbaf[i].rp,
 				ns->lbaf[i].rp == 3 ? "Degraded" :
@@ -834,12 +1061,12 @@ void show_nvme_id_ns(struct nvme_id_ns *ns, unsigned int mode)
 				ns->lbaf[i].rp == 1 ? "Better" : "Best",
 				i == (ns->flbas & 0xf) ? "(in use)" : "");
 		else
-			printf("lbaf %2d : ms:%-3d lbads:%-2d rp:%#x %s\n", i,
+			fprintf(nvme_out(), "lbaf %2d : ms:%-3d lbads:%-2d rp:%#x %s\n", i,
 				le16_to_cpu(ns->lbaf[i].ms), ns->lbaf[i].ds, ns->lbaf[i].rp,
 				i == (ns->flbas & 0xf) ? "(in use)" : "");
 	}
 	if (vs) {
-		printf("vs[]:\n");
+		fprintf(nvme_out(), "vs[]:\n");
 		d(ns->vs, sizeof(ns->vs), 16, 1);
 	}
 }
@@ -933,7 +1160,6 @@ void json_nvme_id_ns_descs(void *data)
 		json_object_add_value_array(root, "ns-descs", json_array);
 
 	json_print_object(root, NULL);
-	printf("\n");
 
 	json_free_object(root);
 }
@@ -958,25 +1184,25 @@ void show_nvme_id_ns_descs(void *data)
 		switch (cur->nidt) {
 		case NVME_NIDT_EUI64:
 			memcpy(eui64, data + pos + sizeof(*cur), sizeof(eui64));
-			printf("eui64   : ");
+			fprintf(nvme_out(), "eui64   : ");
 			for (i = 0; i < 8; i++)
-				printf("%02x", eui64[i]);
-			printf("\n");
+				fprintf(nvme_out(), "%02x", eui64[i]);
+			fprintf(nvme_out(), "\n");
 			len += sizeof(eui64);
 			break;
 		case NVME_NIDT_NGUID:
 			memcpy(nguid, data + pos + sizeof(*cur), sizeof(nguid));
-			printf("nguid   : ");
+			fprintf(nvme_out(), "nguid   : ");
 			for (i = 0; i < 16; i++)
-				printf("%02x", nguid[i]);
-			printf("\n");
+				fprintf(nvme_out(), "%02x", nguid[i]);
+			fprintf(nvme_out(), "\n");
 			len += sizeof(nguid);
 			break;
 #ifdef LIBUUID
 		case NVME_NIDT_UUID:
 			memcpy(uuid, data + pos + sizeof(*cur), 16);
 			uuid_unparse_lower(uuid, uuid_str);
-			printf("uuid    : %s\n", uuid_str);
+			fprintf(nvme_out(), "uuid    : %s\n", uuid_str);
 			len += sizeof(uuid);
 			break;
 #endif
@@ -997,21 +1223,21 @@ static void print_ps_power_and_scale(__le16 ctr_power, __u8 scale)
 	switch (scale & 0x3) {
 	case 0:
 		/* Not reported for this power state */
-		printf("-");
+		fprintf(nvme_out(), "-");
 		break;
 
 	case 1:
 		/* Units of 0.0001W */
-		printf("%01u.%04uW", power / 10000, power % 10000);
+		fprintf(nvme_out(), "%01u.%04uW", power / 10000, power % 10000);
 		break;
 
 	case 2:
 		/* Units of 0.01W */
-		printf("%01u.%02uW", power / 100, scale % 100);
+		fprintf(nvme_out(), "%01u.%02uW", power / 100, scale % 100);
 		break;
 
 	default:
-		printf("reserved");
+		fprintf(nvme_out(), "reserved");
 	}
 }
 
@@ -1023,27 +1249,27 @@ static void show_nvme_id_ctrl_power(struct nvme_id_ctrl *ctrl)
 	for (i = 0; i <= ctrl->npss; i++) {
 		__u16 max_power = le16_to_cpu(ctrl->psd[i].max_power);
 
-		printf("ps %4d : mp:", i);
+		fprintf(nvme_out(), "ps %4d : mp:", i);
 
 		if (ctrl->psd[i].flags & NVME_PS_FLAGS_MAX_POWER_SCALE)
-			printf("%01u.%04uW ", max_power / 10000, max_power % 10000);
+			fprintf(nvme_out(), "%01u.%04uW ", max_power / 10000, max_power % 10000);
 		else
-			printf("%01u.%02uW ", max_power / 100, max_power % 100);
+			fprintf(nvme_out(), "%01u.%02uW ", max_power / 100, max_power % 100);
 
 		if (ctrl->psd[i].flags & NVME_PS_FLAGS_NON_OP_STATE)
-			printf("non-");
+			fprintf(nvme_out(), "non-");
 
-		printf("operational enlat:%d exlat:%d rrt:%d rrl:%d\n"
+		fprintf(nvme_out(), "operational enlat:%d exlat:%d rrt:%d rrl:%d\n"
 			"          rwt:%d rwl:%d idle_power:",
 			le32_to_cpu(ctrl->psd[i].entry_lat), le32_to_cpu(ctrl->psd[i].exit_lat),
 			ctrl->psd[i].read_tput, ctrl->psd[i].read_lat,
 			ctrl->psd[i].write_tput, ctrl->psd[i].write_lat);
 		print_ps_power_and_scale(ctrl->psd[i].idle_power,
 					 POWER_SCALE(ctrl->psd[i].idle_scale));
-		printf(" active_power:");
+		fprintf(nvme_out(), " active_power:");
 		print_ps_power_and_scale(ctrl->psd[i].active_power,
 					 POWER_SCALE(ctrl->psd[i].active_work_scale));
-		printf("\n");
+		fprintf(nvme_out(), "\n");
 
 	}
 }
@@ -1052,131 +1278,13 @@ void __show_nvme_id_ctrl(struct nvme_id_ctrl *ctrl, unsigned int mode, void (*ve
 {
 	int human = mode & HUMAN, vs = mode & VS;
 
-	printf("vid       : %#x\n", le16_to_cpu(ctrl->vid));
-	printf("ssvid     : %#x\n", le16_to_cpu(ctrl->ssvid));
-	printf("sn        : %-.*s\n", (int)sizeof(ctrl->sn), ctrl->sn);
-	printf("mn        : %-.*s\n", (int)sizeof(ctrl->mn), ctrl->mn);
-	printf("fr        : %-.*s\n", (int)sizeof(ctrl->fr), ctrl->fr);
-	printf("rab       : %d\n", ctrl->rab);
-	printf("ieee      : %02x%02x%02x\n",
-		ctrl->ieee[2], ctrl->ieee[1], ctrl->ieee[0]);
-	printf("cmic      : %#x\n", ctrl->cmic);
-	if (human)
-		show_nvme_id_ctrl_cmic(ctrl->cmic);
-	printf("mdts      : %d\n", ctrl->mdts);
-	printf("cntlid    : %#x\n", le16_to_cpu(ctrl->cntlid));
-	printf("ver       : %#x\n", le32_to_cpu(ctrl->ver));
-	printf("rtd3r     : %#x\n", le32_to_cpu(ctrl->rtd3r));
-	printf("rtd3e     : %#x\n", le32_to_cpu(ctrl->rtd3e));
-	printf("oaes      : %#x\n", le32_to_cpu(ctrl->oaes));
-	if (human)
-		show_nvme_id_ctrl_oaes(ctrl->oaes);
-	printf("ctratt    : %#x\n", le32_to_cpu(ctrl->ctratt));
-	if (human)
-		show_nvme_id_ctrl_ctratt(ctrl->ctratt);
-	printf("rrls      : %#x\n", le16_to_cpu(ctrl->rrls));
-
-	printf("crdt1     : %u\n", le16_to_cpu(ctrl->crdt1));
-	printf("crdt2     : %u\n", le16_to_cpu(ctrl->crdt2));
-	printf("crdt3     : %u\n", le16_to_cpu(ctrl->crdt3));
-
-	printf("oacs      : %#x\n", le16_to_cpu(ctrl->oacs));
-	if (human)
-		show_nvme_id_ctrl_oacs(ctrl->oacs);
-	printf("acl       : %d\n", ctrl->acl);
-	printf("aerl      : %d\n", ctrl->aerl);
-	printf("frmw      : %#x\n", ctrl->frmw);
-	if (human)
-		show_nvme_id_ctrl_frmw(ctrl->frmw);
-	printf("lpa       : %#x\n", ctrl->lpa);
-	if (human)
-		show_nvme_id_ctrl_lpa(ctrl->lpa);
-	printf("elpe      : %d\n", ctrl->elpe);
-	printf("npss      : %d\n", ctrl->npss);
-	printf("avscc     : %#x\n", ctrl->avscc);
-	if (human)
-		show_nvme_id_ctrl_avscc(ctrl->avscc);
-	printf("apsta     : %#x\n", ctrl->apsta);
-	if (human)
-		show_nvme_id_ctrl_apsta(ctrl->apsta);
-	printf("wctemp    : %d\n", le16_to_cpu(ctrl->wctemp));
-	printf("cctemp    : %d\n", le16_to_cpu(ctrl->cctemp));
-	printf("mtfa      : %d\n", le16_to_cpu(ctrl->mtfa));
-	printf("hmpre     : %d\n", le32_to_cpu(ctrl->hmpre));
-	printf("hmmin     : %d\n", le32_to_cpu(ctrl->hmmin));
-	printf("tnvmcap   : %.0Lf\n", int128_to_double(ctrl->tnvmcap));
-	printf("unvmcap   : %.0Lf\n", int128_to_double(ctrl->unvmcap));
-	printf("rpmbs     : %#x\n", le32_to_cpu(ctrl->rpmbs));
-	if (human)
-		show_nvme_id_ctrl_rpmbs(ctrl->rpmbs);
-	printf("edstt     : %d\n", le16_to_cpu(ctrl->edstt));
-	printf("dsto      : %d\n", ctrl->dsto);
-	printf("fwug      : %d\n", ctrl->fwug);
-	printf("kas       : %d\n", le16_to_cpu(ctrl->kas));
-	printf("hctma     : %#x\n", le16_to_cpu(ctrl->hctma));
-	if (human)
-		show_nvme_id_ctrl_hctma(ctrl->hctma);
-	printf("mntmt     : %d\n", le16_to_cpu(ctrl->mntmt));
-	printf("mxtmt     : %d\n", le16_to_cpu(ctrl->mxtmt));
-	printf("sanicap   : %#x\n", le32_to_cpu(ctrl->sanicap));
-	if (human)
-		show_nvme_id_ctrl_sanicap(ctrl->sanicap);
-	printf("hmminds   : %d\n", le32_to_cpu(ctrl->hmminds));
-	printf("hmmaxd    : %d\n", le16_to_cpu(ctrl->hmmaxd));
-	printf("nsetidmax : %d\n", le16_to_cpu(ctrl->nsetidmax));
-	printf("anatt     : %d\n", ctrl->anatt);
-	printf("anacap    : %d\n", ctrl->anacap);
-	if (human)
-		show_nvme_id_ctrl_anacap(ctrl->anacap);
-	printf("anagrpmax : %d\n", ctrl->anagrpmax);
-	printf("nanagrpid : %d\n", le32_to_cpu(ctrl->nanagrpid));
-	printf("sqes      : %#x\n", ctrl->sqes);
-	if (human)
-		show_nvme_id_ctrl_sqes(ctrl->sqes);
-	printf("cqes      : %#x\n", ctrl->cqes);
-	if (human)
-		show_nvme_id_ctrl_cqes(ctrl->cqes);
-	printf("maxcmd    : %d\n", le16_to_cpu(ctrl->maxcmd));
-	printf("nn        : %d\n", le32_to_cpu(ctrl->nn));
-	printf("oncs      : %#x\n", le16_to_cpu(ctrl->oncs));
-	if (human)
-		show_nvme_id_ctrl_oncs(ctrl->oncs);
-	printf("fuses     : %#x\n", le16_to_cpu(ctrl->fuses));
-	if (human)
-		show_nvme_id_ctrl_fuses(ctrl->fuses);
-	printf("fna       : %#x\n", ctrl->fna);
-	if (human)
-		show_nvme_id_ctrl_fna(ctrl->fna);
-	printf("vwc       : %#x\n", ctrl->vwc);
-	if (human)
-		show_nvme_id_ctrl_vwc(ctrl->vwc);
-	printf("awun      : %d\n", le16_to_cpu(ctrl->awun));
-	printf("awupf     : %d\n", le16_to_cpu(ctrl->awupf));
-	printf("nvscc     : %d\n", ctrl->nvscc);
-	if (human)
-		show_nvme_id_ctrl_nvscc(ctrl->nvscc);
-	printf("nwpc      : %d\n", ctrl->nwpc);
-	if (human)
-		show_nvme_id_ctrl_nwpc(ctrl->nwpc);
-	printf("acwu      : %d\n", le16_to_cpu(ctrl->acwu));
-	printf("sgls      : %#x\n", le32_to_cpu(ctrl->sgls));
-	if (human)
-		show_nvme_id_ctrl_sgls(ctrl->sgls);
-	printf("mnan      : %d\n", le32_to_cpu(ctrl->mnan));
-	printf("subnqn    : %-.*s\n", (int)sizeof(ctrl->subnqn), ctrl->subnqn);
-	printf("ioccsz    : %d\n", le32_to_cpu(ctrl->ioccsz));
-	printf("iorcsz    : %d\n", le32_to_cpu(ctrl->iorcsz));
-	printf("icdoff    : %d\n", le16_to_cpu(ctrl->icdoff));
-	printf("ctrattr   : %#x\n", ctrl->ctrattr);
-	if (human)
-		show_nvme_id_ctrl_ctrattr(ctrl->ctrattr);
-	printf("msdbd     : %d\n", ctrl->msdbd);
+	show_fields(ctrl, id_ctrl_fields, ARRAY_SIZE(id_ctrl_fields), 10, human);
 
 	show_nvme_id_ctrl_power(ctrl);
 	if (vendor_show)
 		vendor_show(ctrl->vs, NULL);
 	else if (vs) {
-		printf("vs[]:\n");
+		fprintf(nvme_out(), "vs[]:\n");
 		d(ctrl->vs, sizeof(ctrl->vs), 16, 1);
 	}
 }
@@ -1188,26 +1296,27 @@ void show_nvme_id_ctrl(struct nvme_id_ctrl *ctrl, unsigned int mode)
 
 void show_nvme_id_nvmset(struct nvme_id_nvmset *nvmset)
 {
+	char str[UINT128_STRLEN];
 	int i;
 
-	printf("nid     : %d\n", nvmset->nid);
-	printf(".................\n");
+	fprintf(nvme_out(), "nid     : %d\n", nvmset->nid);
+	fprintf(nvme_out(), ".................\n");
 	for (i = 0; i < nvmset->nid; i++) {
-		printf(" NVM Set Attribute Entry[%2d]\n", i);
-		printf(".................\n");
-		printf("nvmset_id               : %d\n",
+		fprintf(nvme_out(), " NVM Set Attribute Entry[%2d]\n", i);
+		fprintf(nvme_out(), ".................\n");
+		fprintf(nvme_out(), "nvmset_id               : %d\n",
 				le16_to_cpu(nvmset->ent[i].id));
-		printf("enduracne_group_id      : %d\n",
+		fprintf(nvme_out(), "enduracne_group_id      : %d\n",
 				le16_to_cpu(nvmset->ent[i].endurance_group_id));
-		printf("random_4k_read_typical  : %u\n",
+		fprintf(nvme_out(), "random_4k_read_typical  : %u\n",
 				le32_to_cpu(nvmset->ent[i].random_4k_read_typical));
-		printf("optimal_write_size      : %u\n",
+		fprintf(nvme_out(), "optimal_write_size      : %u\n",
 				le32_to_cpu(nvmset->ent[i].opt_write_size));
-		printf("total_nvmset_cap        : %.0Lf\n",
-				int128_to_double(nvmset->ent[i].total_nvmset_cap));
-		printf("unalloc_nvmset_cap      : %.0Lf\n",
-				int128_to_double(nvmset->ent[i].unalloc_nvmset_cap));
-		printf(".................\n");
+		fprintf(nvme_out(), "total_nvmset_cap        : %s\n",
+				le128_to_str(nvmset->ent[i].total_nvmset_cap, str, false));
+		fprintf(nvme_out(), "unalloc_nvmset_cap      : %s\n",
+				le128_to_str(nvmset->ent[i].unalloc_nvmset_cap, str, false));
+		fprintf(nvme_out(), ".................\n");
 	}
 }
 
@@ -1230,8 +1339,8 @@ void json_nvme_id_nvmset(struct nvme_id_nvmset *nvmset, const char *devname)
 		json_object_add_value_int(entry, "endurance_group_id", le16_to_cpu(nvmset->ent[i].endurance_group_id));
 		json_object_add_value_int(entry, "random_4k_read_typical", le32_to_cpu(nvmset->ent[i].random_4k_read_typical));
 		json_object_add_value_int(entry, "optimal_write_size", le32_to_cpu(nvmset->ent[i].opt_write_size));
-		json_object_add_value_float(entry, "total_nvmset_cap", int128_to_double(nvmset->ent[i].total_nvmset_cap));
-		json_object_add_value_float(entry, "unalloc_nvmset_cap", int128_to_double(nvmset->ent[i].unalloc_nvmset_cap));
+		json_object_add_value_uint128(entry, "total_nvmset_cap", uint128_from_le(nvmset->ent[i].total_nvmset_cap));
+		json_object_add_value_uint128(entry, "unalloc_nvmset_cap", uint128_from_le(nvmset->ent[i].unalloc_nvmset_cap));
 
 		json_array_add_value_object(entries, entry);
 	}
@@ -1239,7 +1348,6 @@ void json_nvme_id_nvmset(struct nvme_id_nvmset *nvmset, const char *devname)
 	json_object_add_value_array(root, "NVMSet", entries);
 
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -1252,24 +1360,24 @@ void show_nvme_list_secondary_ctrl(const struct nvme_secondary_controllers_list
 	static const char * const state_desc[] = { "Offline", "Online" };
 	const struct nvme_secondary_controller_entry *sc_entry = &sc_list->sc_entry[0];
 
-	printf("Identify Secondary Controller List:\n");
-	printf("   NUMID       : Number of Identifiers           : %d\n", num);
+	fprintf(nvme_out(), "Identify Secondary Controller List:\n");
+	fprintf(nvme_out(), "   NUMID       : Number of Identifiers           : %d\n", num);
 
 	for (i = 0; i < entries; i++) {
-		printf("   SCEntry[%-3d]:\n", i);
-		printf("................\n");
-		printf("     SCID      : Secondary Controller Identifier : 0x%.04x\n",
+		fprintf(nvme_out(), "   SCEntry[%-3d]:\n", i);
+		fprintf(nvme_out(), "................\n");
+		fprintf(nvme_out(), "     SCID      : Secondary Controller Identifier : 0x%.04x\n",
 				le16_to_cpu(sc_entry[i].scid));
-		printf("     PCID      : Primary Controller Identifier   : 0x%.04x\n",
+		fprintf(nvme_out(), "     PCID      : Primary Controller Identifier   : 0x%.04x\n",
 				le16_to_cpu(sc_entry[i].pcid));
-		printf("     SCS       : Secondary Controller State      : 0x%.04x (%s)\n",
+		fprintf(nvme_out(), "     SCS       : Secondary Controller State      : 0x%.04x (%s)\n",
 				sc_entry[i].scs,
 				state_desc[sc_entry[i].scs & 0x1]);
-		printf("     VFN       : Virtual Function Number         : 0x%.04x\n",
+		fprintf(nvme_out(), "     VFN       : Virtual Function Number         : 0x%.04x\n",
 				le16_to_cpu(sc_entry[i].vfn));
-		printf("     NVQ       : Num VQ Flex Resources Assigned  : 0x%.04x\n",
+		fprintf(nvme_out(), "     NVQ       : Num VQ Flex Resources Assigned  : 0x%.04x\n",
 				le16_to_cpu(sc_entry[i].nvq));
-		printf("     NVI       : Num VI Flex Resources Assigned  : 0x%.04x\n",
+		fprintf(nvme_out(), "     NVI       : Num VI Flex Resources Assigned  : 0x%.04x\n",
 				le16_to_cpu(sc_entry[i].nvi));
 	}
 }
@@ -1303,7 +1411,6 @@ void json_nvme_list_secondary_ctrl(const struct nvme_secondary_controllers_list
 	json_object_add_value_array(root, "secondary-controllers", entries);
 
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -1311,17 +1418,17 @@ void show_nvme_id_ns_granularity_list(const struct nvme_id_ns_granularity_list *
 {
 	int i;
 
-	printf("Identify Namespace Granularity List:\n");
-	printf("   ATTR        : Namespace Granularity Attributes: 0x%x\n", glist->attributes);
-	printf("   NUMD        : Number of Descriptors           : %d\n", glist->num_descriptors);
+	fprintf(nvme_out(), "Identify Namespace Granularity List:\n");
+	fprintf(nvme_out(), "   ATTR        : Namespace Granularity Attributes: 0x%x\n", glist->attributes);
+	fprintf(nvme_out(), "   NUMD        : Number of Descriptors           : %d\n", glist->num_descriptors);
 
 	/* Number of Descriptors is a 0's based value */
 	for (i = 0; i <= glist->num_descriptors; i++) {
-		printf("\n     Entry[%2d] :\n", i);
-		printf("................\n");
-		printf("     NSG       : Namespace Size Granularity     : 0x%"PRIx64"\n",
+		fprintf(nvme_out(), "\n     Entry[%2d] :\n", i);
+		fprintf(nvme_out(), "................\n");
+		fprintf(nvme_out(), "     NSG       : Namespace Size Granularity     : 0x%"PRIx64"\n",
 				le64_to_cpu(glist->entry[i].namespace_size_granularity));
-		printf("     NCG       : Namespace Capacity Granularity : 0x%"PRIx64"\n",
+		fprintf(nvme_out(), "     NCG       : Namespace Capacity Granularity : 0x%"PRIx64"\n",
 				le64_to_cpu(glist->entry[i].namespace_capacity_granularity));
 	}
 }
@@ -1351,7 +1458,6 @@ void json_nvme_id_ns_granularity_list(const struct nvme_id_ns_granularity_list *
 	json_object_add_value_array(root, "namespace-granularity-list", entries);
 
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -1383,13 +1489,13 @@ void show_nvme_id_uuid_list(const struct nvme_id_uuid_list *uuid_list, unsigned
 				break;
 			}
 		}
-		printf(" Entry[%3d]\n", i);
-		printf(".................\n");
-		printf("association  : 0x%x %s\n", identifier_association, association);
-		printf("UUID         : %s", nvme_uuid_to_string(uuid));
+		fprintf(nvme_out(), " Entry[%3d]\n", i);
+		fprintf(nvme_out(), ".................\n");
+		fprintf(nvme_out(), "association  : 0x%x %s\n", identifier_association, association);
+		fprintf(nvme_out(), "UUID         : %s", nvme_uuid_to_string(uuid));
 		if (memcmp(uuid_list->entry[i].uuid, invalid_uuid, sizeof(zero_uuid)) == 0)
-			printf(" (Invalid UUID)");
-		printf("\n.................\n");
+			fprintf(nvme_out(), " (Invalid UUID)");
+		fprintf(nvme_out(), "\n.................\n");
 	}
 }
 
@@ -1414,7 +1520,6 @@ void json_nvme_id_uuid_list(struct nvme_id_uuid_list *uuid_list)
 	}
 	json_object_add_value_array(root, "UUID-list", entries);
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -1422,24 +1527,24 @@ void show_error_log(struct nvme_error_log_page *err_log, int entries, const char
 {
 	int i;
 
-	printf("Error Log Entries for device:%s entries:%d\n", devname,
+	fprintf(nvme_out(), "Error Log Entries for device:%s entries:%d\n", devname,
 								entries);
-	printf(".................\n");
+	fprintf(nvme_out(), ".................\n");
 	for (i = 0; i < entries; i++) {
-		printf(" Entry[%2d]   \n", i);
-		printf(".................\n");
-		printf("error_count  : %"PRIu64"\n", le64_to_cpu(err_log[i].error_count));
-		printf("sqid         : %d\n", err_log[i].sqid);
-		printf("cmdid        : %#x\n", err_log[i].cmdid);
-		printf("status_field : %#x(%s)\n", err_log[i].status_field,
+		fprintf(nvme_out(), " Entry[%2d]   \n", i);
+		fprintf(nvme_out(), ".................\n");
+		fprintf(nvme_out(), "error_count  : %"PRIu64"\n", le64_to_cpu(err_log[i].error_count));
+		fprintf(nvme_out(), "sqid         : %d\n", err_log[i].sqid);
+		fprintf(nvme_out(), "cmdid        : %#x\n", err_log[i].cmdid);
+		fprintf(nvme_out(), "status_field : %#x(%s)\n", err_log[i].status_field,
 			nvme_status_to_string(le16_to_cpu(err_log[i].status_field) >> 1));
-		printf("parm_err_loc : %#x\n", err_log[i].parm_error_location);
-		printf("lba          : %#"PRIx64"\n",le64_to_cpu(err_log[i].lba));
-		printf("nsid         : %#x\n", err_log[i].nsid);
-		printf("vs           : %d\n", err_log[i].vs);
-		printf("cs           : %#"PRIx64"\n",
+		fprintf(nvme_out(), "parm_err_loc : %#x\n", err_log[i].parm_error_location);
+		fprintf(nvme_out(), "lba          : %#"PRIx64"\n",le64_to_cpu(err_log[i].lba));
+		fprintf(nvme_out(), "nsid         : %#x\n", err_log[i].nsid);
+		fprintf(nvme_out(), "vs           : %d\n", err_log[i].vs);
+		fprintf(nvme_out(), "cs           : %#"PRIx64"\n",
 		       le64_to_cpu(err_log[i].cs));
-		printf(".................\n");
+		fprintf(nvme_out(), ".................\n");
 	}
 }
 
@@ -1449,11 +1554,11 @@ void show_nvme_resv_report(struct nvme_reservation_status *status, int bytes, __
 
 	regctl = status->regctl[0] | (status->regctl[1] << 8);
 
-	printf("\nNVME Reservation status:\n\n");
-	printf("gen       : %d\n", le32_to_cpu(status->gen));
-	printf("rtype     : %d\n", status->rtype);
-	printf("regctl    : %d\n", regctl);
-	printf("ptpls     : %d\n", status->ptpls);
+	fprintf(nvme_out(), "\nNVME Reservation status:\n\n");
+	fprintf(nvme_out(), "gen       : %d\n", le32_to_cpu(status->gen));
+	fprintf(nvme_out(), "rtype     : %d\n", status->rtype);
+	fprintf(nvme_out(), "regctl    : %d\n", regctl);
+	fprintf(nvme_out(), "ptpls     : %d\n", status->ptpls);
 
 	/* check Extended Data Structure bit */
 	if ((cdw11 & 0x1) == 0) {
@@ -1463,11 +1568,11 @@ void show_nvme_resv_report(struct nvme_reservation_status *status, int bytes, __
 			regctl = entries;
 
 		for (i = 0; i < regctl; i++) {
-			printf("regctl[%d] :\n", i);
-			printf("  cntlid  : %x\n", le16_to_cpu(status->regctl_ds[i].cntlid));
-			printf("  rcsts   : %x\n", status->regctl_ds[i].rcsts);
-			printf("  hostid  : %"PRIx64"\n", le64_to_cpu(status->regctl_ds[i].hostid));
-			printf("  rkey    : %"PRIx64"\n", le64_to_cpu(status->regctl_ds[i].rkey));
+			fprintf(nvme_out(), "regctl[%d] :\n", i);
+			fprintf(nvme_out(), "  cntlid  : %x\n", le16_to_cpu(status->regctl_ds[i].cntlid));
+			fprintf(nvme_out(), "  rcsts   : %x\n", status->regctl_ds[i].rcsts);
+			fprintf(nvme_out(), "  hostid  : %"PRIx64"\n", le64_to_cpu(status->regctl_ds[i].hostid));
+			fprintf(nvme_out(), "  rkey    : %"PRIx64"\n", le64_to_cpu(status->regctl_ds[i].rkey));
 		}
 	} else {
 		struct nvme_reservation_status_ext *ext_status = (struct nvme_reservation_status_ext *)status;
@@ -1477,17 +1582,17 @@ void show_nvme_resv_report(struct nvme_reservation_status *status, int bytes, __
 			regctl = entries;
 
 		for (i = 0; i < regctl; i++) {
-			printf("regctlext[%d] :\n", i);
-			printf("  cntlid     : %x\n", le16_to_cpu(ext_status->regctl_eds[i].cntlid));
-			printf("  rcsts      : %x\n", ext_status->regctl_eds[i].rcsts);
-			printf("  rkey       : %"PRIx64"\n", le64_to_cpu(ext_status->regctl_eds[i].rkey));
-			printf("  hostid     : ");
+			fprintf(nvme_out(), "regctlext[%d] :\n", i);
+			fprintf(nvme_out(), "  cntlid     : %x\n", le16_to_cpu(ext_status->regctl_eds[i].cntlid));
+			fprintf(nvme_out(), "  rcsts      : %x\n", ext_status->regctl_eds[i].rcsts);
+			fprintf(nvme_out(), "  rkey       : %"PRIx64"\n", le64_to_cpu(ext_status->regctl_eds[i].rkey));
+			fprintf(nvme_out(), "  hostid     : ");
 			for (j = 0; j < 16; j++)
-				printf("%x", ext_status->regctl_eds[i].hostid[j]);
-			printf("\n");
+				fprintf(nvme_out(), "%x", ext_status->regctl_eds[i].hostid[j]);
+			fprintf(nvme_out(), "\n");
 		}
 	}
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 }
 
 static const char *fw_to_string(__u64 fw)
@@ -1506,11 +1611,11 @@ void show_fw_log(struct nvme_firmware_log_page *fw_log, const char *devname)
 {
 	int i;
 
-	printf("Firmware Log for device:%s\n", devname);
-	printf("afi  : %#x\n", fw_log->afi);
+	fprintf(nvme_out(), "Firmware Log for device:%s\n", devname);
+	fprintf(nvme_out(), "afi  : %#x\n", fw_log->afi);
 	for (i = 0; i < 7; i++)
 		if (fw_log->frs[i])
-			printf("frs%d : %#016"PRIx64" (%s)\n", i + 1, (uint64_t)fw_log->frs[i],
+			fprintf(nvme_out(), "frs%d : %#016"PRIx64" (%s)\n", i + 1, (uint64_t)fw_log->frs[i],
 						fw_to_string(fw_log->frs[i]));
 }
 
@@ -1525,10 +1630,10 @@ void show_changed_ns_list_log(struct nvme_changed_ns_list_log *log, const char *
 			if (nsid == 0)
 				break;
 
-			printf("[%4u]:%#x\n", i, nsid);
+			fprintf(nvme_out(), "[%4u]:%#x\n", i, nsid);
 		}
 	} else
-		printf("more than %d ns changed\n", NVME_MAX_CHANGED_NAMESPACES);
+		fprintf(nvme_out(), "more than %d ns changed\n", NVME_MAX_CHANGED_NAMESPACES);
 }
 
 static void show_effects_log_human(__u32 effect)
@@ -1536,21 +1641,21 @@ static void show_effects_log_human(__u32 effect)
 	const char *set = "+";
 	const char *clr = "-";
 
-	printf("  CSUPP+");
-	printf("  LBCC%s", (effect & NVME_CMD_EFFECTS_LBCC) ? set : clr);
-	printf("  NCC%s", (effect & NVME_CMD_EFFECTS_NCC) ? set : clr);
-	printf("  NIC%s", (effect & NVME_CMD_EFFECTS_NIC) ? set : clr);
-	printf("  CCC%s", (effect & NVME_CMD_EFFECTS_CCC) ? set : clr);
-	printf("  USS%s", (effect & NVME_CMD_EFFECTS_UUID_SEL) ? set : clr);
+	fprintf(nvme_out(), "  CSUPP+");
+	fprintf(nvme_out(), "  LBCC%s", (effect & NVME_CMD_EFFECTS_LBCC) ? set : clr);
+	fprintf(nvme_out(), "  NCC%s", (effect & NVME_CMD_EFFECTS_NCC) ? set : clr);
+	fprintf(nvme_out(), "  NIC%s", (effect & NVME_CMD_EFFECTS_NIC) ? set : clr);
+	fprintf(nvme_out(), "  CCC%s", (effect & NVME_CMD_EFFECTS_CCC) ? set : clr);
+	fprintf(nvme_out(), "  USS%s", (effect & NVME_CMD_EFFECTS_UUID_SEL) ? set : clr);
 
 	if ((effect & NVME_CMD_EFFECTS_CSE_MASK) >> 16 == 0)
-		printf("  No command restriction\n");
+		fprintf(nvme_out(), "  No command restriction\n");
 	else if ((effect & NVME_CMD_EFFECTS_CSE_MASK) >> 16 == 1)
-		printf("  No other command for same namespace\n");
+		fprintf(nvme_out(), "  No other command for same namespace\n");
 	else if ((effect & NVME_CMD_EFFECTS_CSE_MASK) >> 16 == 2)
-		printf("  No other command for any namespace\n");
+		fprintf(nvme_out(), "  No other command for any namespace\n");
 	else
-		printf("  Reserved CSE\n");
+		fprintf(nvme_out(), "  Reserved CSE\n");
 }
 
 static const char *nvme_cmd_to_string(int admin, __u8 opcode)
@@ -1609,28 +1714,28 @@ void show_effects_log(struct nvme_effects_log_page *effects, unsigned int flags)
 	int human = flags & HUMAN;
 	__u32 effect;
 
-	printf("Admin Command Set\n");
+	fprintf(nvme_out(), "Admin Command Set\n");
 	for (i = 0; i < 256; i++) {
 		effect = le32_to_cpu(effects->acs[i]);
 		if (effect & NVME_CMD_EFFECTS_CSUPP) {
-			printf("ACS%-6d[%-32s] %08x", i,
+			fprintf(nvme_out(), "ACS%-6d[%-32s] %08x", i,
 					nvme_cmd_to_string(1, i), effect);
 			if (human)
 				show_effects_log_human(effect);
 			else
-				printf("\n");
+				fprintf(nvme_out(), "\n");
 		}
 	}
-	printf("\nNVM Command Set\n");
+	fprintf(nvme_out(), "\nNVM Command Set\n");
 	for (i = 0; i < 256; i++) {
 		effect = le32_to_cpu(effects->iocs[i]);
 		if (effect & NVME_CMD_EFFECTS_CSUPP) {
-			printf("IOCS%-5d[%-32s] %08x", i,
+			fprintf(nvme_out(), "IOCS%-5d[%-32s] %08x", i,
 					nvme_cmd_to_string(0, i), effect);
 			if (human)
 				show_effects_log_human(effect);
 			else
-				printf("\n");
+				fprintf(nvme_out(), "\n");
 		}
 	}
 }
@@ -1650,66 +1755,26 @@ uint64_t int48_to_long(__u8 *data)
 void show_endurance_log(struct nvme_endurance_group_log *endurance_group,
 			__u16 group_id, const char *devname)
 {
-	printf("Endurance Group Log for NVME device:%s Group ID:%x\n", devname, group_id);
-	printf("avl_spare_threshold   : %u\n", endurance_group->avl_spare_threshold);
-	printf("percent_used          : %u%%\n", endurance_group->percent_used);
-	printf("endurance_estimate    : %'.0Lf\n",
-		int128_to_double(endurance_group->endurance_estimate));
-	printf("data_units_read       : %'.0Lf\n",
-		int128_to_double(endurance_group->data_units_read));
-	printf("data_units_written    : %'.0Lf\n",
-		int128_to_double(endurance_group->data_units_written));
-	printf("media_units_written   : %'.0Lf\n",
-		int128_to_double(endurance_group->media_units_written));
+	char str[UINT128_STRLEN];
+
+	fprintf(nvme_out(), "Endurance Group Log for NVME device:%s Group ID:%x\n", devname, group_id);
+	fprintf(nvme_out(), "avl_spare_threshold   : %u\n", endurance_group->avl_spare_threshold);
+	fprintf(nvme_out(), "percent_used          : %u%%\n", endurance_group->percent_used);
+	fprintf(nvme_out(), "endurance_estimate    : %s\n",
+		le128_to_str(endurance_group->endurance_estimate, str, true));
+	fprintf(nvme_out(), "data_units_read       : %s\n",
+		le128_to_str(endurance_group->data_units_read, str, true));
+	fprintf(nvme_out(), "data_units_written    : %s\n",
+		le128_to_str(endurance_group->data_units_written, str, true));
+	fprintf(nvme_out(), "media_units_written   : %s\n",
+		le128_to_str(endurance_group->media_units_written, str, true));
 }
 
 void show_smart_log(struct nvme_smart_log *smart, unsigned int nsid, const char *devname)
 {
-	/* convert temperature from Kelvin to Celsius */
-	int temperature = ((smart->temperature[1] << 8) |
-		smart->temperature[0]) - 273;
-	int i;
-
-	printf("Smart Log for NVME device:%s namespace-id:%x\n", devname, nsid);
-	printf("critical_warning                    : %#x\n", smart->critical_warning);
-	printf("temperature                         : %d C\n", temperature);
-	printf("available_spare                     : %u%%\n", smart->avail_spare);
-	printf("available_spare_threshold           : %u%%\n", smart->spare_thresh);
-	printf("percentage_used                     : %u%%\n", smart->percent_used);
-	printf("data_units_read                     : %'.0Lf\n",
-		int128_to_double(smart->data_units_read));
-	printf("data_units_written                  : %'.0Lf\n",
-		int128_to_double(smart->data_units_written));
-	printf("host_read_commands                  : %'.0Lf\n",
-		int128_to_double(smart->host_reads));
-	printf("host_write_commands                 : %'.0Lf\n",
-		int128_to_double(smart->host_writes));
-	printf("controller_busy_time                : %'.0Lf\n",
-		int128_to_double(smart->ctrl_busy_time));
-	printf("power_cycles                        : %'.0Lf\n",
-		int128_to_double(smart->power_cycles));
-	printf("power_on_hours                      : %'.0Lf\n",
-		int128_to_double(smart->power_on_hours));
-	printf("unsafe_shutdowns                    : %'.0Lf\n",
-		int128_to_double(smart->unsafe_shutdowns));
-	printf("media_errors                        : %'.0Lf\n",
-		int128_to_double(smart->media_errors));
-	printf("num_err_log_entries                 : %'.0Lf\n",
-		int128_to_double(smart->num_err_log_entries));
-	printf("Warning Temperature Time            : %u\n", le32_to_cpu(smart->warning_temp_time));
-	printf("Critical Composite Temperature Time : %u\n", le32_to_cpu(smart->critical_comp_time));
-	for (i = 0; i < 8; i++) {
-		__s32 temp = le16_to_cpu(smart->temp_sensor[i]);
-
-		if (temp == 0)
-			continue;
-		printf("Temperature Sensor %d                : %d C\n", i + 1,
-			temp - 273);
-	}
-	printf("Thermal Management T1 Trans Count   : %u\n", le32_to_cpu(smart->thm_temp1_trans_count));
-	printf("Thermal Management T2 Trans Count   : %u\n", le32_to_cpu(smart->thm_temp2_trans_count));
-	printf("Thermal Management T1 Total Time    : %u\n", le32_to_cpu(smart->thm_temp1_total_time));
-	printf("Thermal Management T2 Total Time    : %u\n", le32_to_cpu(smart->thm_temp2_total_time));
+	fprintf(nvme_out(), "Smart Log for NVME device:%s namespace-id:%x\n", devname, nsid);
+	show_fields(smart, smart_log_fields, ARRAY_SIZE(smart_log_fields), 36,
+		    false);
 }
 
 void show_ana_log(struct nvme_ana_rsp_hdr *ana_log, const char *devname)
@@ -1723,13 +1788,13 @@ void show_ana_log(struct nvme_ana_rsp_hdr *ana_log, const char *devname)
 	int i;
 	int j;
 
-	printf("Asynchronous Namespace Access Log for NVMe device: %s\n",
+	fprintf(nvme_out(), "Asynchronous Namespace Access Log for NVMe device: %s\n",
 			devname);
-	printf("ANA LOG HEADER :-\n");
-	printf("chgcnt	:	%"PRIu64"\n",
+	fprintf(nvme_out(), "ANA LOG HEADER :-\n");
+	fprintf(nvme_out(), "chgcnt	:	%"PRIu64"\n",
 			le64_to_cpu(hdr->chgcnt));
-	printf("ngrps	:	%u\n", le16_to_cpu(hdr->ngrps));
-	printf("ANA Log Desc :-\n");
+	fprintf(nvme_out(), "ngrps	:	%u\n", le16_to_cpu(hdr->ngrps));
+	fprintf(nvme_out(), "ANA Log Desc :-\n");
 
 	for (i = 0; i < le16_to_cpu(ana_log->ngrps); i++) {
 		desc = base + offset;
@@ -1737,16 +1802,16 @@ void show_ana_log(struct nvme_ana_rsp_hdr *ana_log, const char *devname)
 		nsid_buf_size = nr_nsids * sizeof(__le32);
 
 		offset += sizeof(*desc);
-		printf("grpid	:	%u\n", le32_to_cpu(desc->grpid));
-		printf("nnsids	:	%u\n", le32_to_cpu(desc->nnsids));
-		printf("chgcnt	:	%"PRIu64"\n",
+		fprintf(nvme_out(), "grpid	:	%u\n", le32_to_cpu(desc->grpid));
+		fprintf(nvme_out(), "nnsids	:	%u\n", le32_to_cpu(desc->nnsids));
+		fprintf(nvme_out(), "chgcnt	:	%"PRIu64"\n",
 		       le64_to_cpu(desc->chgcnt));
-		printf("state	:	%s\n",
+		fprintf(nvme_out(), "state	:	%s\n",
 				nvme_ana_state_to_string(desc->state));
 		for (j = 0; j < le32_to_cpu(desc->nnsids); j++)
-			printf("	nsid	:	%u\n",
+			fprintf(nvme_out(), "	nsid	:	%u\n",
 					le32_to_cpu(desc->nsids[j]));
-		printf("\n");
+		fprintf(nvme_out(), "\n");
 		offset += nsid_buf_size;
 	}
 }
@@ -1771,16 +1836,16 @@ void show_self_test_log(struct nvme_self_test_log *self_test, const char *devnam
 		"Reserved"
 	};
 
-	printf("Device Self Test Log for NVME device:%s\n", devname);
-	printf("Current operation : %#x\n", self_test->crnt_dev_selftest_oprn);
-	printf("Current Completion : %u%%\n", self_test->crnt_dev_selftest_compln);
+	fprintf(nvme_out(), "Device Self Test Log for NVME device:%s\n", devname);
+	fprintf(nvme_out(), "Current operation : %#x\n", self_test->crnt_dev_selftest_oprn);
+	fprintf(nvme_out(), "Current Completion : %u%%\n", self_test->crnt_dev_selftest_compln);
 	for (i = 0; i < NVME_SELF_TEST_REPORTS; i++) {
 		temp = self_test->result[i].device_self_test_status & 0xf;
 		if (temp == 0xf)
 			continue;
 
-		printf("Result[%d]:\n", i);
-		printf("  Test Result                  : %#x %s\n", temp,
+		fprintf(nvme_out(), "Result[%d]:\n", i);
+		fprintf(nvme_out(), "  Test Result                  : %#x %s\n", temp,
 			test_res[temp > 10 ? 10 : temp]);
 
 		temp = self_test->result[i].device_self_test_status >> 4;
@@ -1798,30 +1863,30 @@ void show_self_test_log(struct nvme_self_test_log *self_test, const char *devnam
 			test_code_res = "Reserved";
 			break;
 		}
-		printf("  Test Code                    : %#x %s\n", temp,
+		fprintf(nvme_out(), "  Test Code                    : %#x %s\n", temp,
 			test_code_res);
 		if (temp == 7)
-			printf("  Segment number               : %#x\n",
+			fprintf(nvme_out(), "  Segment number               : %#x\n",
 				self_test->result[i].segment_num);
 
 		temp = self_test->result[i].valid_diagnostic_info;
-		printf("  Valid Diagnostic Information : %#x\n", temp);
-		printf("  Power on hours (POH)         : %#"PRIx64"\n",
+		fprintf(nvme_out(), "  Valid Diagnostic Information : %#x\n", temp);
+		fprintf(nvme_out(), "  Power on hours (POH)         : %#"PRIx64"\n",
 			le64_to_cpu(self_test->result[i].power_on_hours));
 
 		if (temp & NVME_SELF_TEST_VALID_NSID)
-			printf("  Namespace Identifier         : %#x\n",
+			fprintf(nvme_out(), "  Namespace Identifier         : %#x\n",
 				le32_to_cpu(self_test->result[i].nsid));
 		if (temp & NVME_SELF_TEST_VALID_FLBA)
-			printf("  Failing LBA                  : %#"PRIx64"\n",
+			fprintf(nvme_out(), "  Failing LBA                  : %#"PRIx64"\n",
 				le64_to_cpu(self_test->result[i].failing_lba));
 		if (temp & NVME_SELF_TEST_VALID_SCT)
-			printf("  Status Code Type             : %#x\n",
+			fprintf(nvme_out(), "  Status Code Type             : %#x\n",
 				self_test->result[i].status_code_type);
 		if (temp & NVME_SELF_TEST_VALID_SC)
-			printf("  Status Code                  : %#x\n",
+			fprintf(nvme_out(), "  Status Code                  : %#x\n",
 				self_test->result[i].status_code);
-		printf("  Vendor Specific                      : %x %x\n",
+		fprintf(nvme_out(), "  Vendor Specific                      : %x %x\n",
 			self_test->result[i].vendor_specific[0],
 			self_test->result[i].vendor_specific[0]);
 	}
@@ -1832,7 +1897,7 @@ static void show_sanitize_log_sprog(__u32 sprog)
 	double percent;
 
 	percent = (((double)sprog * 100) / 0x10000);
-	printf("\t(%f%%)\n", percent);
+	fprintf(nvme_out(), "\t(%f%%)\n", percent);
 }
 
 static const char *get_sanitize_log_sstat_status_str(__u16 status)
@@ -1866,26 +1931,26 @@ static void show_sanitize_log_sstat(__u16 status)
 {
 	const char *str = get_sanitize_log_sstat_status_str(status);
 
-	printf("\t[2:0]\t%s\n", str);
+	fprintf(nvme_out(), "\t[2:0]\t%s\n", str);
 	str = "Number of completed passes if most recent operation was overwrite";
-	printf("\t[7:3]\t%s:\t%u\n", str, (status & NVME_SANITIZE_LOG_NUM_CMPLTED_PASS_MASK) >> 3);
+	fprintf(nvme_out(), "\t[7:3]\t%s:\t%u\n", str, (status & NVME_SANITIZE_LOG_NUM_CMPLTED_PASS_MASK) >> 3);
 
-	printf("\t  [8]\t");
+	fprintf(nvme_out(), "\t  [8]\t");
 	if (status & NVME_SANITIZE_LOG_GLOBAL_DATA_ERASED)
 		str = "Global Data Erased set: no NS LB in the NVM subsystem has been written to "\
 		      "and no PMR in the NVM subsystem has been enabled";
 	else
 		str = "Global Data Erased cleared: a NS LB in the NVM subsystem has been written to "\
 		      "or  a PMR in the NVM subsystem has been enabled";
-	printf("%s\n", str);
+	fprintf(nvme_out(), "%s\n", str);
 }
 
 static void show_estimate_sanitize_time(const char *text, uint32_t value)
 {
 	if (value == 0xffffffff)
-		printf("%s:  0xffffffff (No time period reported)\n", text);
+		fprintf(nvme_out(), "%s:  0xffffffff (No time period reported)\n", text);
 	else
-		printf("%s:  %u\n", text, value);
+		fprintf(nvme_out(), "%s:  %u\n", text, value);
 }
 
 void show_sanitize_log(struct nvme_sanitize_log_page *sanitize, unsigned int mode, const char *devname)
@@ -1893,18 +1958,18 @@ void show_sanitize_log(struct nvme_sanitize_log_page *sanitize, unsigned int mod
 	int human = mode & HUMAN;
 	__u16 status = le16_to_cpu(sanitize->status) & NVME_SANITIZE_LOG_STATUS_MASK;
 
-	printf("Sanitize Progress                      (SPROG) :  %u",
+	fprintf(nvme_out(), "Sanitize Progress                      (SPROG) :  %u",
 	       le16_to_cpu(sanitize->progress));
 	if (human && status == NVME_SANITIZE_LOG_IN_PROGESS)
 		show_sanitize_log_sprog(le16_to_cpu(sanitize->progress));
 	else
-		printf("\n");
+		fprintf(nvme_out(), "\n");
 
-	printf("Sanitize Status                        (SSTAT) :  %#x\n", le16_to_cpu(sanitize->status));
+	fprintf(nvme_out(), "Sanitize Status                        (SSTAT) :  %#x\n", le16_to_cpu(sanitize->status));
 	if (human)
 		show_sanitize_log_sstat(le16_to_cpu(sanitize->status));
 
-	printf("Sanitize Command Dword 10 Information (SCDW10) :  %#x\n", le32_to_cpu(sanitize->cdw10_info));
+	fprintf(nvme_out(), "Sanitize Command Dword 10 Information (SCDW10) :  %#x\n", le32_to_cpu(sanitize->cdw10_info));
 	show_estimate_sanitize_time("Estimated Time For Overwrite                   ", le32_to_cpu(sanitize->est_ovrwrt_time));
 	show_estimate_sanitize_time("Estimated Time For Block Erase                 ", le32_to_cpu(sanitize->est_blk_erase_time));
 	show_estimate_sanitize_time("Estimated Time For Crypto Erase                ", le32_to_cpu(sanitize->est_crypto_erase_time));
@@ -1980,11 +2045,11 @@ const char *nvme_select_to_string(int sel)
 void nvme_show_select_result(__u32 result)
 {
 	if (result & 0x1)
-		printf("  Feature is saveable\n");
+		fprintf(nvme_out(), "  Feature is saveable\n");
 	if (result & 0x2)
-		printf("  Feature is per-namespace\n");
+		fprintf(nvme_out(), "  Feature is per-namespace\n");
 	if (result & 0x4)
-		printf("  Feature is changeable\n");
+		fprintf(nvme_out(), "  Feature is changeable\n");
 }
 
 const char *nvme_status_to_string(__u32 status)
@@ -2078,15 +2143,15 @@ void show_lba_range(struct nvme_lba_range_type *lbrt, int nr_ranges)
 	int i, j;
 
 	for (i = 0; i <= nr_ranges; i++) {
-		printf("\ttype       : %#x - %s\n", lbrt[i].type, nvme_feature_lba_type_to_string(lbrt[i].type));
-		printf("\tattributes : %#x - %s, %s\n", lbrt[i].attributes, (lbrt[i].attributes & 0x0001) ? "LBA range may be overwritten":"LBA range should not be overwritten",
+		fprintf(nvme_out(), "\ttype       : %#x - %s\n", lbrt[i].type, nvme_feature_lba_type_to_string(lbrt[i].type));
+		fprintf(nvme_out(), "\tattributes : %#x - %s, %s\n", lbrt[i].attributes, (lbrt[i].attributes & 0x0001) ? "LBA range may be overwritten":"LBA range should not be overwritten",
 			((lbrt[i].attributes & 0x0002) >> 1) ? "LBA range should be hidden from the OS/EFI/BIOS":"LBA range should be visible from the OS/EFI/BIOS");
-		printf("\tslba       : %#"PRIx64"\n", (uint64_t)(lbrt[i].slba));
-		printf("\tnlb        : %#"PRIx64"\n", (uint64_t)(lbrt[i].nlb));
-		printf("\tguid       : ");
+		fprintf(nvme_out(), "\tslba       : %#"PRIx64"\n", (uint64_t)(lbrt[i].slba));
+		fprintf(nvme_out(), "\tnlb        : %#"PRIx64"\n", (uint64_t)(lbrt[i].nlb));
+		fprintf(nvme_out(), "\tguid       : ");
 		for (j = 0; j < 16; j++)
-			printf("%02x", lbrt[i].guid[j]);
-		printf("\n");
+			fprintf(nvme_out(), "%02x", lbrt[i].guid[j]);
+		fprintf(nvme_out(), "\n");
 	}
 }
 
@@ -2131,14 +2196,14 @@ static void show_auto_pst(struct nvme_auto_pst *apst)
 {
 	int i;
 
-	printf( "\tAuto PST Entries");
-	printf("\t.................\n");
+	fprintf(nvme_out(), "\tAuto PST Entries");
+	fprintf(nvme_out(), "\t.................\n");
 	for (i = 0; i < 32; i++) {
-		printf("\tEntry[%2d]   \n", i);
-		printf("\t.................\n");
-		printf("\tIdle Time Prior to Transition (ITPT): %u ms\n", (apst[i].data & 0xffffff00) >> 8);
-		printf("\tIdle Transition Power State   (ITPS): %u\n", (apst[i].data & 0x000000f8) >> 3);
-		printf("\t.................\n");
+		fprintf(nvme_out(), "\tEntry[%2d]   \n", i);
+		fprintf(nvme_out(), "\t.................\n");
+		fprintf(nvme_out(), "\tIdle Time Prior to Transition (ITPT): %u ms\n", (apst[i].data & 0xffffff00) >> 8);
+		fprintf(nvme_out(), "\tIdle Transition Power State   (ITPS): %u\n", (apst[i].data & 0x000000f8) >> 3);
+		fprintf(nvme_out(), "\t.................\n");
 	}
 }
 
@@ -2151,21 +2216,21 @@ static void show_timestamp(struct nvme_timestamp *ts)
 	tm = localtime(&timestamp);
 	strftime(buffer, sizeof(buffer), "%c %Z", tm);
 
-	printf("\tThe timestamp is : %"PRIu64" (%s)\n", int48_to_long(ts->timestamp), buffer);
-	printf("\t%s\n", (ts->attr & 2) ? "The Timestamp field was initialized with a "\
+	fprintf(nvme_out(), "\tThe timestamp is : %"PRIu64" (%s)\n", int48_to_long(ts->timestamp), buffer);
+	fprintf(nvme_out(), "\t%s\n", (ts->attr & 2) ? "The Timestamp field was initialized with a "\
 			"Timestamp value using a Set Features command." : "The Timestamp field was initialized "\
 			"to ‘0’ by a Controller Level Reset.");
-	printf("\t%s\n", (ts->attr & 1) ? "The controller may have stopped counting during vendor specific "\
+	fprintf(nvme_out(), "\t%s\n", (ts->attr & 1) ? "The controller may have stopped counting during vendor specific "\
 			"intervals after the Timestamp value was initialized" : "The controller counted time in milliseconds "\
 			"continuously since the Timestamp value was initialized.");
 }
 
 static void show_host_mem_buffer(struct nvme_host_mem_buffer *hmb)
 {
-	printf("\tHost Memory Descriptor List Entry Count (HMDLEC): %u\n", hmb->hmdlec);
-	printf("\tHost Memory Descriptor List Address     (HMDLAU): 0x%x\n", hmb->hmdlau);
-	printf("\tHost Memory Descriptor List Address     (HMDLAL): 0x%x\n", hmb->hmdlal);
-	printf("\tHost Memory Buffer Size                  (HSIZE): %u\n", hmb->hsize);
+	fprintf(nvme_out(), "\tHost Memory Descriptor List Entry Count (HMDLEC): %u\n", hmb->hmdlec);
+	fprintf(nvme_out(), "\tHost Memory Descriptor List Address     (HMDLAU): 0x%x\n", hmb->hmdlau);
+	fprintf(nvme_out(), "\tHost Memory Descriptor List Address     (HMDLAL): 0x%x\n", hmb->hmdlal);
+	fprintf(nvme_out(), "\tHost Memory Buffer Size                  (HSIZE): %u\n", hmb->hsize);
 }
 
 void nvme_directive_show_fields(__u8 dtype, __u8 doper, unsigned int result, unsigned char *buf)
@@ -2176,12 +2241,12 @@ void nvme_directive_show_fields(__u8 dtype, __u8 doper, unsigned int result, uns
         case NVME_DIR_IDENTIFY:
                 switch (doper) {
                 case NVME_DIR_RCV_ID_OP_PARAM:
-                        printf("\tDirective support \n");
-                        printf("\t\tIdentify Directive  : %s\n", (*field & 0x1) ? "supported":"not supported");
-                        printf("\t\tStream Directive    : %s\n", (*field & 0x2) ? "supported":"not supported");
-                        printf("\tDirective status \n");
-                        printf("\t\tIdentify Directive  : %s\n", (*(field + 32) & 0x1) ? "enabled" : "disabled");
-                        printf("\t\tStream Directive    : %s\n", (*(field + 32) & 0x2) ? "enabled" : "disabled");
+                        fprintf(nvme_out(), "\tDirective support \n");
+                        fprintf(nvme_out(), "\t\tIdentify Directive  : %s\n", (*field & 0x1) ? "supported":"not supported");
+                        fprintf(nvme_out(), "\t\tStream Directive    : %s\n", (*field & 0x2) ? "supported":"not supported");
+                        fprintf(nvme_out(), "\tDirective status \n");
+                        fprintf(nvme_out(), "\t\tIdentify Directive  : %s\n", (*(field + 32) & 0x1) ? "enabled" : "disabled");
+                        fprintf(nvme_out(), "\t\tStream Directive    : %s\n", (*(field + 32) & 0x2) ? "enabled" : "disabled");
                         break;
                 default:
                         fprintf(stderr, "invalid directive operations for Identify Directives\n");
@@ -2190,23 +2255,23 @@ void nvme_directive_show_fields(__u8 dtype, __u8 doper, unsigned int result, uns
         case NVME_DIR_STREAMS:
                 switch (doper) {
                 case NVME_DIR_RCV_ST_OP_PARAM:
-                        printf("\tMax Streams Limit                          (MSL): %u\n", *(__u16 *) field);
-                        printf("\tNVM Subsystem Streams Available           (NSSA): %u\n", *(__u16 *) (field + 2));
-                        printf("\tNVM Subsystem Streams Open                (NSSO): %u\n", *(__u16 *) (field + 4));
-                        printf("\tStream Write Size (in unit of LB size)     (SWS): %u\n", *(__u32 *) (field + 16));
-                        printf("\tStream Granularity Size (in unit of SWS)   (SGS): %u\n", *(__u16 *) (field + 20));
-                        printf("\tNamespece Streams Allocated                (NSA): %u\n", *(__u16 *) (field + 22));
-                        printf("\tNamespace Streams Open                     (NSO): %u\n", *(__u16 *) (field + 24));
+                        fprintf(nvme_out(), "\tMax Streams Limit                          (MSL): %u\n", *(__u16 *) field);
+                        fprintf(nvme_out(), "\tNVM Subsystem Streams Available           (NSSA): %u\n", *(__u16 *) (field + 2));
+                        fprintf(nvme_out(), "\tNVM Subsystem Streams Open                (NSSO): %u\n", *(__u16 *) (field + 4));
+                        fprintf(nvme_out(), "\tStream Write Size (in unit of LB size)     (SWS): %u\n", *(__u32 *) (field + 16));
+                        fprintf(nvme_out(), "\tStream Granularity Size (in unit of SWS)   (SGS): %u\n", *(__u16 *) (field + 20));
+                        fprintf(nvme_out(), "\tNamespece Streams Allocated                (NSA): %u\n", *(__u16 *) (field + 22));
+                        fprintf(nvme_out(), "\tNamespace Streams Open                     (NSO): %u\n", *(__u16 *) (field + 24));
                         break;
                 case NVME_DIR_RCV_ST_OP_STATUS:
                         count = *(__u16 *) field;
-                        printf("\tOpen Stream Count  : %u\n", *(__u16 *) field);
+                        fprintf(nvme_out(), "\tOpen Stream Count  : %u\n", *(__u16 *) field);
                         for ( i = 0; i < count; i++ ) {
-                                printf("\tStream Identifier %.6u : %u\n", i + 1, *(__u16 *) (field + ((i + 1) * 2)));
+                                fprintf(nvme_out(), "\tStream Identifier %.6u : %u\n", i + 1, *(__u16 *) (field + ((i + 1) * 2)));
                         }
                         break;
                 case NVME_DIR_RCV_ST_OP_RESOURCE:
-                        printf("\tNamespace Streams Allocated (NSA): %u\n", result & 0xffff);
+                        fprintf(nvme_out(), "\tNamespace Streams Allocated (NSA): %u\n", result & 0xffff);
                         break;
                 default:
                         fprintf(stderr, "invalid directive operations for Streams Directives\n");
@@ -2233,10 +2298,10 @@ static const char *nvme_plm_window(__u32 plm)
 
 static void show_plm_config(struct nvme_plm_config *plmcfg)
 {
-	printf("\tEnable Event          :%04x\n", le16_to_cpu(plmcfg->enable_event));
-	printf("\tDTWIN Reads Threshold :%"PRIu64"\n", le64_to_cpu(plmcfg->dtwin_reads_thresh));
-	printf("\tDTWIN Writes Threshold:%"PRIu64"\n", le64_to_cpu(plmcfg->dtwin_writes_thresh));
-	printf("\tDTWIN Time Threshold  :%"PRIu64"\n", le64_to_cpu(plmcfg->dtwin_time_thresh));
+	fprintf(nvme_out(), "\tEnable Event          :%04x\n", le16_to_cpu(plmcfg->enable_event));
+	fprintf(nvme_out(), "\tDTWIN Reads Threshold :%"PRIu64"\n", le64_to_cpu(plmcfg->dtwin_reads_thresh));
+	fprintf(nvme_out(), "\tDTWIN Writes Threshold:%"PRIu64"\n", le64_to_cpu(plmcfg->dtwin_writes_thresh));
+	fprintf(nvme_out(), "\tDTWIN Time Threshold  :%"PRIu64"\n", le64_to_cpu(plmcfg->dtwin_time_thresh));
 }
 
 void nvme_feature_show_fields(__u32 fid, unsigned int result, unsigned char *buf)
@@ -2246,111 +2311,111 @@ void nvme_feature_show_fields(__u32 fid, unsigned int result, unsigned char *buf
 
 	switch (fid) {
 	case NVME_FEAT_ARBITRATION:
-		printf("\tHigh Priority Weight   (HPW): %u\n", ((result & 0xff000000) >> 24) + 1);
-		printf("\tMedium Priority Weight (MPW): %u\n", ((result & 0x00ff0000) >> 16) + 1);
-		printf("\tLow Priority Weight    (LPW): %u\n", ((result & 0x0000ff00) >> 8) + 1);
-		printf("\tArbitration Burst       (AB): ");
+		fprintf(nvme_out(), "\tHigh Priority Weight   (HPW): %u\n", ((result & 0xff000000) >> 24) + 1);
+		fprintf(nvme_out(), "\tMedium Priority Weight (MPW): %u\n", ((result & 0x00ff0000) >> 16) + 1);
+		fprintf(nvme_out(), "\tLow Priority Weight    (LPW): %u\n", ((result & 0x0000ff00) >> 8) + 1);
+		fprintf(nvme_out(), "\tArbitration Burst       (AB): ");
 		if ((result & 0x00000007) == 7)
-			printf("No limit\n");
+			fprintf(nvme_out(), "No limit\n");
 		else
-			printf("%u\n",  1 << (result & 0x00000007));
+			fprintf(nvme_out(), "%u\n",  1 << (result & 0x00000007));
 		break;
 	case NVME_FEAT_POWER_MGMT:
 		field = (result & 0x000000E0) >> 5;
-		printf("\tWorkload Hint (WH): %u - %s\n",  field, nvme_feature_wl_hints_to_string(field));
-		printf("\tPower State   (PS): %u\n",  result & 0x0000001f);
+		fprintf(nvme_out(), "\tWorkload Hint (WH): %u - %s\n",  field, nvme_feature_wl_hints_to_string(field));
+		fprintf(nvme_out(), "\tPower State   (PS): %u\n",  result & 0x0000001f);
 		break;
 	case NVME_FEAT_LBA_RANGE:
 		field = result & 0x0000003f;
-		printf("\tNumber of LBA Ranges (NUM): %u\n", field + 1);
+		fprintf(nvme_out(), "\tNumber of LBA Ranges (NUM): %u\n", field + 1);
 		show_lba_range((struct nvme_lba_range_type *)buf, field);
 		break;
 	case NVME_FEAT_TEMP_THRESH:
 		field = (result & 0x00300000) >> 20;
-		printf("\tThreshold Type Select         (THSEL): %u - %s\n", field, nvme_feature_temp_type_to_string(field));
+		fprintf(nvme_out(), "\tThreshold Type Select         (THSEL): %u - %s\n", field, nvme_feature_temp_type_to_string(field));
 		field = (result & 0x000f0000) >> 16;
-		printf("\tThreshold Temperature Select (TMPSEL): %u - %s\n", field, nvme_feature_temp_sel_to_string(field));
-		printf("\tTemperature Threshold         (TMPTH): %d C\n", (result & 0x0000ffff) - 273);
+		fprintf(nvme_out(), "\tThreshold Temperature Select (TMPSEL): %u - %s\n", field, nvme_feature_temp_sel_to_string(field));
+		fprintf(nvme_out(), "\tTemperature Threshold         (TMPTH): %d C\n", (result & 0x0000ffff) - 273);
 		break;
 	case NVME_FEAT_ERR_RECOVERY:
-		printf("\tDeallocated or Unwritten Logical Block Error Enable (DULBE): %s\n", ((result & 0x00010000) >> 16) ? "Enabled":"Disabled");
-		printf("\tTime Limited Error Recovery                          (TLER): %u ms\n", (result & 0x0000ffff) * 100);
+		fprintf(nvme_out(), "\tDeallocated or Unwritten Logical Block Error Enable (DULBE): %s\n", ((result & 0x00010000) >> 16) ? "Enabled":"Disabled");
+		fprintf(nvme_out(), "\tTime Limited Error Recovery                          (TLER): %u ms\n", (result & 0x0000ffff) * 100);
 		break;
 	case NVME_FEAT_VOLATILE_WC:
-		printf("\tVolatile Write Cache Enable (WCE): %s\n", (result & 0x00000001) ? "Enabled":"Disabled");
+		fprintf(nvme_out(), "\tVolatile Write Cache Enable (WCE): %s\n", (result & 0x00000001) ? "Enabled":"Disabled");
 		break;
 	case NVME_FEAT_NUM_QUEUES:
-		printf("\tNumber of IO Completion Queues Allocated (NCQA): %u\n", ((result & 0xffff0000) >> 16) + 1);
-		printf("\tNumber of IO Submission Queues Allocated (NSQA): %u\n",  (result & 0x0000ffff) + 1);
+		fprintf(nvme_out(), "\tNumber of IO Completion Queues Allocated (NCQA): %u\n", ((result & 0xffff0000) >> 16) + 1);
+		fprintf(nvme_out(), "\tNumber of IO Submission Queues Allocated (NSQA): %u\n",  (result & 0x0000ffff) + 1);
 		break;
 	case NVME_FEAT_IRQ_COALESCE:
-		printf("\tAggregation Time     (TIME): %u usec\n", ((result & 0x0000ff00) >> 8) * 100);
-		printf("\tAggregation Threshold (THR): %u\n",  (result & 0x000000ff) + 1);
+		fprintf(nvme_out(), "\tAggregation Time     (TIME): %u usec\n", ((result & 0x0000ff00) >> 8) * 100);
+		fprintf(nvme_out(), "\tAggregation Threshold (THR): %u\n",  (result & 0x000000ff) + 1);
 		break;
 	case NVME_FEAT_IRQ_CONFIG:
-		printf("\tCoalescing Disable (CD): %s\n", ((result & 0x00010000) >> 16) ? "True":"False");
-		printf("\tInterrupt Vector   (IV): %u\n",  result & 0x0000ffff);
+		fprintf(nvme_out(), "\tCoalescing Disable (CD): %s\n", ((result & 0x00010000) >> 16) ? "True":"False");
+		fprintf(nvme_out(), "\tInterrupt Vector   (IV): %u\n",  result & 0x0000ffff);
 		break;
 	case NVME_FEAT_WRITE_ATOMIC:
-		printf("\tDisable Normal (DN): %s\n", (result & 0x00000001) ? "True":"False");
+		fprintf(nvme_out(), "\tDisable Normal (DN): %s\n", (result & 0x00000001) ? "True":"False");
 		break;
 	case NVME_FEAT_ASYNC_EVENT:
-		printf("\tTelemetry Log Notices           : %s\n", ((result & 0x00000400) >> 10) ? "Send async event":"Do not send async event");
-		printf("\tFirmware Activation Notices     : %s\n", ((result & 0x00000200) >> 9) ? "Send async event":"Do not send async event");
-		printf("\tNamespace Attribute Notices     : %s\n", ((result & 0x00000100) >> 8) ? "Send async event":"Do not send async event");
-		printf("\tSMART / Health Critical Warnings: %s\n", (result & 0x000000ff) ? "Send async event":"Do not send async event");
+		fprintf(nvme_out(), "\tTelemetry Log Notices           : %s\n", ((result & 0x00000400) >> 10) ? "Send async event":"Do not send async event");
+		fprintf(nvme_out(), "\tFirmware Activation Notices     : %s\n", ((result & 0x00000200) >> 9) ? "Send async event":"Do not send async event");
+		fprintf(nvme_out(), "\tNamespace Attribute Notices     : %s\n", ((result & 0x00000100) >> 8) ? "Send async event":"Do not send async event");
+		fprintf(nvme_out(), "\tSMART / Health Critical Warnings: %s\n", (result & 0x000000ff) ? "Send async event":"Do not send async event");
 		break;
 	case NVME_FEAT_AUTO_PST:
-		printf("\tAutonomous Power State Transition Enable (APSTE): %s\n", (result & 0x00000001) ? "Enabled":"Disabled");
+		fprintf(nvme_out(), "\tAutonomous Power State Transition Enable (APSTE): %s\n", (result & 0x00000001) ? "Enabled":"Disabled");
 		show_auto_pst((struct nvme_auto_pst *)buf);
 		break;
 	case NVME_FEAT_HOST_MEM_BUF:
-		printf("\tMemory Return       (MR): %s\n", ((result & 0x00000002) >> 1) ? "True":"False");
-		printf("\tEnable Host Memory (EHM): %s\n", (result & 0x00000001) ? "Enabled":"Disabled");
+		fprintf(nvme_out(), "\tMemory Return       (MR): %s\n", ((result & 0x00000002) >> 1) ? "True":"False");
+		fprintf(nvme_out(), "\tEnable Host Memory (EHM): %s\n", (result & 0x00000001) ? "Enabled":"Disabled");
 		show_host_mem_buffer((struct nvme_host_mem_buffer *)buf);
 		break;
 	case NVME_FEAT_SW_PROGRESS:
-		printf("\tPre-boot Software Load Count (PBSLC): %u\n", result & 0x000000ff);
+		fprintf(nvme_out(), "\tPre-boot Software Load Count (PBSLC): %u\n", result & 0x000000ff);
 		break;
 	case NVME_FEAT_PLM_CONFIG:
-		printf("\tPredictable Latency Window Enabled: %s\n", result & 0x1 ? "True":"False");
+		fprintf(nvme_out(), "\tPredictable Latency Window Enabled: %s\n", result & 0x1 ? "True":"False");
 		show_plm_config((struct nvme_plm_config *)buf);
 		break;
 	case NVME_FEAT_PLM_WINDOW:
-		printf("\tWindow Select: %s", nvme_plm_window(result));
+		fprintf(nvme_out(), "\tWindow Select: %s", nvme_plm_window(result));
 		break;
 	case NVME_FEAT_HOST_ID:
 		ull =  buf[7]; ull <<= 8; ull |= buf[6]; ull <<= 8; ull |= buf[5]; ull <<= 8;
 		ull |= buf[4]; ull <<= 8; ull |= buf[3]; ull <<= 8; ull |= buf[2]; ull <<= 8;
 		ull |= buf[1]; ull <<= 8; ull |= buf[0];
-		printf("\tHost Identifier (HOSTID):  %" PRIu64 "\n", ull);
+		fprintf(nvme_out(), "\tHost Identifier (HOSTID):  %" PRIu64 "\n", ull);
 		break;
 	case NVME_FEAT_RESV_MASK:
-		printf("\tMask Reservation Preempted Notification  (RESPRE): %s\n", ((result & 0x00000008) >> 3) ? "True":"False");
-		printf("\tMask Reservation Released Notification   (RESREL): %s\n", ((result & 0x00000004) >> 2) ? "True":"False");
-		printf("\tMask Registration Preempted Notification (REGPRE): %s\n", ((result & 0x00000002) >> 1) ? "True":"False");
+		fprintf(nvme_out(), "\tMask Reservation Preempted Notification  (RESPRE): %s\n", ((result & 0x00000008) >> 3) ? "True":"False");
+		fprintf(nvme_out(), "\tMask Reservation Released Notification   (RESREL): %s\n", ((result & 0x00000004) >> 2) ? "True":"False");
+		fprintf(nvme_out(), "\tMask Registration Preempted Notification (REGPRE): %s\n", ((result & 0x00000002) >> 1) ? "True":"False");
 		break;
 	case NVME_FEAT_RESV_PERSIST:
-		printf("\tPersist Through Power Loss (PTPL): %s\n", (result & 0x00000001) ? "True":"False");
+		fprintf(nvme_out(), "\tPersist Through Power Loss (PTPL): %s\n", (result & 0x00000001) ? "True":"False");
 		break;
 	case NVME_FEAT_WRITE_PROTECT:
-		printf("\tNamespace Write Protect: %s\n", result != NVME_NS_NO_WRITE_PROTECT ? "True" :  "False");
+		fprintf(nvme_out(), "\tNamespace Write Protect: %s\n", result != NVME_NS_NO_WRITE_PROTECT ? "True" :  "False");
 		break;
 	case NVME_FEAT_TIMESTAMP:
 		show_timestamp((struct nvme_timestamp *)buf);
 		break;
 	case NVME_FEAT_HCTM:
-		printf("\tThermal Management Temperature 1 (TMT1) : %u Kelvin\n", (result >> 16));
-		printf("\tThermal Management Temperature 2 (TMT2) : %u Kelvin\n", (result & 0x0000ffff));
+		fprintf(nvme_out(), "\tThermal Management Temperature 1 (TMT1) : %u Kelvin\n", (result >> 16));
+		fprintf(nvme_out(), "\tThermal Management Temperature 2 (TMT2) : %u Kelvin\n", (result & 0x0000ffff));
 		break;
 	case NVME_FEAT_KATO:
-		printf("\tKeep Alive Timeout (KATO) in milliseconds: %u\n", result);
+		fprintf(nvme_out(), "\tKeep Alive Timeout (KATO) in milliseconds: %u\n", result);
 		break;
 	case NVME_FEAT_NOPSC:
-		printf("\tNon-Operational Power State Permissive Mode Enable (NOPPME): %s\n", (result & 1) ? "True" : "False");
+		fprintf(nvme_out(), "\tNon-Operational Power State Permissive Mode Enable (NOPPME): %s\n", (result & 1) ? "True" : "False");
 		break;
 	case NVME_FEAT_HOST_BEHAVIOR:
-		printf("\tHost Behavior Support: %s\n", (buf[0] & 0x1) ? "True" : "False");
+		fprintf(nvme_out(), "\tHost Behavior Support: %s\n", (buf[0] & 0x1) ? "True" : "False");
 		break;
 	}
 }
@@ -2359,16 +2424,16 @@ void show_lba_status(struct nvme_lba_status *list)
 {
 	int idx;
 
-	printf("Number of LBA Status Descriptors(NLSD): %lu\n",
+	fprintf(nvme_out(), "Number of LBA Status Descriptors(NLSD): %lu\n",
 			le64_to_cpu(list->nlsd));
-	printf("Completion Condition(CMPC): %u\n", list->cmpc);
+	fprintf(nvme_out(), "Completion Condition(CMPC): %u\n", list->cmpc);
 	switch (list->cmpc) {
 	case 1:
-		printf("\tCompleted due to transferring the amount of data"\
+		fprintf(nvme_out(), "\tCompleted due to transferring the amount of data"\
 			" specified in the MNDW field\n");
 		break;
 	case 2:
-		printf("\tCompleted due to having performed the action\n"\
+		fprintf(nvme_out(), "\tCompleted due to having performed the action\n"\
 			"\tspecified in the Action Type field over the\n"\
 			"\tnumber of logical blocks specified in the\n"\
 			"\tRange Length field\n");
@@ -2377,12 +2442,97 @@ void show_lba_status(struct nvme_lba_status *list)
 
 	for (idx = 0; idx < list->nlsd; idx++) {
 		struct nvme_lba_status_desc *e = &list->descs[idx];
-		printf("{ DSLBA: 0x%016"PRIu64", NLB: 0x%08x, Status: 0x%02x }\n",
+		fprintf(nvme_out(), "{ DSLBA: 0x%016"PRIu64", NLB: 0x%08x, Status: 0x%02x }\n",
 				le64_to_cpu(e->dslba), le32_to_cpu(e->nlb),
 				e->status);
 	}
 }
 
+void show_iogen_result(struct nvme_iogen_result *res, const char *command,
+		       unsigned int qd)
+{
+	double secs = res->elapsed_ns / 1e9;
+	double bw = secs ? res->bytes / secs : 0;
+	const char *bw_suffix = suffix_si_get(&bw);
+
+	fprintf(nvme_out(), "%s: %"PRIu64" commands in %.3f s, queue depth %u\n",
+		command, (uint64_t)res->ios, secs, qd);
+	fprintf(nvme_out(), "  IOPS      : %.0f\n", secs ? res->ios / secs : 0);
+	fprintf(nvme_out(), "  bandwidth : %.2f %sB/s\n", bw, bw_suffix);
+	fprintf(nvme_out(), "  latency   : min %.1f us, avg %.1f us, max %.1f us\n",
+		res->lat.min / 1000.0,
+		res->lat.count ? (double)res->lat.sum / res->lat.count / 1000.0 : 0,
+		res->lat.max / 1000.0);
+	fprintf(nvme_out(), "  percentile: p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us\n",
+		nvme_hist_percentile(&res->lat, 50) / 1000.0,
+		nvme_hist_percentile(&res->lat, 90) / 1000.0,
+		nvme_hist_percentile(&res->lat, 99) / 1000.0,
+		nvme_hist_percentile(&res->lat, 99.9) / 1000.0);
+}
+
+static const double latency_percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+
+void show_latency_stats(struct nvme_iogen_result *res, const char *command,
+			size_t data_size, unsigned int qd)
+{
+	int i;
+
+	fprintf(nvme_out(), "%s latency: %"PRIu64" commands of %zu bytes, queue depth %u\n",
+		command, (uint64_t)res->ios, data_size, qd);
+	fprintf(nvme_out(), "  min    : %10.2f us\n", res->lat.min / 1000.0);
+	fprintf(nvme_out(), "  avg    : %10.2f us\n", res->lat.count ?
+		(double)res->lat.sum / res->lat.count / 1000.0 : 0);
+	fprintf(nvme_out(), "  max    : %10.2f us\n", res->lat.max / 1000.0);
+	for (i = 0; i < ARRAY_SIZE(latency_percentiles); i++)
+		fprintf(nvme_out(), "  p%-6g: %10.2f us\n", latency_percentiles[i],
+			nvme_hist_percentile(&res->lat, latency_percentiles[i]) / 1000.0);
+}
+
+void json_latency_stats(struct nvme_iogen_result *res, const char *command,
+			size_t data_size, unsigned int qd)
+{
+	struct json_object *root, *pcts, *bucket;
+	struct json_array *buckets;
+	char name[16];
+	__u64 low, high;
+	int i;
+
+	root = json_create_object();
+	json_object_add_value_string(root, "command", command);
+	json_object_add_value_uint(root, "commands", res->ios);
+	json_object_add_value_uint(root, "data_size", data_size);
+	json_object_add_value_uint(root, "queue_depth", qd);
+	json_object_add_value_uint(root, "elapsed_ns", res->elapsed_ns);
+	json_object_add_value_uint(root, "min_ns", res->lat.min);
+	json_object_add_value_uint(root, "avg_ns",
+		res->lat.count ? res->lat.sum / res->lat.count : 0);
+	json_object_add_value_uint(root, "max_ns", res->lat.max);
+
+	pcts = json_create_object();
+	for (i = 0; i < ARRAY_SIZE(latency_percentiles); i++) {
+		snprintf(name, sizeof(name), "p%g", latency_percentiles[i]);
+		json_object_add_value_uint(pcts, name,
+			nvme_hist_percentile(&res->lat, latency_percentiles[i]));
+	}
+	json_object_add_value_object(root, "percentiles_ns", pcts);
+
+	buckets = json_create_array();
+	for (i = 0; i < NVME_HIST_BUCKETS; i++) {
+		if (!res->lat.buckets[i])
+			continue;
+		nvme_hist_bucket_range(i, &low, &high);
+		bucket = json_create_object();
+		json_object_add_value_uint(bucket, "low_ns", low);
+		json_object_add_value_uint(bucket, "high_ns", high);
+		json_object_add_value_uint(bucket, "count", res->lat.buckets[i]);
+		json_array_add_value_object(buckets, bucket);
+	}
+	json_object_add_value_array(root, "histogram", buckets);
+
+	json_print_object(root, NULL);
+	json_free_object(root);
+}
+
 static void show_list_item(struct list_item list_item)
 {
 	long long int lba = 1 << list_item.ns.lbaf[(list_item.ns.flbas & 0x0f)].ds;
@@ -2396,11 +2546,14 @@ static void show_list_item(struct list_item list_item)
 	char usage[128];
 	char format[128];
 
-	sprintf(usage,"%6.2f %2sB / %6.2f %2sB", nuse, u_suffix,
-		nsze, s_suffix);
+	if (list_item.no_nuse)
+		sprintf(usage, "%9s / %6.2f %2sB", "-", nsze, s_suffix);
+	else
+		sprintf(usage, "%6.2f %2sB / %6.2f %2sB", nuse, u_suffix,
+			nsze, s_suffix);
 	sprintf(format,"%3.0f %2sB + %2d B", (double)lba, l_suffix,
 		le16_to_cpu(list_item.ns.lbaf[(list_item.ns.flbas & 0x0f)].ms));
-	printf("%-16s %-*.*s %-*.*s %-9d %-26s %-16s %-.*s\n", list_item.node,
+	fprintf(nvme_out(), "%-16s %-*.*s %-*.*s %-9d %-26s %-16s %-.*s\n", list_item.node,
             (int)sizeof(list_item.ctrl.sn), (int)sizeof(list_item.ctrl.sn), list_item.ctrl.sn,
             (int)sizeof(list_item.ctrl.mn), (int)sizeof(list_item.ctrl.mn), list_item.ctrl.mn,
             list_item.nsid, usage, format, (int)sizeof(list_item.ctrl.fr), list_item.ctrl.fr);
@@ -2410,9 +2563,9 @@ void show_list_items(struct list_item *list_items, unsigned len)
 {
 	unsigned i;
 
-	printf("%-16s %-20s %-40s %-9s %-26s %-16s %-8s\n",
+	fprintf(nvme_out(), "%-16s %-20s %-40s %-9s %-26s %-16s %-8s\n",
 	    "Node", "SN", "Model", "Namespace", "Usage", "Format", "FW Rev");
-	printf("%-16s %-20s %-40s %-9s %-26s %-16s %-8s\n",
+	fprintf(nvme_out(), "%-16s %-20s %-40s %-9s %-26s %-16s %-8s\n",
             "----------------", "--------------------", "----------------------------------------",
             "---------", "--------------------------", "----------------", "--------");
 	for (i = 0 ; i < len ; i++)
@@ -2422,9 +2575,7 @@ void show_list_items(struct list_item *list_items, unsigned len)
 
 void json_print_list_items(struct list_item *list_items, unsigned len)
 {
-	struct json_object *root;
-	struct json_array *devices;
-	struct json_object *device_attrs;
+	struct json_writer w;
 	char formatter[41] = { 0 };
 	int index, i = 0;
 	char *product;
@@ -2432,135 +2583,69 @@ void json_print_list_items(struct list_item *list_items, unsigned len)
 	double nsze;
 	double nuse;
 
-	root = json_create_object();
-	devices = json_create_array();
+	json_writer_init(&w, nvme_out());
+	json_writer_begin_object(&w, NULL);
+	if (len)
+		json_writer_begin_array(&w, "Devices");
 	for (i = 0; i < len; i++) {
-		device_attrs = json_create_object();
-
-	    json_object_add_value_int(device_attrs,
-	                              "NameSpace",
-	                              list_items[i].nsid);
+		json_writer_begin_object(&w, NULL);
 
-		json_object_add_value_string(device_attrs,
-					     "DevicePath",
-					     list_items[i].node);
+		json_write_int(&w, "NameSpace", list_items[i].nsid);
+		json_write_string(&w, "DevicePath", list_items[i].node);
 
 		format(formatter, sizeof(formatter),
 			   list_items[i].ctrl.fr,
 			   sizeof(list_items[i].ctrl.fr));
-
-		json_object_add_value_string(device_attrs,
-					     "Firmware",
-					     formatter);
+		json_write_string(&w, "Firmware", formatter);
 
 		if (sscanf(list_items[i].node, "/dev/nvme%d", &index) == 1)
-			json_object_add_value_int(device_attrs,
-						  "Index",
-						  index);
+			json_write_int(&w, "Index", index);
 
 		format(formatter, sizeof(formatter),
 		       list_items[i].ctrl.mn,
 		       sizeof(list_items[i].ctrl.mn));
-
-		json_object_add_value_string(device_attrs,
-					     "ModelNumber",
-					     formatter);
+		json_write_string(&w, "ModelNumber", formatter);
 
 		product = nvme_product_name(index);
-
-		json_object_add_value_string(device_attrs,
-					     "ProductName",
-					     product);
+		json_write_string(&w, "ProductName", product);
 
 		format(formatter, sizeof(formatter),
 		       list_items[i].ctrl.sn,
 		       sizeof(list_items[i].ctrl.sn));
-
-		json_object_add_value_string(device_attrs,
-					     "SerialNumber",
-					     formatter);
-
-		json_array_add_value_object(devices, device_attrs);
+		json_write_string(&w, "SerialNumber", formatter);
 
 		lba = 1 << list_items[i].ns.lbaf[(list_items[i].ns.flbas & 0x0f)].ds;
 		nsze = le64_to_cpu(list_items[i].ns.nsze) * lba;
 		nuse = le64_to_cpu(list_items[i].ns.nuse) * lba;
-		json_object_add_value_uint(device_attrs,
-					  "UsedBytes",
-					  nuse);
-		json_object_add_value_uint(device_attrs,
-					  "MaximumLBA",
-					  le64_to_cpu(list_items[i].ns.nsze));
-		json_object_add_value_uint(device_attrs,
-					  "PhysicalSize",
-					  nsze);
-		json_object_add_value_uint(device_attrs,
-					  "SectorSize",
-					  lba);
-
+		if (!list_items[i].no_nuse)
+			json_write_uint(&w, "UsedBytes", nuse);
+		json_write_uint(&w, "MaximumLBA",
+				le64_to_cpu(list_items[i].ns.nsze));
+		json_write_uint(&w, "PhysicalSize", nsze);
+		json_write_uint(&w, "SectorSize", lba);
+
+		json_writer_end_object(&w);
 		free((void*)product);
 	}
-	if (i)
-		json_object_add_value_array(root, "Devices", devices);
-	json_print_object(root, NULL);
+	if (len)
+		json_writer_end_array(&w);
+	json_writer_end_object(&w);
 }
 
 void json_nvme_id_ns(struct nvme_id_ns *ns, unsigned int mode)
 {
-	char nguid_buf[2 * sizeof(ns->nguid) + 1], eui64_buf[2 * sizeof(ns->eui64) + 1];
-	char *nguid = nguid_buf, *eui64 = eui64_buf;
 	struct json_object *root;
 	struct json_array *lbafs;
 	int i;
 
-	long double nvmcap = int128_to_double(ns->nvmcap);
-
 	root = json_create_object();
 
-	json_object_add_value_uint(root, "nsze", le64_to_cpu(ns->nsze));
-	json_object_add_value_uint(root, "ncap", le64_to_cpu(ns->ncap));
-	json_object_add_value_uint(root, "nuse", le64_to_cpu(ns->nuse));
-	json_object_add_value_int(root, "nsfeat", ns->nsfeat);
-	json_object_add_value_int(root, "nlbaf", ns->nlbaf);
-	json_object_add_value_int(root, "flbas", ns->flbas);
-	json_object_add_value_int(root, "mc", ns->mc);
-	json_object_add_value_int(root, "dpc", ns->dpc);
-	json_object_add_value_int(root, "dps", ns->dps);
-	json_object_add_value_int(root, "nmic", ns->nmic);
-	json_object_add_value_int(root, "rescap", ns->rescap);
-	json_object_add_value_int(root, "fpi", ns->fpi);
-	json_object_add_value_int(root, "nawun", le16_to_cpu(ns->nawun));
-	json_object_add_value_int(root, "nawupf", le16_to_cpu(ns->nawupf));
-	json_object_add_value_int(root, "nacwu", le16_to_cpu(ns->nacwu));
-	json_object_add_value_int(root, "nabsn", le16_to_cpu(ns->nabsn));
-	json_object_add_value_int(root, "nabo", le16_to_cpu(ns->nabo));
-	json_object_add_value_int(root, "nabspf", le16_to_cpu(ns->nabspf));
-	json_object_add_value_int(root, "noiob", le16_to_cpu(ns->noiob));
-	json_object_add_value_float(root, "nvmcap", nvmcap);
-	json_object_add_value_int(root, "nsattr", ns->nsattr);
-	json_object_add_value_int(root, "nvmsetid", le16_to_cpu(ns->nvmsetid));
-
-	if (ns->nsfeat & 0x10) {
-		json_object_add_value_int(root, "npwg", le16_to_cpu(ns->npwg));
-		json_object_add_value_int(root, "npwa", le16_to_cpu(ns->npwa));
-		json_object_add_value_int(root, "npdg", le16_to_cpu(ns->npdg));
-		json_object_add_value_int(root, "npda", le16_to_cpu(ns->npda));
-		json_object_add_value_int(root, "nows", le16_to_cpu(ns->nows));
-	}
-
-	json_object_add_value_int(root, "anagrpid", le32_to_cpu(ns->anagrpid));
-	json_object_add_value_int(root, "endgid", le16_to_cpu(ns->endgid));
-
-	memset(eui64, 0, sizeof(eui64_buf));
-	for (i = 0; i < sizeof(ns->eui64); i++)
-		eui64 += sprintf(eui64, "%02x", ns->eui64[i]);
-
-	memset(nguid, 0, sizeof(nguid_buf));
-	for (i = 0; i < sizeof(ns->nguid); i++)
-		nguid += sprintf(nguid, "%02x", ns->nguid[i]);
-
-	json_object_add_value_string(root, "eui64", eui64_buf);
-	json_object_add_value_string(root, "nguid", nguid_buf);
+	json_add_fields(root, ns, id_ns_fields, ARRAY_SIZE(id_ns_fields));
+	if (ns->nsfeat & 0x10)
+		json_add_fields(root, ns, id_ns_optperf_fields,
+				ARRAY_SIZE(id_ns_optperf_fields));
+	json_add_fields(root, ns, id_ns_tail_fields,
+			ARRAY_SIZE(id_ns_tail_fields));
 
 	lbafs = json_create_array();
 	json_object_add_value_array(root, "lbafs", lbafs);
@@ -2576,7 +2661,6 @@ void json_nvme_id_ns(struct nvme_id_ns *ns, unsigned int mode)
 	}
 
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -2584,98 +2668,11 @@ void json_nvme_id_ctrl(struct nvme_id_ctrl *ctrl, unsigned int mode, void (*vs)(
 {
 	struct json_object *root;
 	struct json_array *psds;
-
-	long double tnvmcap = int128_to_double(ctrl->tnvmcap);
-	long double unvmcap = int128_to_double(ctrl->unvmcap);
-
-	char sn[sizeof(ctrl->sn) + 1], mn[sizeof(ctrl->mn) + 1],
-		fr[sizeof(ctrl->fr) + 1], subnqn[sizeof(ctrl->subnqn) + 1];
-	__u32 ieee = ctrl->ieee[2] << 16 | ctrl->ieee[1] << 8 | ctrl->ieee[0];
-
 	int i;
 
-	snprintf(sn, sizeof(sn), "%-.*s", (int)sizeof(ctrl->sn), ctrl->sn);
-	snprintf(mn, sizeof(mn), "%-.*s", (int)sizeof(ctrl->mn), ctrl->mn);
-	snprintf(fr, sizeof(fr), "%-.*s", (int)sizeof(ctrl->fr), ctrl->fr);
-	snprintf(subnqn, sizeof(subnqn), "%-.*s", (int)sizeof(ctrl->subnqn), ctrl->subnqn);
-
 	root = json_create_object();
 
-	json_object_add_value_int(root, "vid", le16_to_cpu(ctrl->vid));
-	json_object_add_value_int(root, "ssvid", le16_to_cpu(ctrl->ssvid));
-	json_object_add_value_string(root, "sn", sn);
-	json_object_add_value_string(root, "mn", mn);
-	json_object_add_value_string(root, "fr", fr);
-	json_object_add_value_int(root, "rab", ctrl->rab);
-	json_object_add_value_int(root, "ieee", ieee);
-	json_object_add_value_int(root, "cmic", ctrl->cmic);
-	json_object_add_value_int(root, "mdts", ctrl->mdts);
-	json_object_add_value_int(root, "cntlid", le16_to_cpu(ctrl->cntlid));
-	json_object_add_value_uint(root, "ver", le32_to_cpu(ctrl->ver));
-	json_object_add_value_uint(root, "rtd3r", le32_to_cpu(ctrl->rtd3r));
-	json_object_add_value_uint(root, "rtd3e", le32_to_cpu(ctrl->rtd3e));
-	json_object_add_value_uint(root, "oaes", le32_to_cpu(ctrl->oaes));
-	json_object_add_value_int(root, "ctratt", le32_to_cpu(ctrl->ctratt));
-	json_object_add_value_int(root, "rrls", le16_to_cpu(ctrl->rrls));
-	json_object_add_value_int(root, "crdt1", le16_to_cpu(ctrl->crdt1));
-	json_object_add_value_int(root, "crdt2", le16_to_cpu(ctrl->crdt2));
-	json_object_add_value_int(root, "crdt3", le16_to_cpu(ctrl->crdt3));
-	json_object_add_value_int(root, "oacs", le16_to_cpu(ctrl->oacs));
-	json_object_add_value_int(root, "acl", ctrl->acl);
-	json_object_add_value_int(root, "aerl", ctrl->aerl);
-	json_object_add_value_int(root, "frmw", ctrl->frmw);
-	json_object_add_value_int(root, "lpa", ctrl->lpa);
-	json_object_add_value_int(root, "elpe", ctrl->elpe);
-	json_object_add_value_int(root, "npss", ctrl->npss);
-	json_object_add_value_int(root, "avscc", ctrl->avscc);
-	json_object_add_value_int(root, "apsta", ctrl->apsta);
-	json_object_add_value_int(root, "wctemp", le16_to_cpu(ctrl->wctemp));
-	json_object_add_value_int(root, "cctemp", le16_to_cpu(ctrl->cctemp));
-	json_object_add_value_int(root, "mtfa", le16_to_cpu(ctrl->mtfa));
-	json_object_add_value_uint(root, "hmpre", le32_to_cpu(ctrl->hmpre));
-	json_object_add_value_uint(root, "hmmin", le32_to_cpu(ctrl->hmmin));
-	json_object_add_value_float(root, "tnvmcap", tnvmcap);
-	json_object_add_value_float(root, "unvmcap", unvmcap);
-	json_object_add_value_uint(root, "rpmbs", le32_to_cpu(ctrl->rpmbs));
-	json_object_add_value_int(root, "edstt", le16_to_cpu(ctrl->edstt));
-	json_object_add_value_int(root, "dsto", ctrl->dsto);
-	json_object_add_value_int(root, "fwug", ctrl->fwug);
-	json_object_add_value_int(root, "kas", le16_to_cpu(ctrl->kas));
-	json_object_add_value_int(root, "hctma", le16_to_cpu(ctrl->hctma));
-	json_object_add_value_int(root, "mntmt", le16_to_cpu(ctrl->mntmt));
-	json_object_add_value_int(root, "mxtmt", le16_to_cpu(ctrl->mxtmt));
-	json_object_add_value_int(root, "sanicap", le32_to_cpu(ctrl->sanicap));
-	json_object_add_value_int(root, "hmminds", le32_to_cpu(ctrl->hmminds));
-	json_object_add_value_int(root, "hmmaxd", le16_to_cpu(ctrl->hmmaxd));
-	json_object_add_value_int(root, "nsetidmax", le16_to_cpu(ctrl->nsetidmax));
-
-	json_object_add_value_int(root, "anatt",ctrl->anatt);
-	json_object_add_value_int(root, "anacap", ctrl->anacap);
-	json_object_add_value_int(root, "anagrpmax", le32_to_cpu(ctrl->anagrpmax));
-	json_object_add_value_int(root, "nanagrpid", le32_to_cpu(ctrl->nanagrpid));
-	json_object_add_value_int(root, "sqes", ctrl->sqes);
-	json_object_add_value_int(root, "cqes", ctrl->cqes);
-	json_object_add_value_int(root, "maxcmd", le16_to_cpu(ctrl->maxcmd));
-	json_object_add_value_uint(root, "nn", le32_to_cpu(ctrl->nn));
-	json_object_add_value_int(root, "oncs", le16_to_cpu(ctrl->oncs));
-	json_object_add_value_int(root, "fuses", le16_to_cpu(ctrl->fuses));
-	json_object_add_value_int(root, "fna", ctrl->fna);
-	json_object_add_value_int(root, "vwc", ctrl->vwc);
-	json_object_add_value_int(root, "awun", le16_to_cpu(ctrl->awun));
-	json_object_add_value_int(root, "awupf", le16_to_cpu(ctrl->awupf));
-	json_object_add_value_int(root, "nvscc", ctrl->nvscc);
-	json_object_add_value_int(root, "nwpc", ctrl->nwpc);
-	json_object_add_value_int(root, "acwu", le16_to_cpu(ctrl->acwu));
-	json_object_add_value_int(root, "sgls", le32_to_cpu(ctrl->sgls));
-
-	if (strlen(subnqn))
-		json_object_add_value_string(root, "subnqn", subnqn);
-
-	json_object_add_value_int(root, "ioccsz", le32_to_cpu(ctrl->ioccsz));
-	json_object_add_value_int(root, "iorcsz", le32_to_cpu(ctrl->iorcsz));
-	json_object_add_value_int(root, "icdoff", le16_to_cpu(ctrl->icdoff));
-	json_object_add_value_int(root, "ctrattr", ctrl->ctrattr);
-	json_object_add_value_int(root, "msdbd", ctrl->msdbd);
+	json_add_fields(root, ctrl, id_ctrl_fields, ARRAY_SIZE(id_ctrl_fields));
 
 	psds = json_create_array();
 	json_object_add_value_array(root, "psds", psds);
@@ -2707,49 +2704,37 @@ void json_nvme_id_ctrl(struct nvme_id_ctrl *ctrl, unsigned int mode, void (*vs)(
 	if(vs)
 		vs(ctrl->vs, root);
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
 void json_error_log(struct nvme_error_log_page *err_log, int entries, const char *devname)
 {
-	struct json_object *root;
-	struct json_array *errors;
-
+	struct json_writer w;
 	int i;
 
-	root = json_create_object();
-
-	errors = json_create_array();
-	json_object_add_value_array(root, "errors", errors);
+	json_writer_init(&w, nvme_out());
+	json_writer_begin_object(&w, NULL);
+	json_writer_begin_array(&w, "errors");
 
 	for (i = 0; i < entries; i++) {
-		struct json_object *error = json_create_object();
-
-		json_object_add_value_uint(error, "error_count",
-					   le64_to_cpu(err_log[i].error_count));
-		json_object_add_value_int(error, "sqid",
-					  le16_to_cpu(err_log[i].sqid));
-		json_object_add_value_int(error, "cmdid",
-					  le16_to_cpu(err_log[i].cmdid));
-		json_object_add_value_int(error, "status_field",
-					  le16_to_cpu(err_log[i].status_field));
-		json_object_add_value_int(error, "parm_error_location",
-					  le16_to_cpu(err_log[i].parm_error_location));
-		json_object_add_value_uint(error, "lba",
-					   le64_to_cpu(err_log[i].lba));
-		json_object_add_value_uint(error, "nsid",
-					   le32_to_cpu(err_log[i].nsid));
-		json_object_add_value_int(error, "vs", err_log[i].vs);
-		json_object_add_value_uint(error, "cs",
-					   le64_to_cpu(err_log[i].cs));
-
-		json_array_add_value_object(errors, error);
-	}
-
-	json_print_object(root, NULL);
-	printf("\n");
-	json_free_object(root);
+		json_writer_begin_object(&w, NULL);
+		json_write_uint(&w, "error_count",
+				le64_to_cpu(err_log[i].error_count));
+		json_write_int(&w, "sqid", le16_to_cpu(err_log[i].sqid));
+		json_write_int(&w, "cmdid", le16_to_cpu(err_log[i].cmdid));
+		json_write_int(&w, "status_field",
+			       le16_to_cpu(err_log[i].status_field));
+		json_write_int(&w, "parm_error_location",
+			       le16_to_cpu(err_log[i].parm_error_location));
+		json_write_uint(&w, "lba", le64_to_cpu(err_log[i].lba));
+		json_write_uint(&w, "nsid", le32_to_cpu(err_log[i].nsid));
+		json_write_int(&w, "vs", err_log[i].vs);
+		json_write_uint(&w, "cs", le64_to_cpu(err_log[i].cs));
+		json_writer_end_object(&w);
+	}
+
+	json_writer_end_array(&w);
+	json_writer_end_object(&w);
 }
 
 void json_nvme_resv_report(struct nvme_reservation_status *status, int bytes, __u32 cdw11)
@@ -2812,7 +2797,6 @@ void json_nvme_resv_report(struct nvme_reservation_status *status, int bytes, __
 	}
 
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -2840,7 +2824,6 @@ void json_fw_log(struct nvme_firmware_log_page *fw_log, const char *devname)
 	json_object_add_value_object(root, devname, fwsi);
 
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -2874,7 +2857,6 @@ void json_changed_ns_list_log(struct nvme_changed_ns_list_log *log, const char *
 
 	json_object_add_value_object(root, devname, nsi);
 	json_print_object(root, NULL);
-	printf("\n");
 
 	json_free_object(root);
 }
@@ -2884,87 +2866,31 @@ void json_endurance_log(struct nvme_endurance_group_log *endurance_group,
 {
 	struct json_object *root;
 
-	long double endurance_estimate= int128_to_double(endurance_group->endurance_estimate);
-	long double data_units_read= int128_to_double(endurance_group->data_units_read);
-	long double data_units_written= int128_to_double(endurance_group->data_units_written);
-	long double media_units_written= int128_to_double(endurance_group->media_units_written);
-
 	root = json_create_object();
 
 	json_object_add_value_int(root, "avl_spare_threshold", endurance_group->avl_spare_threshold);
 	json_object_add_value_int(root, "percent_used", endurance_group->percent_used);
-	json_object_add_value_float(root, "endurance_estimate", endurance_estimate);
-	json_object_add_value_float(root, "data_units_read", data_units_read);
-	json_object_add_value_float(root, "data_units_written", data_units_written);
-	json_object_add_value_float(root, "mediate_write_commands", media_units_written);
+	json_object_add_value_uint128(root, "endurance_estimate",
+			uint128_from_le(endurance_group->endurance_estimate));
+	json_object_add_value_uint128(root, "data_units_read",
+			uint128_from_le(endurance_group->data_units_read));
+	json_object_add_value_uint128(root, "data_units_written",
+			uint128_from_le(endurance_group->data_units_written));
+	json_object_add_value_uint128(root, "mediate_write_commands",
+			uint128_from_le(endurance_group->media_units_written));
 
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
 void json_smart_log(struct nvme_smart_log *smart, unsigned int nsid, const char *devname)
 {
 	struct json_object *root;
-	int c;
-	char key[21];
-
-	unsigned int temperature = ((smart->temperature[1] << 8) |
-		smart->temperature[0]);
-
-	long double data_units_read = int128_to_double(smart->data_units_read);
-	long double data_units_written = int128_to_double(smart->data_units_written);
-	long double host_read_commands = int128_to_double(smart->host_reads);
-	long double host_write_commands = int128_to_double(smart->host_writes);
-	long double controller_busy_time = int128_to_double(smart->ctrl_busy_time);
-	long double power_cycles = int128_to_double(smart->power_cycles);
-	long double power_on_hours = int128_to_double(smart->power_on_hours);
-	long double unsafe_shutdowns = int128_to_double(smart->unsafe_shutdowns);
-	long double media_errors = int128_to_double(smart->media_errors);
-	long double num_err_log_entries = int128_to_double(smart->num_err_log_entries);
 
 	root = json_create_object();
-
-	json_object_add_value_int(root, "critical_warning", smart->critical_warning);
-	json_object_add_value_int(root, "temperature", temperature);
-	json_object_add_value_int(root, "avail_spare", smart->avail_spare);
-	json_object_add_value_int(root, "spare_thresh", smart->spare_thresh);
-	json_object_add_value_int(root, "percent_used", smart->percent_used);
-	json_object_add_value_float(root, "data_units_read", data_units_read);
-	json_object_add_value_float(root, "data_units_written", data_units_written);
-	json_object_add_value_float(root, "host_read_commands", host_read_commands);
-	json_object_add_value_float(root, "host_write_commands", host_write_commands);
-	json_object_add_value_float(root, "controller_busy_time", controller_busy_time);
-	json_object_add_value_float(root, "power_cycles", power_cycles);
-	json_object_add_value_float(root, "power_on_hours", power_on_hours);
-	json_object_add_value_float(root, "unsafe_shutdowns", unsafe_shutdowns);
-	json_object_add_value_float(root, "media_errors", media_errors);
-	json_object_add_value_float(root, "num_err_log_entries", num_err_log_entries);
-	json_object_add_value_uint(root, "warning_temp_time",
-			le32_to_cpu(smart->warning_temp_time));
-	json_object_add_value_uint(root, "critical_comp_time",
-			le32_to_cpu(smart->critical_comp_time));
-
-	for (c=0; c < 8; c++) {
-		__s32 temp = le16_to_cpu(smart->temp_sensor[c]);
-
-		if (temp == 0)
-			continue;
-		sprintf(key, "temperature_sensor_%d",c+1);
-		json_object_add_value_int(root, key, temp);
-	}
-
-	json_object_add_value_uint(root, "thm_temp1_trans_count",
-			le32_to_cpu(smart->thm_temp1_trans_count));
-	json_object_add_value_uint(root, "thm_temp2_trans_count",
-			le32_to_cpu(smart->thm_temp2_trans_count));
-	json_object_add_value_uint(root, "thm_temp1_total_time",
-			le32_to_cpu(smart->thm_temp1_total_time));
-	json_object_add_value_uint(root, "thm_temp2_total_time",
-			le32_to_cpu(smart->thm_temp2_total_time));
-
+	json_add_fields(root, smart, smart_log_fields,
+			ARRAY_SIZE(smart_log_fields));
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -3023,7 +2949,6 @@ void json_ana_log(struct nvme_ana_rsp_hdr *ana_log, const char *devname)
 
 	json_object_add_value_array(root, "ANA DESC LIST ", desc_list);
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -3062,7 +2987,6 @@ void json_self_test_log(struct nvme_self_test_log *self_test, const char *devnam
 	}
 	json_object_add_value_array(root, "List of Valid Reports", valid);
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -3088,7 +3012,6 @@ void json_effects_log(struct nvme_effects_log_page *effects_log, const char *dev
 	}
 
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -3127,7 +3050,6 @@ void json_sanitize_log(struct nvme_sanitize_log_page *sanitize_log, const char *
 
 	json_object_add_value_object(root, devname, dev);
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -3135,11 +3057,11 @@ static void show_nvme_subsystem(struct subsys_list_item *item)
 {
 	int i;
 
-	printf("%s - NQN=%s\n", item->name, item->subsysnqn);
-	printf("\\\n");
+	fprintf(nvme_out(), "%s - NQN=%s\n", item->name, item->subsysnqn);
+	fprintf(nvme_out(), "\\\n");
 
 	for (i = 0; i < item->nctrls; i++) {
-		printf(" +- %s %s %s %s %s\n", item->ctrls[i].name,
+		fprintf(nvme_out(), " +- %s %s %s %s %s\n", item->ctrls[i].name,
 				item->ctrls[i].transport,
 				item->ctrls[i].address,
 				item->ctrls[i].state,
@@ -3158,193 +3080,180 @@ void show_nvme_subsystem_list(struct subsys_list_item *slist, int n)
 }
 void json_print_nvme_subsystem_list(struct subsys_list_item *slist, int n)
 {
-	struct json_object *root;
-	struct json_array *subsystems;
-	struct json_object *subsystem_attrs;
-	struct json_array *paths;
-	struct json_object *path_attrs;
+	struct json_writer w;
 	int i, j;
 
-	root = json_create_object();
-	subsystems = json_create_array();
+	json_writer_init(&w, nvme_out());
+	json_writer_begin_object(&w, NULL);
+	if (n)
+		json_writer_begin_array(&w, "Subsystems");
 
 	for (i = 0; i < n; i++) {
-		subsystem_attrs = json_create_object();
-
-		json_object_add_value_string(subsystem_attrs,
-					     "Name", slist[i].name);
-		json_object_add_value_string(subsystem_attrs,
-					     "NQN", slist[i].subsysnqn);
-
-		json_array_add_value_object(subsystems, subsystem_attrs);
-
-		paths = json_create_array();
+		json_writer_begin_object(&w, NULL);
+		json_write_string(&w, "Name", slist[i].name);
+		json_write_string(&w, "NQN", slist[i].subsysnqn);
 
+		if (slist[i].nctrls)
+			json_writer_begin_array(&w, "Paths");
 		for (j = 0; j < slist[i].nctrls; j++) {
-			path_attrs = json_create_object();
-			json_object_add_value_string(path_attrs, "Name",
-					slist[i].ctrls[j].name);
-			json_object_add_value_string(path_attrs, "Transport",
-					slist[i].ctrls[j].transport);
-			json_object_add_value_string(path_attrs, "Address",
-					slist[i].ctrls[j].address);
-			json_object_add_value_string(path_attrs, "State",
-					slist[i].ctrls[j].state);
+			json_writer_begin_object(&w, NULL);
+			json_write_string(&w, "Name", slist[i].ctrls[j].name);
+			json_write_string(&w, "Transport",
+					  slist[i].ctrls[j].transport);
+			json_write_string(&w, "Address",
+					  slist[i].ctrls[j].address);
+			json_write_string(&w, "State", slist[i].ctrls[j].state);
 			if (slist[i].ctrls[j].ana_state)
-				json_object_add_value_string(path_attrs,
-						"ANAState",
-						slist[i].ctrls[j].ana_state);
-			json_array_add_value_object(paths, path_attrs);
-		}
-		if (j) {
-			json_object_add_value_array(subsystem_attrs, "Paths", paths);
+				json_write_string(&w, "ANAState",
+						  slist[i].ctrls[j].ana_state);
+			json_writer_end_object(&w);
 		}
-
+		if (slist[i].nctrls)
+			json_writer_end_array(&w);
+		json_writer_end_object(&w);
 	}
 
-	if (i)
-		json_object_add_value_array(root, "Subsystems", subsystems);
-	json_print_object(root, NULL);
-	printf("\n");
-	json_free_object(root);
+	if (n)
+		json_writer_end_array(&w);
+	json_writer_end_object(&w);
 }
 
 static void show_registers_cap(struct nvme_bar_cap *cap)
 {
-	printf("\tPersistent Memory Region Supported (PMRS): The Persistent Memory Region is %s\n",
+	fprintf(nvme_out(), "\tPersistent Memory Region Supported (PMRS): The Persistent Memory Region is %s\n",
 			(cap->rsvd_pmrs & 0x01) ? "supported":"not supported");
-	printf("\tMemory Page Size Maximum	   (MPSMAX): %u bytes\n", 1 <<  (12 + ((cap->mpsmax_mpsmin & 0xf0) >> 4)));
-	printf("\tMemory Page Size Minimum         (MPSMIN): %u bytes\n", 1 <<  (12 + (cap->mpsmax_mpsmin & 0x0f)));
-	printf("\tBoot Partition Support              (BPS): %s\n", (cap->bps_css_nssrs_dstrd & 0x2000) ? "Yes":"No");
-	printf("\tCommand Sets Supported              (CSS): NVM command set is %s\n",
+	fprintf(nvme_out(), "\tMemory Page Size Maximum	   (MPSMAX): %u bytes\n", 1 <<  (12 + ((cap->mpsmax_mpsmin & 0xf0) >> 4)));
+	fprintf(nvme_out(), "\tMemory Page Size Minimum         (MPSMIN): %u bytes\n", 1 <<  (12 + (cap->mpsmax_mpsmin & 0x0f)));
+	fprintf(nvme_out(), "\tBoot Partition Support              (BPS): %s\n", (cap->bps_css_nssrs_dstrd & 0x2000) ? "Yes":"No");
+	fprintf(nvme_out(), "\tCommand Sets Supported              (CSS): NVM command set is %s\n",
 			(cap->bps_css_nssrs_dstrd & 0x0020) ? "supported":"not supported");
-	printf("\tNVM Subsystem Reset Supported     (NSSRS): %s\n", (cap->bps_css_nssrs_dstrd & 0x0010) ? "Yes":"No");
-	printf("\tDoorbell Stride                   (DSTRD): %u bytes\n", 1 << (2 + (cap->bps_css_nssrs_dstrd & 0x000f)));
-	printf("\tTimeout                              (TO): %u ms\n", cap->to * 500);
-	printf("\tArbitration Mechanism Supported     (AMS): Weighted Round Robin with Urgent Priority Class is %s\n",
+	fprintf(nvme_out(), "\tNVM Subsystem Reset Supported     (NSSRS): %s\n", (cap->bps_css_nssrs_dstrd & 0x0010) ? "Yes":"No");
+	fprintf(nvme_out(), "\tDoorbell Stride                   (DSTRD): %u bytes\n", 1 << (2 + (cap->bps_css_nssrs_dstrd & 0x000f)));
+	fprintf(nvme_out(), "\tTimeout                              (TO): %u ms\n", cap->to * 500);
+	fprintf(nvme_out(), "\tArbitration Mechanism Supported     (AMS): Weighted Round Robin with Urgent Priority Class is %s\n",
 			(cap->ams_cqr & 0x02) ? "supported":"not supported");
-	printf("\tContiguous Queues Required	      (CQR): %s\n", (cap->ams_cqr & 0x01) ? "Yes":"No");
-	printf("\tMaximum Queue Entries Supported    (MQES): %u\n\n", cap->mqes + 1);
+	fprintf(nvme_out(), "\tContiguous Queues Required	      (CQR): %s\n", (cap->ams_cqr & 0x01) ? "Yes":"No");
+	fprintf(nvme_out(), "\tMaximum Queue Entries Supported    (MQES): %u\n\n", cap->mqes + 1);
 }
 
 static void show_registers_version(__u32 vs)
 {
-	printf("\tNVMe specification %d.%d\n\n", (vs & 0xffff0000) >> 16,  (vs & 0x0000ff00) >> 8);
+	fprintf(nvme_out(), "\tNVMe specification %d.%d\n\n", (vs & 0xffff0000) >> 16,  (vs & 0x0000ff00) >> 8);
 }
 
 static void show_registers_cc_ams (__u8 ams)
 {
-	printf("\tArbitration Mechanism Selected     (AMS): ");
+	fprintf(nvme_out(), "\tArbitration Mechanism Selected     (AMS): ");
 	switch (ams) {
 	case 0:
-		printf("Round Robin\n");
+		fprintf(nvme_out(), "Round Robin\n");
 		break;
 	case 1:
-		printf("Weighted Round Robin with Urgent Priority Class\n");
+		fprintf(nvme_out(), "Weighted Round Robin with Urgent Priority Class\n");
 		break;
 	case 7:
-		printf("Vendor Specific\n");
+		fprintf(nvme_out(), "Vendor Specific\n");
 		break;
 	default:
-		printf("Reserved\n");
+		fprintf(nvme_out(), "Reserved\n");
 	}
 }
 
 static void show_registers_cc_shn (__u8 shn)
 {
-	printf("\tShutdown Notification              (SHN): ");
+	fprintf(nvme_out(), "\tShutdown Notification              (SHN): ");
 	switch (shn) {
 	case 0:
-		printf("No notification; no effect\n");
+		fprintf(nvme_out(), "No notification; no effect\n");
 		break;
 	case 1:
-		printf("Normal shutdown notification\n");
+		fprintf(nvme_out(), "Normal shutdown notification\n");
 		break;
 	case 2:
-		printf("Abrupt shutdown notification\n");
+		fprintf(nvme_out(), "Abrupt shutdown notification\n");
 		break;
 	default:
-		printf("Reserved\n");
+		fprintf(nvme_out(), "Reserved\n");
 	}
 }
 
 static void show_registers_cc(__u32 cc)
 {
-	printf("\tI/O Completion Queue Entry Size (IOCQES): %u bytes\n", 1 << ((cc & 0x00f00000) >> NVME_CC_IOCQES_SHIFT));
-	printf("\tI/O Submission Queue Entry Size (IOSQES): %u bytes\n", 1 << ((cc & 0x000f0000) >> NVME_CC_IOSQES_SHIFT));
+	fprintf(nvme_out(), "\tI/O Completion Queue Entry Size (IOCQES): %u bytes\n", 1 << ((cc & 0x00f00000) >> NVME_CC_IOCQES_SHIFT));
+	fprintf(nvme_out(), "\tI/O Submission Queue Entry Size (IOSQES): %u bytes\n", 1 << ((cc & 0x000f0000) >> NVME_CC_IOSQES_SHIFT));
 	show_registers_cc_shn((cc & 0x0000c000) >> NVME_CC_SHN_SHIFT);
 	show_registers_cc_ams((cc & 0x00003800) >> NVME_CC_AMS_SHIFT);
-	printf("\tMemory Page Size                   (MPS): %u bytes\n", 1 << (12 + ((cc & 0x00000780) >> NVME_CC_MPS_SHIFT)));
-	printf("\tI/O Command Sets Selected          (CSS): %s\n", (cc & 0x00000070) ? "Reserved":"NVM Command Set");
-	printf("\tEnable                              (EN): %s\n\n", (cc & 0x00000001) ? "Yes":"No");
+	fprintf(nvme_out(), "\tMemory Page Size                   (MPS): %u bytes\n", 1 << (12 + ((cc & 0x00000780) >> NVME_CC_MPS_SHIFT)));
+	fprintf(nvme_out(), "\tI/O Command Sets Selected          (CSS): %s\n", (cc & 0x00000070) ? "Reserved":"NVM Command Set");
+	fprintf(nvme_out(), "\tEnable                              (EN): %s\n\n", (cc & 0x00000001) ? "Yes":"No");
 }
 
 static void show_registers_csts_shst(__u8 shst)
 {
-	printf("\tShutdown Status               (SHST): ");
+	fprintf(nvme_out(), "\tShutdown Status               (SHST): ");
 	switch (shst) {
 	case 0:
-		printf("Normal operation (no shutdown has been requested)\n");
+		fprintf(nvme_out(), "Normal operation (no shutdown has been requested)\n");
 		break;
 	case 1:
-		printf("Shutdown processing occurring\n");
+		fprintf(nvme_out(), "Shutdown processing occurring\n");
 		break;
 	case 2:
-		printf("Shutdown processing complete\n");
+		fprintf(nvme_out(), "Shutdown processing complete\n");
 		break;
 	default:
-		printf("Reserved\n");
+		fprintf(nvme_out(), "Reserved\n");
 	}
 }
 
 static void show_registers_csts(__u32 csts)
 {
-	printf("\tProcessing Paused               (PP): %s\n", (csts & 0x00000020) ? "Yes":"No");
-	printf("\tNVM Subsystem Reset Occurred (NSSRO): %s\n", (csts & 0x00000010) ? "Yes":"No");
+	fprintf(nvme_out(), "\tProcessing Paused               (PP): %s\n", (csts & 0x00000020) ? "Yes":"No");
+	fprintf(nvme_out(), "\tNVM Subsystem Reset Occurred (NSSRO): %s\n", (csts & 0x00000010) ? "Yes":"No");
 	show_registers_csts_shst((csts & 0x0000000c) >> 2);
-	printf("\tController Fatal Status        (CFS): %s\n", (csts & 0x00000002) ? "True":"False");
-	printf("\tReady                          (RDY): %s\n\n", (csts & 0x00000001) ? "Yes":"No");
+	fprintf(nvme_out(), "\tController Fatal Status        (CFS): %s\n", (csts & 0x00000002) ? "True":"False");
+	fprintf(nvme_out(), "\tReady                          (RDY): %s\n\n", (csts & 0x00000001) ? "Yes":"No");
 
 }
 
 static void show_registers_aqa(__u32 aqa)
 {
-	printf("\tAdmin Completion Queue Size (ACQS): %u\n", ((aqa & 0x0fff0000) >> 16)+1);
-	printf("\tAdmin Submission Queue Size (ASQS): %u\n\n", (aqa & 0x00000fff)+1);
+	fprintf(nvme_out(), "\tAdmin Completion Queue Size (ACQS): %u\n", ((aqa & 0x0fff0000) >> 16)+1);
+	fprintf(nvme_out(), "\tAdmin Submission Queue Size (ASQS): %u\n\n", (aqa & 0x00000fff)+1);
 
 }
 
 static void show_registers_cmbloc(__u32 cmbloc, __u32 cmbsz)
 {
 	if (cmbsz == 0) {
-		printf("\tController Memory Buffer feature is not supported\n\n");
+		fprintf(nvme_out(), "\tController Memory Buffer feature is not supported\n\n");
 		return;
 	}
 
         static const char *enforced[] = { "Enforced", "Not Enforced" };
 
-	printf("\tOffset                                                        (OFST): 0x%x (See cmbsz.szu for granularity)\n",
+	fprintf(nvme_out(), "\tOffset                                                        (OFST): 0x%x (See cmbsz.szu for granularity)\n",
 			(cmbloc & 0xfffff000) >> 12);
 
-	printf("\tCMB Queue Dword Alignment                                     (CQDA): %d\n",
+	fprintf(nvme_out(), "\tCMB Queue Dword Alignment                                     (CQDA): %d\n",
 			(cmbloc & 0x00000100) >> 8);
 
-	printf("\tCMB Data Metadata Mixed Memory Support                      (CDMMMS): %s\n",
+	fprintf(nvme_out(), "\tCMB Data Metadata Mixed Memory Support                      (CDMMMS): %s\n",
 			enforced[(cmbloc & 0x00000080) >> 7]);
 
-	printf("\tCMB Data Pointer and Command Independent Locations Support (CDPCILS): %s\n",
+	fprintf(nvme_out(), "\tCMB Data Pointer and Command Independent Locations Support (CDPCILS): %s\n",
 			enforced[(cmbloc & 0x00000040) >> 6]);
 
-	printf("\tCMB Data Pointer Mixed Locations Support                    (CDPMLS): %s\n",
+	fprintf(nvme_out(), "\tCMB Data Pointer Mixed Locations Support                    (CDPMLS): %s\n",
 			enforced[(cmbloc & 0x00000020) >> 5]);
 
-	printf("\tCMB Queue Physically Discontiguous Support                   (CQPDS): %s\n",
+	fprintf(nvme_out(), "\tCMB Queue Physically Discontiguous Support                   (CQPDS): %s\n",
 			enforced[(cmbloc & 0x00000010) >> 4]);
 
-	printf("\tCMB Queue Mixed Memory Support                               (CQMMS): %s\n",
+	fprintf(nvme_out(), "\tCMB Queue Mixed Memory Support                               (CQMMS): %s\n",
 			enforced[(cmbloc & 0x00000008) >> 3]);
 
-	printf("\tBase Indicator Register                                        (BIR): 0x%x\n\n",
+	fprintf(nvme_out(), "\tBase Indicator Register                                        (BIR): 0x%x\n\n",
 			(cmbloc & 0x00000007));
 }
 
@@ -3365,94 +3274,94 @@ static const char *nvme_register_szu_to_string(__u8 szu)
 static void show_registers_cmbsz(__u32 cmbsz)
 {
 	if (cmbsz == 0) {
-		printf("\tController Memory Buffer feature is not supported\n\n");
+		fprintf(nvme_out(), "\tController Memory Buffer feature is not supported\n\n");
 		return;
 	}
-	printf("\tSize                      (SZ): %u\n", (cmbsz & 0xfffff000) >> 12);
-	printf("\tSize Units               (SZU): %s\n", nvme_register_szu_to_string((cmbsz & 0x00000f00) >> 8));
-	printf("\tWrite Data Support       (WDS): Write Data and metadata transfer in Controller Memory Buffer is %s\n",
+	fprintf(nvme_out(), "\tSize                      (SZ): %u\n", (cmbsz & 0xfffff000) >> 12);
+	fprintf(nvme_out(), "\tSize Units               (SZU): %s\n", nvme_register_szu_to_string((cmbsz & 0x00000f00) >> 8));
+	fprintf(nvme_out(), "\tWrite Data Support       (WDS): Write Data and metadata transfer in Controller Memory Buffer is %s\n",
 			(cmbsz & 0x00000010) ? "Supported":"Not supported");
-	printf("\tRead Data Support        (RDS): Read Data and metadata transfer in Controller Memory Buffer is %s\n",
+	fprintf(nvme_out(), "\tRead Data Support        (RDS): Read Data and metadata transfer in Controller Memory Buffer is %s\n",
 			(cmbsz & 0x00000008) ? "Supported":"Not supported");
-	printf("\tPRP SGL List Support   (LISTS): PRP/SG Lists in Controller Memory Buffer is %s\n",
+	fprintf(nvme_out(), "\tPRP SGL List Support   (LISTS): PRP/SG Lists in Controller Memory Buffer is %s\n",
 			(cmbsz & 0x00000004) ? "Supported":"Not supported");
-	printf("\tCompletion Queue Support (CQS): Admin and I/O Completion Queues in Controller Memory Buffer is %s\n",
+	fprintf(nvme_out(), "\tCompletion Queue Support (CQS): Admin and I/O Completion Queues in Controller Memory Buffer is %s\n",
 			(cmbsz & 0x00000002) ? "Supported":"Not supported");
-	printf("\tSubmission Queue Support (SQS): Admin and I/O Submission Queues in Controller Memory Buffer is %s\n\n",
+	fprintf(nvme_out(), "\tSubmission Queue Support (SQS): Admin and I/O Submission Queues in Controller Memory Buffer is %s\n\n",
 			(cmbsz & 0x00000001) ? "Supported":"Not supported");
 }
 
 static void show_registers_bpinfo_brs(__u8 brs)
 {
-	printf("\tBoot Read Status                (BRS): ");
+	fprintf(nvme_out(), "\tBoot Read Status                (BRS): ");
 	switch (brs) {
 	case 0:
-		printf("No Boot Partition read operation requested\n");
+		fprintf(nvme_out(), "No Boot Partition read operation requested\n");
 		break;
 	case 1:
-		printf("Boot Partition read in progress\n");
+		fprintf(nvme_out(), "Boot Partition read in progress\n");
 		break;
 	case 2:
-		printf("Boot Partition read completed successfully\n");
+		fprintf(nvme_out(), "Boot Partition read completed successfully\n");
 		break;
 	case 3:
-		printf("Error completing Boot Partition read\n");
+		fprintf(nvme_out(), "Error completing Boot Partition read\n");
 		break;
 	default:
-		printf("Invalid\n");
+		fprintf(nvme_out(), "Invalid\n");
 	}
 }
 
 static void show_registers_bpinfo(__u32 bpinfo)
 {
 	if (bpinfo == 0) {
-		printf("\tBoot Partition feature is not supported\n\n");
+		fprintf(nvme_out(), "\tBoot Partition feature is not supported\n\n");
 		return;
 	}
 
-	printf("\tActive Boot Partition ID      (ABPID): %u\n", (bpinfo & 0x80000000) >> 31);
+	fprintf(nvme_out(), "\tActive Boot Partition ID      (ABPID): %u\n", (bpinfo & 0x80000000) >> 31);
 	show_registers_bpinfo_brs((bpinfo & 0x03000000) >> 24);
-	printf("\tBoot Partition Size            (BPSZ): %u\n", bpinfo & 0x00007fff);
+	fprintf(nvme_out(), "\tBoot Partition Size            (BPSZ): %u\n", bpinfo & 0x00007fff);
 }
 
 static void show_registers_bprsel(__u32 bprsel)
 {
 	if (bprsel == 0) {
-		printf("\tBoot Partition feature is not supported\n\n");
+		fprintf(nvme_out(), "\tBoot Partition feature is not supported\n\n");
 		return;
 	}
 
-	printf("\tBoot Partition Identifier      (BPID): %u\n", (bprsel & 0x80000000) >> 31);
-	printf("\tBoot Partition Read Offset    (BPROF): %x\n", (bprsel & 0x3ffffc00) >> 10);
-	printf("\tBoot Partition Read Size      (BPRSZ): %x\n", bprsel & 0x000003ff);
+	fprintf(nvme_out(), "\tBoot Partition Identifier      (BPID): %u\n", (bprsel & 0x80000000) >> 31);
+	fprintf(nvme_out(), "\tBoot Partition Read Offset    (BPROF): %x\n", (bprsel & 0x3ffffc00) >> 10);
+	fprintf(nvme_out(), "\tBoot Partition Read Size      (BPRSZ): %x\n", bprsel & 0x000003ff);
 }
 
 static void show_registers_bpmbl(uint64_t bpmbl)
 {
 	if (bpmbl == 0) {
-		printf("\tBoot Partition feature is not supported\n\n");
+		fprintf(nvme_out(), "\tBoot Partition feature is not supported\n\n");
 		return;
 	}
 
-	printf("\tBoot Partition Memory Buffer Base Address (BMBBA): %"PRIx64"\n", bpmbl);
+	fprintf(nvme_out(), "\tBoot Partition Memory Buffer Base Address (BMBBA): %"PRIx64"\n", bpmbl);
 }
 
 static void show_registers_pmrcap(__u32 pmrcap)
 {
-	printf("\tPersistent Memory Region Timeout		    (PMRTO): %x\n", (pmrcap & 0x00ff0000) >> 16);
-	printf("\tPersistent Memory Region Write Barrier Mechanisms(PMRWBM): %x\n", (pmrcap & 0x00003c00) >> 10);
-	printf("\tPersistent Memory Region Time Units		    (PMRTU): PMR time unit is %s\n",
+	fprintf(nvme_out(), "\tPersistent Memory Region Timeout		    (PMRTO): %x\n", (pmrcap & 0x00ff0000) >> 16);
+	fprintf(nvme_out(), "\tPersistent Memory Region Write Barrier Mechanisms(PMRWBM): %x\n", (pmrcap & 0x00003c00) >> 10);
+	fprintf(nvme_out(), "\tPersistent Memory Region Time Units		    (PMRTU): PMR time unit is %s\n",
 			(pmrcap & 0x00000300) >> 8 ? "minutes":"500 milliseconds");
-	printf("\tBase Indicator Register			      (BIR): %x\n", (pmrcap & 0x000000e0) >> 5);
-	printf("\tWrite Data Support				      (WDS): Write data to the PMR is %s\n",
+	fprintf(nvme_out(), "\tBase Indicator Register			      (BIR): %x\n", (pmrcap & 0x000000e0) >> 5);
+	fprintf(nvme_out(), "\tWrite Data Support				      (WDS): Write data to the PMR is %s\n",
 			(pmrcap & 0x00000010) ? "supported":"not supported");
-	printf("\tRead Data Support				      (RDS): Read data from the PMR is %s\n",
+	fprintf(nvme_out(), "\tRead Data Support				      (RDS): Read data from the PMR is %s\n",
 			(pmrcap & 0x00000008) ? "supported":"not supported");
 }
 
 static void show_registers_pmrctl(__u32 pmrctl)
 {
-	printf("\tEnable (EN): PMR is %s\n", (pmrctl & 0x00000001) ? "READY":"Disabled");
+	fprintf(nvme_out(), "\tEnable (EN): PMR is %s\n", (pmrctl & 0x00000001) ? "READY":"Disabled");
 }
 
 static const char *nvme_register_pmr_hsts_to_string(__u8 hsts)
@@ -3468,11 +3377,11 @@ static const char *nvme_register_pmr_hsts_to_string(__u8 hsts)
 
 static void show_registers_pmrsts(__u32 pmrsts, __u32 pmrctl)
 {
-	printf("\tHealth Status (HSTS): %s\n", nvme_register_pmr_hsts_to_string((pmrsts & 0x00000e00) >> 9));
-	printf("\tNot Ready	(NRDY): The Persistent Memory Region is %s to process "\
+	fprintf(nvme_out(), "\tHealth Status (HSTS): %s\n", nvme_register_pmr_hsts_to_string((pmrsts & 0x00000e00) >> 9));
+	fprintf(nvme_out(), "\tNot Ready	(NRDY): The Persistent Memory Region is %s to process "\
 	       "PCI Express memory read and write requests\n",
 	       (pmrsts & 0x00000100) == 0 && (pmrctl & 0x00000001) ? "READY":"Not Ready");
-	printf("\tError		 (ERR): %x\n", (pmrsts & 0x000000ff));
+	fprintf(nvme_out(), "\tError		 (ERR): %x\n", (pmrsts & 0x000000ff));
 }
 
 static inline uint32_t mmio_read32(void *addr)
@@ -3536,7 +3445,6 @@ void json_ctrl_registers(void *bar)
 	json_object_add_value_int(root, "pmrctl", pmrctl);
 	json_object_add_value_int(root, "pmrsts", pmrsts);
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -3569,90 +3477,90 @@ void show_ctrl_registers(void *bar, unsigned int mode, bool fabrics)
 
 	if (human) {
 		if (cap != 0xffffffff) {
-			printf("cap     : %"PRIx64"\n", cap);
+			fprintf(nvme_out(), "cap     : %"PRIx64"\n", cap);
 			show_registers_cap((struct nvme_bar_cap *)&cap);
 		}
 		if (vs != 0xffffffff) {
-			printf("version : %x\n", vs);
+			fprintf(nvme_out(), "version : %x\n", vs);
 			show_registers_version(vs);
 		}
 		if (cc != 0xffffffff) {
-			printf("cc      : %x\n", cc);
+			fprintf(nvme_out(), "cc      : %x\n", cc);
 			show_registers_cc(cc);
 		}
 		if (csts != 0xffffffff) {
-			printf("csts    : %x\n", csts);
+			fprintf(nvme_out(), "csts    : %x\n", csts);
 			show_registers_csts(csts);
 		}
 		if (nssr != 0xffffffff) {
-			printf("nssr    : %x\n", nssr);
-			printf("\tNVM Subsystem Reset Control (NSSRC): %u\n\n", nssr);
+			fprintf(nvme_out(), "nssr    : %x\n", nssr);
+			fprintf(nvme_out(), "\tNVM Subsystem Reset Control (NSSRC): %u\n\n", nssr);
 		}
 		if (!fabrics) {
-			printf("intms   : %x\n", intms);
-			printf("\tInterrupt Vector Mask Set (IVMS): %x\n\n",
+			fprintf(nvme_out(), "intms   : %x\n", intms);
+			fprintf(nvme_out(), "\tInterrupt Vector Mask Set (IVMS): %x\n\n",
 					intms);
 
-			printf("intmc   : %x\n", intmc);
-			printf("\tInterrupt Vector Mask Clear (IVMC): %x\n\n",
+			fprintf(nvme_out(), "intmc   : %x\n", intmc);
+			fprintf(nvme_out(), "\tInterrupt Vector Mask Clear (IVMC): %x\n\n",
 					intmc);
-			printf("aqa     : %x\n", aqa);
+			fprintf(nvme_out(), "aqa     : %x\n", aqa);
 			show_registers_aqa(aqa);
 
-			printf("asq     : %"PRIx64"\n", asq);
-			printf("\tAdmin Submission Queue Base (ASQB): %"PRIx64"\n\n",
+			fprintf(nvme_out(), "asq     : %"PRIx64"\n", asq);
+			fprintf(nvme_out(), "\tAdmin Submission Queue Base (ASQB): %"PRIx64"\n\n",
 					asq);
 
-			printf("acq     : %"PRIx64"\n", acq);
-			printf("\tAdmin Completion Queue Base (ACQB): %"PRIx64"\n\n",
+			fprintf(nvme_out(), "acq     : %"PRIx64"\n", acq);
+			fprintf(nvme_out(), "\tAdmin Completion Queue Base (ACQB): %"PRIx64"\n\n",
 					acq);
 
-			printf("cmbloc  : %x\n", cmbloc);
+			fprintf(nvme_out(), "cmbloc  : %x\n", cmbloc);
 			show_registers_cmbloc(cmbloc, cmbsz);
 
-			printf("cmbsz   : %x\n", cmbsz);
+			fprintf(nvme_out(), "cmbsz   : %x\n", cmbsz);
 			show_registers_cmbsz(cmbsz);
 
-			printf("bpinfo  : %x\n", bpinfo);
+			fprintf(nvme_out(), "bpinfo  : %x\n", bpinfo);
 			show_registers_bpinfo(bpinfo);
 
-			printf("bprsel  : %x\n", bprsel);
+			fprintf(nvme_out(), "bprsel  : %x\n", bprsel);
 			show_registers_bprsel(bprsel);
 
-			printf("bpmbl   : %"PRIx64"\n", bpmbl);
+			fprintf(nvme_out(), "bpmbl   : %"PRIx64"\n", bpmbl);
 			show_registers_bpmbl(bpmbl);
 
-			printf("pmrcap  : %x\n", pmrcap);
+			fprintf(nvme_out(), "pmrcap  : %x\n", pmrcap);
 			show_registers_pmrcap(pmrcap);
 
-			printf("pmrctl  : %x\n", pmrctl);
+			fprintf(nvme_out(), "pmrctl  : %x\n", pmrctl);
 			show_registers_pmrctl(pmrctl);
 
-			printf("pmrsts  : %x\n", pmrsts);
+			fprintf(nvme_out(), "pmrsts  : %x\n", pmrsts);
 			show_registers_pmrsts(pmrsts, pmrctl);
 		}
 	} else {
 		if (cap != 0xffffffff)
-			printf("cap     : %"PRIx64"\n", cap);
+			fprintf(nvme_out(), "cap     : %"PRIx64"\n", cap);
 		if (vs != 0xffffffff)
-			printf("version : %x\n", vs);
+			fprintf(nvme_out(), "version : %x\n", vs);
 		if (cc != 0xffffffff)
-			printf("cc      : %x\n", cc);
+			fprintf(nvme_out(), "cc      : %x\n", cc);
 		if (csts != 0xffffffff)
-			printf("csts    : %x\n", csts);
+			fprintf(nvme_out(), "csts    : %x\n", csts);
 		if (nssr != 0xffffffff)
-			printf("nssr    : %x\n", nssr);
+			fprintf(nvme_out(), "nssr    : %x\n", nssr);
 		if (!fabrics) {
-			printf("intms   : %x\n", intms);
-			printf("intmc   : %x\n", intmc);
-			printf("aqa     : %x\n", aqa);
-			printf("asq     : %"PRIx64"\n", asq);
-			printf("acq     : %"PRIx64"\n", acq);
-			printf("cmbloc  : %x\n", cmbloc);
-			printf("cmbsz   : %x\n", cmbsz);
-			printf("bpinfo  : %x\n", bpinfo);
-			printf("bprsel  : %x\n", bprsel);
-			printf("bpmbl   : %"PRIx64"\n", bpmbl);
+			fprintf(nvme_out(), "intms   : %x\n", intms);
+			fprintf(nvme_out(), "intmc   : %x\n", intmc);
+			fprintf(nvme_out(), "aqa     : %x\n", aqa);
+			fprintf(nvme_out(), "asq     : %"PRIx64"\n", asq);
+			fprintf(nvme_out(), "acq     : %"PRIx64"\n", acq);
+			fprintf(nvme_out(), "cmbloc  : %x\n", cmbloc);
+			fprintf(nvme_out(), "cmbsz   : %x\n", cmbsz);
+			fprintf(nvme_out(), "bpinfo  : %x\n", bpinfo);
+			fprintf(nvme_out(), "bprsel  : %x\n", bprsel);
+			fprintf(nvme_out(), "bpmbl   : %"PRIx64"\n", bpmbl);
 		}
 	}
 }
@@ -3663,10 +3571,10 @@ void show_single_property(int offset, uint64_t value64, int human)
 
 	if (!human) {
 		if (is_64bit_reg(offset))
-			printf("property: 0x%02x (%s), value: %"PRIx64"\n", offset,
+			fprintf(nvme_out(), "property: 0x%02x (%s), value: %"PRIx64"\n", offset,
 				   nvme_register_to_string(offset), value64);
 		else
-			printf("property: 0x%02x (%s), value: %x\n", offset,
+			fprintf(nvme_out(), "property: 0x%02x (%s), value: %x\n", offset,
 				   nvme_register_to_string(offset),
 				   (uint32_t) value64);
 
@@ -3677,32 +3585,32 @@ void show_single_property(int offset, uint64_t value64, int human)
 
 	switch (offset) {
 	case NVME_REG_CAP:
-		printf("cap : %"PRIx64"\n", value64);
+		fprintf(nvme_out(), "cap : %"PRIx64"\n", value64);
 		show_registers_cap((struct nvme_bar_cap *)&value64);
 		break;
 
 	case NVME_REG_VS:
-		printf("version : %x\n", value32);
+		fprintf(nvme_out(), "version : %x\n", value32);
 		show_registers_version(value32);
 		break;
 
 	case NVME_REG_CC:
-		printf("cc : %x\n", value32);
+		fprintf(nvme_out(), "cc : %x\n", value32);
 		show_registers_cc(value32);
 		break;
 
 	case NVME_REG_CSTS:
-		printf("csts : %x\n", value32);
+		fprintf(nvme_out(), "csts : %x\n", value32);
 		show_registers_csts(value32);
 		break;
 
 	case NVME_REG_NSSR:
-		printf("nssr : %x\n", value32);
-		printf("\tNVM Subsystem Reset Control (NSSRC): %u\n\n", value32);
+		fprintf(nvme_out(), "nssr : %x\n", value32);
+		fprintf(nvme_out(), "\tNVM Subsystem Reset Control (NSSRC): %u\n\n", value32);
 		break;
 
 	default:
-		printf("unknown property: 0x%02x (%s), value: %"PRIx64"\n", offset,
+		fprintf(nvme_out(), "unknown property: 0x%02x (%s), value: %"PRIx64"\n", offset,
 			   nvme_register_to_string(offset), value64);
 		break;
 	}
@@ -3,6 +3,7 @@
 
 #include "nvme.h"
 #include "json.h"
+#include "nvme-output.h"
 #include <inttypes.h>
 
 enum {
@@ -37,6 +38,13 @@ void show_ctrl_registers(void *bar, unsigned int mode, bool fabrics);
 void show_single_property(int offset, uint64_t prop, int human);
 void show_nvme_id_ns_descs(void *data);
 void show_lba_status(struct nvme_lba_status *list);
+struct nvme_iogen_result;
+void show_iogen_result(struct nvme_iogen_result *res, const char *command,
+		       unsigned int qd);
+void show_latency_stats(struct nvme_iogen_result *res, const char *command,
+			size_t data_size, unsigned int qd);
+void json_latency_stats(struct nvme_iogen_result *res, const char *command,
+			size_t data_size, unsigned int qd);
 void show_list_items(struct list_item *list_items, unsigned len);
 void show_nvme_subsystem_list(struct subsys_list_item *slist, int n);
 void show_nvme_id_nvmset(struct nvme_id_nvmset *nvmset);
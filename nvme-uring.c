@@ -0,0 +1,520 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/fs.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+
+#include "nvme-uring.h"
+#include "common.h"
+
+enum nvme_backend nvme_get_backend(void)
+{
+	static int backend = -1;
+	const char *env;
+
+	if (backend >= 0)
+		return backend;
+
+	backend = NVME_BACKEND_IOCTL;
+	env = getenv("NVME_IO_BACKEND");
+	if (env && !strcmp(env, "io_uring")) {
+#ifdef IOURING
+		backend = NVME_BACKEND_IO_URING;
+#else
+		fprintf(stderr, "io_uring backend not built in, using ioctl\n");
+#endif
+	}
+	return backend;
+}
+
+#ifdef IOURING
+#include <linux/io_uring.h>
+
+#define NVME_URING_SQE_SHIFT	7	/* IORING_SETUP_SQE128 */
+#define NVME_URING_CQE_SHIFT	5	/* IORING_SETUP_CQE32 */
+#define NVME_URING_MAX_DEVS	32
+
+struct nvme_uring {
+	int fd;
+	unsigned int sq_entries;
+	unsigned int pending;
+	unsigned int inflight;
+
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	void *sqes;
+	void *cqes;
+
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+};
+
+/*
+ * What a device resolves to. Only properties of the device are kept,
+ * never a file descriptor: the caller's may be closed and its number
+ * reused as soon as the command returns.
+ */
+struct nvme_uring_dev {
+	dev_t rdev;
+	bool blk;
+	bool admin;
+	int err;
+	__u32 nsid;
+	unsigned int lba_size;
+	char ng[32];		/* generic node to open, "" for the fd itself */
+};
+
+static struct nvme_uring_dev uring_devs[NVME_URING_MAX_DEVS];
+static int nr_uring_devs;
+static pthread_mutex_t uring_devs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int nvme_uring_resolve(int fd, struct stat *st, bool admin,
+			      struct nvme_uring_dev *dev)
+{
+	char path[64], link[PATH_MAX];
+	const char *name;
+	bool blk = S_ISBLK(st->st_mode);
+	ssize_t len;
+	int nsid;
+
+	snprintf(path, sizeof(path), "/sys/dev/%s/%u:%u", blk ? "block" : "char",
+		 major(st->st_rdev), minor(st->st_rdev));
+	len = readlink(path, link, sizeof(link) - 1);
+	if (len < 0)
+		return -errno;
+	link[len] = '\0';
+	name = basename(link);
+
+	if (admin) {
+		/* admin uring commands are only accepted on /dev/nvmeX */
+		if (blk || strncmp(name, "nvme", 4) || strchr(name + 4, 'n'))
+			return -ENOTSUP;
+		return 0;
+	}
+
+	nsid = ioctl(fd, NVME_IOCTL_ID);
+	if (nsid <= 0)
+		return -ENOTSUP;
+	dev->nsid = nsid;
+
+	if (!blk)
+		return strncmp(name, "ng", 2) ? -ENOTSUP : 0;
+
+	if (strncmp(name, "nvme", 4))
+		return -ENOTSUP;
+	if (ioctl(fd, BLKSSZGET, &dev->lba_size) < 0)
+		dev->lba_size = 0;
+	snprintf(dev->ng, sizeof(dev->ng), "/dev/ng%s", name + 4);
+	return 0;
+}
+
+/*
+ * Looks up the character device a command for @fd has to be sent to:
+ * the generic /dev/ngXnY node for I/O on a namespace block device, or
+ * @fd itself otherwise. What the device resolves to is cached; a node
+ * opened here is released by nvme_uring_put_target().
+ */
+int nvme_uring_get_target(int fd, bool admin, struct nvme_uring_target *t)
+{
+	struct nvme_uring_dev *dev, tmp;
+	struct stat st;
+	int i, err;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	if (!S_ISBLK(st.st_mode) && !S_ISCHR(st.st_mode))
+		return -ENOTSUP;
+
+	pthread_mutex_lock(&uring_devs_lock);
+	for (i = 0; i < nr_uring_devs; i++) {
+		dev = &uring_devs[i];
+		if (dev->rdev == st.st_rdev && dev->admin == admin &&
+		    dev->blk == !!S_ISBLK(st.st_mode))
+			goto found;
+	}
+
+	dev = nr_uring_devs < NVME_URING_MAX_DEVS ?
+		&uring_devs[nr_uring_devs++] : &tmp;
+	memset(dev, 0, sizeof(*dev));
+	dev->rdev = st.st_rdev;
+	dev->blk = S_ISBLK(st.st_mode);
+	dev->admin = admin;
+	dev->err = nvme_uring_resolve(fd, &st, admin, dev);
+found:
+	err = dev->err;
+	memset(t, 0, sizeof(*t));
+	t->fd = fd;
+	t->nsid = dev->nsid;
+	t->lba_size = dev->lba_size;
+	if (!err && dev->ng[0]) {
+		t->fd = open(dev->ng, O_RDONLY);
+		if (t->fd < 0)
+			err = -errno;
+		else
+			t->close = true;
+	}
+	pthread_mutex_unlock(&uring_devs_lock);
+	return err;
+}
+
+void nvme_uring_put_target(struct nvme_uring_target *t)
+{
+	if (t->close)
+		close(t->fd);
+	t->close = false;
+}
+
+struct nvme_uring *nvme_uring_create(unsigned int depth)
+{
+	struct io_uring_params p;
+	struct nvme_uring *ring;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_SQE128 | IORING_SETUP_CQE32;
+	ring->fd = syscall(__NR_io_uring_setup, depth, &p);
+	if (ring->fd < 0)
+		goto free_ring;
+
+	ring->sq_entries = p.sq_entries;
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(__u32);
+	ring->cq_size = p.cq_off.cqes +
+		((size_t)p.cq_entries << NVME_URING_CQE_SHIFT);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->sq_size = ring->cq_size = max(ring->sq_size, ring->cq_size);
+
+	ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->fd,
+			    IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED)
+		goto close_fd;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+				    MAP_SHARED | MAP_POPULATE, ring->fd,
+				    IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED)
+			goto unmap_sq;
+	}
+
+	ring->sqes_size = (size_t)p.sq_entries << NVME_URING_SQE_SHIFT;
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto unmap_cq;
+
+	ring->sq_head = ring->sq_ptr + p.sq_off.head;
+	ring->sq_tail = ring->sq_ptr + p.sq_off.tail;
+	ring->sq_mask = ring->sq_ptr + p.sq_off.ring_mask;
+	ring->sq_array = ring->sq_ptr + p.sq_off.array;
+	ring->cq_head = ring->cq_ptr + p.cq_off.head;
+	ring->cq_tail = ring->cq_ptr + p.cq_off.tail;
+	ring->cq_mask = ring->cq_ptr + p.cq_off.ring_mask;
+	ring->cqes = ring->cq_ptr + p.cq_off.cqes;
+	return ring;
+
+unmap_cq:
+	if (ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_size);
+unmap_sq:
+	munmap(ring->sq_ptr, ring->sq_size);
+close_fd:
+	close(ring->fd);
+free_ring:
+	free(ring);
+	return NULL;
+}
+
+/*
+ * The commands the kernel still owns may be transferring data, so they
+ * are waited for before the ring goes away; queued ones not yet
+ * submitted are dropped.
+ */
+void nvme_uring_destroy(struct nvme_uring *ring)
+{
+	struct nvme_uring_cqe cqes[16];
+	int ret;
+
+	if (!ring)
+		return;
+	while (ring->inflight) {
+		ret = syscall(__NR_io_uring_enter, ring->fd, 0, 1,
+			      IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0 && errno != EINTR)
+			break;
+		nvme_uring_reap(ring, cqes, ARRAY_SIZE(cqes));
+	}
+	munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_size);
+	munmap(ring->sq_ptr, ring->sq_size);
+	close(ring->fd);
+	free(ring);
+}
+
+int nvme_uring_queue(struct nvme_uring *ring, int fd, bool admin,
+		     struct nvme_passthru_cmd *cmd, void *priv)
+{
+	struct io_uring_sqe *sqe;
+	struct nvme_uring_cmd *ucmd;
+	unsigned int tail, idx;
+
+	/* never queue more than the CQ ring can hold */
+	if (ring->pending + ring->inflight >= ring->sq_entries)
+		return -EBUSY;
+
+	tail = *ring->sq_tail;
+	idx = tail & *ring->sq_mask;
+	sqe = ring->sqes + ((size_t)idx << NVME_URING_SQE_SHIFT);
+	memset(sqe, 0, 1 << NVME_URING_SQE_SHIFT);
+	sqe->opcode = IORING_OP_URING_CMD;
+	sqe->fd = fd;
+	sqe->cmd_op = admin ? NVME_URING_CMD_ADMIN : NVME_URING_CMD_IO;
+	sqe->user_data = (__u64)(uintptr_t)priv;
+
+	ucmd = (struct nvme_uring_cmd *)sqe->cmd;
+	ucmd->opcode = cmd->opcode;
+	ucmd->flags = cmd->flags;
+	ucmd->rsvd1 = cmd->rsvd1;
+	ucmd->nsid = cmd->nsid;
+	ucmd->cdw2 = cmd->cdw2;
+	ucmd->cdw3 = cmd->cdw3;
+	ucmd->metadata = cmd->metadata;
+	ucmd->addr = cmd->addr;
+	ucmd->metadata_len = cmd->metadata_len;
+	ucmd->data_len = cmd->data_len;
+	ucmd->cdw10 = cmd->cdw10;
+	ucmd->cdw11 = cmd->cdw11;
+	ucmd->cdw12 = cmd->cdw12;
+	ucmd->cdw13 = cmd->cdw13;
+	ucmd->cdw14 = cmd->cdw14;
+	ucmd->cdw15 = cmd->cdw15;
+	ucmd->timeout_ms = cmd->timeout_ms;
+
+	ring->sq_array[idx] = idx;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->pending++;
+	return 0;
+}
+
+/*
+ * Submits everything queued so far and waits for at least @wait_nr
+ * completions. Returns the number of commands handed to the kernel.
+ */
+int nvme_uring_submit(struct nvme_uring *ring, unsigned int wait_nr)
+{
+	int ret;
+
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, ring->pending,
+			      wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0,
+			      NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		return -errno;
+
+	ring->pending -= ret;
+	ring->inflight += ret;
+	return ret;
+}
+
+int nvme_uring_reap(struct nvme_uring *ring, struct nvme_uring_cqe *cqes,
+		    unsigned int max)
+{
+	unsigned int head, tail, n = 0;
+
+	head = *ring->cq_head;
+	tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	while (head != tail && n < max) {
+		struct io_uring_cqe *cqe = ring->cqes +
+			((size_t)(head & *ring->cq_mask) << NVME_URING_CQE_SHIFT);
+
+		cqes[n].priv = (void *)(uintptr_t)cqe->user_data;
+		cqes[n].status = cqe->res;
+		/* the 32 byte CQE carries the NVMe result after the header */
+		cqes[n].result = ((__u64 *)(cqe + 1))[0];
+		head++;
+		n++;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	ring->inflight -= n;
+	return n;
+}
+
+static __thread struct nvme_uring *sync_ring;
+static pthread_key_t sync_ring_key;
+static pthread_once_t sync_ring_once = PTHREAD_ONCE_INIT;
+static int uring_broken;
+static int uring_works;
+
+static void sync_ring_free(void *ring)
+{
+	nvme_uring_destroy(ring);
+}
+
+static void sync_ring_key_init(void)
+{
+	pthread_key_create(&sync_ring_key, sync_ring_free);
+}
+
+/* Each thread gets its own ring, torn down when the thread exits */
+static struct nvme_uring *sync_ring_get(void)
+{
+	if (sync_ring)
+		return sync_ring;
+	pthread_once(&sync_ring_once, sync_ring_key_init);
+	sync_ring = nvme_uring_create(1);
+	if (sync_ring)
+		pthread_setspecific(sync_ring_key, sync_ring);
+	return sync_ring;
+}
+
+/*
+ * Synchronous single command submission to @t, see nvme_uring_passthru().
+ * For callers that already looked the target up.
+ */
+bool nvme_uring_passthru_target(struct nvme_uring_target *t, bool admin,
+				struct nvme_passthru_cmd *cmd, int *err)
+{
+	struct nvme_uring *ring;
+	struct nvme_uring_cqe cqe;
+	int ret;
+
+	if (nvme_get_backend() != NVME_BACKEND_IO_URING ||
+	    __atomic_load_n(&uring_broken, __ATOMIC_RELAXED))
+		return false;
+	ring = sync_ring_get();
+	if (!ring) {
+		__atomic_store_n(&uring_broken, 1, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	if (nvme_uring_queue(ring, t->fd, admin, cmd, cmd))
+		return false;
+	ret = nvme_uring_submit(ring, 1);
+	if (ret < 0) {
+		*err = -1;
+		errno = -ret;
+		return true;
+	}
+	while (!nvme_uring_reap(ring, &cqe, 1))
+		nvme_uring_submit(ring, 1);
+
+	if ((cqe.status == -EOPNOTSUPP || cqe.status == -EINVAL) &&
+	    !__atomic_load_n(&uring_works, __ATOMIC_RELAXED)) {
+		/*
+		 * Kernel without NVMe uring_cmd support, never executed.
+		 * Only the first commands can tell; once one went through,
+		 * -EINVAL is the command's own error.
+		 */
+		__atomic_store_n(&uring_broken, 1, __ATOMIC_RELAXED);
+		return false;
+	}
+	__atomic_store_n(&uring_works, 1, __ATOMIC_RELAXED);
+	if (cqe.status < 0) {
+		*err = -1;
+		errno = -cqe.status;
+	} else {
+		*err = cqe.status;
+		cmd->result = cqe.result;
+	}
+	return true;
+}
+
+/*
+ * Synchronous single command submission used by the nvme-ioctl.c
+ * helpers. Returns false if the command has to go through the ioctl
+ * path instead; otherwise @err follows the ioctl() return convention.
+ */
+bool nvme_uring_passthru(int fd, bool admin, struct nvme_passthru_cmd *cmd,
+			 int *err)
+{
+	struct nvme_uring_target t;
+	bool ret;
+
+	if (nvme_get_backend() != NVME_BACKEND_IO_URING ||
+	    __atomic_load_n(&uring_broken, __ATOMIC_RELAXED))
+		return false;
+	if (nvme_uring_get_target(fd, admin, &t))
+		return false;
+	ret = nvme_uring_passthru_target(&t, admin, cmd, err);
+	nvme_uring_put_target(&t);
+	return ret;
+}
+
+#else /* !IOURING */
+
+int nvme_uring_get_target(int fd, bool admin, struct nvme_uring_target *t)
+{
+	return -ENOTSUP;
+}
+
+void nvme_uring_put_target(struct nvme_uring_target *t)
+{
+}
+
+struct nvme_uring *nvme_uring_create(unsigned int depth)
+{
+	return NULL;
+}
+
+void nvme_uring_destroy(struct nvme_uring *ring)
+{
+}
+
+int nvme_uring_queue(struct nvme_uring *ring, int fd, bool admin,
+		     struct nvme_passthru_cmd *cmd, void *priv)
+{
+	return -ENOTSUP;
+}
+
+int nvme_uring_submit(struct nvme_uring *ring, unsigned int wait_nr)
+{
+	return -ENOTSUP;
+}
+
+int nvme_uring_reap(struct nvme_uring *ring, struct nvme_uring_cqe *cqes,
+		    unsigned int max)
+{
+	return 0;
+}
+
+bool nvme_uring_passthru_target(struct nvme_uring_target *t, bool admin,
+				struct nvme_passthru_cmd *cmd, int *err)
+{
+	return false;
+}
+
+bool nvme_uring_passthru(int fd, bool admin, struct nvme_passthru_cmd *cmd,
+			 int *err)
+{
+	return false;
+}
+
+#endif /* IOURING */
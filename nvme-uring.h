@@ -0,0 +1,66 @@
+#ifndef _NVME_URING_H
+#define _NVME_URING_H
+
+#include <linux/types.h>
+#include <stdbool.h>
+#include "linux/nvme_ioctl.h"
+
+/*
+ * Optional io_uring passthrough backend. It is selected at runtime by
+ * setting NVME_IO_BACKEND=io_uring in the environment; every command
+ * the backend can not carry (old kernel, no generic char device, ...)
+ * silently falls back to the blocking ioctl path.
+ */
+enum nvme_backend {
+	NVME_BACKEND_IOCTL,
+	NVME_BACKEND_IO_URING,
+};
+
+enum nvme_backend nvme_get_backend(void);
+
+/*
+ * nvme_uring_target - where a command for a given fd can be sent
+ * @fd: character device accepting uring commands (/dev/nvmeX for
+ *      admin, /dev/ngXnY for I/O)
+ * @nsid: namespace of the device, 0 for a controller
+ * @lba_size: logical block size, 0 if unknown
+ * @close: @fd was opened for the target, see nvme_uring_put_target()
+ */
+struct nvme_uring_target {
+	int fd;
+	__u32 nsid;
+	unsigned int lba_size;
+	bool close;
+};
+
+int nvme_uring_get_target(int fd, bool admin, struct nvme_uring_target *t);
+void nvme_uring_put_target(struct nvme_uring_target *t);
+
+struct nvme_uring;
+
+/*
+ * nvme_uring_cqe - a reaped completion
+ * @priv: cookie passed to nvme_uring_queue()
+ * @status: NVMe status (> 0), or -errno
+ * @result: completion queue entry dword 0
+ */
+struct nvme_uring_cqe {
+	void *priv;
+	int status;
+	__u32 result;
+};
+
+struct nvme_uring *nvme_uring_create(unsigned int depth);
+void nvme_uring_destroy(struct nvme_uring *ring);
+int nvme_uring_queue(struct nvme_uring *ring, int fd, bool admin,
+		     struct nvme_passthru_cmd *cmd, void *priv);
+int nvme_uring_submit(struct nvme_uring *ring, unsigned int wait_nr);
+int nvme_uring_reap(struct nvme_uring *ring, struct nvme_uring_cqe *cqes,
+		    unsigned int max);
+
+bool nvme_uring_passthru(int fd, bool admin, struct nvme_passthru_cmd *cmd,
+			 int *err);
+bool nvme_uring_passthru_target(struct nvme_uring_target *t, bool admin,
+				struct nvme_passthru_cmd *cmd, int *err);
+
+#endif /* _NVME_URING_H */
@@ -32,10 +32,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <math.h>
 #include <dirent.h>
 #include <libgen.h>
+#include <glob.h>
+#include <pthread.h>
 
 #include <linux/fs.h>
 
@@ -48,6 +51,9 @@
 #include "common.h"
 #include "nvme-print.h"
 #include "nvme-ioctl.h"
+#include "nvme-iogen.h"
+#include "nvme-capture.h"
+#include "nvme-daemon.h"
 #include "nvme-status.h"
 #include "nvme-lightnvm.h"
 #include "plugin.h"
@@ -90,10 +96,76 @@ static unsigned long long elapsed_utime(struct timeval start_time,
 	return ret;
 }
 
+/*
+ * The daemon keeps every device it has opened. A cached descriptor is
+ * handed out again, duplicated so commands can close it as usual, as
+ * long as the path still refers to the same device node.
+ */
+struct dev_cache_entry {
+	struct dev_cache_entry *next;
+	char *path;
+	int fd;
+	struct stat st;
+};
+
+static struct dev_cache_entry *dev_cache;
+static bool dev_cache_enabled;
+
+static int dev_cache_get(const char *dev)
+{
+	struct dev_cache_entry *e, **pe;
+	struct stat st;
+
+	if (stat(dev, &st) < 0)
+		return -1;
+	for (pe = &dev_cache; (e = *pe); pe = &e->next) {
+		if (strcmp(e->path, dev))
+			continue;
+		if (e->st.st_rdev == st.st_rdev && e->st.st_ino == st.st_ino) {
+			nvme_stat = e->st;
+			return dup(e->fd);
+		}
+		/* the node went away or now belongs to another device */
+		*pe = e->next;
+		close(e->fd);
+		free(e->path);
+		free(e);
+		break;
+	}
+	return -1;
+}
+
+static void dev_cache_add(const char *dev, int fd)
+{
+	struct dev_cache_entry *e;
+
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return;
+	e->path = strdup(dev);
+	e->fd = dup(fd);
+	if (!e->path || e->fd < 0) {
+		free(e->path);
+		free(e);
+		return;
+	}
+	e->st = nvme_stat;
+	e->next = dev_cache;
+	dev_cache = e;
+}
+
 static int open_dev(char *dev)
 {
 	int err, fd;
 
+	if (dev_cache_enabled) {
+		fd = dev_cache_get(dev);
+		if (fd >= 0) {
+			devicename = basename(dev);
+			return fd;
+		}
+	}
+
 	devicename = basename(dev);
 	err = open(dev, O_RDONLY);
 	if (err < 0)
@@ -107,6 +179,8 @@ static int open_dev(char *dev)
 		fprintf(stderr, "%s is not a block or character device\n", dev);
 		return -ENODEV;
 	}
+	if (dev_cache_enabled)
+		dev_cache_add(dev, fd);
 	return fd;
 perror:
 	perror(dev);
@@ -150,7 +224,10 @@ int parse_and_open(int argc, char **argv, const char *desc,
 	return ret;
 }
 
-static const char *output_format = "Output format: normal|json|binary";
+static const char *output_format = "Output format: normal|json|json-compact|ndjson|cbor|binary";
+
+/* the last command asked for binary output, see batch_result() */
+static bool binary_output;
 
 int validate_output_format(char *format)
 {
@@ -158,10 +235,27 @@ int validate_output_format(char *format)
 		return -EINVAL;
 	if (!strcmp(format, "normal"))
 		return NORMAL;
-	if (!strcmp(format, "json"))
+	if (!strcmp(format, "json")) {
+		json_set_format(JSON_FMT_PRETTY);
+		return JSON;
+	}
+	if (!strcmp(format, "json-compact")) {
+		json_set_format(JSON_FMT_COMPACT);
+		return JSON;
+	}
+	if (!strcmp(format, "ndjson")) {
+		json_set_format(JSON_FMT_NDJSON);
+		return JSON;
+	}
+	if (!strcmp(format, "cbor")) {
+		json_set_format(JSON_FMT_CBOR);
+		binary_output = true;
 		return JSON;
-	if (!strcmp(format, "binary"))
+	}
+	if (!strcmp(format, "binary")) {
+		binary_output = true;
 		return BINARY;
+	}
 	return -EINVAL;
 }
 
@@ -311,9 +405,9 @@ static int get_telemetry_log(int argc, char **argv, struct command *cmd, struct
 	const char *dgen = "Pick which telemetry data area to report. Default is all. Valid options are 1, 2, 3.";
 	const size_t bs = 512;
 	struct nvme_telemetry_log_page_hdr *hdr;
+	struct nvme_capture cap;
 	size_t full_size, offset = bs;
 	int err = 0, fd, output;
-	void *page_log;
 
 	struct config {
 		char *file_name;
@@ -350,8 +444,7 @@ static int get_telemetry_log(int argc, char **argv, struct command *cmd, struct
 
 	cfg.host_gen = !!cfg.host_gen;
 	hdr = malloc(bs);
-	page_log = malloc(bs);
-	if (!hdr || !page_log) {
+	if (!hdr) {
 		fprintf(stderr, "Failed to allocate %zu bytes for log: %s\n",
 				bs, strerror(errno));
 		err = -ENOMEM;
@@ -368,9 +461,10 @@ static int get_telemetry_log(int argc, char **argv, struct command *cmd, struct
 	}
 
 	err = nvme_get_telemetry_log(fd, hdr, cfg.host_gen, cfg.ctrl_init, bs, 0);
-	if (err < 0)
+	if (err < 0) {
 		perror("get-telemetry-log");
-	else if (err > 0) {
+		goto close_output;
+	} else if (err > 0) {
 		show_nvme_status(err);
 		fprintf(stderr, "Failed to acquire telemetry header %d!\n", err);
 		goto close_output;
@@ -399,33 +493,31 @@ static int get_telemetry_log(int argc, char **argv, struct command *cmd, struct
 	}
 
 	/*
-	 * Continuously pull data until the offset hits the end of the last
-	 * block.
+	 * Pull the data areas in the largest transfers the controller
+	 * allows, writing out one chunk while the next is being read.
 	 */
-	while (offset != full_size) {
-		err = nvme_get_telemetry_log(fd, page_log, 0, cfg.ctrl_init, bs, offset);
-		if (err < 0) {
-			perror("get-telemetry-log");
-			break;
-		} else if (err > 0) {
-			fprintf(stderr, "Failed to acquire full telemetry log!\n");
-			show_nvme_status(err);
-			break;
-		}
-
-		err = write(output, (void *) page_log, bs);
-		if (err != bs) {
-			fprintf(stderr, "Failed to flush all data to file!");
-			break;
-		}
-		offset += bs;
+	memset(&cap, 0, sizeof(cap));
+	cap.fd = fd;
+	cap.out = output;
+	cap.offset = offset;
+	cap.len = full_size - offset;
+	cap.nsid = NVME_NSID_ALL;
+	cap.log_id = cfg.ctrl_init ? NVME_LOG_TELEMETRY_CTRL :
+				     NVME_LOG_TELEMETRY_HOST;
+	cap.rae = true;
+	cap.progress = true;
+	err = nvme_capture_log(&cap);
+	if (err < 0)
+		fprintf(stderr, "get-telemetry-log: %s\n", strerror(-err));
+	else if (err > 0) {
+		fprintf(stderr, "Failed to acquire full telemetry log!\n");
+		show_nvme_status(err);
 	}
 
 close_output:
 	close(output);
 free_mem:
 	free(hdr);
-	free(page_log);
 close_fd:
 	close(fd);
 ret:
@@ -838,12 +930,12 @@ static int get_log(int argc, char **argv, struct command *cmd, struct plugin *pl
 			goto close_fd;
 		}
 
-		err = nvme_get_log14(fd, cfg.namespace_id, cfg.log_id,
-				     cfg.lsp, cfg.lpo, 0, cfg.rae,
-				     cfg.uuid_index, cfg.log_len, log);
+		err = nvme_get_log_split(fd, cfg.namespace_id, cfg.log_id,
+					 cfg.lsp, cfg.lpo, 0, cfg.rae,
+					 cfg.uuid_index, cfg.log_len, log);
 		if (!err) {
 			if (!cfg.raw_binary) {
-				printf("Device:%s log-id:%d namespace-id:%#x\n",
+				fprintf(nvme_out(), "Device:%s log-id:%d namespace-id:%#x\n",
 				       devicename, cfg.log_id,
 				       cfg.namespace_id);
 				d(log, cfg.log_len, 16, 1);
@@ -968,7 +1060,7 @@ static int list_ctrl(int argc, char **argv, struct command *cmd, struct plugin *
 		__u16 num = le16_to_cpu(cntlist->num);
 
 		for (i = 0; i < (min(num, 2048)); i++)
-			printf("[%4u]:%#x\n", i, le16_to_cpu(cntlist->identifier[i]));
+			fprintf(nvme_out(), "[%4u]:%#x\n", i, le16_to_cpu(cntlist->identifier[i]));
 	}
 	else if (err > 0)
 		show_nvme_status(err);
@@ -1024,7 +1116,7 @@ static int list_ns(int argc, char **argv, struct command *cmd, struct plugin *pl
 	if (!err) {
 		for (i = 0; i < 1024; i++)
 			if (ns_list[i])
-				printf("[%4u]:%#x\n", i, le32_to_cpu(ns_list[i]));
+				fprintf(nvme_out(), "[%4u]:%#x\n", i, le32_to_cpu(ns_list[i]));
 	} else if (err > 0) {
 		show_nvme_status(err);
 	} else {
@@ -1098,7 +1190,7 @@ static int delete_ns(int argc, char **argv, struct command *cmd, struct plugin *
 
 	err = nvme_ns_delete(fd, cfg.namespace_id, cfg.timeout);
 	if (!err)
-		printf("%s: Success, deleted nsid:%d\n", cmd->name,
+		fprintf(nvme_out(), "%s: Success, deleted nsid:%d\n", cmd->name,
 								cfg.namespace_id);
 	else if (err > 0)
 		show_nvme_status(err);
@@ -1166,7 +1258,7 @@ static int nvme_attach_ns(int argc, char **argv, int attach, const char *desc, s
 		err = nvme_ns_detach_ctrls(fd, cfg.namespace_id, num, ctrlist);
 
 	if (!err)
-		printf("%s: Success, nsid:%d\n", cmd->name, cfg.namespace_id);
+		fprintf(nvme_out(), "%s: Success, nsid:%d\n", cmd->name, cfg.namespace_id);
 	else if (err > 0)
 		show_nvme_status(err);
 	else
@@ -1296,7 +1388,7 @@ static int create_ns(int argc, char **argv, struct command *cmd, struct plugin *
 	err = nvme_ns_create(fd, cfg.nsze, cfg.ncap, cfg.flbas, cfg.dps,
 			     cfg.nmic, cfg.timeout, &nsid);
 	if (!err)
-		printf("%s: Success, created nsid:%d\n", cmd->name, nsid);
+		fprintf(nvme_out(), "%s: Success, created nsid:%d\n", cmd->name, nsid);
 	else if (err > 0)
 		show_nvme_status(err);
 	else
@@ -1392,13 +1484,12 @@ close_fd:
 	return subsysnqn;
 }
 
-static char *get_nvme_ctrl_attr(char *path, const char *attr)
+static char *__get_nvme_attr(char *path, const char *attr, bool quiet)
 {
 	char *attrpath;
 	char *value;
 	int fd;
 	ssize_t ret;
-	int i;
 
 	ret = asprintf(&attrpath, "%s/%s", path, attr);
 	if (ret < 0)
@@ -1410,25 +1501,23 @@ static char *get_nvme_ctrl_attr(char *path, const char *attr)
 
 	fd = open(attrpath, O_RDONLY);
 	if (fd < 0) {
-		fprintf(stderr, "Failed to open %s: %s\n",
-				attrpath, strerror(errno));
+		if (!quiet)
+			fprintf(stderr, "Failed to open %s: %s\n",
+					attrpath, strerror(errno));
 		goto err_free_value;
 	}
 
 	ret = read(fd, value, 1024);
-	if (ret < 0) {
-		fprintf(stderr, "read :%s :%s\n", attrpath, strerror(errno));
+	if (ret <= 0) {
+		if (!quiet)
+			fprintf(stderr, "read :%s :%s\n", attrpath,
+					strerror(errno));
 		goto err_close_fd;
 	}
 
 	if (value[strlen(value) - 1] == '\n')
 		value[strlen(value) - 1] = '\0';
 
-	for (i = 0; i < strlen(value); i++) {
-		if (value[i] == ',' )
-			value[i] = ' ';
-	}
-
 	close(fd);
 	free(attrpath);
 
@@ -1444,6 +1533,20 @@ err_free_path:
 	return NULL;
 }
 
+static char *get_nvme_ctrl_attr(char *path, const char *attr)
+{
+	char *value = __get_nvme_attr(path, attr, false);
+	int i;
+
+	if (!value)
+		return NULL;
+	for (i = 0; i < strlen(value); i++) {
+		if (value[i] == ',' )
+			value[i] = ' ';
+	}
+	return value;
+}
+
 static int scan_ctrl_paths_filter(const struct dirent *d)
 {
 	int id, cntlid, nsid;
@@ -1823,7 +1926,7 @@ static int list_subsys(int argc, char **argv, struct command *cmd,
 
 	const struct argconfig_commandline_options opts[] = {
 		{"output-format", 'o', "FMT", CFG_STRING, &cfg.output_format,
-			required_argument, "Output Format: normal|json"},
+			required_argument, "Output Format: normal|json|json-compact|ndjson|cbor"},
 		{NULL}
 	};
 
@@ -1885,9 +1988,13 @@ ret:
 
 static int get_nvme_info(int fd, struct list_item *item, const char *node)
 {
+	struct stat st;
 	int err;
 
-	err = nvme_identify_ctrl(fd, &item->ctrl);
+	err = fstat(fd, &st);
+	if (err < 0)
+		return -errno;
+	err = nvme_identify_ctrl_cached(fd, &item->ctrl);
 	if (err)
 		return err;
 	item->nsid = nvme_get_nsid(fd);
@@ -1898,13 +2005,311 @@ static int get_nvme_info(int fd, struct list_item *item, const char *node)
 	if (err)
 		return err;
 	strcpy(item->node, node);
-	item->block = S_ISBLK(nvme_stat.st_mode);
+	item->block = S_ISBLK(st.st_mode);
+
+	return 0;
+}
+
+/* Copy a sysfs string attribute into a space padded identify field */
+static bool get_sysfs_string(char *path, const char *attr, char *buf,
+			     size_t len)
+{
+	char *value = __get_nvme_attr(path, attr, true);
+
+	if (!value)
+		return false;
+	memset(buf, ' ', len);
+	memcpy(buf, value, min(strlen(value), len));
+	free(value);
+	return true;
+}
+
+static bool get_sysfs_u64(char *path, const char *attr, __u64 *val)
+{
+	char *value = __get_nvme_attr(path, attr, true);
+	char *end;
+
+	if (!value)
+		return false;
+	errno = 0;
+	*val = strtoull(value, &end, 0);
+	if (errno || end == value)
+		*val = 0;
+	free(value);
+	return !errno && end != value;
+}
+
+/*
+ * Same as get_nvme_info(), but taken from the sysfs attributes of the
+ * namespace and its controller (or subsystem, with native multipath).
+ * Identify is only sent for the parts older kernels do not export.
+ */
+static int get_nvme_info_sysfs(int fd, struct list_item *item,
+			       const char *node)
+{
+	char ns_path[300], ctrl_path[320];
+	__u64 nsid, size, lbs, ms;
+	const char *name = strrchr(node, '/');
+	struct stat st;
+	int err;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	name = name ? name + 1 : node;
+	snprintf(ns_path, sizeof(ns_path), "/sys/block/%s", name);
+	snprintf(ctrl_path, sizeof(ctrl_path), "%s/device", ns_path);
+
+	if (!get_sysfs_string(ctrl_path, "serial", item->ctrl.sn,
+			      sizeof(item->ctrl.sn)) ||
+	    !get_sysfs_string(ctrl_path, "model", item->ctrl.mn,
+			      sizeof(item->ctrl.mn)) ||
+	    !get_sysfs_string(ctrl_path, "firmware_rev", item->ctrl.fr,
+			      sizeof(item->ctrl.fr))) {
+		err = nvme_identify_ctrl_cached(fd, &item->ctrl);
+		if (err)
+			return err;
+	}
+
+	if (get_sysfs_u64(ns_path, "nsid", &nsid))
+		item->nsid = nsid;
+	else
+		item->nsid = nvme_get_nsid(fd);
+	if (item->nsid < 0)
+		return -errno;
+	if (!item->nsid)
+		return -EINVAL;
+
+	/*
+	 * The nuse attribute is left alone: reading it makes the kernel
+	 * send Identify Namespace to refresh the value.
+	 */
+	if (get_sysfs_u64(ns_path, "size", &size) &&
+	    get_sysfs_u64(ns_path, "queue/logical_block_size", &lbs) &&
+	    get_sysfs_u64(ns_path, "metadata_bytes", &ms) &&
+	    lbs >= 512 && !(lbs & (lbs - 1))) {
+		memset(&item->ns, 0, sizeof(item->ns));
+		item->ns.nsze = cpu_to_le64(size * 512 / lbs);
+		item->ns.ncap = item->ns.nsze;
+		item->ns.lbaf[0].ds = ffsll(lbs) - 1;
+		item->ns.lbaf[0].ms = cpu_to_le16(ms);
+		item->no_nuse = true;
+	} else {
+		err = nvme_identify_ns(fd, item->nsid, 0, &item->ns);
+		if (err)
+			return err;
+	}
+	strcpy(item->node, node);
+	item->block = S_ISBLK(st.st_mode);
 
 	return 0;
 }
 
 static const char *dev = "/dev/";
 
+/*
+ * Devices are probed by a bounded pool of detached worker threads. A
+ * device that does not answer within the timeout (e.g. a controller
+ * stuck in reset) is abandoned: its worker is left blocked in the
+ * ioctl and a replacement is started so the rest of the list keeps
+ * moving. The pool is reference counted since abandoned workers may
+ * outlive list().
+ */
+#define NVME_LIST_WORKERS	16
+
+enum {
+	LIST_PROBE_PENDING,
+	LIST_PROBE_RUNNING,
+	LIST_PROBE_DONE,
+	LIST_PROBE_TIMEDOUT,
+};
+
+struct list_probe_dev {
+	char path[264];
+	int state;
+	int err;
+	bool open_failed;
+	struct timespec deadline;
+	struct list_item item;
+};
+
+struct list_probe {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct list_probe_dev *devs;
+	int n;
+	int next;
+	int resolved;
+	int refs;
+	unsigned int timeout_ms;
+	bool sysfs;
+};
+
+/* Drop a reference to @lp, called with the pool lock held */
+static void list_probe_put(struct list_probe *lp)
+{
+	bool last = !--lp->refs;
+
+	pthread_mutex_unlock(&lp->lock);
+	if (!last)
+		return;
+	pthread_mutex_destroy(&lp->lock);
+	pthread_cond_destroy(&lp->cond);
+	free(lp->devs);
+	free(lp);
+}
+
+static void *list_probe_worker(void *arg)
+{
+	struct list_probe *lp = arg;
+	struct list_probe_dev *d;
+	int err, fd;
+
+	pthread_mutex_lock(&lp->lock);
+	while (lp->next < lp->n) {
+		d = &lp->devs[lp->next++];
+		d->state = LIST_PROBE_RUNNING;
+		clock_gettime(CLOCK_MONOTONIC, &d->deadline);
+		d->deadline.tv_sec += lp->timeout_ms / 1000;
+		d->deadline.tv_nsec += (lp->timeout_ms % 1000) * 1000000L;
+		if (d->deadline.tv_nsec >= 1000000000L) {
+			d->deadline.tv_sec++;
+			d->deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_broadcast(&lp->cond);
+		pthread_mutex_unlock(&lp->lock);
+
+		/* d->item is not looked at until the probe is marked done */
+		fd = open(d->path, O_RDONLY);
+		if (fd < 0) {
+			err = -errno;
+			d->open_failed = true;
+		} else {
+			if (lp->sysfs)
+				err = get_nvme_info_sysfs(fd, &d->item,
+							  d->path);
+			else
+				err = get_nvme_info(fd, &d->item, d->path);
+			close(fd);
+		}
+
+		pthread_mutex_lock(&lp->lock);
+		if (d->state == LIST_PROBE_TIMEDOUT) {
+			/* a replacement worker has taken over our slot */
+			break;
+		}
+		d->err = err;
+		d->state = LIST_PROBE_DONE;
+		lp->resolved++;
+		pthread_cond_broadcast(&lp->cond);
+	}
+	list_probe_put(lp);
+	return NULL;
+}
+
+static int list_probe_spawn(struct list_probe *lp)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	int err;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	lp->refs++;
+	err = pthread_create(&thread, &attr, list_probe_worker, lp);
+	if (err)
+		lp->refs--;
+	pthread_attr_destroy(&attr);
+	return -err;
+}
+
+static bool timespec_before(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec ||
+		(a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/*
+ * Probe every device in @devices, which are expected in the order they
+ * should be listed in. Returns the probe pool with every device either
+ * done or timed out, with the pool lock held; release it with
+ * list_probe_put().
+ */
+static struct list_probe *list_probe_run(struct dirent **devices, int n,
+					 unsigned int timeout_ms, bool sysfs)
+{
+	struct timespec now, *next;
+	pthread_condattr_t attr;
+	struct list_probe *lp;
+	int i, workers = 0;
+
+	lp = calloc(1, sizeof(*lp));
+	if (!lp)
+		return NULL;
+	lp->devs = calloc(n, sizeof(*lp->devs));
+	if (!lp->devs) {
+		free(lp);
+		return NULL;
+	}
+	for (i = 0; i < n; i++)
+		snprintf(lp->devs[i].path, sizeof(lp->devs[i].path), "%s%s",
+			 dev, devices[i]->d_name);
+	lp->n = n;
+	lp->refs = 1;
+	lp->timeout_ms = timeout_ms;
+	lp->sysfs = sysfs;
+	pthread_mutex_init(&lp->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&lp->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	pthread_mutex_lock(&lp->lock);
+	for (i = 0; i < min(n, NVME_LIST_WORKERS); i++)
+		if (!list_probe_spawn(lp))
+			workers++;
+	if (!workers) {
+		/* no threads available, probe from this thread instead */
+		lp->refs++;
+		pthread_mutex_unlock(&lp->lock);
+		list_probe_worker(lp);
+		pthread_mutex_lock(&lp->lock);
+	}
+
+	while (lp->resolved < lp->n) {
+		next = NULL;
+		for (i = 0; i < lp->next; i++) {
+			if (lp->devs[i].state != LIST_PROBE_RUNNING)
+				continue;
+			if (!next || timespec_before(&lp->devs[i].deadline, next))
+				next = &lp->devs[i].deadline;
+		}
+		if (!next) {
+			pthread_cond_wait(&lp->cond, &lp->lock);
+			continue;
+		}
+		pthread_cond_timedwait(&lp->cond, &lp->lock, next);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		for (i = 0; i < lp->next; i++) {
+			if (lp->devs[i].state != LIST_PROBE_RUNNING ||
+			    timespec_before(&now, &lp->devs[i].deadline))
+				continue;
+			lp->devs[i].state = LIST_PROBE_TIMEDOUT;
+			lp->devs[i].err = -ETIMEDOUT;
+			lp->resolved++;
+			if (lp->next < lp->n && list_probe_spawn(lp)) {
+				/* can't replace the stuck worker, give up on the rest */
+				for (; lp->next < lp->n; lp->next++) {
+					lp->devs[lp->next].state = LIST_PROBE_TIMEDOUT;
+					lp->devs[lp->next].err = -ETIMEDOUT;
+					lp->resolved++;
+				}
+			}
+		}
+	}
+	return lp;
+}
+
 /* Assume every block device starting with /dev/nvme is an nvme namespace */
 static int scan_dev_filter(const struct dirent *d)
 {
@@ -1930,22 +2335,31 @@ static int scan_dev_filter(const struct dirent *d)
 
 static int list(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	char path[264];
 	struct dirent **devices;
 	struct list_item *list_items;
+	struct list_probe *lp;
+	struct list_probe_dev *d;
 	unsigned int list_cnt = 0;
-	int fmt, ret, fd, i, n;
+	int fmt, ret, i, n;
 	const char *desc = "Retrieve basic information for all NVMe namespaces";
+	const char *timeout = "per device probe timeout in ms";
+	const char *sysfs = "read device attributes from sysfs, only "\
+		"send identify for what the kernel does not export";
 	struct config {
 		char *output_format;
+		__u32 timeout;
+		int   sysfs;
 	};
 
 	struct config cfg = {
 		.output_format = "normal",
+		.timeout       = 10000,
 	};
 
 	const struct argconfig_commandline_options opts[] = {
-		{"output-format", 'o', "FMT", CFG_STRING, &cfg.output_format, required_argument, "Output Format: normal|json"},
+		{"output-format", 'o', "FMT", CFG_STRING,   &cfg.output_format, required_argument, "Output Format: normal|json|json-compact|ndjson|cbor"},
+		{"timeout",       't', "NUM", CFG_POSITIVE, &cfg.timeout,       required_argument, timeout},
+		{"sysfs",         's', "",    CFG_NONE,     &cfg.sysfs,         no_argument,       sysfs},
 		{NULL}
 	};
 
@@ -1959,6 +2373,10 @@ static int list(int argc, char **argv, struct command *cmd, struct plugin *plugi
 		ret = -EINVAL;
 		goto ret;
 	}
+	if (!cfg.timeout) {
+		ret = -EINVAL;
+		goto ret;
+	}
 
 	n = scandir(dev, &devices, scan_dev_filter, alphasort);
 	if (n < 0) {
@@ -1974,29 +2392,36 @@ static int list(int argc, char **argv, struct command *cmd, struct plugin *plugi
 		goto cleanup_devices;
 	}
 
+	lp = list_probe_run(devices, n, cfg.timeout, cfg.sysfs);
+	if (!lp) {
+		fprintf(stderr, "can not allocate device probe pool\n");
+		ret = -ENOMEM;
+		goto cleanup_list_items;
+	}
+
+	ret = 0;
 	for (i = 0; i < n; i++) {
-		snprintf(path, sizeof(path), "%s%s", dev, devices[i]->d_name);
-		fd = open(path, O_RDONLY);
-		if (fd < 0) {
-			fprintf(stderr, "Failed to open %s: %s\n", path,
-					strerror(errno));
-			ret = -errno;
-			goto cleanup_list_items;
-		}
-		ret = get_nvme_info(fd, &list_items[list_cnt], path);
-		close(fd);
-		if (ret == 0) {
-			list_cnt++;
-		}
-		else if (ret > 0) {
-			fprintf(stderr, "identify failed\n");
-			show_nvme_status(ret);
+		d = &lp->devs[i];
+		if (d->err == 0) {
+			list_items[list_cnt++] = d->item;
+			continue;
 		}
-		else {
+		if (d->err > 0) {
+			fprintf(stderr, "%s: identify failed\n", d->path);
+			show_nvme_status(d->err);
+		} else if (d->err == -ETIMEDOUT) {
+			fprintf(stderr, "%s: timed out obtaining nvme info\n",
+					d->path);
+		} else if (d->open_failed) {
+			fprintf(stderr, "Failed to open %s: %s\n", d->path,
+					strerror(-d->err));
+			ret = d->err;
+		} else {
 			fprintf(stderr, "%s: failed to obtain nvme info: %s\n",
-					path, strerror(-ret));
+					d->path, strerror(-d->err));
 		}
 	}
+	list_probe_put(lp);
 
 	if (list_cnt) {
 		if (fmt == JSON)
@@ -2016,104 +2441,279 @@ ret:
 	return nvme_status_to_errno(ret, false);
 }
 
-/*
- * Given a controller name, create a ctrl_list_item with its
- * attributes and compare the attributes against the connect args
- * given.
- * Return true/false based on whether it matches
- */
-bool ctrl_matches_connectargs(char *name, struct connect_args *args)
+static bool connectarg_matches(const char *val, const char *arg)
 {
-	struct ctrl_list_item *ctrl;
-	bool found = false;
+	return !strcmp(val, arg) || !strcmp(arg, "none");
+}
 
-	ctrl = malloc(sizeof(*ctrl));
-	if (!ctrl) {
-		fprintf(stderr, "Failed to allocate controller list element\n");
-		return false;
+static bool ctrl_index_item_matches(struct ctrl_index_item *item,
+				    struct connect_args *args)
+{
+	return !strcmp(item->subsysnqn, args->subsysnqn) &&
+		!strcmp(item->transport, args->transport) &&
+		connectarg_matches(item->traddr, args->traddr) &&
+		connectarg_matches(item->trsvcid, args->trsvcid) &&
+		connectarg_matches(item->host_traddr, args->host_traddr);
+}
+
+static void ctrl_index_item_free(struct ctrl_index_item *item)
+{
+	free(item->name);
+	free(item->transport);
+	free(item->subsysnqn);
+	free(item->state);
+	free(item->hostnqn);
+	free(item->hostid);
+	free(item->traddr);
+	free(item->trsvcid);
+	free(item->host_traddr);
+}
+
+/* Reads the attributes of controller @name, returns 0 on success */
+static int ctrl_index_item_read(struct ctrl_index_item *item, const char *name)
+{
+	char path[512];
+	char *address;
+
+	memset(item, 0, sizeof(*item));
+	snprintf(path, sizeof(path), "%s/%s", SYS_NVME, name);
+
+	item->name = strdup(name);
+	item->transport = get_nvme_ctrl_attr(path, "transport");
+	item->subsysnqn = get_nvme_ctrl_attr(path, "subsysnqn");
+	address = get_nvme_ctrl_attr(path, "address");
+	if (!item->name || !item->transport || !item->subsysnqn || !address) {
+		free(address);
+		ctrl_index_item_free(item);
+		return 1;
 	}
-	memset(ctrl, 0, sizeof(*ctrl));
+	item->state = __get_nvme_attr(path, "state", true);
+	item->hostnqn = __get_nvme_attr(path, "hostnqn", true);
+	item->hostid = __get_nvme_attr(path, "hostid", true);
 
-	if (get_nvme_ctrl_info(name, SYS_NVME, ctrl, NVME_NSID_ALL))
-		goto cleanup_exit;
+	item->traddr = __parse_connect_arg(address, delim_space,
+					conarg_traddr);
+	item->trsvcid = __parse_connect_arg(address, delim_space,
+					conarg_trsvcid);
+	item->host_traddr = __parse_connect_arg(address, delim_space,
+					conarg_host_traddr);
+	free(address);
+	return 0;
+}
 
-	if (!strcmp(ctrl->subsysnqn, args->subsysnqn) &&
-	    !strcmp(ctrl->transport, args->transport) &&
-	    (!strcmp(ctrl->traddr, args->traddr) ||
-	     !strcmp(args->traddr, "none")) &&
-	    (!strcmp(ctrl->trsvcid, args->trsvcid) ||
-	     !strcmp(args->trsvcid, "none")) &&
-	    (!strcmp(ctrl->host_traddr, args->host_traddr) ||
-	     !strcmp(args->host_traddr, "none")))
-		found = true;
+static unsigned int ctrl_index_hash(unsigned int hash, const char *str)
+{
+	while (*str)
+		hash = (hash ^ (unsigned char)*str++) * 16777619;
+	/* separator, so that "a","bc" differs from "ab","c" */
+	return (hash ^ 0xff) * 16777619;
+}
 
-cleanup_exit:
-	free_ctrl_list_item(ctrl);
-	free(ctrl);
+static unsigned int ctrl_index_key(const char *transport, const char *traddr,
+				   const char *trsvcid, const char *subsysnqn,
+				   const char *host_traddr)
+{
+	unsigned int hash = 2166136261;
 
-	return found;
+	hash = ctrl_index_hash(hash, transport);
+	hash = ctrl_index_hash(hash, traddr);
+	hash = ctrl_index_hash(hash, trsvcid);
+	hash = ctrl_index_hash(hash, subsysnqn);
+	return ctrl_index_hash(hash, host_traddr);
 }
 
 /*
- * Look through the system to find an existing controller whose
- * attributes match the connect arguments specified
- * If found, a string containing the controller name (ex: "nvme?")
- * is returned.
- * If not found, a NULL is returned.
+ * Reads every controller in SYS_NVME once. Controllers whose attributes
+ * can't be read (e.g. because they are going away) are left out.
  */
-char *find_ctrl_with_connectargs(struct connect_args *args)
+struct ctrl_index *ctrl_index_scan(void)
 {
-	struct dirent **devices;
-	char *devname = NULL;
+	struct ctrl_index_item *item;
+	struct dirent **devices = NULL;
+	struct ctrl_index *idx;
+	unsigned int h;
 	int i, n;
 
-	n = scandir(SYS_NVME, &devices, scan_ctrls_filter, alphasort);
-	if (n < 0) {
-		fprintf(stderr, "no NVMe controller(s) detected.\n");
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
 		return NULL;
-	}
 
-	for (i = 0; i < n; i++) {
-		if (ctrl_matches_connectargs(devices[i]->d_name, args)) {
-			devname = strdup(devices[i]->d_name);
-			if (devname == NULL)
-				fprintf(stderr, "no memory for ctrl name %s\n",
-						devices[i]->d_name);
-			goto cleanup_devices;
-		}
+	n = scandir(SYS_NVME, &devices, scan_ctrls_filter, alphasort);
+	if (n < 0)
+		n = 0;
+
+	idx->size = 16;
+	while (idx->size < 2 * n)
+		idx->size <<= 1;
+	idx->items = calloc(n ? n : 1, sizeof(*idx->items));
+	idx->by_key = calloc(idx->size, sizeof(*idx->by_key));
+	idx->by_nqn = calloc(idx->size, sizeof(*idx->by_nqn));
+	if (!idx->items || !idx->by_key || !idx->by_nqn) {
+		ctrl_index_free(idx);
+		idx = NULL;
+		goto free_devices;
+	}
+
+	/* backwards, so that the chains end up in name order */
+	for (i = n - 1; i >= 0; i--) {
+		item = &idx->items[idx->nr];
+		if (ctrl_index_item_read(item, devices[i]->d_name))
+			continue;
+		idx->nr++;
+
+		h = ctrl_index_key(item->transport, item->traddr,
+				   item->trsvcid, item->subsysnqn,
+				   item->host_traddr) & (idx->size - 1);
+		item->next_key = idx->by_key[h];
+		idx->by_key[h] = item;
+
+		h = ctrl_index_hash(2166136261, item->subsysnqn) &
+			(idx->size - 1);
+		item->next_nqn = idx->by_nqn[h];
+		idx->by_nqn[h] = item;
 	}
 
-cleanup_devices:
+free_devices:
 	for (i = 0; i < n; i++)
 		free(devices[i]);
 	free(devices);
-
-	return devname;
+	return idx;
 }
 
-int __id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin, void (*vs)(__u8 *vs, struct json_object *root))
+void ctrl_index_free(struct ctrl_index *idx)
 {
-	const char *desc = "Send an Identify Controller command to "\
-		"the given device and report information about the specified "\
-		"controller in human-readable or "\
-		"binary format. May also return vendor-specific "\
-		"controller attributes in hex-dump if requested.";
-	const char *vendor_specific = "dump binary vendor infos";
-	const char *raw_binary = "show infos in binary format";
-	const char *human_readable = "show infos in readable format";
-	int err, fmt, fd;
-	unsigned int flags = 0;
-	struct nvme_id_ctrl ctrl;
+	int i;
 
-	struct config {
-		int vendor_specific;
-		int raw_binary;
-		int human_readable;
-		char *output_format;
-	};
+	if (!idx)
+		return;
+	for (i = 0; i < idx->nr; i++)
+		ctrl_index_item_free(&idx->items[i]);
+	free(idx->items);
+	free(idx->by_key);
+	free(idx->by_nqn);
+	free(idx);
+}
 
-	struct config cfg = {
-		.output_format = "normal",
+/*
+ * Returns the next controller connected to @subsysnqn after @prev, or
+ * the first one if @prev is NULL.
+ */
+struct ctrl_index_item *ctrl_index_find_nqn(struct ctrl_index *idx,
+					    const char *subsysnqn,
+					    struct ctrl_index_item *prev)
+{
+	struct ctrl_index_item *item;
+
+	if (prev)
+		item = prev->next_nqn;
+	else
+		item = idx->by_nqn[ctrl_index_hash(2166136261, subsysnqn) &
+				   (idx->size - 1)];
+	for (; item; item = item->next_nqn)
+		if (!strcmp(item->subsysnqn, subsysnqn))
+			return item;
+	return NULL;
+}
+
+/*
+ * Returns the first controller, by name, matching the connect arguments.
+ * A "none" traddr, trsvcid or host_traddr matches any value.
+ */
+struct ctrl_index_item *ctrl_index_find(struct ctrl_index *idx,
+					struct connect_args *args)
+{
+	struct ctrl_index_item *item = NULL;
+	unsigned int h;
+
+	if (!strcmp(args->traddr, "none") || !strcmp(args->trsvcid, "none") ||
+	    !strcmp(args->host_traddr, "none")) {
+		while ((item = ctrl_index_find_nqn(idx, args->subsysnqn, item)))
+			if (ctrl_index_item_matches(item, args))
+				return item;
+		return NULL;
+	}
+
+	h = ctrl_index_key(args->transport, args->traddr, args->trsvcid,
+			   args->subsysnqn, args->host_traddr);
+	for (item = idx->by_key[h & (idx->size - 1)]; item;
+	     item = item->next_key)
+		if (ctrl_index_item_matches(item, args))
+			return item;
+	return NULL;
+}
+
+/*
+ * Given a controller name, read its attributes and compare them
+ * against the connect args given.
+ * Return true/false based on whether it matches
+ */
+bool ctrl_matches_connectargs(char *name, struct connect_args *args)
+{
+	struct ctrl_index_item item;
+	bool found;
+
+	if (ctrl_index_item_read(&item, name))
+		return false;
+	found = ctrl_index_item_matches(&item, args);
+	ctrl_index_item_free(&item);
+
+	return found;
+}
+
+/*
+ * Look through the system to find an existing controller whose
+ * attributes match the connect arguments specified
+ * If found, a string containing the controller name (ex: "nvme?")
+ * is returned.
+ * If not found, a NULL is returned.
+ */
+char *find_ctrl_with_connectargs(struct connect_args *args)
+{
+	struct ctrl_index_item *item;
+	struct ctrl_index *idx;
+	char *devname = NULL;
+
+	idx = ctrl_index_scan();
+	if (!idx) {
+		fprintf(stderr, "no memory for controller index\n");
+		return NULL;
+	}
+
+	item = ctrl_index_find(idx, args);
+	if (item) {
+		devname = strdup(item->name);
+		if (devname == NULL)
+			fprintf(stderr, "no memory for ctrl name %s\n",
+					item->name);
+	}
+	ctrl_index_free(idx);
+
+	return devname;
+}
+
+int __id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin, void (*vs)(__u8 *vs, struct json_object *root))
+{
+	const char *desc = "Send an Identify Controller command to "\
+		"the given device and report information about the specified "\
+		"controller in human-readable or "\
+		"binary format. May also return vendor-specific "\
+		"controller attributes in hex-dump if requested.";
+	const char *vendor_specific = "dump binary vendor infos";
+	const char *raw_binary = "show infos in binary format";
+	const char *human_readable = "show infos in readable format";
+	int err, fmt, fd;
+	unsigned int flags = 0;
+	struct nvme_id_ctrl ctrl;
+
+	struct config {
+		int vendor_specific;
+		int raw_binary;
+		int human_readable;
+		char *output_format;
+	};
+
+	struct config cfg = {
+		.output_format = "normal",
 	};
 
 	const struct argconfig_commandline_options command_line_options[] = {
@@ -2145,14 +2745,14 @@ int __id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin,
 	if (cfg.human_readable)
 		flags |= HUMAN;
 
-	err = nvme_identify_ctrl(fd, &ctrl);
+	err = nvme_identify_ctrl_cached(fd, &ctrl);
 	if (!err) {
 		if (fmt == BINARY)
 			d_raw((unsigned char *)&ctrl, sizeof(ctrl));
 		else if (fmt == JSON)
 			json_nvme_id_ctrl(&ctrl, flags, vs);
 		else {
-			printf("NVME Identify Controller:\n");
+			fprintf(nvme_out(), "NVME Identify Controller:\n");
 			__show_nvme_id_ctrl(&ctrl, flags, vs);
 		}
 	}
@@ -2233,7 +2833,7 @@ static int ns_descs(int argc, char **argv, struct command *cmd, struct plugin *p
 		else if (fmt == JSON)
 			json_nvme_id_ns_descs(nsdescs);
 		else {
-			printf("NVME Namespace Identification Descriptors NS %d:\n", cfg.namespace_id);
+			fprintf(nvme_out(), "NVME Namespace Identification Descriptors NS %d:\n", cfg.namespace_id);
 			show_nvme_id_ns_descs(nsdescs);
 		}
 	}
@@ -2324,7 +2924,7 @@ static int id_ns(int argc, char **argv, struct command *cmd, struct plugin *plug
 		else if (fmt == JSON)
 			json_nvme_id_ns(&ns, flags);
 		else {
-			printf("NVME Identify Namespace %d:\n", cfg.namespace_id);
+			fprintf(nvme_out(), "NVME Identify Namespace %d:\n", cfg.namespace_id);
 			show_nvme_id_ns(&ns, flags);
 		}
 	}
@@ -2444,7 +3044,7 @@ static int id_nvmset(int argc, char **argv, struct command *cmd, struct plugin *
 		else if (fmt == JSON)
 			json_nvme_id_nvmset(&nvmset, devicename);
 		else {
-			printf("NVME Identify NVM Set List %d:\n", cfg.nvmset_id);
+			fprintf(nvme_out(), "NVME Identify NVM Set List %d:\n", cfg.nvmset_id);
 			show_nvme_id_nvmset(&nvmset);
 		}
 	}
@@ -2502,7 +3102,7 @@ static int id_uuid(int argc, char **argv, struct command *cmd, struct plugin *pl
 		else if (fmt == JSON)
 			json_nvme_id_uuid_list(&uuid_list);
 		else {
-			printf("NVME Identify UUID:\n");
+			fprintf(nvme_out(), "NVME Identify UUID:\n");
 			show_nvme_id_uuid_list(&uuid_list, flags);
 		}
 	} else if (err > 0)
@@ -2535,7 +3135,7 @@ static int get_ns_id(int argc, char **argv, struct command *cmd, struct plugin *
 		err = errno;
 		goto close_fd;
 	}
-	printf("%s: namespace-id:%d\n", devicename, nsid);
+	fprintf(nvme_out(), "%s: namespace-id:%d\n", devicename, nsid);
 
 close_fd:
 	close(fd);
@@ -2599,7 +3199,7 @@ static int virtual_mgmt(int argc, char **argv, struct command *cmd, struct plugi
 
 	err = nvme_virtual_mgmt(fd, cfg.cdw10, cfg.cdw11, &result);
 	if (!err) {
-		printf("success, Number of Resources allocated:%#x\n", result);
+		fprintf(nvme_out(), "success, Number of Resources allocated:%#x\n", result);
 	} else if (err > 0) {
 		show_nvme_status(err);
 	} else
@@ -2725,9 +3325,9 @@ static int device_self_test(int argc, char **argv, struct command *cmd, struct p
 	err = nvme_self_test_start(fd, cfg.namespace_id, cfg.cdw10);
 	if (!err) {
 		if ((cfg.cdw10 & 0xf) == 0xf)
-			printf("Aborting device self-test operation\n");
+			fprintf(nvme_out(), "Aborting device self-test operation\n");
 		else
-			printf("Device self-test started\n");
+			fprintf(nvme_out(), "Device self-test started\n");
 	} else if (err > 0) {
 		show_nvme_status(err);
 	} else
@@ -2781,7 +3381,7 @@ static int self_test_log(int argc, char **argv, struct command *cmd, struct plug
 			else
 				show_self_test_log(&self_test_log, devicename);
 		} else {
-			printf("Test is %d%% complete and is still in progress.\n",
+			fprintf(nvme_out(), "Test is %d%% complete and is still in progress.\n",
 				self_test_log.crnt_dev_selftest_compln);
 		}
 	} else if (err > 0) {
@@ -2907,7 +3507,7 @@ static int get_feature(int argc, char **argv, struct command *cmd, struct plugin
 			cfg.data_len, buf, &result);
 	if (!err) {
 		if (!cfg.raw_binary || !buf) {
-			printf("get-feature:%#02x (%s), %s value:%#08x\n", cfg.feature_id,
+			fprintf(nvme_out(), "get-feature:%#02x (%s), %s value:%#08x\n", cfg.feature_id,
 				nvme_feature_to_string(cfg.feature_id),
 				nvme_select_to_string(cfg.sel), result);
 			if (cfg.sel == 3)
@@ -2932,6 +3532,186 @@ ret:
 	return nvme_status_to_errno(err, false);
 }
 
+/*
+ * fw_download_job - one controller receiving the firmware image
+ * @xfer: chunk size in bytes, 0 to pick it from MDTS and FWUG
+ */
+struct fw_download_job {
+	const char *dev;
+	int fd;
+	pthread_t thread;
+	bool started;
+	const void *image;
+	__u32 size;
+	__u32 offset;
+	__u32 xfer;
+	int err;
+	unsigned int chunks;
+	__u64 min_ns;
+	__u64 max_ns;
+	__u64 total_ns;
+};
+
+static __u64 fw_download_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Largest chunk the controller takes in one Firmware Image Download:
+ * bounded by MDTS, and a multiple of the firmware update granularity.
+ * Fails if a single granule is already more than MDTS allows.
+ */
+static int fw_download_xfer(struct fw_download_job *j)
+{
+	struct nvme_id_ctrl ctrl;
+	__u32 xfer = nvme_get_max_xfer(j->fd), fwug;
+
+	j->xfer = xfer;
+	if (nvme_identify_ctrl_cached(j->fd, &ctrl))
+		return 0;
+	if (!ctrl.fwug || ctrl.fwug == 0xff)
+		return 0;
+	fwug = ctrl.fwug * 4096;
+	if (xfer < fwug) {
+		fprintf(stderr, "%s: firmware update granularity of %u bytes "
+			"exceeds the maximum transfer size of %u bytes\n",
+			j->dev, fwug, xfer);
+		return -EINVAL;
+	}
+	j->xfer = xfer - xfer % fwug;
+	return 0;
+}
+
+static void *fw_download_one(void *arg)
+{
+	struct fw_download_job *j = arg;
+	const void *buf = j->image;
+	__u32 size = j->size, offset = j->offset, xfer;
+	__u64 start, ns;
+
+	j->min_ns = ~0ULL;
+	if (!j->xfer) {
+		j->err = fw_download_xfer(j);
+		if (j->err)
+			return NULL;
+	}
+
+	while (size > 0) {
+		xfer = min(j->xfer, size);
+
+		start = fw_download_now();
+		j->err = nvme_fw_download(j->fd, offset, xfer, (void *)buf);
+		if (j->err < 0)
+			j->err = -errno;
+		if (j->err)
+			break;
+		ns = fw_download_now() - start;
+
+		j->chunks++;
+		j->total_ns += ns;
+		j->min_ns = min(j->min_ns, ns);
+		j->max_ns = max(j->max_ns, ns);
+		buf    += xfer;
+		size   -= xfer;
+		offset += xfer;
+	}
+	return NULL;
+}
+
+static void fw_download_report(struct fw_download_job *j, bool name)
+{
+	const char *prefix = name ? j->dev : "";
+	const char *sep = name ? ": " : "";
+
+	if (j->err < 0) {
+		fprintf(stderr, "%s%sfw-download: %s\n", prefix, sep,
+			strerror(-j->err));
+		return;
+	}
+	if (j->err) {
+		if (name)
+			fprintf(stderr, "%s: ", j->dev);
+		show_nvme_status(j->err);
+		return;
+	}
+	fprintf(nvme_out(), "%s%sFirmware download success\n", prefix, sep);
+	if (j->chunks)
+		fprintf(nvme_out(), "%s%s%u chunks of %u bytes, latency min/avg/max: "
+		       "%llu/%llu/%llu us\n", prefix, sep, j->chunks, j->xfer,
+		       (unsigned long long)j->min_ns / 1000,
+		       (unsigned long long)(j->total_ns / j->chunks) / 1000,
+		       (unsigned long long)j->max_ns / 1000);
+}
+
+/*
+ * fw_image - a firmware image mapped read-only, so every controller
+ * streams straight out of the page cache. Files that can't be mapped
+ * are read into memory instead.
+ */
+struct fw_image {
+	void *buf;
+	__u32 size;
+	bool mapped;
+};
+
+static int fw_image_get(const char *file, struct fw_image *img)
+{
+	struct stat sb;
+	int fd, err = 0;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open firmware file %s: %s\n",
+				file, strerror(errno));
+		return -EINVAL;
+	}
+
+	if (fstat(fd, &sb) < 0) {
+		err = -errno;
+		perror("fstat");
+		goto close_fd;
+	}
+
+	img->size = sb.st_size;
+	if (!img->size || img->size & 0x3) {
+		fprintf(stderr, "Invalid size:%d for f/w image\n", img->size);
+		err = -EINVAL;
+		goto close_fd;
+	}
+
+	img->mapped = true;
+	img->buf = mmap(NULL, img->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (img->buf != MAP_FAILED)
+		goto close_fd;
+
+	img->mapped = false;
+	if (posix_memalign(&img->buf, getpagesize(), img->size)) {
+		fprintf(stderr, "No memory for f/w size:%d\n", img->size);
+		err = -ENOMEM;
+		goto close_fd;
+	}
+	if (read(fd, img->buf, img->size) != ((ssize_t)(img->size))) {
+		err = -errno;
+		fprintf(stderr, "read :%s :%s\n", file, strerror(errno));
+		free(img->buf);
+	}
+close_fd:
+	close(fd);
+	return err;
+}
+
+static void fw_image_put(struct fw_image *img)
+{
+	if (img->mapped)
+		munmap(img->buf, img->size);
+	else
+		free(img->buf);
+}
+
 static int fw_download(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Copy all or part of a firmware image to "\
@@ -2943,29 +3723,34 @@ static int fw_download(int argc, char **argv, struct command *cmd, struct plugin
 		"Submission Queues. Activate downloaded firmware with "\
 		"fw-activate, and then reset the device to apply the downloaded firmware.";
 	const char *fw = "firmware file (required)";
-	const char *xfer = "transfer chunksize limit";
+	const char *xfer = "transfer chunksize limit, default from MDTS";
 	const char *offset = "starting dword offset, default 0";
-	int err, fd, fw_fd = -1;
-	unsigned int fw_size;
-	struct stat sb;
-	void *fw_buf, *buf;
+	const char *controllers = "comma separated list of additional "\
+		"controllers to download the same image to in parallel";
+	struct fw_download_job *jobs = NULL;
+	int err, fd, i, njobs = 1;
+	struct fw_image img;
+	char *list, *dev;
 
 	struct config {
 		char  *fw;
 		__u32 xfer;
 		__u32 offset;
+		char  *controllers;
 	};
 
 	struct config cfg = {
-		.fw     = "",
-		.xfer   = 4096,
-		.offset = 0,
+		.fw          = "",
+		.xfer        = 0,
+		.offset      = 0,
+		.controllers = "",
 	};
 
 	const struct argconfig_commandline_options command_line_options[] = {
-		{"fw",     'f', "FILE", CFG_STRING,   &cfg.fw,     required_argument, fw},
-		{"xfer",   'x', "NUM",  CFG_POSITIVE, &cfg.xfer,   required_argument, xfer},
-		{"offset", 'o', "NUM",  CFG_POSITIVE, &cfg.offset, required_argument, offset},
+		{"fw",          'f', "FILE", CFG_STRING,   &cfg.fw,          required_argument, fw},
+		{"xfer",        'x', "NUM",  CFG_POSITIVE, &cfg.xfer,        required_argument, xfer},
+		{"offset",      'o', "NUM",  CFG_POSITIVE, &cfg.offset,      required_argument, offset},
+		{"controllers", 'C', "LIST", CFG_STRING,   &cfg.controllers, required_argument, controllers},
 		{NULL}
 	};
 
@@ -2975,64 +3760,77 @@ static int fw_download(int argc, char **argv, struct command *cmd, struct plugin
 		goto ret;
 	}
 
-	fw_fd = open(cfg.fw, O_RDONLY);
 	cfg.offset <<= 2;
-	if (fw_fd < 0) {
-		fprintf(stderr, "Failed to open firmware file %s: %s\n",
-				cfg.fw, strerror(errno));
-		err = -EINVAL;
+	err = fw_image_get(cfg.fw, &img);
+	if (err)
 		goto close_fd;
-	}
 
-	err = fstat(fw_fd, &sb);
-	if (err < 0) {
-		perror("fstat");
-		goto close_fw_fd;
-	}
-
-	fw_size = sb.st_size;
-	if (fw_size & 0x3) {
-		fprintf(stderr, "Invalid size:%d for f/w image\n", fw_size);
-		err = -EINVAL;
-		goto close_fw_fd;
-	}
-	if (posix_memalign(&fw_buf, getpagesize(), fw_size)) {
-		fprintf(stderr, "No memory for f/w size:%d\n", fw_size);
-		err = -ENOMEM;
-		goto close_fw_fd;
-	}
-
-	buf = fw_buf;
-	if (cfg.xfer == 0 || cfg.xfer % 4096)
+	if (cfg.xfer % 4096)
 		cfg.xfer = 4096;
-	if (read(fw_fd, fw_buf, fw_size) != ((ssize_t)(fw_size))) {
-		err = -errno;
-		fprintf(stderr, "read :%s :%s\n", cfg.fw, strerror(errno));
-		goto free;
-	}
 
-	while (fw_size > 0) {
-		cfg.xfer = min(cfg.xfer, fw_size);
+	for (i = 0; cfg.controllers[i]; i++)
+		if (cfg.controllers[i] == ',')
+			njobs++;
+	if (strlen(cfg.controllers))
+		njobs++;
 
-		err = nvme_fw_download(fd, cfg.offset, cfg.xfer, fw_buf);
-		if (err < 0) {
-			perror("fw-download");
-			break;
-		} else if (err != 0) {
-			show_nvme_status(err);
-			break;
+	jobs = calloc(njobs, sizeof(*jobs));
+	if (!jobs) {
+		err = -ENOMEM;
+		goto put_image;
+	}
+	for (i = 0; i < njobs; i++) {
+		jobs[i].fd = -1;
+		jobs[i].image = img.buf;
+		jobs[i].size = img.size;
+		jobs[i].offset = cfg.offset;
+		jobs[i].xfer = cfg.xfer;
+	}
+	jobs[0].dev = devicename;
+	jobs[0].fd = fd;
+
+	njobs = 1;
+	list = cfg.controllers;
+	while ((dev = strsep(&list, ",")) != NULL) {
+		if (!strlen(dev))
+			continue;
+		jobs[njobs].dev = dev;
+		jobs[njobs].fd = open(dev, O_RDONLY);
+		if (jobs[njobs].fd < 0) {
+			err = -errno;
+			fprintf(stderr, "Failed to open %s: %s\n", dev,
+					strerror(-err));
+			goto close_jobs;
 		}
-		fw_buf     += cfg.xfer;
-		fw_size    -= cfg.xfer;
-		cfg.offset += cfg.xfer;
+		njobs++;
 	}
-	if (!err)
-		printf("Firmware download success\n");
 
-free:
-	free(buf);
-close_fw_fd:
-	close(fw_fd);
+	for (i = 1; i < njobs; i++) {
+		err = pthread_create(&jobs[i].thread, NULL, fw_download_one,
+				     &jobs[i]);
+		if (err)
+			jobs[i].err = -err;
+		else
+			jobs[i].started = true;
+	}
+	fw_download_one(&jobs[0]);
+	for (i = 1; i < njobs; i++)
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+
+	err = 0;
+	for (i = 0; i < njobs; i++) {
+		fw_download_report(&jobs[i], njobs > 1);
+		if (!err)
+			err = jobs[i].err;
+	}
+
+close_jobs:
+	for (i = 1; i < njobs; i++)
+		close(jobs[i].fd);
+	free(jobs);
+put_image:
+	fw_image_put(&img);
 close_fd:
 	close(fd);
 ret:
@@ -3110,22 +3908,22 @@ static int fw_commit(int argc, char **argv, struct command *cmd, struct plugin *
 		case NVME_SC_FW_NEEDS_CONV_RESET:
 		case NVME_SC_FW_NEEDS_SUBSYS_RESET:
 		case NVME_SC_FW_NEEDS_RESET:
-			printf("Success activating firmware action:%d slot:%d",
+			fprintf(nvme_out(), "Success activating firmware action:%d slot:%d",
 			       cfg.action, cfg.slot);
 			if (cfg.action == 6 || cfg.action == 7)
-				printf(" bpid:%d", cfg.bpid);
-			printf(", but firmware requires %s reset\n", nvme_fw_status_reset_type(err));
+				fprintf(nvme_out(), " bpid:%d", cfg.bpid);
+			fprintf(nvme_out(), ", but firmware requires %s reset\n", nvme_fw_status_reset_type(err));
 			break;
 		default:
 			show_nvme_status(err);
 			break;
 		}
 	else {
-		printf("Success committing firmware action:%d slot:%d",
+		fprintf(nvme_out(), "Success committing firmware action:%d slot:%d",
 		       cfg.action, cfg.slot);
 		if (cfg.action == 6 || cfg.action == 7)
-			printf(" bpid:%d", cfg.bpid);
-		printf("\n");
+			fprintf(nvme_out(), " bpid:%d", cfg.bpid);
+		fprintf(nvme_out(), "\n");
 	}
 
 close_fd:
@@ -3134,6 +3932,429 @@ ret:
 	return nvme_status_to_errno(err, false);
 }
 
+/*
+ * fw-update: download, commit and (optionally) reset a set of controllers
+ * with a bounded number of them in flight at once.
+ */
+struct fw_update_dev {
+	char *path;
+	char *subsysnqn;
+	char old_rev[9];
+	char new_rev[9];
+	const char *status;
+	const char *step;
+	const char *reset;
+	int err;
+	struct fw_download_job dl;
+};
+
+struct fw_update {
+	pthread_mutex_t lock;
+	struct fw_update_dev *devs;
+	int ndevs;
+	int next;
+	struct fw_image *img;
+	__u32 xfer;
+	__u8 slot;
+	__u8 action;
+	const char *revision;
+	bool reset;
+};
+
+/* Revision of the active firmware slot, with the padding stripped */
+static void fw_log_active_rev(struct nvme_firmware_log_page *log, char *rev)
+{
+	int slot = log->afi & 0x7, i;
+
+	rev[0] = '\0';
+	if (slot < 1 || slot > 7)
+		return;
+	memcpy(rev, &log->frs[slot - 1], 8);
+	rev[8] = '\0';
+	for (i = 7; i >= 0 && (rev[i] == ' ' || rev[i] == '\0'); i--)
+		rev[i] = '\0';
+}
+
+static int fw_update_read_rev(int fd, char *rev)
+{
+	struct nvme_firmware_log_page log;
+	int err;
+
+	err = nvme_fw_log(fd, &log);
+	if (err < 0)
+		return -errno;
+	if (!err)
+		fw_log_active_rev(&log, rev);
+	return err;
+}
+
+static void fw_update_one(struct fw_update *u, struct fw_update_dev *d)
+{
+	int fd, err, status;
+
+	d->status = "failed";
+	d->step = "open";
+	fd = open(d->path, O_RDONLY);
+	if (fd < 0) {
+		d->err = -errno;
+		return;
+	}
+
+	d->step = "fw-log";
+	err = fw_update_read_rev(fd, d->old_rev);
+	if (err)
+		goto out;
+	if (u->revision && !strcmp(d->old_rev, u->revision)) {
+		d->status = "skipped";
+		d->step = NULL;
+		goto out;
+	}
+
+	d->step = "download";
+	d->dl.dev = d->path;
+	d->dl.fd = fd;
+	d->dl.image = u->img->buf;
+	d->dl.size = u->img->size;
+	d->dl.xfer = u->xfer;
+	fw_download_one(&d->dl);
+	err = d->dl.err;
+	if (err)
+		goto out;
+
+	d->step = "commit";
+	err = nvme_fw_commit(fd, u->slot, u->action, 0);
+	if (err < 0) {
+		err = -errno;
+		goto out;
+	}
+	status = err & 0x3ff;
+	switch (status) {
+	case NVME_SC_FW_NEEDS_CONV_RESET:
+	case NVME_SC_FW_NEEDS_SUBSYS_RESET:
+	case NVME_SC_FW_NEEDS_RESET:
+		d->reset = nvme_fw_status_reset_type(err);
+		err = 0;
+		break;
+	}
+	if (err)
+		goto out;
+	/* actions 1 and 2 succeed but only activate at the next reset */
+	if (!d->reset && (u->action == 1 || u->action == 2))
+		d->reset = nvme_fw_status_reset_type(NVME_SC_FW_NEEDS_RESET);
+
+	/* a subsystem reset takes down other controllers, leave it to the user */
+	if (d->reset && u->reset && status != NVME_SC_FW_NEEDS_SUBSYS_RESET) {
+		d->step = "reset";
+		if (nvme_reset_controller(fd) < 0) {
+			err = -errno;
+			goto out;
+		}
+		d->reset = NULL;
+	}
+
+	d->step = "fw-log";
+	err = fw_update_read_rev(fd, d->new_rev);
+	if (err)
+		goto out;
+	d->status = d->reset ? "reset required" : "updated";
+	d->step = NULL;
+out:
+	d->err = err;
+	close(fd);
+}
+
+static void *fw_update_worker(void *arg)
+{
+	struct fw_update *u = arg;
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&u->lock);
+		i = u->next++;
+		pthread_mutex_unlock(&u->lock);
+		if (i >= u->ndevs)
+			break;
+		fw_update_one(u, &u->devs[i]);
+	}
+	return NULL;
+}
+
+/*
+ * Adds the controller at @path unless another controller of its
+ * subsystem is already there: the controllers of a multipath subsystem
+ * share their firmware slots, so one of them does the update.
+ */
+static int fw_update_add_dev(struct fw_update *u, const char *path)
+{
+	struct fw_update_dev *devs;
+	const char *name = strrchr(path, '/');
+	char sysfs[PATH_MAX], *subsysnqn;
+	struct stat st;
+	int i, instance, len;
+
+	/* only controllers, so no device gets the image twice */
+	name = name ? name + 1 : path;
+	if (sscanf(name, "nvme%d%n", &instance, &len) != 1 || name[len])
+		return 0;
+	if (stat(path, &st) || !S_ISCHR(st.st_mode))
+		return 0;
+
+	snprintf(sysfs, sizeof(sysfs), "/sys/class/nvme/%s", name);
+	subsysnqn = __get_nvme_attr(sysfs, "subsysnqn", true);
+	for (i = 0; subsysnqn && i < u->ndevs; i++) {
+		if (u->devs[i].subsysnqn &&
+		    !strcmp(u->devs[i].subsysnqn, subsysnqn)) {
+			free(subsysnqn);
+			return 0;
+		}
+	}
+
+	devs = realloc(u->devs, (u->ndevs + 1) * sizeof(*devs));
+	if (!devs) {
+		free(subsysnqn);
+		return -ENOMEM;
+	}
+	u->devs = devs;
+	memset(&devs[u->ndevs], 0, sizeof(*devs));
+	devs[u->ndevs].subsysnqn = subsysnqn;
+	devs[u->ndevs].path = strdup(path);
+	if (!devs[u->ndevs].path) {
+		free(subsysnqn);
+		return -ENOMEM;
+	}
+	u->ndevs++;
+	return 0;
+}
+
+static int fw_update_scan_nqn(struct fw_update *u, const char *nqn)
+{
+	struct dirent **ctrls;
+	char path[PATH_MAX], *subsysnqn;
+	int i, n, err = 0;
+
+	/* no controllers at all is reported like no matching ones */
+	n = scandir("/sys/class/nvme", &ctrls, scan_ctrls_filter, alphasort);
+	if (n < 0)
+		return 0;
+	for (i = 0; i < n; i++) {
+		snprintf(path, sizeof(path), "/sys/class/nvme/%s",
+			 ctrls[i]->d_name);
+		subsysnqn = get_nvme_subsnqn(path);
+		if (!err && subsysnqn && !strcmp(subsysnqn, nqn)) {
+			snprintf(path, sizeof(path), "/dev/%s",
+				 ctrls[i]->d_name);
+			err = fw_update_add_dev(u, path);
+		}
+		free(subsysnqn);
+		free(ctrls[i]);
+	}
+	free(ctrls);
+	return err;
+}
+
+static void fw_update_show(struct fw_update *u)
+{
+	struct json_object *root, *dev;
+	struct json_array *devices;
+	struct fw_update_dev *d;
+	int i;
+
+	root = json_create_object();
+	devices = json_create_array();
+	for (i = 0; i < u->ndevs; i++) {
+		d = &u->devs[i];
+		dev = json_create_object();
+		json_object_add_value_string(dev, "device", d->path);
+		json_object_add_value_string(dev, "status", d->status);
+		if (d->old_rev[0])
+			json_object_add_value_string(dev, "old_revision",
+						     d->old_rev);
+		if (d->new_rev[0])
+			json_object_add_value_string(dev, "new_revision",
+						     d->new_rev);
+		if (d->reset)
+			json_object_add_value_string(dev, "reset_required",
+						     d->reset);
+		if (d->dl.chunks) {
+			json_object_add_value_uint(dev, "download_chunks",
+						   d->dl.chunks);
+			json_object_add_value_uint(dev, "download_us",
+						   d->dl.total_ns / 1000);
+		}
+		if (d->step) {
+			json_object_add_value_string(dev, "failed_step",
+						     d->step);
+			json_object_add_value_string(dev, "error", d->err < 0 ?
+				strerror(-d->err) : nvme_status_to_string(d->err));
+		}
+		json_array_add_value_object(devices, dev);
+	}
+	json_object_add_value_array(root, "devices", devices);
+	json_print_object(root, NULL);
+	json_free_object(root);
+}
+
+static int fw_update(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Download a firmware image to every controller "\
+		"matching a device glob or subsystem NQN, commit it and "\
+		"optionally reset the controllers to activate it. Controllers "\
+		"are updated in parallel and a JSON result is printed per "\
+		"controller.";
+	const char *fw = "firmware file (required)";
+	const char *devices = "glob of controller devices, e.g. /dev/nvme*";
+	const char *nqn = "update all controllers of this subsystem NQN";
+	const char *revision = "firmware revision of the image; controllers "\
+		"already running it are skipped";
+	const char *slot = "[0-7]: firmware slot for commit action";
+	const char *action = "[0-7]: commit action, default 1";
+	const char *xfer = "transfer chunksize limit, default from MDTS";
+	const char *jobs = "number of controllers updated at once";
+	const char *reset = "reset controllers that need it to activate "\
+		"the new firmware";
+	struct fw_update u = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+	};
+	struct fw_image img;
+	pthread_t *threads = NULL;
+	bool *started = NULL;
+	glob_t g;
+	int err, i, nthreads;
+
+	struct config {
+		char  *fw;
+		char  *devices;
+		char  *nqn;
+		char  *revision;
+		__u8  slot;
+		__u8  action;
+		__u32 xfer;
+		__u32 jobs;
+		int   reset;
+	};
+
+	struct config cfg = {
+		.fw       = "",
+		.devices  = "",
+		.nqn      = "",
+		.revision = "",
+		.slot     = 0,
+		.action   = 1,
+		.xfer     = 0,
+		.jobs     = 8,
+	};
+
+	const struct argconfig_commandline_options opts[] = {
+		{"fw",       'f', "FILE", CFG_STRING,   &cfg.fw,       required_argument, fw},
+		{"devices",  'd', "GLOB", CFG_STRING,   &cfg.devices,  required_argument, devices},
+		{"nqn",      'n', "NQN",  CFG_STRING,   &cfg.nqn,      required_argument, nqn},
+		{"revision", 'r', "REV",  CFG_STRING,   &cfg.revision, required_argument, revision},
+		{"slot",     's', "NUM",  CFG_BYTE,     &cfg.slot,     required_argument, slot},
+		{"action",   'a', "NUM",  CFG_BYTE,     &cfg.action,   required_argument, action},
+		{"xfer",     'x', "NUM",  CFG_POSITIVE, &cfg.xfer,     required_argument, xfer},
+		{"jobs",     'j', "NUM",  CFG_POSITIVE, &cfg.jobs,     required_argument, jobs},
+		{"reset",    'R', "",     CFG_NONE,     &cfg.reset,    no_argument,       reset},
+		{NULL}
+	};
+
+	err = argconfig_parse(argc, argv, desc, opts, &cfg, sizeof(cfg));
+	if (err < 0)
+		goto ret;
+
+	if (!strlen(cfg.devices) == !strlen(cfg.nqn)) {
+		fprintf(stderr, "exactly one of --devices or --nqn is required\n");
+		err = -EINVAL;
+		goto ret;
+	}
+	if (cfg.slot > 7) {
+		fprintf(stderr, "invalid slot:%d\n", cfg.slot);
+		err = -EINVAL;
+		goto ret;
+	}
+	if (cfg.action > 7 || cfg.action == 4 || cfg.action == 5) {
+		fprintf(stderr, "invalid action:%d\n", cfg.action);
+		err = -EINVAL;
+		goto ret;
+	}
+	if (strlen(cfg.revision) > 8) {
+		fprintf(stderr, "invalid revision:%s\n", cfg.revision);
+		err = -EINVAL;
+		goto ret;
+	}
+	if (!cfg.jobs) {
+		err = -EINVAL;
+		goto ret;
+	}
+	if (cfg.xfer % 4096)
+		cfg.xfer = 4096;
+
+	if (strlen(cfg.devices)) {
+		err = glob(cfg.devices, 0, NULL, &g);
+		if (err && err != GLOB_NOMATCH) {
+			err = -ENOMEM;
+			goto ret;
+		}
+		for (i = 0; !err && i < g.gl_pathc; i++)
+			err = fw_update_add_dev(&u, g.gl_pathv[i]);
+		globfree(&g);
+	} else
+		err = fw_update_scan_nqn(&u, cfg.nqn);
+	if (err < 0)
+		goto free_devs;
+	if (!u.ndevs) {
+		fprintf(stderr, "no NVMe controller(s) matched.\n");
+		err = -ENODEV;
+		goto free_devs;
+	}
+
+	err = fw_image_get(cfg.fw, &img);
+	if (err)
+		goto free_devs;
+
+	u.img = &img;
+	u.xfer = cfg.xfer;
+	u.slot = cfg.slot;
+	u.action = cfg.action;
+	u.revision = strlen(cfg.revision) ? cfg.revision : NULL;
+	u.reset = cfg.reset;
+
+	nthreads = min(u.ndevs, (int)min(cfg.jobs, 256));
+	threads = calloc(nthreads, sizeof(*threads));
+	started = calloc(nthreads, sizeof(*started));
+	if (!threads || !started) {
+		err = -ENOMEM;
+		goto put_image;
+	}
+	for (i = 1; i < nthreads; i++)
+		started[i] = !pthread_create(&threads[i], NULL,
+					     fw_update_worker, &u);
+	fw_update_worker(&u);
+	for (i = 1; i < nthreads; i++)
+		if (started[i])
+			pthread_join(threads[i], NULL);
+
+	fw_update_show(&u);
+	for (i = 0; i < u.ndevs; i++) {
+		if (u.devs[i].err) {
+			err = u.devs[i].err;
+			break;
+		}
+	}
+
+put_image:
+	free(threads);
+	free(started);
+	fw_image_put(&img);
+free_devs:
+	for (i = 0; i < u.ndevs; i++) {
+		free(u.devs[i].path);
+		free(u.devs[i].subsysnqn);
+	}
+	free(u.devs);
+ret:
+	return nvme_status_to_errno(err, false);
+}
+
 static int subsystem_reset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Resets the NVMe subsystem\n";
@@ -3479,7 +4700,7 @@ static int set_property(int argc, char **argv, struct command *cmd, struct plugi
 	if (err < 0) {
 		perror("set-property");
 	} else if (!err) {
-		printf("set-property: %02x (%s), value: %#08x\n", cfg.offset,
+		fprintf(nvme_out(), "set-property: %02x (%s), value: %#08x\n", cfg.offset,
 				nvme_register_to_string(cfg.offset), cfg.value);
 	} else if (err > 0) {
 		show_nvme_status(err);
@@ -3764,7 +4985,7 @@ static int format(int argc, char **argv, struct command *cmd, struct plugin *plu
 	else if (err != 0)
 		show_nvme_status(err);
 	else {
-		printf("Success formatting namespace:%x\n", cfg.namespace_id);
+		fprintf(nvme_out(), "Success formatting namespace:%x\n", cfg.namespace_id);
 		if (S_ISBLK(nvme_stat.st_mode) && ioctl(fd, BLKRRPART) < 0) {
 			fprintf(stderr, "failed to re-read partition table\n");
 			err = -errno;
@@ -3880,7 +5101,7 @@ static int set_feature(int argc, char **argv, struct command *cmd, struct plugin
 	if (err < 0) {
 		perror("set-feature");
 	} else if (!err) {
-		printf("set-feature:%02x (%s), value:%#08x\n", cfg.feature_id,
+		fprintf(nvme_out(), "set-feature:%02x (%s), value:%#08x\n", cfg.feature_id,
 			nvme_feature_to_string(cfg.feature_id), cfg.value);
 		if (buf) {
 			if (cfg.feature_id == NVME_FEAT_LBA_RANGE)
@@ -3990,7 +5211,7 @@ static int sec_send(int argc, char **argv, struct command *cmd, struct plugin *p
 	else if (err != 0)
 		fprintf(stderr, "NVME Security Send Command Error:%d\n", err);
 	else
-		printf("NVME Security Send Command Success:%d\n", result);
+		fprintf(nvme_out(), "NVME Security Send Command Success:%d\n", result);
 
 free:
 	free(sec_buf);
@@ -4133,7 +5354,7 @@ static int dir_send(int argc, char **argv, struct command *cmd, struct plugin *p
 		goto close_ffd;
 	}
 	if (!err) {
-		printf("dir-send: type %#x, operation %#x, spec_val %#x, nsid %#x, result %#x \n",
+		fprintf(nvme_out(), "dir-send: type %#x, operation %#x, spec_val %#x, nsid %#x, result %#x \n",
 				cfg.dtype, cfg.doper, cfg.dspec, cfg.namespace_id, result);
 		if (buf) {
 			if (!cfg.raw_binary)
@@ -4205,7 +5426,7 @@ static int write_uncor(int argc, char **argv, struct command *cmd, struct plugin
 	else if (err != 0)
 		show_nvme_status(err);
 	else
-		printf("NVME Write Uncorrectable Success\n");
+		fprintf(nvme_out(), "NVME Write Uncorrectable Success\n");
 
 close_fd:
 	close(fd);
@@ -4299,7 +5520,7 @@ static int write_zeroes(int argc, char **argv, struct command *cmd, struct plugi
 	else if (err != 0)
 		show_nvme_status(err);
 	else
-		printf("NVME Write Zeroes Success\n");
+		fprintf(nvme_out(), "NVME Write Zeroes Success\n");
 
 close_fd:
 	close(fd);
@@ -4402,7 +5623,7 @@ static int dsm(int argc, char **argv, struct command *cmd, struct plugin *plugin
 	else if (err != 0)
 		show_nvme_status(err);
 	else
-		printf("NVMe DSM: success\n");
+		fprintf(nvme_out(), "NVMe DSM: success\n");
 
 close_fd:
 	close(fd);
@@ -4453,7 +5674,7 @@ static int flush(int argc, char **argv, struct command *cmd, struct plugin *plug
 	else if (err != 0)
 		show_nvme_status(err);
 	else
-		printf("NVMe Flush: success\n");
+		fprintf(nvme_out(), "NVMe Flush: success\n");
 close_fd:
 	close(fd);
 ret:
@@ -4529,7 +5750,7 @@ static int resv_acquire(int argc, char **argv, struct command *cmd, struct plugi
 	else if (err != 0)
 		show_nvme_status(err);
 	else
-		printf("NVME Reservation Acquire success\n");
+		fprintf(nvme_out(), "NVME Reservation Acquire success\n");
 
 close_fd:
 	close(fd);
@@ -4609,7 +5830,7 @@ static int resv_register(int argc, char **argv, struct command *cmd, struct plug
 	else if (err != 0)
 		show_nvme_status(err);
 	else
-		printf("NVME Reservation  success\n");
+		fprintf(nvme_out(), "NVME Reservation  success\n");
 
 close_fd:
 	close(fd);
@@ -4685,7 +5906,7 @@ static int resv_release(int argc, char **argv, struct command *cmd, struct plugi
 	else if (err != 0)
 		show_nvme_status(err);
 	else
-		printf("NVME Reservation Release success\n");
+		fprintf(nvme_out(), "NVME Reservation Release success\n");
 
 close_fd:
 	close(fd);
@@ -4778,7 +5999,7 @@ static int resv_report(int argc, char **argv, struct command *cmd, struct plugin
 		else if (fmt == JSON)
 			json_nvme_resv_report(status, size, cfg.cdw11);
 		else {
-			printf("NVME Reservation Report success\n");
+			fprintf(nvme_out(), "NVME Reservation Report success\n");
 			show_nvme_resv_report(status, size, cfg.cdw11);
 		}
 	}
@@ -4790,6 +6011,77 @@ ret:
 	return nvme_status_to_errno(err, false);
 }
 
+static int get_ns_geometry(int fd, __u32 nsid, __u64 *nsze,
+			   unsigned int *lba_size)
+{
+	struct nvme_id_ns ns;
+	int err;
+
+	err = nvme_identify_ns(fd, nsid, 0, &ns);
+	if (err)
+		return err;
+
+	*nsze = le64_to_cpu(ns.nsze);
+	*lba_size = 1 << ns.lbaf[ns.flbas & 0xf].ds;
+	return 0;
+}
+
+/*
+ * Fills in the LBA pattern and the region of @job, which spans from
+ * --start-block to the end of the namespace.
+ */
+static int setup_iogen(struct nvme_iogen_job *job, const char *pattern,
+		       unsigned int *lba_size)
+{
+	__u64 nsze;
+	int err;
+
+	err = nvme_iogen_parse_pattern(pattern);
+	if (err < 0) {
+		fprintf(stderr, "Invalid io-pattern: %s\n", pattern);
+		return err;
+	}
+	job->pattern = err;
+
+	err = get_ns_geometry(job->fd, job->nsid, &nsze, lba_size);
+	if (err) {
+		if (err < 0)
+			perror("identify-namespace");
+		else
+			show_nvme_status(err);
+		return err;
+	}
+	if (job->slba >= nsze) {
+		fprintf(stderr, "start-block is beyond the namespace size\n");
+		return -EINVAL;
+	}
+	job->nr_lbas = nsze - job->slba;
+	return 0;
+}
+
+static int run_iogen(struct nvme_iogen_job *job, const char *command,
+		     const char *pattern)
+{
+	struct nvme_iogen_result res;
+	unsigned int lba_size;
+	int err;
+
+	err = setup_iogen(job, pattern, &lba_size);
+	if (err)
+		return err;
+	if (job->opcode == nvme_cmd_verify)
+		job->data_size = (job->nblocks + 1) * lba_size;
+
+	err = nvme_iogen_run(job, &res);
+	if (res.ios)
+		show_iogen_result(&res, command, job->qd);
+	if (err < 0)
+		fprintf(stderr, "%s: %s\n", command, strerror(-err));
+	else if (err)
+		show_nvme_status(err);
+	return err;
+}
+
 static int submit_io(int opcode, char *command, const char *desc,
 		     int argc, char **argv)
 {
@@ -4822,6 +6114,9 @@ static int submit_io(int opcode, char *command, const char *desc,
 	const char *dtype = "directive type (for write-only)";
 	const char *dspec = "directive specific (for write-only)";
 	const char *dsm = "dataset management attributes (lower 16 bits)";
+	const char *queue_depth = "number of commands kept in flight";
+	const char *iterations = "number of commands to issue";
+	const char *io_pattern = "LBA pattern for repeated commands: seq|rand";
 
 	struct config {
 		__u64 start_block;
@@ -4842,6 +6137,9 @@ static int submit_io(int opcode, char *command, const char *desc,
 		int   show;
 		int   dry_run;
 		int   latency;
+		__u32 queue_depth;
+		__u64 iterations;
+		char  *io_pattern;
 	};
 
 	struct config cfg = {
@@ -4855,6 +6153,9 @@ static int submit_io(int opcode, char *command, const char *desc,
 		.prinfo          = 0,
 		.app_tag_mask    = 0,
 		.app_tag         = 0,
+		.queue_depth     = 1,
+		.iterations      = 1,
+		.io_pattern      = "seq",
 	};
 
 	const struct argconfig_commandline_options command_line_options[] = {
@@ -4876,6 +6177,9 @@ static int submit_io(int opcode, char *command, const char *desc,
 		{"show-command",      'v', "",     CFG_NONE,        &cfg.show,              no_argument,       show},
 		{"dry-run",           'w', "",     CFG_NONE,        &cfg.dry_run,           no_argument,       dry},
 		{"latency",           't', "",     CFG_NONE,        &cfg.latency,           no_argument,       latency},
+		{"queue-depth",       'q', "NUM",  CFG_POSITIVE,    &cfg.queue_depth,       required_argument, queue_depth},
+		{"iterations",        'i', "NUM",  CFG_LONG_SUFFIX, &cfg.iterations,        required_argument, iterations},
+		{"io-pattern",        'P', "PAT",  CFG_STRING,      &cfg.io_pattern,        required_argument, io_pattern},
 		{NULL}
 	};
 
@@ -4886,6 +6190,11 @@ static int submit_io(int opcode, char *command, const char *desc,
 	}
 
 	dfd = mfd = opcode & 1 ? STDIN_FILENO : STDOUT_FILENO;
+	if (!cfg.queue_depth || !cfg.iterations) {
+		fprintf(stderr, "queue-depth and iterations must be non-zero\n");
+		err = -EINVAL;
+		goto close_fd;
+	}
 	if (cfg.prinfo > 0xf) {
 		err = -EINVAL;
 		goto close_fd;
@@ -4982,28 +6291,56 @@ static int submit_io(int opcode, char *command, const char *desc,
 	}
 
 	if (cfg.show) {
-		printf("opcode       : %02x\n", opcode);
-		printf("flags        : %02x\n", 0);
-		printf("control      : %04x\n", control);
-		printf("nblocks      : %04x\n", cfg.block_count);
-		printf("rsvd         : %04x\n", 0);
-		printf("metadata     : %"PRIx64"\n", (uint64_t)(uintptr_t)mbuffer);
-		printf("addr         : %"PRIx64"\n", (uint64_t)(uintptr_t)buffer);
-		printf("slba         : %"PRIx64"\n", (uint64_t)cfg.start_block);
-		printf("dsmgmt       : %08x\n", dsmgmt);
-		printf("reftag       : %08x\n", cfg.ref_tag);
-		printf("apptag       : %04x\n", cfg.app_tag);
-		printf("appmask      : %04x\n", cfg.app_tag_mask);
+		fprintf(nvme_out(), "opcode       : %02x\n", opcode);
+		fprintf(nvme_out(), "flags        : %02x\n", 0);
+		fprintf(nvme_out(), "control      : %04x\n", control);
+		fprintf(nvme_out(), "nblocks      : %04x\n", cfg.block_count);
+		fprintf(nvme_out(), "rsvd         : %04x\n", 0);
+		fprintf(nvme_out(), "metadata     : %"PRIx64"\n", (uint64_t)(uintptr_t)mbuffer);
+		fprintf(nvme_out(), "addr         : %"PRIx64"\n", (uint64_t)(uintptr_t)buffer);
+		fprintf(nvme_out(), "slba         : %"PRIx64"\n", (uint64_t)cfg.start_block);
+		fprintf(nvme_out(), "dsmgmt       : %08x\n", dsmgmt);
+		fprintf(nvme_out(), "reftag       : %08x\n", cfg.ref_tag);
+		fprintf(nvme_out(), "apptag       : %04x\n", cfg.app_tag);
+		fprintf(nvme_out(), "appmask      : %04x\n", cfg.app_tag_mask);
 	}
 	if (cfg.dry_run)
 		goto free_mbuffer;
 
+	if (cfg.queue_depth > 1 || cfg.iterations > 1) {
+		struct nvme_iogen_job job = {
+			.fd		= fd,
+			.opcode		= opcode,
+			.slba		= cfg.start_block,
+			.nblocks	= cfg.block_count,
+			.control	= control,
+			.dsmgmt		= dsmgmt,
+			.reftag		= cfg.ref_tag,
+			.apptag		= cfg.app_tag,
+			.appmask	= cfg.app_tag_mask,
+			.data		= buffer,
+			.data_size	= buffer_size,
+			.metadata	= mbuffer,
+			.metadata_size	= cfg.metadata_size,
+			.qd		= cfg.queue_depth,
+			.iterations	= cfg.iterations,
+		};
+
+		job.nsid = get_nsid(fd);
+		if (!job.nsid) {
+			err = -EINVAL;
+			goto free_mbuffer;
+		}
+		err = run_iogen(&job, command, cfg.io_pattern);
+		goto free_mbuffer;
+	}
+
 	gettimeofday(&start_time, NULL);
 	err = nvme_io(fd, opcode, cfg.start_block, cfg.block_count, control, dsmgmt,
 			cfg.ref_tag, cfg.app_tag, cfg.app_tag_mask, buffer, mbuffer);
 	gettimeofday(&end_time, NULL);
 	if (cfg.latency)
-		printf(" latency: %s: %llu us\n",
+		fprintf(nvme_out(), " latency: %s: %llu us\n",
 			command, elapsed_utime(start_time, end_time));
 	if (err < 0)
 		perror("submit-io");
@@ -5076,6 +6413,9 @@ static int verify_cmd(int argc, char **argv, struct command *cmd, struct plugin
 	const char *ref_tag = "reference tag (for end to end PI)";
 	const char *app_tag_mask = "app tag mask (for end to end PI)";
 	const char *app_tag = "app tag (for end to end PI)";
+	const char *queue_depth = "number of commands kept in flight";
+	const char *iterations = "number of commands to issue";
+	const char *io_pattern = "LBA pattern for repeated commands: seq|rand";
 
 	struct config {
 		__u64 start_block;
@@ -5087,6 +6427,9 @@ static int verify_cmd(int argc, char **argv, struct command *cmd, struct plugin
 		__u8  prinfo;
 		int   limited_retry;
 		int   force_unit_access;
+		__u32 queue_depth;
+		__u64 iterations;
+		char  *io_pattern;
 	};
 
 	struct config cfg = {
@@ -5099,6 +6442,9 @@ static int verify_cmd(int argc, char **argv, struct command *cmd, struct plugin
 		.app_tag_mask      = 0,
 		.limited_retry     = 0,
 		.force_unit_access = 0,
+		.queue_depth       = 1,
+		.iterations        = 1,
+		.io_pattern        = "seq",
 	};
 
 	const struct argconfig_commandline_options command_line_options[] = {
@@ -5111,6 +6457,9 @@ static int verify_cmd(int argc, char **argv, struct command *cmd, struct plugin
 		{"ref-tag",           'r', "NUM", CFG_POSITIVE,    &cfg.ref_tag,           required_argument, ref_tag},
 		{"app-tag",           'a', "NUM", CFG_SHORT,       &cfg.app_tag,           required_argument, app_tag},
 		{"app-tag-mask",      'm', "NUM", CFG_SHORT,       &cfg.app_tag_mask,      required_argument, app_tag_mask},
+		{"queue-depth",       'q', "NUM", CFG_POSITIVE,    &cfg.queue_depth,       required_argument, queue_depth},
+		{"iterations",        'i', "NUM", CFG_LONG_SUFFIX, &cfg.iterations,        required_argument, iterations},
+		{"io-pattern",        'P', "PAT", CFG_STRING,      &cfg.io_pattern,        required_argument, io_pattern},
 		{NULL}
 	};
 
@@ -5118,7 +6467,7 @@ static int verify_cmd(int argc, char **argv, struct command *cmd, struct plugin
 	if (fd < 0)
 		return fd;
 
-	if (cfg.prinfo > 0xf) {
+	if (cfg.prinfo > 0xf || !cfg.queue_depth || !cfg.iterations) {
 		err = EINVAL;
 		goto close_fd;
 	}
@@ -5137,6 +6486,25 @@ static int verify_cmd(int argc, char **argv, struct command *cmd, struct plugin
 		}
 	}
 
+	if (cfg.queue_depth > 1 || cfg.iterations > 1) {
+		struct nvme_iogen_job job = {
+			.fd		= fd,
+			.opcode		= nvme_cmd_verify,
+			.nsid		= cfg.namespace_id,
+			.slba		= cfg.start_block,
+			.nblocks	= cfg.block_count,
+			.control	= control,
+			.reftag		= cfg.ref_tag,
+			.apptag		= cfg.app_tag,
+			.appmask	= cfg.app_tag_mask,
+			.qd		= cfg.queue_depth,
+			.iterations	= cfg.iterations,
+		};
+
+		err = run_iogen(&job, "verify", cfg.io_pattern);
+		goto close_fd;
+	}
+
 	err = nvme_verify(fd, cfg.namespace_id, cfg.start_block, cfg.block_count,
 				control, cfg.ref_tag, cfg.app_tag, cfg.app_tag_mask);
 	if (err < 0)
@@ -5144,13 +6512,181 @@ static int verify_cmd(int argc, char **argv, struct command *cmd, struct plugin
 	else if (err != 0)
 		show_nvme_status(err);
 	else
-		printf("NVME Verify Success\n");
+		fprintf(nvme_out(), "NVME Verify Success\n");
 
 close_fd:
 	close(fd);
 	return err;
 }
 
+static int latency_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Repeatedly read (or write) the given logical "\
+		"blocks from within this process and report a latency "\
+		"histogram with percentiles.";
+	const char *start_block = "64-bit addr of first block to access";
+	const char *block_count = "number of blocks (zeroes based) on device to access";
+	const char *data_size = "size of data in bytes";
+	const char *metadata_size = "size of metadata in bytes";
+	const char *ref_tag = "reference tag (for end to end PI)";
+	const char *prinfo = "PI and check field";
+	const char *app_tag_mask = "app tag mask (for end to end PI)";
+	const char *app_tag = "app tag (for end to end PI)";
+	const char *limited_retry = "limit num. media access attempts";
+	const char *force = "force device to commit data before command completes";
+	const char *write = "measure writes of random data instead of reads";
+	const char *iterations = "number of commands to issue";
+	const char *queue_depth = "number of commands kept in flight";
+	const char *io_pattern = "LBA pattern: fixed|seq|rand";
+	struct nvme_iogen_result res;
+	struct nvme_iogen_job job;
+	unsigned int lba_size;
+	void *buffer = NULL, *mbuffer = NULL;
+	__u16 control = 0;
+	int err, fmt, fd;
+	size_t i;
+
+	struct config {
+		__u64 start_block;
+		__u16 block_count;
+		__u64 data_size;
+		__u64 metadata_size;
+		__u32 ref_tag;
+		__u8  prinfo;
+		__u16 app_tag_mask;
+		__u16 app_tag;
+		int   limited_retry;
+		int   force_unit_access;
+		int   write;
+		__u64 iterations;
+		__u32 queue_depth;
+		char  *io_pattern;
+		char  *output_format;
+	};
+
+	struct config cfg = {
+		.start_block     = 0,
+		.block_count     = 0,
+		.data_size       = 0,
+		.metadata_size   = 0,
+		.ref_tag         = 0,
+		.prinfo          = 0,
+		.app_tag_mask    = 0,
+		.app_tag         = 0,
+		.iterations      = 1000,
+		.queue_depth     = 1,
+		.io_pattern      = "fixed",
+		.output_format   = "normal",
+	};
+
+	const struct argconfig_commandline_options command_line_options[] = {
+		{"start-block",       's', "NUM", CFG_LONG_SUFFIX, &cfg.start_block,       required_argument, start_block},
+		{"block-count",       'c', "NUM", CFG_SHORT,       &cfg.block_count,       required_argument, block_count},
+		{"data-size",         'z', "NUM", CFG_LONG_SUFFIX, &cfg.data_size,         required_argument, data_size},
+		{"metadata-size",     'y', "NUM", CFG_LONG_SUFFIX, &cfg.metadata_size,     required_argument, metadata_size},
+		{"ref-tag",           'r', "NUM", CFG_POSITIVE,    &cfg.ref_tag,           required_argument, ref_tag},
+		{"prinfo",            'p', "NUM", CFG_BYTE,        &cfg.prinfo,            required_argument, prinfo},
+		{"app-tag-mask",      'm', "NUM", CFG_SHORT,       &cfg.app_tag_mask,      required_argument, app_tag_mask},
+		{"app-tag",           'a', "NUM", CFG_SHORT,       &cfg.app_tag,           required_argument, app_tag},
+		{"limited-retry",     'l', "",    CFG_NONE,        &cfg.limited_retry,     no_argument,       limited_retry},
+		{"force-unit-access", 'f', "",    CFG_NONE,        &cfg.force_unit_access, no_argument,       force},
+		{"write",             'w', "",    CFG_NONE,        &cfg.write,             no_argument,       write},
+		{"iterations",        'i', "NUM", CFG_LONG_SUFFIX, &cfg.iterations,        required_argument, iterations},
+		{"queue-depth",       'q', "NUM", CFG_POSITIVE,    &cfg.queue_depth,       required_argument, queue_depth},
+		{"io-pattern",        'P', "PAT", CFG_STRING,      &cfg.io_pattern,        required_argument, io_pattern},
+		{"output-format",     'o', "FMT", CFG_STRING,      &cfg.output_format,     required_argument, output_format},
+		{NULL}
+	};
+
+	fd = parse_and_open(argc, argv, desc, command_line_options, &cfg, sizeof(cfg));
+	if (fd < 0)
+		return fd;
+
+	fmt = validate_output_format(cfg.output_format);
+	if (fmt < 0 || fmt == BINARY) {
+		fprintf(stderr, "Invalid output format\n");
+		err = -EINVAL;
+		goto close_fd;
+	}
+	if (cfg.prinfo > 0xf || !cfg.iterations || !cfg.queue_depth) {
+		err = -EINVAL;
+		goto close_fd;
+	}
+
+	control |= (cfg.prinfo << 10);
+	if (cfg.limited_retry)
+		control |= NVME_RW_LR;
+	if (cfg.force_unit_access)
+		control |= NVME_RW_FUA;
+
+	memset(&job, 0, sizeof(job));
+	job.fd = fd;
+	job.opcode = cfg.write ? nvme_cmd_write : nvme_cmd_read;
+	job.slba = cfg.start_block;
+	job.nblocks = cfg.block_count;
+	job.control = control;
+	job.reftag = cfg.ref_tag;
+	job.apptag = cfg.app_tag;
+	job.appmask = cfg.app_tag_mask;
+	job.qd = cfg.queue_depth;
+	job.iterations = cfg.iterations;
+
+	job.nsid = get_nsid(fd);
+	if (!job.nsid) {
+		err = -EINVAL;
+		goto close_fd;
+	}
+	err = setup_iogen(&job, cfg.io_pattern, &lba_size);
+	if (err)
+		goto close_fd;
+
+	job.data_size = max(cfg.data_size, (__u64)(cfg.block_count + 1) * lba_size);
+	buffer = malloc(job.data_size);
+	if (!buffer) {
+		err = -ENOMEM;
+		goto close_fd;
+	}
+	if (cfg.write) {
+		fprintf(stderr, "WARNING: writing random data to %s\n", devicename);
+		srand(time(NULL));
+		for (i = 0; i < job.data_size; i++)
+			((__u8 *)buffer)[i] = rand();
+	} else
+		memset(buffer, 0, job.data_size);
+	job.data = buffer;
+
+	if (cfg.metadata_size) {
+		mbuffer = calloc(1, cfg.metadata_size);
+		if (!mbuffer) {
+			err = -ENOMEM;
+			goto free_buffer;
+		}
+		job.metadata = mbuffer;
+		job.metadata_size = cfg.metadata_size;
+	}
+
+	err = nvme_iogen_run(&job, &res);
+	if (err < 0)
+		fprintf(stderr, "latency: %s\n", strerror(-err));
+	else if (err)
+		show_nvme_status(err);
+	if (res.ios) {
+		if (fmt == JSON)
+			json_latency_stats(&res, cfg.write ? "write" : "read",
+					   job.data_size, job.qd);
+		else
+			show_latency_stats(&res, cfg.write ? "write" : "read",
+					   job.data_size, job.qd);
+	}
+
+	free(mbuffer);
+free_buffer:
+	free(buffer);
+close_fd:
+	close(fd);
+	return nvme_status_to_errno(err, false);
+}
+
 static int sec_recv(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Obtain results of one or more "\
@@ -5222,7 +6758,7 @@ static int sec_recv(int argc, char **argv, struct command *cmd, struct plugin *p
 									err);
 	else {
 		if (!cfg.raw_binary) {
-			printf("NVME Security Receive Command Success:%d\n",
+			fprintf(nvme_out(), "NVME Security Receive Command Success:%d\n",
 							result);
 			d(sec_buf, cfg.size, 16, 1);
 		} else if (cfg.size)
@@ -5428,7 +6964,7 @@ static int dir_receive(int argc, char **argv, struct command *cmd, struct plugin
 	}
 
 	if (!err) {
-		printf("dir-receive: type %#x, operation %#x, spec %#x, nsid %#x, result %#x \n",
+		fprintf(nvme_out(), "dir-receive: type %#x, operation %#x, spec %#x, nsid %#x, result %#x \n",
 				cfg.dtype, cfg.doper, cfg.dspec, cfg.namespace_id, result);
 		if (cfg.human_readable)
 			nvme_directive_show_fields(cfg.dtype, cfg.doper, result, buf);
@@ -5601,23 +7137,23 @@ static int passthru(int argc, char **argv, int ioctl_cmd, const char *desc, stru
 	}
 
 	if (cfg.show_command) {
-		printf("opcode       : %02x\n", cfg.opcode);
-		printf("flags        : %02x\n", cfg.flags);
-		printf("rsvd1        : %04x\n", cfg.rsvd);
-		printf("nsid         : %08x\n", cfg.namespace_id);
-		printf("cdw2         : %08x\n", cfg.cdw2);
-		printf("cdw3         : %08x\n", cfg.cdw3);
-		printf("data_len     : %08x\n", cfg.data_len);
-		printf("metadata_len : %08x\n", cfg.metadata_len);
-		printf("addr         : %"PRIx64"\n", (uint64_t)(uintptr_t)data);
-		printf("metadata     : %"PRIx64"\n", (uint64_t)(uintptr_t)metadata);
-		printf("cdw10        : %08x\n", cfg.cdw10);
-		printf("cdw11        : %08x\n", cfg.cdw11);
-		printf("cdw12        : %08x\n", cfg.cdw12);
-		printf("cdw13        : %08x\n", cfg.cdw13);
-		printf("cdw14        : %08x\n", cfg.cdw14);
-		printf("cdw15        : %08x\n", cfg.cdw15);
-		printf("timeout_ms   : %08x\n", cfg.timeout);
+		fprintf(nvme_out(), "opcode       : %02x\n", cfg.opcode);
+		fprintf(nvme_out(), "flags        : %02x\n", cfg.flags);
+		fprintf(nvme_out(), "rsvd1        : %04x\n", cfg.rsvd);
+		fprintf(nvme_out(), "nsid         : %08x\n", cfg.namespace_id);
+		fprintf(nvme_out(), "cdw2         : %08x\n", cfg.cdw2);
+		fprintf(nvme_out(), "cdw3         : %08x\n", cfg.cdw3);
+		fprintf(nvme_out(), "data_len     : %08x\n", cfg.data_len);
+		fprintf(nvme_out(), "metadata_len : %08x\n", cfg.metadata_len);
+		fprintf(nvme_out(), "addr         : %"PRIx64"\n", (uint64_t)(uintptr_t)data);
+		fprintf(nvme_out(), "metadata     : %"PRIx64"\n", (uint64_t)(uintptr_t)metadata);
+		fprintf(nvme_out(), "cdw10        : %08x\n", cfg.cdw10);
+		fprintf(nvme_out(), "cdw11        : %08x\n", cfg.cdw11);
+		fprintf(nvme_out(), "cdw12        : %08x\n", cfg.cdw12);
+		fprintf(nvme_out(), "cdw13        : %08x\n", cfg.cdw13);
+		fprintf(nvme_out(), "cdw14        : %08x\n", cfg.cdw14);
+		fprintf(nvme_out(), "cdw15        : %08x\n", cfg.cdw15);
+		fprintf(nvme_out(), "timeout_ms   : %08x\n", cfg.timeout);
 	}
 	if (cfg.dry_run)
 		goto free_data;
@@ -5678,7 +7214,7 @@ static int gen_hostnqn_cmd(int argc, char **argv, struct command *command, struc
 
 	uuid_generate_random(uuid);
 	uuid_unparse_lower(uuid, uuid_str);
-	printf("nqn.2014-08.org.nvmexpress:uuid:%s\n", uuid_str);
+	fprintf(nvme_out(), "nqn.2014-08.org.nvmexpress:uuid:%s\n", uuid_str);
 	return 0;
 }
 #else
@@ -5705,7 +7241,7 @@ static int connect_all_cmd(int argc, char **argv, struct command *command, struc
 static int connect_cmd(int argc, char **argv, struct command *command, struct plugin *plugin)
 {
 	const char *desc = "Connect to NVMeoF subsystem";
-	return connect(desc, argc, argv);
+	return fabrics_connect(desc, argc, argv);
 }
 
 static int disconnect_cmd(int argc, char **argv, struct command *command, struct plugin *plugin)
@@ -5720,6 +7256,268 @@ static int disconnect_all_cmd(int argc, char **argv, struct command *command, st
 	return disconnect_all(desc, argc, argv);
 }
 
+/*
+ * Commands that leave the controllers as they were. Anything else may
+ * change what Identify returns and drops the cached data.
+ */
+static const char *cached_read_only[] = {
+	"list", "list-subsys", "id-ctrl", "id-ns", "ns-descs", "list-ns",
+	"list-ctrl", "get-ns-id", "smart-log", "error-log", "fw-log",
+	"effects-log", "endurance-log", "get-log", "show-regs", "version",
+	NULL
+};
+
+/* Runs one command line of the daemon or of a batch in this process */
+static int cached_run(int argc, char **argv)
+{
+	const char *name = argv[0];
+	bool read_only = false;
+	int i, ret;
+
+	while (*name == '-')
+		name++;
+	/* these would take over the process */
+	if (!strcmp(name, "daemon") || !strcmp(name, "batch"))
+		return -EINVAL;
+	for (i = 0; cached_read_only[i]; i++)
+		if (!strcmp(name, cached_read_only[i]))
+			read_only = true;
+
+	/* start from what a new process would see */
+	json_set_format(JSON_FMT_PRETTY);
+	binary_output = false;
+	errno = 0;
+
+	ret = handle_plugin(argc, argv, nvme.extensions);
+	if (!read_only)
+		nvme_identify_ctrl_cache_flush();
+	return ret;
+}
+
+static int daemon_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Serve nvme commands over a Unix socket. Each "\
+		"request is a command line as given to nvme, without the "\
+		"program name; the reply carries its status and output. "\
+		"Opened devices and Identify Controller data are kept "\
+		"between requests.";
+	const char *socket = "path of the Unix socket to listen on";
+	int err;
+
+	struct config {
+		char *socket;
+	};
+
+	struct config cfg = {
+		.socket = "",
+	};
+
+	const struct argconfig_commandline_options opts[] = {
+		{"socket", 'S', "PATH", CFG_STRING, &cfg.socket, required_argument, socket},
+		{NULL}
+	};
+
+	err = argconfig_parse(argc, argv, desc, opts, &cfg, sizeof(cfg));
+	if (err < 0)
+		return err;
+	if (!strlen(cfg.socket)) {
+		fprintf(stderr, "--socket is required\n");
+		argconfig_print_help(desc, opts);
+		return -EINVAL;
+	}
+
+	dev_cache_enabled = true;
+	nvme.embedded = true;
+	err = nvme_daemon_serve(cfg.socket, cached_run);
+	if (err)
+		fprintf(stderr, "%s: %s\n", cfg.socket, strerror(-err));
+	return err;
+}
+
+static char *base64_encode(const unsigned char *data, size_t len)
+{
+	static const char tbl[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	char *out, *p;
+	__u32 v;
+	size_t i;
+
+	out = p = malloc((len + 2) / 3 * 4 + 1);
+	if (!out)
+		return NULL;
+	for (i = 0; i < len; i += 3) {
+		v = data[i] << 16;
+		if (i + 1 < len)
+			v |= data[i + 1] << 8;
+		if (i + 2 < len)
+			v |= data[i + 2];
+		*p++ = tbl[(v >> 18) & 0x3f];
+		*p++ = tbl[(v >> 12) & 0x3f];
+		*p++ = i + 1 < len ? tbl[(v >> 6) & 0x3f] : '=';
+		*p++ = i + 2 < len ? tbl[v & 0x3f] : '=';
+	}
+	*p = '\0';
+	return out;
+}
+
+/* Strict UTF-8: no overlong forms, surrogates or code points past U+10FFFF */
+static bool utf8_valid(const unsigned char *s, size_t len)
+{
+	size_t i = 0, n, k;
+	__u32 c, min;
+
+	while (i < len) {
+		c = s[i];
+		if (c < 0x80) {
+			i++;
+			continue;
+		} else if ((c & 0xe0) == 0xc0) {
+			n = 1, min = 0x80, c &= 0x1f;
+		} else if ((c & 0xf0) == 0xe0) {
+			n = 2, min = 0x800, c &= 0x0f;
+		} else if ((c & 0xf8) == 0xf0) {
+			n = 3, min = 0x10000, c &= 0x07;
+		} else {
+			return false;
+		}
+		if (len - i <= n)
+			return false;
+		for (k = 1; k <= n; k++) {
+			if ((s[i + k] & 0xc0) != 0x80)
+				return false;
+			c = (c << 6) | (s[i + k] & 0x3f);
+		}
+		if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+			return false;
+		i += n + 1;
+	}
+	return true;
+}
+
+static void batch_result(FILE *out, unsigned long lineno, const char *cmd,
+			 int status, const char *output, size_t len)
+{
+	const char *encoding = NULL;
+	struct json_writer w;
+	char *buf = NULL;
+
+	/* binary output, e.g. with -o binary or -o cbor, can't be a string */
+	if (len && (binary_output || memchr(output, '\0', len) ||
+		    !utf8_valid((const unsigned char *)output, len))) {
+		buf = base64_encode((const unsigned char *)output, len);
+		encoding = "base64";
+	} else if (len) {
+		buf = strndup(output, len);
+	}
+	if (len && !buf)
+		status = -ENOMEM;
+	output = buf ? buf : "";
+
+	json_writer_init(&w, out);
+	w.fmt = JSON_FMT_NDJSON;
+	json_writer_begin_object(&w, NULL);
+	json_write_uint(&w, "line", lineno);
+	json_write_string(&w, "command", cmd);
+	json_write_int(&w, "status", status);
+	json_write_string(&w, "output", output);
+	if (buf && encoding)
+		json_write_string(&w, "encoding", encoding);
+	json_writer_end_object(&w);
+	fflush(out);
+	free(buf);
+}
+
+static int batch_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Run the nvme command lines read from a file, or "\
+		"from standard input if it is '-', in a single process. "\
+		"Opened devices and Identify Controller data are kept "\
+		"between lines. One JSON object per line gives its status "\
+		"and output.";
+	const char *stop = "stop at the first line that fails";
+	char *line = NULL, *copy, *args[NVME_DAEMON_MAX_ARGS], *p;
+	unsigned long lineno = 0;
+	struct nvme_sink sink;
+	size_t size = 0;
+	ssize_t len;
+	FILE *fp, *out = nvme_out();
+	int err, ret, nargs, status = 0;
+
+	struct config {
+		int stop_on_error;
+	};
+
+	struct config cfg = {
+		.stop_on_error = 0,
+	};
+
+	const struct argconfig_commandline_options opts[] = {
+		{"stop-on-error", 'e', "", CFG_NONE, &cfg.stop_on_error, no_argument, stop},
+		{NULL}
+	};
+
+	err = argconfig_parse(argc, argv, desc, opts, &cfg, sizeof(cfg));
+	if (err < 0)
+		return err;
+	if (optind >= argc) {
+		fprintf(stderr, "%s: script file or '-' required\n", argv[0]);
+		argconfig_print_help(desc, opts);
+		return -EINVAL;
+	}
+
+	if (!strcmp(argv[optind], "-")) {
+		fp = stdin;
+	} else {
+		fp = fopen(argv[optind], "r");
+		if (!fp) {
+			perror(argv[optind]);
+			return -errno;
+		}
+	}
+
+	dev_cache_enabled = true;
+	nvme.embedded = true;
+	while ((len = getline(&line, &size, fp)) >= 0) {
+		lineno++;
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		for (p = line; *p == ' ' || *p == '\t'; p++)
+			;
+		if (!*p || *p == '#')
+			continue;
+
+		copy = strdup(p);
+		if (!copy) {
+			status = -ENOMEM;
+			break;
+		}
+		nargs = nvme_daemon_split(p, args, NVME_DAEMON_MAX_ARGS);
+		sink.buf = NULL;
+		sink.len = 0;
+		if (nargs <= 0) {
+			ret = nargs ? nargs : -EINVAL;
+		} else if ((ret = nvme_sink_memory(&sink)) == 0) {
+			nvme_sink_push(&sink);
+			ret = cached_run(nargs, args);
+			nvme_sink_pop(&sink);
+			nvme_sink_close(&sink);
+		}
+		batch_result(out, lineno, copy, ret, sink.buf, sink.len);
+		free(sink.buf);
+		free(copy);
+
+		if (ret && !status)
+			status = ret;
+		if (ret && cfg.stop_on_error)
+			break;
+	}
+
+	free(line);
+	if (fp != stdin)
+		fclose(fp);
+	return status;
+}
+
 void register_extension(struct plugin *plugin)
 {
 	plugin->parent = &nvme;
@@ -5728,10 +7526,48 @@ void register_extension(struct plugin *plugin)
 	nvme.extensions->tail = plugin;
 }
 
+/*
+ * --output-file applies to every command, builtin or plugin. It is only
+ * taken before the command name, as several commands have an option of
+ * the same name for their own data file.
+ */
+static int output_file_arg(int *argc, char **argv)
+{
+	const char *opt = "--output-file", *path;
+	size_t len = strlen(opt);
+	int i, n, err;
+
+	if (*argc < 2 || strncmp(argv[1], opt, len))
+		return 0;
+	if (argv[1][len] == '=') {
+		path = argv[1] + len + 1;
+		n = 1;
+	} else if (!argv[1][len] && *argc > 2) {
+		path = argv[2];
+		n = 2;
+	} else {
+		return 0;
+	}
+
+	for (i = 1; i + n < *argc; i++)
+		argv[i] = argv[i + n];
+	*argc -= n;
+	argv[*argc] = NULL;
+
+	err = nvme_output_redirect(path);
+	if (err)
+		fprintf(stderr, "%s: %s\n", path, strerror(-err));
+	return err;
+}
+
 int main(int argc, char **argv)
 {
 	int ret;
 
+	ret = output_file_arg(&argc, argv);
+	if (ret)
+		return -ret;
+
 	nvme.extensions->parent = &nvme;
 	if (argc < 2) {
 		general_help(&builtin);
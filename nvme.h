@@ -152,6 +152,7 @@ struct list_item {
 	int                 nsid;
 	struct nvme_id_ns   ns;
 	unsigned            block;
+	bool                no_nuse;	/* ns.nuse was not read */
 };
 
 struct ctrl_list_item {
@@ -189,6 +190,47 @@ struct connect_args {
 
 #define SYS_NVME		"/sys/class/nvme"
 
+/*
+ * Attributes of a controller in SYS_NVME that connect arguments are
+ * matched against. @state, @hostnqn and @hostid are NULL if the kernel
+ * doesn't export them.
+ */
+struct ctrl_index_item {
+	char *name;
+	char *transport;
+	char *subsysnqn;
+	char *state;
+	char *hostnqn;
+	char *hostid;
+	char *traddr;
+	char *trsvcid;
+	char *host_traddr;
+	struct ctrl_index_item *next_key;
+	struct ctrl_index_item *next_nqn;
+};
+
+/*
+ * Snapshot of all controllers in SYS_NVME, read in one pass. Items are
+ * hashed by the full connect key (transport, traddr, trsvcid, subsysnqn,
+ * host_traddr) and by subsysnqn alone, for lookups with wildcards. Both
+ * chains are kept in controller name order.
+ */
+struct ctrl_index {
+	struct ctrl_index_item *items;
+	int nr;
+	unsigned int size;
+	struct ctrl_index_item **by_key;
+	struct ctrl_index_item **by_nqn;
+};
+
+struct ctrl_index *ctrl_index_scan(void);
+void ctrl_index_free(struct ctrl_index *idx);
+struct ctrl_index_item *ctrl_index_find(struct ctrl_index *idx,
+					struct connect_args *args);
+struct ctrl_index_item *ctrl_index_find_nqn(struct ctrl_index *idx,
+					    const char *subsysnqn,
+					    struct ctrl_index_item *prev);
+
 bool ctrl_matches_connectargs(char *name, struct connect_args *args);
 char *find_ctrl_with_connectargs(struct connect_args *args);
 char *__parse_connect_arg(char *conargs, const char delim, const char *fieldnm);
@@ -5,15 +5,16 @@
 
 #include "plugin.h"
 #include "argconfig.h"
+#include "nvme-output.h"
 
 static int version(struct plugin *plugin)
 {
 	struct program *prog = plugin->parent;
 
 	if (plugin->name)
-		printf("%s %s version %s\n", prog->name, plugin->name, prog->version);
+		fprintf(nvme_out(), "%s %s version %s\n", prog->name, plugin->name, prog->version);
 	else
-		printf("%s version %s\n", prog->name, prog->version);
+		fprintf(nvme_out(), "%s version %s\n", prog->name, prog->version);
 	return 0;
 }
 
@@ -40,6 +41,10 @@ static int help(int argc, char **argv, struct plugin *plugin)
 			sprintf(man, "%s-%s-%s", prog->name, plugin->name, cmd->name);
 		else
 			sprintf(man, "%s-%s", prog->name, cmd->name);
+		if (prog->embedded) {
+			fprintf(nvme_out(), "see man %s\n", man);
+			continue;
+		}
 		if (execlp("man", "man", man, (char *)NULL))
 			perror(argv[1]);
 	}
@@ -51,9 +56,9 @@ void usage(struct plugin *plugin)
 	struct program *prog = plugin->parent;
 
 	if (plugin->name)
-		printf("usage: %s %s %s\n", prog->name, plugin->name, prog->usage);
+		fprintf(nvme_out(), "usage: %s %s %s\n", prog->name, plugin->name, prog->usage);
 	else
-		printf("usage: %s %s\n", prog->name, prog->usage);
+		fprintf(nvme_out(), "usage: %s %s\n", prog->name, prog->usage);
 }
 
 void general_help(struct plugin *plugin)
@@ -63,21 +68,21 @@ void general_help(struct plugin *plugin)
 	unsigned i = 0;
 	unsigned padding = 15;
 	unsigned curr_length = 0;
-	printf("%s-%s\n", prog->name, prog->version);
+	fprintf(nvme_out(), "%s-%s\n", prog->name, prog->version);
 
 	usage(plugin);
 
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 	print_word_wrapped(prog->desc, 0, 0);
-	printf("\n");
+	fprintf(nvme_out(), "\n");
 
 	if (plugin->desc) {
-		printf("\n");
+		fprintf(nvme_out(), "\n");
 		print_word_wrapped(plugin->desc, 0, 0);
-		printf("\n");
+		fprintf(nvme_out(), "\n");
 	}
 
-	printf("\nThe following are all implemented sub-commands:\n");
+	fprintf(nvme_out(), "\nThe following are all implemented sub-commands:\n");
 
 	/* iterate through all commands to get maximum length */
 	/* Still need to handle the case of ultra long strings, help messages, etc */
@@ -87,18 +92,18 @@ void general_help(struct plugin *plugin)
 
 	i = 0;
 	for (; plugin->commands[i]; i++)
-		printf("  %-*s %s\n", padding, plugin->commands[i]->name,
+		fprintf(nvme_out(), "  %-*s %s\n", padding, plugin->commands[i]->name,
 					plugin->commands[i]->help);
 
-	printf("  %-*s %s\n", padding, "version", "Shows the program version");
-	printf("  %-*s %s\n", padding, "help", "Display this help");
-	printf("\n");
+	fprintf(nvme_out(), "  %-*s %s\n", padding, "version", "Shows the program version");
+	fprintf(nvme_out(), "  %-*s %s\n", padding, "help", "Display this help");
+	fprintf(nvme_out(), "\n");
 
 	if (plugin->name)
-		printf("See '%s %s help <command>' for more information on a specific command\n",
+		fprintf(nvme_out(), "See '%s %s help <command>' for more information on a specific command\n",
 			prog->name, plugin->name);
 	else
-		printf("See '%s help <command>' for more information on a specific command\n",
+		fprintf(nvme_out(), "See '%s help <command>' for more information on a specific command\n",
 			prog->name);
 
 	/* The first plugin is the built-in. If we're not showing help for the
@@ -110,12 +115,12 @@ void general_help(struct plugin *plugin)
 	if (!extension)
 		return;
 
-	printf("\nThe following are all installed plugin extensions:\n");
+	fprintf(nvme_out(), "\nThe following are all installed plugin extensions:\n");
 	while (extension) {
-		printf("  %-*s %s\n", 15, extension->name, extension->desc);
+		fprintf(nvme_out(), "  %-*s %s\n", 15, extension->name, extension->desc);
 		extension = extension->next;
 	}
-	printf("\nSee '%s <plugin> help' for more information on a plugin\n",
+	fprintf(nvme_out(), "\nSee '%s <plugin> help' for more information on a plugin\n",
 			prog->name);
 }
 
@@ -160,7 +165,7 @@ int handle_plugin(int argc, char **argv, struct plugin *plugin)
 
 	/* Check extensions only if this is running the built-in plugin */
 	if (plugin->name) { 
-		printf("ERROR: Invalid sub-command '%s' for plugin %s\n", str, plugin->name);
+		fprintf(nvme_out(), "ERROR: Invalid sub-command '%s' for plugin %s\n", str, plugin->name);
 		return -ENOTTY;
         }
 
@@ -183,6 +188,6 @@ int handle_plugin(int argc, char **argv, struct plugin *plugin)
 		}
 		extension = extension->next;
 	}
-	printf("ERROR: Invalid sub-command '%s'\n", str);
+	fprintf(nvme_out(), "ERROR: Invalid sub-command '%s'\n", str);
 	return -ENOTTY;
 }
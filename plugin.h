@@ -11,6 +11,8 @@ struct program {
 	const char *more;
 	struct command **commands;
 	struct plugin *extensions;
+	/* commands run inside a long-lived process, help must not exec */
+	bool embedded;
 };
 
 struct plugin {
@@ -99,7 +99,7 @@ static int huawei_get_nvme_info(int fd, struct huawei_list_item *item, const cha
 
 	memset(item, 0, sizeof(*item));
 
-	err = nvme_identify_ctrl(fd, &item->ctrl);
+	err = nvme_identify_ctrl_cached(fd, &item->ctrl);
 	if (err)
 		return err;
 
@@ -206,7 +206,6 @@ static void huawei_json_print_list_items(struct huawei_list_item *list_items,
 	}
 	json_object_add_value_array(root, "Devices", devices);
 	json_print_object(root, NULL);
-    printf("\n");
 	json_free_object(root);
 }
 
@@ -88,89 +88,87 @@ static int id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *pl
 static void show_intel_smart_log_jsn(struct nvme_additional_smart_log *smart,
 		unsigned int nsid, const char *devname)
 {
-	struct json_object *root, *entry_stats, *dev_stats, *multi;
-
-	root = json_create_object();
-	json_object_add_value_string(root, "Intel Smart log", devname);
-
-	dev_stats = json_create_object();
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->program_fail_cnt.norm);
-	json_object_add_value_int(entry_stats, "raw", int48_to_long(smart->program_fail_cnt.raw));
-	json_object_add_value_object(dev_stats, "program_fail_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->erase_fail_cnt.norm);
-	json_object_add_value_int(entry_stats, "raw", int48_to_long(smart->erase_fail_cnt.raw));
-	json_object_add_value_object(dev_stats, "erase_fail_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->wear_leveling_cnt.norm);
-	multi = json_create_object();
-	json_object_add_value_int(multi, "min", le16_to_cpu(smart->wear_leveling_cnt.wear_level.min));
-	json_object_add_value_int(multi, "max", le16_to_cpu(smart->wear_leveling_cnt.wear_level.max));
-	json_object_add_value_int(multi, "avg", le16_to_cpu(smart->wear_leveling_cnt.wear_level.avg));
-	json_object_add_value_object(entry_stats, "raw", multi);
-	json_object_add_value_object(dev_stats, "wear_leveling", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->e2e_err_cnt.norm);
-	json_object_add_value_int(entry_stats, "raw", int48_to_long(smart->e2e_err_cnt.raw));
-	json_object_add_value_object(dev_stats, "end_to_end_error_detection_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->crc_err_cnt.norm);
-	json_object_add_value_int(entry_stats, "raw", int48_to_long(smart->crc_err_cnt.raw));
-	json_object_add_value_object(dev_stats, "crc_error_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->timed_workload_media_wear.norm);
-	json_object_add_value_float(entry_stats, "raw", ((long double)int48_to_long(smart->timed_workload_media_wear.raw)) / 1024);
-	json_object_add_value_object(dev_stats, "timed_workload_media_wear", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->timed_workload_host_reads.norm);
-	json_object_add_value_int(entry_stats, "raw", int48_to_long(smart->timed_workload_host_reads.raw));
-	json_object_add_value_object(dev_stats, "timed_workload_host_reads", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->timed_workload_timer.norm);
-	json_object_add_value_int(entry_stats, "raw", int48_to_long(smart->timed_workload_timer.raw));
-	json_object_add_value_object(dev_stats, "timed_workload_timer", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->thermal_throttle_status.norm);
-	multi = json_create_object();
-	json_object_add_value_int(multi, "pct", smart->thermal_throttle_status.thermal_throttle.pct);
-	json_object_add_value_int(multi, "cnt", smart->thermal_throttle_status.thermal_throttle.count);
-	json_object_add_value_object(entry_stats, "raw", multi);
-	json_object_add_value_object(dev_stats, "thermal_throttle_status", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->retry_buffer_overflow_cnt.norm);
-	json_object_add_value_int(entry_stats, "raw", 	int48_to_long(smart->retry_buffer_overflow_cnt.raw));
-	json_object_add_value_object(dev_stats, "retry_buffer_overflow_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->pll_lock_loss_cnt.norm);
-	json_object_add_value_int(entry_stats, "raw", 	int48_to_long(smart->pll_lock_loss_cnt.raw));
-	json_object_add_value_object(dev_stats, "pll_lock_loss_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->nand_bytes_written.norm);
-	json_object_add_value_int(entry_stats, "raw", 	int48_to_long(smart->nand_bytes_written.raw));
-	json_object_add_value_object(dev_stats, "nand_bytes_written", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "normalized", smart->host_bytes_written.norm);
-	json_object_add_value_int(entry_stats, "raw", 	int48_to_long(smart->host_bytes_written.raw));
-	json_object_add_value_object(dev_stats, "host_bytes_written", entry_stats);
-
-	json_object_add_value_object(root, "Device stats", dev_stats);
-
-	json_print_object(root, NULL);
-	json_free_object(root);
+	struct json_writer w;
+
+	json_writer_init(&w, nvme_out());
+	json_writer_begin_object(&w, NULL);
+	json_write_string(&w, "Intel Smart log", devname);
+	json_writer_begin_object(&w, "Device stats");
+
+	json_writer_begin_object(&w, "program_fail_count");
+	json_write_int(&w, "normalized", smart->program_fail_cnt.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->program_fail_cnt.raw));
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "erase_fail_count");
+	json_write_int(&w, "normalized", smart->erase_fail_cnt.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->erase_fail_cnt.raw));
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "wear_leveling");
+	json_write_int(&w, "normalized", smart->wear_leveling_cnt.norm);
+	json_writer_begin_object(&w, "raw");
+	json_write_int(&w, "min", le16_to_cpu(smart->wear_leveling_cnt.wear_level.min));
+	json_write_int(&w, "max", le16_to_cpu(smart->wear_leveling_cnt.wear_level.max));
+	json_write_int(&w, "avg", le16_to_cpu(smart->wear_leveling_cnt.wear_level.avg));
+	json_writer_end_object(&w);
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "end_to_end_error_detection_count");
+	json_write_int(&w, "normalized", smart->e2e_err_cnt.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->e2e_err_cnt.raw));
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "crc_error_count");
+	json_write_int(&w, "normalized", smart->crc_err_cnt.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->crc_err_cnt.raw));
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "timed_workload_media_wear");
+	json_write_int(&w, "normalized", smart->timed_workload_media_wear.norm);
+	json_write_float(&w, "raw", ((long double)int48_to_long(smart->timed_workload_media_wear.raw)) / 1024);
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "timed_workload_host_reads");
+	json_write_int(&w, "normalized", smart->timed_workload_host_reads.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->timed_workload_host_reads.raw));
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "timed_workload_timer");
+	json_write_int(&w, "normalized", smart->timed_workload_timer.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->timed_workload_timer.raw));
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "thermal_throttle_status");
+	json_write_int(&w, "normalized", smart->thermal_throttle_status.norm);
+	json_writer_begin_object(&w, "raw");
+	json_write_int(&w, "pct", smart->thermal_throttle_status.thermal_throttle.pct);
+	json_write_int(&w, "cnt", smart->thermal_throttle_status.thermal_throttle.count);
+	json_writer_end_object(&w);
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "retry_buffer_overflow_count");
+	json_write_int(&w, "normalized", smart->retry_buffer_overflow_cnt.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->retry_buffer_overflow_cnt.raw));
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "pll_lock_loss_count");
+	json_write_int(&w, "normalized", smart->pll_lock_loss_cnt.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->pll_lock_loss_cnt.raw));
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "nand_bytes_written");
+	json_write_int(&w, "normalized", smart->nand_bytes_written.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->nand_bytes_written.raw));
+	json_writer_end_object(&w);
+
+	json_writer_begin_object(&w, "host_bytes_written");
+	json_write_int(&w, "normalized", smart->host_bytes_written.norm);
+	json_write_int(&w, "raw", int48_to_long(smart->host_bytes_written.raw));
+	json_writer_end_object(&w);
+
+	json_writer_end_object(&w);
+	json_writer_end_object(&w);
 }
 
 static void show_intel_smart_log(struct nvme_additional_smart_log *smart,
@@ -297,6 +297,7 @@ static void netapp_smdevices_print(struct smdevice_info *devices, int count, int
 		/* complete the json output */
 		json_object_add_value_array(root, "SMdevices", json_devices);
 		json_print_object(root, NULL);
+		json_free_object(root);
 	}
 }
 
@@ -355,6 +356,7 @@ static void netapp_ontapdevices_print(struct ontapdevice_info *devices,
 		/* complete the json output */
 		json_object_add_value_array(root, "ONTAPdevices", json_devices);
 		json_print_object(root, NULL);
+		json_free_object(root);
 	}
 }
 
@@ -393,7 +395,7 @@ static int netapp_smdevices_get_info(int fd, struct smdevice_info *item,
 {
 	int err;
 
-	err = nvme_identify_ctrl(fd, &item->ctrl);
+	err = nvme_identify_ctrl_cached(fd, &item->ctrl);
 	if (err) {
 		fprintf(stderr, "Identify Controller failed to %s (%s)\n", dev,
 			strerror(err));
@@ -420,7 +422,7 @@ static int netapp_ontapdevices_get_info(int fd, struct ontapdevice_info *item,
 {
 	int err;
 
-	err = nvme_identify_ctrl(fd, &item->ctrl);
+	err = nvme_identify_ctrl_cached(fd, &item->ctrl);
 	if (err) {
 		fprintf(stderr, "Identify Controller failed to %s (%s)\n",
 				dev, strerror(err));
@@ -32,6 +32,7 @@
 #include "nvme.h"
 #include "nvme-print.h"
 #include "nvme-ioctl.h"
+#include "nvme-capture.h"
 #include "plugin.h"
 #include "argconfig.h"
 #include "suffix.h"
@@ -148,7 +149,7 @@ static void json_log_pages_supp(log_page_map *logPageMap)
 		json_array_add_value_object(logPages, lbaf);
 	}
 	json_print_object(root, NULL);
-	printf("\n");
+	json_free_object(root);
 }
 
 static int log_pages_supp(int argc, char **argv, struct command *cmd,
@@ -603,7 +604,6 @@ static void json_print_smart_log(struct json_object *root,
 
 	/*
 	  json_print_object(root, NULL);
-	  printf("\n");
 	*/
 }
 
@@ -709,7 +709,6 @@ static void json_print_smart_log_CF(struct json_object *root,
 
 	/*
 	  json_print_object(root, NULL);
-	  printf("\n");
 	*/
 }
 
@@ -718,11 +717,9 @@ static int vs_smart_log(int argc, char **argv, struct command *cmd, struct plugi
 	EXTENDED_SMART_INFO_T   ExtdSMARTInfo;
 	vendor_log_page_CF      logPageCF;
 	int fd;
-	struct json_object *root;
-	struct json_array *lbafs;
+	struct json_object *root = NULL;
+	struct json_array *lbafs = NULL;
 	struct json_object *lbafs_ExtSmart, *lbafs_DramSmart;
-	root = json_create_object();
-	lbafs = json_create_array();
 
 	const char *desc = "Retrieve Seagate Extended SMART information for the given device ";
 	const char *output_format = "output in binary format";
@@ -755,6 +752,8 @@ static int vs_smart_log(int argc, char **argv, struct command *cmd, struct plugi
 				print_smart_log(ExtdSMARTInfo.Version, ExtdSMARTInfo.vendorData[index], index == (NUMBER_EXTENDED_SMART_ATTRIBUTES - 1));
 
 		} else {
+			root = json_create_object();
+			lbafs = json_create_array();
 			lbafs_ExtSmart = json_create_object();
 			json_print_smart_log(lbafs_ExtSmart, &ExtdSMARTInfo);
 
@@ -784,6 +783,8 @@ static int vs_smart_log(int argc, char **argv, struct command *cmd, struct plugi
 		fprintf(stderr, "NVMe Status:%s(%x)\n",
 			nvme_status_to_string(err), err);
 
+	if (root)
+		json_free_object(root);
 	return err;
 }
 //EOF Extended-SMART Information
@@ -808,8 +809,7 @@ static void json_temp_stats(__u32 temperature, __u32 PcbTemp, __u32 SocTemp, __u
 	}
 
 	json_print_object(root, NULL);
-	printf("\n");
-
+	json_free_object(root);
 }
 static int temp_stats(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
@@ -985,7 +985,7 @@ static void json_vs_pcie_error_log(pcie_error_log_page pcieErrorLog)
 	json_object_add_value_int(root, "Cpl TLP Poisoned Error Count", pcieErrorLog.CplTlpPoisonedErrCnt);
 	json_object_add_value_int(root, "Request Completion Abort Error Count", pcieErrorLog.ReqCAErrCnt);
 	json_print_object(root, NULL);
-	printf("\n");
+	json_free_object(root);
 }
 
 static int vs_pcie_error_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
@@ -1061,6 +1061,34 @@ static int vs_clr_pcie_correctable_errs(int argc, char **argv, struct command *c
 
 }
 
+/*
+ * Copy telemetry data blocks 1 to maxBlk straight into dump_fd, in
+ * transfers sized by the controller's MDTS.
+ */
+static int seagate_capture_tele(int fd, __u32 nsid, __u8 log_id,
+				__u64 offset, int maxBlk, int dump_fd)
+{
+	struct nvme_capture cap;
+	int err;
+
+	memset(&cap, 0, sizeof(cap));
+	cap.fd = fd;
+	cap.out = dump_fd;
+	cap.offset = offset;
+	cap.len = (__u64)maxBlk * 512;
+	cap.nsid = nsid;
+	cap.log_id = log_id;
+	cap.progress = true;
+
+	err = nvme_capture_log(&cap);
+	if (err > 0)
+		fprintf(stderr, "NVMe Status:%s(%x)\n",
+			nvme_status_to_string(err), err);
+	else if (err < 0)
+		fprintf(stderr, "log page: %s\n", strerror(-err));
+	return err;
+}
+
 static int get_host_tele(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Capture the Telemetry Host-Initiated Data in either " \
@@ -1126,19 +1154,26 @@ static int get_host_tele(int argc, char **argv, struct command *cmd, struct plug
 	else
 		perror("log page");
 
+	if (!err && cfg.raw_binary) {
+		err = seagate_capture_tele(fd, cfg.namespace_id, cfg.log_id,
+					   offset, maxBlk, dump_fd);
+		goto close_fd;
+	}
+
 	blkCnt = 0;
 
 	while(blkCnt < maxBlk) {
 		blksToGet = ((maxBlk - blkCnt) >= TELEMETRY_BLOCKS_TO_READ) ? TELEMETRY_BLOCKS_TO_READ : (maxBlk - blkCnt);
 
 		if(blksToGet == 0)
-			return err;
+			break;
 
 		log = malloc(blksToGet * 512);
 
 		if (!log) {
 			fprintf(stderr, "could not alloc buffer for log\n");
-			return EINVAL;
+			err = EINVAL;
+			break;
 		}
 
 		memset(log, 0, blksToGet * 512);
@@ -1166,8 +1201,9 @@ static int get_host_tele(int argc, char **argv, struct command *cmd, struct plug
 		free(log);
 	}
 
+close_fd:
+	close(fd);
 	return err;
-
 }
 
 static int get_ctrl_tele(int argc, char **argv, struct command *cmd, struct plugin *plugin)
@@ -1227,19 +1263,26 @@ static int get_ctrl_tele(int argc, char **argv, struct command *cmd, struct plug
 	else
 		perror("log page");
 
+	if (!err && cfg.raw_binary) {
+		err = seagate_capture_tele(fd, cfg.namespace_id, log_id,
+					   offset, maxBlk, dump_fd);
+		goto close_fd;
+	}
+
 	blkCnt = 0;
 
 	while(blkCnt < maxBlk) {
 		blksToGet = ((maxBlk - blkCnt) >= TELEMETRY_BLOCKS_TO_READ) ? TELEMETRY_BLOCKS_TO_READ : (maxBlk - blkCnt);
 
 		if(blksToGet == 0)
-			return err;
+			break;
 
 		log = malloc(blksToGet * 512);
 
 		if (!log) {
 			fprintf(stderr, "could not alloc buffer for log\n");
-			return EINVAL;
+			err = EINVAL;
+			break;
 		}
 
 		memset(log, 0, blksToGet * 512);
@@ -1266,8 +1309,10 @@ static int get_ctrl_tele(int argc, char **argv, struct command *cmd, struct plug
 
 		free(log);
 	}
-	return err;
 
+close_fd:
+	close(fd);
+	return err;
 }
 
 void seaget_d_raw(unsigned char *buf, int len, int fd)
@@ -1297,8 +1342,7 @@ static int vs_internal_log(int argc, char **argv, struct command *cmd, struct pl
 	struct nvme_temetry_log_hdr tele_log;
 	__le64  offset = 0;
 	__u16 log_id;
-	int blkCnt, maxBlk = 0, blksToGet;
-	unsigned char  *log;
+	int maxBlk = 0;
 
 	struct config {
 		__u32 namespace_id;
@@ -1350,42 +1394,9 @@ static int vs_internal_log(int argc, char **argv, struct command *cmd, struct pl
 	else
 		perror("log page");
 
-	blkCnt = 0;
-
-	while(blkCnt < maxBlk) {
-		blksToGet = ((maxBlk - blkCnt) >= TELEMETRY_BLOCKS_TO_READ) ? TELEMETRY_BLOCKS_TO_READ : (maxBlk - blkCnt);
-
-		if(blksToGet == 0) {
-			return err;
-		}
-
-		log = malloc(blksToGet * 512);
-
-		if (!log) {
-			fprintf(stderr, "could not alloc buffer for log\n");
-			return EINVAL;
-		}
-
-		memset(log, 0, blksToGet * 512);
-
-		err = nvme_get_log13(fd, cfg.namespace_id, log_id,
-				     NVME_NO_LOG_LSP, offset, 0, false,
-				     blksToGet * 512, (void *)log);
-		if (!err) {
-			offset += blksToGet * 512;
-
-			seaget_d_raw((unsigned char *)log, blksToGet * 512, dump_fd);
-
-		} else if (err > 0)
-			fprintf(stderr, "NVMe Status:%s(%x)\n",
-				nvme_status_to_string(err), err);
-		else
-			perror("log page");
-
-		blkCnt += blksToGet;
-
-		free(log);
-	}
+	if (!err)
+		err = seagate_capture_tele(fd, cfg.namespace_id, log_id,
+					   offset, maxBlk, dump_fd);
 
 	if(strlen(cfg.file))
 		close(dump_fd);
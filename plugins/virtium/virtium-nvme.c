@@ -56,19 +56,6 @@ struct vtview_save_log_settings
     const char*                     test_name;
 };
 
-static long double int128_to_double(__u8 *data)
-{
-    int i;
-    long double result = 0;
-
-    for (i = 0; i < 16; i++) 
-    {
-        result *= 256;
-        result += data[15 - i];
-    }
-    return result;
-}
-
 static void vt_initialize_header_buffer(struct vtview_log_header *pbuff)
 {
     memset(pbuff->path, 0, sizeof(pbuff->path));
@@ -126,6 +113,7 @@ static void vt_generate_vtview_log_file_name(char* fname)
 static void vt_convert_smart_data_to_human_readable_format(struct vtview_smart_log_entry *smart, char *text)
 {
     char tempbuff[1024] = "";
+    char str[UINT128_STRLEN];
     int i;
     int temperature = ((smart->raw_smart.temperature[1] << 8) | smart->raw_smart.temperature[0]) - 273;
 
@@ -144,25 +132,25 @@ static void vt_convert_smart_data_to_human_readable_format(struct vtview_smart_l
     strcat(text, tempbuff);
     snprintf(tempbuff, sizeof(tempbuff), "Percentage_Used;%u;", smart->raw_smart.percent_used);
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Data_Units_Read;%0.Lf;", int128_to_double(smart->raw_smart.data_units_read));
+    snprintf(tempbuff, sizeof(tempbuff), "Data_Units_Read;%s;", le128_to_str(smart->raw_smart.data_units_read, str, false));
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Data_Units_Written;%0.Lf;", int128_to_double(smart->raw_smart.data_units_written));
+    snprintf(tempbuff, sizeof(tempbuff), "Data_Units_Written;%s;", le128_to_str(smart->raw_smart.data_units_written, str, false));
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Host_Read_Commands;%0.Lf;", int128_to_double(smart->raw_smart.host_reads));
+    snprintf(tempbuff, sizeof(tempbuff), "Host_Read_Commands;%s;", le128_to_str(smart->raw_smart.host_reads, str, false));
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Host_Write_Commands;%0.Lf;", int128_to_double(smart->raw_smart.host_writes));
+    snprintf(tempbuff, sizeof(tempbuff), "Host_Write_Commands;%s;", le128_to_str(smart->raw_smart.host_writes, str, false));
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Controller_Busy_Time;%0.Lf;", int128_to_double(smart->raw_smart.ctrl_busy_time));
+    snprintf(tempbuff, sizeof(tempbuff), "Controller_Busy_Time;%s;", le128_to_str(smart->raw_smart.ctrl_busy_time, str, false));
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Power_Cycles;%0.Lf;", int128_to_double(smart->raw_smart.power_cycles));
+    snprintf(tempbuff, sizeof(tempbuff), "Power_Cycles;%s;", le128_to_str(smart->raw_smart.power_cycles, str, false));
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Power_On_Hours;%0.Lf;", int128_to_double(smart->raw_smart.power_on_hours));
+    snprintf(tempbuff, sizeof(tempbuff), "Power_On_Hours;%s;", le128_to_str(smart->raw_smart.power_on_hours, str, false));
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Unsafe_Shutdowns;%0.Lf;", int128_to_double(smart->raw_smart.unsafe_shutdowns));
+    snprintf(tempbuff, sizeof(tempbuff), "Unsafe_Shutdowns;%s;", le128_to_str(smart->raw_smart.unsafe_shutdowns, str, false));
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Media_Errors;%0.Lf;", int128_to_double(smart->raw_smart.media_errors));
+    snprintf(tempbuff, sizeof(tempbuff), "Media_Errors;%s;", le128_to_str(smart->raw_smart.media_errors, str, false));
     strcat(text, tempbuff);
-    snprintf(tempbuff, sizeof(tempbuff), "Num_Err_Log_Entries;%0.Lf;", int128_to_double(smart->raw_smart.num_err_log_entries));
+    snprintf(tempbuff, sizeof(tempbuff), "Num_Err_Log_Entries;%s;", le128_to_str(smart->raw_smart.num_err_log_entries, str, false));
     strcat(text, tempbuff);
     snprintf(tempbuff, sizeof(tempbuff), "Warning_Temperature_Time;%u;", le32_to_cpu(smart->raw_smart.warning_temp_time));
     strcat(text, tempbuff);
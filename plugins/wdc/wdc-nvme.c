@@ -35,6 +35,7 @@
 #include "nvme.h"
 #include "nvme-print.h"
 #include "nvme-ioctl.h"
+#include "nvme-capture.h"
 #include "plugin.h"
 #include "json.h"
 
@@ -618,18 +619,6 @@ static double calc_percent(uint64_t numerator, uint64_t denominator)
 		(uint64_t)(((double)numerator / (double)denominator) * 100) : 0;
 }
 
-static long double int128_to_double(__u8 *data)
-{
-	int i;
-	long double result = 0;
-
-	for (i = 0; i < 16; i++) {
-		result *= 256;
-		result += data[15 - i];
-	}
-	return result;
-}
-
 static int wdc_get_pci_ids(uint32_t *device_id, uint32_t *vendor_id)
 {
 	int fd, ret = -1;
@@ -1083,7 +1072,7 @@ static __u32 wdc_dump_length_e6(int fd, __u32 opcode, __u32 cdw10, __u32 cdw12,
 	return ret;
 }
 
-static __u32 wdc_dump_dui_data(int fd, __u32 dataLen, __u32 offset, __u8 *dump_data, bool last_xfer)
+static int wdc_dump_dui_data(int fd, __u32 dataLen, __u32 offset, __u8 *dump_data, bool last_xfer)
 {
 	int ret;
 	struct nvme_admin_cmd admin_cmd;
@@ -1102,7 +1091,11 @@ static __u32 wdc_dump_dui_data(int fd, __u32 dataLen, __u32 offset, __u8 *dump_d
 
 
 	ret = nvme_submit_passthru(fd, NVME_IOCTL_ADMIN_CMD, &admin_cmd);
-	if (ret != 0) {
+	if (ret < 0) {
+		ret = -errno;
+		fprintf(stderr, "ERROR : WDC : reading DUI data failed : %s\n",
+				strerror(-ret));
+	} else if (ret != 0) {
 		fprintf(stderr, "ERROR : WDC : reading DUI data failed\n");
 		fprintf(stderr, "NVMe Status:%s(%x)\n", nvme_status_to_string(ret), ret);
 	}
@@ -1110,7 +1103,7 @@ static __u32 wdc_dump_dui_data(int fd, __u32 dataLen, __u32 offset, __u8 *dump_d
 	return ret;
 }
 
-static __u32 wdc_dump_dui_data_v2(int fd, __u32 dataLen, __u64 offset, __u8 *dump_data, bool last_xfer)
+static int wdc_dump_dui_data_v2(int fd, __u32 dataLen, __u64 offset, __u8 *dump_data, bool last_xfer)
 {
 	int ret;
 	struct nvme_admin_cmd admin_cmd;
@@ -1129,7 +1122,11 @@ static __u32 wdc_dump_dui_data_v2(int fd, __u32 dataLen, __u64 offset, __u8 *dum
 		admin_cmd.cdw14 = WDC_NVME_CAP_DUI_DISABLE_IO;
 
 	ret = nvme_submit_passthru(fd, NVME_IOCTL_ADMIN_CMD, &admin_cmd);
-	if (ret != 0) {
+	if (ret < 0) {
+		ret = -errno;
+		fprintf(stderr, "ERROR : WDC : reading DUI data V2 failed : %s\n",
+				strerror(-ret));
+	} else if (ret != 0) {
 		fprintf(stderr, "ERROR : WDC : reading DUI data V2 failed\n");
 		fprintf(stderr, "NVMe Status:%s(%x)\n", nvme_status_to_string(ret), ret);
 	}
@@ -1300,6 +1297,43 @@ out:
 	return ret;
 }
 
+static int wdc_dui_read_chunk(int fd, void *priv, __u64 offset, __u32 len,
+		void *buf, bool last)
+{
+	bool v2 = *(bool *)priv;
+
+	if (v2)
+		return wdc_dump_dui_data_v2(fd, len, offset, buf, last);
+	return wdc_dump_dui_data(fd, len, (__u32)offset, buf, last);
+}
+
+/* Copy the DUI data behind the headers to output, overlapping reads and writes */
+static int wdc_capture_dui(int fd, int output, bool v2, __u64 offset,
+		__s64 log_size, __u32 xfer_size)
+{
+	struct nvme_capture cap;
+	int ret;
+
+	if (log_size <= 0)
+		return 0;
+
+	memset(&cap, 0, sizeof(cap));
+	cap.fd = fd;
+	cap.out = output;
+	cap.offset = offset;
+	cap.len = log_size;
+	cap.xfer = xfer_size;
+	cap.read = wdc_dui_read_chunk;
+	cap.priv = &v2;
+	cap.progress = true;
+
+	ret = nvme_capture_log(&cap);
+	if (ret < 0)
+		fprintf(stderr, "%s: ERROR : WDC : Failed to capture DUI data : %s\n",
+				__func__, strerror(-ret));
+	return ret;
+}
+
 static int wdc_do_cap_dui(int fd, char *file, __u32 xfer_size, int data_area, int verbose)
 {
 	int ret = 0;
@@ -1308,10 +1342,7 @@ static int wdc_do_cap_dui(int fd, char *file, __u32 xfer_size, int data_area, in
 	struct wdc_dui_log_hdr_v2 *log_hdr_v2;
 	__u32 cap_dui_length;
 	__u64 cap_dui_length_v2;
-	__u8 *dump_data = NULL;
-	__u64 buffer_addr;
 	__s64 total_size = 0;
-	int i;
 	int j;
 	bool last_xfer = false;
 	int err = 0, output = 0;
@@ -1369,15 +1400,6 @@ static int wdc_do_cap_dui(int fd, char *file, __u32 xfer_size, int data_area, in
 
 			total_size = log_size;
 
-			dump_data = (__u8 *) malloc(sizeof (__u8) * xfer_size_long);
-			if (dump_data == NULL) {
-				fprintf(stderr, "%s: ERROR : dump data V2 malloc failed : status %s, size = 0x%lx\n",
-						__func__, strerror(errno), (long unsigned int)xfer_size_long);
-				ret = -1;
-				goto out;
-			}
-			memset(dump_data, 0, sizeof (__u8) * xfer_size_long);
-
 			output = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
 			if (output < 0) {
 				fprintf(stderr, "%s: Failed to open output file %s: %s!\n",
@@ -1395,34 +1417,8 @@ static int wdc_do_cap_dui(int fd, char *file, __u32 xfer_size, int data_area, in
 
 			log_size -= WDC_NVME_CAP_DUI_HEADER_SIZE;
 			curr_data_offset = WDC_NVME_CAP_DUI_HEADER_SIZE;
-			i = 0;
-			buffer_addr = (__u64)(uintptr_t)dump_data;
-
-			for(; log_size > 0; log_size -= xfer_size_long) {
-				xfer_size_long = min(xfer_size_long, log_size);
-
-				if (log_size <= xfer_size_long)
-					last_xfer = true;
-
-				ret = wdc_dump_dui_data_v2(fd, (__u32)xfer_size_long, curr_data_offset, (__u8 *)buffer_addr, last_xfer);
-				if (ret != 0) {
-					fprintf(stderr, "%s: ERROR : WDC : Get chunk %d, size = 0x%lx, offset = 0x%lx, addr = 0x%lx\n",
-							__func__, i, (long unsigned int)total_size, (long unsigned int)curr_data_offset, (long unsigned int)buffer_addr);
-					fprintf(stderr, "%s: ERROR : WDC : NVMe Status:%s(%x)\n", __func__, nvme_status_to_string(ret), ret);
-					break;
-				}
-
-				/* write the dump data into the file */
-				err = write(output, (void *)buffer_addr, xfer_size_long);
-				if (err != xfer_size_long) {
-					fprintf(stderr, "%s: ERROR : WDC : Failed to flush DUI data to file! chunk %d, err = 0x%x, xfer_size = 0x%lx\n",
-							__func__, i, err, (long unsigned int)xfer_size_long);
-					goto free_mem;
-				}
-
-				curr_data_offset += xfer_size_long;
-				i++;
-			}
+			ret = wdc_capture_dui(fd, output, true, curr_data_offset,
+					log_size, xfer_size_long);
 		}
 	} else	{
 		__s32 log_size = 0;
@@ -1458,15 +1454,6 @@ static int wdc_do_cap_dui(int fd, char *file, __u32 xfer_size, int data_area, in
 
 			total_size = log_size;
 
-			dump_data = (__u8 *) malloc(sizeof (__u8) * xfer_size);
-			if (dump_data == NULL) {
-				fprintf(stderr, "%s: ERROR : dump data V1 malloc failed : status %s, size = 0x%x\n",
-						__func__, strerror(errno), (unsigned int)xfer_size);
-				ret = -1;
-				goto out;
-			}
-			memset(dump_data, 0, sizeof (__u8) * xfer_size);
-
 			output = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
 			if (output < 0) {
 				fprintf(stderr, "%s: Failed to open output file %s: %s!\n",
@@ -1484,34 +1471,8 @@ static int wdc_do_cap_dui(int fd, char *file, __u32 xfer_size, int data_area, in
 
 			log_size -= WDC_NVME_CAP_DUI_HEADER_SIZE;
 			curr_data_offset = WDC_NVME_CAP_DUI_HEADER_SIZE;
-			i = 0;
-			buffer_addr = (__u64)(uintptr_t)dump_data;
-
-			for(; log_size > 0; log_size -= xfer_size) {
-				xfer_size = min(xfer_size, log_size);
-
-				if (log_size <= xfer_size)
-					last_xfer = true;
-
-				ret = wdc_dump_dui_data(fd, xfer_size, curr_data_offset, (__u8 *)buffer_addr, last_xfer);
-				if (ret != 0) {
-					fprintf(stderr, "%s: ERROR : WDC : Get chunk %d, size = 0x%lx, offset = 0x%x, addr = 0x%lx\n",
-							__func__, i, (long unsigned int)log_size, curr_data_offset, (long unsigned int)buffer_addr);
-					fprintf(stderr, "%s: ERROR : WDC : NVMe Status:%s(%x)\n", __func__, nvme_status_to_string(ret), ret);
-					break;
-				}
-
-				/* write the dump data into the file */
-				err = write(output, (void *)buffer_addr, xfer_size);
-				if (err != xfer_size) {
-					fprintf(stderr, "%s: ERROR : WDC : Failed to flush DUI data to file! chunk %d, err = 0x%x, xfer_size = 0x%x\n",
-							__func__, i, err, xfer_size);
-					goto free_mem;
-				}
-
-				curr_data_offset += xfer_size;
-				i++;
-			}
+			ret = wdc_capture_dui(fd, output, false, curr_data_offset,
+					log_size, xfer_size);
 		}
 	}
 
@@ -1521,7 +1482,6 @@ static int wdc_do_cap_dui(int fd, char *file, __u32 xfer_size, int data_area, in
 
  free_mem:
 	close(output);
-	free(dump_data);
 
  out:
 	free(log_hdr);
@@ -2414,7 +2374,6 @@ static void wdc_print_log_json(struct wdc_ssd_perf_stats *perf)
 	json_object_add_value_int(root, "NAND Read Before Written",
 			le64_to_cpu(perf->nrbw));
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -2555,7 +2514,6 @@ static void wdc_print_ca_log_json(struct wdc_ssd_ca_perf_stats *perf)
 	json_object_add_value_int(root, "Incomplete Shutdown Counte", le32_to_cpu(perf->incomplete_shutdown_count));
 	json_object_add_value_int(root, "Percent Free Blocks", perf->percent_free_blocks);
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -2610,57 +2568,56 @@ static void wdc_print_d0_log_normal(struct wdc_ssd_d0_smart_log *perf)
 
 static void wdc_print_d0_log_json(struct wdc_ssd_d0_smart_log *perf)
 {
-	struct json_object *root;
+	struct json_writer w;
 
-	root = json_create_object();
-	json_object_add_value_int(root, "Lifetime Reallocated Erase Block Count",
+	json_writer_init(&w, nvme_out());
+	json_writer_begin_object(&w, NULL);
+	json_write_int(&w, "Lifetime Reallocated Erase Block Count",
 			le32_to_cpu(perf->lifetime_realloc_erase_block_count));
-	json_object_add_value_int(root, "Lifetime Power on Hours",
+	json_write_int(&w, "Lifetime Power on Hours",
 			le32_to_cpu(perf->lifetime_power_on_hours));
-	json_object_add_value_int(root, "Lifetime UECC Count",
+	json_write_int(&w, "Lifetime UECC Count",
 			le32_to_cpu(perf->lifetime_uecc_count));
-	json_object_add_value_int(root, "Lifetime Write Amplification Factor",
+	json_write_int(&w, "Lifetime Write Amplification Factor",
 			le32_to_cpu(perf->lifetime_wrt_amp_factor));
-	json_object_add_value_int(root, "Trailing Hour Write Amplification Factor",
+	json_write_int(&w, "Trailing Hour Write Amplification Factor",
 			le32_to_cpu(perf->trailing_hr_wrt_amp_factor));
-	json_object_add_value_int(root, "Reserve Erase Block Count",
+	json_write_int(&w, "Reserve Erase Block Count",
 			le32_to_cpu(perf->reserve_erase_block_count));
-	json_object_add_value_int(root, "Lifetime Program Fail Count",
+	json_write_int(&w, "Lifetime Program Fail Count",
 			le32_to_cpu(perf->lifetime_program_fail_count));
-	json_object_add_value_int(root, "Lifetime Block Erase Fail Count",
+	json_write_int(&w, "Lifetime Block Erase Fail Count",
 			le32_to_cpu(perf->lifetime_block_erase_fail_count));
-	json_object_add_value_int(root, "Lifetime Die Failure Count",
+	json_write_int(&w, "Lifetime Die Failure Count",
 			le32_to_cpu(perf->lifetime_die_failure_count));
-	json_object_add_value_int(root, "Lifetime Link Rate Downgrade Count",
+	json_write_int(&w, "Lifetime Link Rate Downgrade Count",
 			le32_to_cpu(perf->lifetime_link_rate_downgrade_count));
-	json_object_add_value_int(root, "Lifetime Clean Shutdown Count on Power Loss",
+	json_write_int(&w, "Lifetime Clean Shutdown Count on Power Loss",
 			le32_to_cpu(perf->lifetime_clean_shutdown_count));
-	json_object_add_value_int(root, "Lifetime Unclean Shutdowns on Power Loss",
+	json_write_int(&w, "Lifetime Unclean Shutdowns on Power Loss",
 			le32_to_cpu(perf->lifetime_unclean_shutdown_count));
-	json_object_add_value_int(root, "Current Temperature",
+	json_write_int(&w, "Current Temperature",
 			le32_to_cpu(perf->current_temp));
-	json_object_add_value_int(root, "Max Recorded Temperature",
+	json_write_int(&w, "Max Recorded Temperature",
 			le32_to_cpu(perf->max_recorded_temp));
-	json_object_add_value_int(root, "Lifetime Retired Block Count",
+	json_write_int(&w, "Lifetime Retired Block Count",
 			le32_to_cpu(perf->lifetime_retired_block_count));
-	json_object_add_value_int(root, "Lifetime Read Disturb Reallocation Events",
+	json_write_int(&w, "Lifetime Read Disturb Reallocation Events",
 			le32_to_cpu(perf->lifetime_read_disturb_realloc_events));
-	json_object_add_value_int(root, "Lifetime NAND Writes",
+	json_write_int(&w, "Lifetime NAND Writes",
 			le64_to_cpu(perf->lifetime_nand_writes));
-	json_object_add_value_int(root, "Capacitor Health",
+	json_write_int(&w, "Capacitor Health",
 			le32_to_cpu(perf->capacitor_health));
-	json_object_add_value_int(root, "Lifetime User Writes",
+	json_write_int(&w, "Lifetime User Writes",
 			le64_to_cpu(perf->lifetime_user_writes));
-	json_object_add_value_int(root, "Lifetime User Reads",
+	json_write_int(&w, "Lifetime User Reads",
 			le64_to_cpu(perf->lifetime_user_reads));
-	json_object_add_value_int(root, "Lifetime Thermal Throttle Activations",
+	json_write_int(&w, "Lifetime Thermal Throttle Activations",
 			le32_to_cpu(perf->lifetime_thermal_throttle_act));
-	json_object_add_value_int(root, "Percentage of P/E Cycles Remaining",
+	json_write_int(&w, "Percentage of P/E Cycles Remaining",
 			le32_to_cpu(perf->percentage_pe_cycles_remaining));
 
-	json_print_object(root, NULL);
-	printf("\n");
-	json_free_object(root);
+	json_writer_end_object(&w);
 }
 
 static int wdc_print_ca_log(struct wdc_ssd_ca_perf_stats *perf, int fmt)
@@ -3900,11 +3857,13 @@ static int wdc_drive_resize(int argc, char **argv,
 
 static void wdc_print_nand_stats_normal(struct wdc_nand_stats *data)
 {
+	char str[UINT128_STRLEN];
+
 	printf("  NAND Statistics :- \n");
-	printf("  NAND Writes TLC (Bytes)		         %.0Lf\n",
-			int128_to_double(data->nand_write_tlc));
-	printf("  NAND Writes SLC (Bytes)		         %.0Lf\n",
-			int128_to_double(data->nand_write_slc));
+	printf("  NAND Writes TLC (Bytes)		         %s\n",
+			le128_to_str(data->nand_write_tlc, str, false));
+	printf("  NAND Writes SLC (Bytes)		         %s\n",
+			le128_to_str(data->nand_write_slc, str, false));
 	printf("  NAND Program Failures			  	 %"PRIu32"\n",
 			(uint32_t)le32_to_cpu(data->nand_prog_failure));
 	printf("  NAND Erase Failures				 %"PRIu32"\n",
@@ -3920,10 +3879,10 @@ static void wdc_print_nand_stats_json(struct wdc_nand_stats *data)
 	struct json_object *root;
 
 	root = json_create_object();
-	json_object_add_value_float(root, "NAND Writes TLC (Bytes)",
-			int128_to_double(data->nand_write_tlc));
-	json_object_add_value_float(root, "NAND Writes SLC (Bytes)",
-			int128_to_double(data->nand_write_slc));
+	json_object_add_value_uint128(root, "NAND Writes TLC (Bytes)",
+			uint128_from_le(data->nand_write_tlc));
+	json_object_add_value_uint128(root, "NAND Writes SLC (Bytes)",
+			uint128_from_le(data->nand_write_slc));
 	json_object_add_value_uint(root, "NAND Program Failures",
 			le32_to_cpu(data->nand_prog_failure));
 	json_object_add_value_uint(root, "NAND Erase Failures",
@@ -3934,7 +3893,6 @@ static void wdc_print_nand_stats_json(struct wdc_nand_stats *data)
 			le64_to_cpu(data->nand_rec_trigger_event));
 
 	json_print_object(root, NULL);
-	printf("\n");
 	json_free_object(root);
 }
 
@@ -0,0 +1,112 @@
+#include <limits.h>
+#include <locale.h>
+#include <string.h>
+
+#include "uint128.h"
+
+struct uint128 uint128_from_le(const void *data)
+{
+	const uint8_t *p = data;
+	struct uint128 val = { 0, 0 };
+	int i;
+
+	for (i = 7; i >= 0; i--) {
+		val.lo = val.lo << 8 | p[i];
+		val.hi = val.hi << 8 | p[i + 8];
+	}
+	return val;
+}
+
+/*
+ * Writes the digits backwards from @end and returns the first one. The
+ * value is split into 32-bit limbs and divided by 10^9 per round, so a
+ * full 128-bit value takes five rounds and anything below 2^64 never
+ * leaves the 64-bit fast path.
+ */
+static char *uint128_digits(struct uint128 val, char *end)
+{
+	uint32_t limb[4] = {
+		val.hi >> 32, (uint32_t)val.hi, val.lo >> 32, (uint32_t)val.lo,
+	};
+	uint64_t rem, lo;
+	int i, n;
+
+	while (limb[0] || limb[1]) {
+		rem = 0;
+		for (i = 0; i < 4; i++) {
+			rem = rem << 32 | limb[i];
+			limb[i] = rem / 1000000000;
+			rem %= 1000000000;
+		}
+		for (n = 0; n < 9; n++) {
+			*--end = '0' + rem % 10;
+			rem /= 10;
+		}
+	}
+
+	lo = (uint64_t)limb[2] << 32 | limb[3];
+	do {
+		*--end = '0' + lo % 10;
+		lo /= 10;
+	} while (lo);
+	return end;
+}
+
+/* Same rules as the printf ' flag, see localeconv(3) */
+static bool uint128_group(const char *digits, int ndigits, char *buf)
+{
+	const struct lconv *lc = localeconv();
+	const char *grouping = lc->grouping, *sep = lc->thousands_sep;
+	int seplen = strlen(sep), size = 0, left = ndigits, len = 0, i;
+	int groups[40], ngroups = 0;
+
+	if (!seplen || !grouping || !*grouping)
+		return false;
+
+	/* group sizes from the least significant digit up */
+	while (left > 0) {
+		if (*grouping == CHAR_MAX || *grouping < 0)
+			break;
+		if (*grouping)
+			size = *grouping++;
+		if (!size || left <= size)
+			break;
+		groups[ngroups++] = size;
+		left -= size;
+	}
+	if (ndigits + ngroups * seplen >= UINT128_STRLEN)
+		return false;
+
+	memcpy(buf, digits, left);
+	len = left;
+	digits += left;
+	for (i = ngroups - 1; i >= 0; i--) {
+		memcpy(buf + len, sep, seplen);
+		len += seplen;
+		memcpy(buf + len, digits, groups[i]);
+		len += groups[i];
+		digits += groups[i];
+	}
+	buf[len] = '\0';
+	return true;
+}
+
+char *uint128_to_str(struct uint128 val, char *buf, bool group)
+{
+	char tmp[40], *digits, *end = tmp + sizeof(tmp);
+	int ndigits;
+
+	digits = uint128_digits(val, end);
+	ndigits = end - digits;
+	if (group && uint128_group(digits, ndigits, buf))
+		return buf;
+
+	memcpy(buf, digits, ndigits);
+	buf[ndigits] = '\0';
+	return buf;
+}
+
+char *le128_to_str(const void *data, char *buf, bool group)
+{
+	return uint128_to_str(uint128_from_le(data), buf, group);
+}
@@ -0,0 +1,33 @@
+#ifndef _UINT128_H
+#define _UINT128_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * 128-bit unsigned counters as found in the NVMe log pages, e.g. the
+ * SMART data units read/written. They do not fit any native type on all
+ * platforms and lose precision above 2^64 when converted to long double.
+ */
+struct uint128 {
+	uint64_t lo;
+	uint64_t hi;
+};
+
+/* Longest decimal string, including digit grouping and the NUL */
+#define UINT128_STRLEN	80
+
+/* Reads a 16 byte little endian counter */
+struct uint128 uint128_from_le(const void *data);
+
+/*
+ * Formats @val in decimal into @buf, which must hold UINT128_STRLEN
+ * bytes, and returns @buf. @group inserts the thousands separator of
+ * the current locale, as printf's ' flag does.
+ */
+char *uint128_to_str(struct uint128 val, char *buf, bool group);
+
+/* Same, reading the little endian counter at @data */
+char *le128_to_str(const void *data, char *buf, bool group);
+
+#endif /* _UINT128_H */